@@ -1,13 +1,19 @@
 #include "WiFiManager.h"
 #include "Arduino.h"
+#include "scheduler.h"
+#include "marquee.h"
 
-WiFiManager::WiFiManager(LiquidCrystal* lcd) : 
-  server(80), lcd(lcd), failedAttempts(0), inAPMode(false), 
-  lastDisplayChange(0), displayState(0) {}
+WiFiManager::WiFiManager(DisplayDriver* lcd, WebServer* server) : 
+  server(server), lcd(lcd), failedAttempts(0), inAPMode(false), 
+  displayState(0) {}
 
 void WiFiManager::begin() {
     preferences.begin("wifi-config", false);
     
+    // Маршруты регистрируются до основных, чтобы "/" портала
+    // перекрывал главную страницу в режиме точки доступа
+    setupServer();
+    
     // Попытка подключения к сохраненной сети
     String ssid = preferences.getString("ssid", "");
     String password = preferences.getString("password", "");
@@ -40,8 +46,8 @@ void WiFiManager::begin() {
             lcd->print("Connected to:");
             lcd->setCursor(0, 1);
             String displaySSID = ssid;
-            if (displaySSID.length() > 16) {
-                displaySSID = displaySSID.substring(0, 13) + "...";
+            if (displaySSID.length() > lcd->columns()) {
+                displaySSID = displaySSID.substring(0, lcd->columns() - 3) + "...";
             }
             lcd->print(displaySSID);
             delay(2000);
@@ -53,6 +59,10 @@ void WiFiManager::begin() {
 }
 
 void WiFiManager::setupAP() {
+    // Дисплей переходит к экрану настройки: бегущая строка из своей задачи
+    // больше не пишет в LCD
+    stopMarquee();
+    
     apSSID = "TickerTapeAP";
     apPassword = "config123";
     
@@ -64,18 +74,12 @@ void WiFiManager::setupAP() {
     Serial.print("IP Address: ");
     Serial.println(WiFi.softAPIP());
     
-    // Display AP info on LCD
+    // Display AP info on LCD, чередуя SSID и пароль каждые 3 секунды
     updateDisplay();
-    
-    setupServer();
-}
-
-void WiFiManager::update() {
-    if (inAPMode && millis() - lastDisplayChange > 3000) {
+    scheduleEvery("ap-display", 3000, [this]() {
         displayState = (displayState + 1) % 2;
         updateDisplay();
-        lastDisplayChange = millis();
-    }
+    }, 3000);
 }
 
 void WiFiManager::updateDisplay() {
@@ -87,8 +91,8 @@ void WiFiManager::updateDisplay() {
         lcd->print("WiFi Setup Mode");
         lcd->setCursor(0, 1);
         String displaySSID = "SSID: " + apSSID;
-        if (displaySSID.length() > 16) {
-            displaySSID = displaySSID.substring(0, 16);
+        if (displaySSID.length() > lcd->columns()) {
+            displaySSID = displaySSID.substring(0, lcd->columns());
         }
         lcd->print(displaySSID);
     } else {
@@ -96,18 +100,24 @@ void WiFiManager::updateDisplay() {
         lcd->print("Password:");
         lcd->setCursor(0, 1);
         String displayPass = apPassword;
-        if (displayPass.length() > 16) {
-            displayPass = displayPass.substring(0, 16);
+        if (displayPass.length() > lcd->columns()) {
+            displayPass = displayPass.substring(0, lcd->columns());
         }
         lcd->print(displayPass);
     }
 }
 
 void WiFiManager::setupServer() {
-    server.on("/", std::bind(&WiFiManager::handleRoot, this));
-    server.on("/config", std::bind(&WiFiManager::handleConfig, this));
-    server.on("/save", HTTP_POST, std::bind(&WiFiManager::handleSave, this));
-    server.begin();
+    auto apOnly = [this](WebServer&) { return inAPMode; };
+    
+    // Маршруты портала точки доступа
+    server->on("/", std::bind(&WiFiManager::handleRoot, this)).setFilter(apOnly);
+    server->on("/config", std::bind(&WiFiManager::handleConfig, this)).setFilter(apOnly);
+    server->on("/save", HTTP_POST, std::bind(&WiFiManager::handleSave, this)).setFilter(apOnly);
+    
+    // Настройки WiFi из основного веб-интерфейса
+    server->on("/wifi/config", HTTP_GET, std::bind(&WiFiManager::handleConfig, this));
+    server->on("/wifi/save", HTTP_POST, std::bind(&WiFiManager::handleSave, this));
 }
 
 String WiFiManager::getStyle() {
@@ -194,52 +204,24 @@ void WiFiManager::handleRoot() {
     html += "<p>Current mode: ";
     html += inAPMode ? "Access Point" : "Station (Connected)";
     html += "</p>";
-    html += "<p><a href='/config'>Configure WiFi Settings</a></p>";
+    html += "<p><a href='/wifi/config'>Configure WiFi Settings</a></p>";
     html += "<div class='nav'>";
     html += "<a href='/'>Home</a>";
     html += "</div>";
     html += "</div></body></html>";
     
-    server.send(200, "text/html", html);
+    server->send(200, "text/html", html);
 }
 
 void WiFiManager::handleConfig() {
-    String currentSSID = preferences.getString("ssid", "");
-    
-    String html = "<!DOCTYPE html><html><head>";
-    html += "<title>WiFi Configuration</title>";
-    html += getStyle();
-    html += "</head><body>";
-    html += "<div class='container'>";
-    html += "<h1>WiFi Configuration</h1>";
-    html += "<form method='POST' action='/save'>";
-    html += "<div class='form-group'>";
-    html += "<label for='ssid'>SSID:</label>";
-    html += "<input type='text' id='ssid' name='ssid' value='" + currentSSID + "' required>";
-    html += "</div>";
-    html += "<div class='form-group'>";
-    html += "<label for='password'>Password:</label>";
-    html += "<input type='password' id='password' name='password'>";
-    html += "</div>";
-    html += "<input type='submit' value='Save Settings'>";
-    html += "</form>";
-    html += "<div class='nav'>";
-    html += "<a href='/'>Back</a>";
-    html += "</div>";
-    html += "</div></body></html>";
-    
-    server.send(200, "text/html", html);
+    server->send(200, "text/html", getConfigHTML());
 }
 
 void WiFiManager::handleSave() {
-    String ssid = server.arg("ssid");
-    String password = server.arg("password");
+    String ssid = server->arg("ssid");
+    String password = server->arg("password");
     
-    if (ssid.length() > 0) {
-        preferences.putString("ssid", ssid);
-        preferences.putString("password", password);
-        preferences.putInt("failedAttempts", 0);
-        
+    if (saveConfig(ssid, password)) {
         String html = "<!DOCTYPE html><html><head>";
         html += "<title>Settings Saved</title>";
         html += getStyle();
@@ -252,7 +234,10 @@ void WiFiManager::handleSave() {
         html += "</div>";
         html += "</div></body></html>";
         
-        server.send(200, "text/html", html);
+        server->send(200, "text/html", html);
+        
+        // Лента не должна перерисовать сообщение до перезагрузки
+        stopMarquee();
         
         if (lcd) {
             lcd->clear();
@@ -262,8 +247,8 @@ void WiFiManager::handleSave() {
             lcd->print("Restarting...");
         }
         
-        delay(3000);
-        ESP.restart();
+        // Перезагрузка отложенным заданием, чтобы ответ успел уйти клиенту
+        scheduleOnce("restart", 3000, []() { ESP.restart(); });
     } else {
         String html = "<!DOCTYPE html><html><head>";
         html += "<title>Error</title>";
@@ -272,13 +257,13 @@ void WiFiManager::handleSave() {
         html += "<div class='container'>";
         html += "<h1>Error</h1>";
         html += "<div class='message error'>SSID cannot be empty.</div>";
-        html += "<p><a href='/config'>Try again</a></p>";
+        html += "<p><a href='/wifi/config'>Try again</a></p>";
         html += "<div class='nav'>";
         html += "<a href='/'>Home</a>";
         html += "</div>";
         html += "</div></body></html>";
         
-        server.send(400, "text/html", html);
+        server->send(400, "text/html", html);
     }
 }
 
@@ -297,12 +282,6 @@ bool WiFiManager::isAPModeActive() {
     return inAPMode;
 }
 
-void WiFiManager::processClient() {
-    if (inAPMode) {
-        server.handleClient();
-    }
-}
-
 String WiFiManager::getCurrentSSID() {
     return preferences.getString("ssid", "");
 }
@@ -320,6 +299,7 @@ bool WiFiManager::saveConfig(String ssid, String password) {
     }
     return false;
 }
+
 String WiFiManager::getConfigHTML() {
     String currentSSID = preferences.getString("ssid", "");
     
@@ -341,29 +321,9 @@ String WiFiManager::getConfigHTML() {
     html += "<input type='submit' value='Save Settings'>";
     html += "</form>";
     html += "<div class='nav'>";
-    html += "<a href='/'>Back to Main</a>";
+    html += "<a href='/'>Back</a>";
     html += "</div>";
     html += "</div></body></html>";
     
     return html;
 }
-
-String WiFiManager::getSaveResponse(String ssid, String password) {
-    if (saveConfig(ssid, password)) {
-        String html = "<!DOCTYPE html><html><head>";
-        html += "<title>Settings Saved</title>";
-        html += getStyle();
-        html += "</head><body>";
-        html += "<div class='container'>";
-        html += "<h1>Configuration Saved</h1>";
-        html += "<div class='message success'>Settings saved successfully. Device will restart and attempt to connect to the new network.</div>";
-        html += "<div class='nav'>";
-        html += "<a href='/'>Back to Main</a>";
-        html += "</div>";
-        html += "</div></body></html>";
-        
-        return html;
-    } else {
-        return "Error: SSID cannot be empty";
-    }
-}
\ No newline at end of file
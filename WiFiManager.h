@@ -4,18 +4,17 @@
 #include <WiFi.h>
 #include <WebServer.h>
 #include <Preferences.h>
-#include <LiquidCrystal.h>
+#include "display_driver.h"
 
 class WiFiManager {
 private:
-    WebServer server;
+    WebServer* server;
     Preferences preferences;
-    LiquidCrystal* lcd;
+    DisplayDriver* lcd;
     String apSSID;
     String apPassword;
     int failedAttempts;
     bool inAPMode;
-    unsigned long lastDisplayChange;
     int displayState;
 
     void setupAP();
@@ -26,20 +25,17 @@ private:
     void updateDisplay();
 
 public:
-    WiFiManager(LiquidCrystal* lcd);
+    // Маршруты регистрируются на общем сервере из скетча,
+    // портал точки доступа отвечает только в режиме AP
+    WiFiManager(DisplayDriver* lcd, WebServer* server);
     void begin();
     void checkConnection();
     bool isAPModeActive();
-    void processClient();
     String getStyle();
-    void update();
     String getCurrentSSID();
     String getCurrentPassword();
     bool saveConfig(String ssid, String password);
-    
-    // Новые методы для интеграции с основным сервером
     String getConfigHTML();
-    String getSaveResponse(String ssid, String password);
 };
 
 #endif
\ No newline at end of file
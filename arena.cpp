@@ -0,0 +1,186 @@
+#include "arena.h"
+#include <stdarg.h>
+
+// Перед каждым блоком - его размер, чтобы reallocate знал, сколько копировать
+#define ARENA_ALIGN 8
+#define ARENA_HEADER ARENA_ALIGN
+#define ARENA_NO_BLOCK ((size_t)-1)
+
+static size_t alignUp(size_t value) {
+  return (value + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+Arena::Arena(uint8_t* buffer, size_t size) :
+  buffer(buffer), size(size), offset(0), peak(0), overflowCount(0), lastBlock(ARENA_NO_BLOCK) {}
+
+bool Arena::owns(const void* ptr) const {
+  return ptr >= buffer && ptr < buffer + size;
+}
+
+void* Arena::allocateBlock(size_t bytes) {
+  size_t start = offset;
+  size_t end = start + ARENA_HEADER + alignUp(bytes);
+  if (end > size) return NULL;
+  
+  *(uint32_t*)(buffer + start) = bytes;
+  offset = end;
+  lastBlock = start;
+  if (offset > peak) peak = offset;
+  return buffer + start + ARENA_HEADER;
+}
+
+void* Arena::allocate(size_t bytes) {
+  void* ptr = allocateBlock(bytes);
+  if (ptr) return ptr;
+  
+  overflowCount++;
+  return malloc(bytes);
+}
+
+void* Arena::reallocate(void* ptr, size_t bytes) {
+  if (ptr == NULL) return allocate(bytes);
+  if (!owns(ptr)) return realloc(ptr, bytes);
+  
+  size_t start = (uint8_t*)ptr - buffer - ARENA_HEADER;
+  uint32_t oldSize = *(uint32_t*)(buffer + start);
+  
+  // Последний блок растет или сжимается на месте - так строятся строки парсера
+  if (start == lastBlock && start + ARENA_HEADER + alignUp(bytes) <= size) {
+    *(uint32_t*)(buffer + start) = bytes;
+    offset = start + ARENA_HEADER + alignUp(bytes);
+    if (offset > peak) peak = offset;
+    return ptr;
+  }
+  
+  if (bytes <= oldSize) {
+    *(uint32_t*)(buffer + start) = bytes;
+    return ptr;
+  }
+  
+  void* moved = allocate(bytes);
+  if (moved) memcpy(moved, ptr, oldSize);
+  return moved;
+}
+
+void Arena::deallocate(void* ptr) {
+  if (ptr == NULL) return;
+  if (!owns(ptr)) {
+    free(ptr);
+    return;
+  }
+  
+  // Освобождение последнего блока возвращает место сразу, остальные - при сбросе
+  size_t start = (uint8_t*)ptr - buffer - ARENA_HEADER;
+  if (start == lastBlock) {
+    offset = start;
+    lastBlock = ARENA_NO_BLOCK;
+  }
+}
+
+char* Arena::format(const char* pattern, ...) {
+  va_list args;
+  va_start(args, pattern);
+  va_list copy;
+  va_copy(copy, args);
+  int length = vsnprintf(NULL, 0, pattern, copy);
+  va_end(copy);
+  
+  char* text = length < 0 ? NULL : (char*)allocateBlock(length + 1);
+  if (text) {
+    vsnprintf(text, length + 1, pattern, args);
+  } else {
+    overflowCount++;
+  }
+  va_end(args);
+  return text;
+}
+
+size_t Arena::mark() const {
+  return offset;
+}
+
+void Arena::rewind(size_t mark) {
+  if (mark > offset) return;
+  offset = mark;
+  lastBlock = ARENA_NO_BLOCK;
+}
+
+void Arena::reset() {
+  rewind(0);
+}
+
+size_t Arena::capacity() const {
+  return size;
+}
+
+size_t Arena::used() const {
+  return offset;
+}
+
+size_t Arena::highWater() const {
+  return peak;
+}
+
+uint32_t Arena::overflows() const {
+  return overflowCount;
+}
+
+ArenaScope::ArenaScope(Arena& arena) : arena(arena), start(arena.mark()) {}
+
+ArenaScope::~ArenaScope() {
+  arena.rewind(start);
+}
+
+ArenaJsonAllocator::ArenaJsonAllocator(Arena* arena) : arena(arena) {}
+
+void* ArenaJsonAllocator::allocate(size_t size) {
+  return arena ? arena->allocate(size) : malloc(size);
+}
+
+void ArenaJsonAllocator::deallocate(void* ptr) {
+  if (arena) arena->deallocate(ptr);
+  else free(ptr);
+}
+
+void* ArenaJsonAllocator::reallocate(void* ptr, size_t newSize) {
+  return arena ? arena->reallocate(ptr, newSize) : realloc(ptr, newSize);
+}
+
+// Веб-запросы обрабатываются только из loop(), одной арены достаточно
+static StaticArena<WEB_ARENA_SIZE> webArenaStorage;
+Arena& webArena = webArenaStorage;
+
+// Запросы к бирже идут из воркеров пула и из loop(), арена выдается на время запроса
+static StaticArena<FETCH_ARENA_SIZE> fetchArenas[FETCH_ARENA_COUNT];
+static uint32_t fetchArenasBusy = 0;
+
+Arena* acquireFetchArena() {
+  uint32_t busy = __atomic_load_n(&fetchArenasBusy, __ATOMIC_ACQUIRE);
+  for (int i = 0; i < FETCH_ARENA_COUNT; i++) {
+    uint32_t bit = 1u << i;
+    while (!(busy & bit)) {
+      if (__atomic_compare_exchange_n(&fetchArenasBusy, &busy, busy | bit, false,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return &fetchArenas[i];
+      }
+    }
+  }
+  return NULL;
+}
+
+void releaseFetchArena(Arena* arena) {
+  for (int i = 0; i < FETCH_ARENA_COUNT; i++) {
+    if (arena != &fetchArenas[i]) continue;
+    arena->reset();
+    __atomic_fetch_and(&fetchArenasBusy, ~(1u << i), __ATOMIC_RELEASE);
+    return;
+  }
+}
+
+int fetchArenaCount() {
+  return FETCH_ARENA_COUNT;
+}
+
+Arena* fetchArenaAt(int index) {
+  return index >= 0 && index < FETCH_ARENA_COUNT ? &fetchArenas[index] : NULL;
+}
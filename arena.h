@@ -0,0 +1,87 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "fetch_pool.h"
+
+// Размеры арен: одна на веб-запрос, по одной на каждый параллельный запрос к бирже
+#define WEB_ARENA_SIZE 4096
+#define FETCH_ARENA_SIZE 4096
+#define FETCH_ARENA_COUNT (FETCH_POOL_MAX_WORKERS + 1)
+
+// Линейный аллокатор: выделение - сдвиг указателя, освобождение - сброс целиком.
+// Не хватило места - блок берется из кучи и учитывается как переполнение
+class Arena {
+public:
+  Arena(uint8_t* buffer, size_t size);
+
+  void* allocate(size_t size);
+  void* reallocate(void* ptr, size_t size);
+  void deallocate(void* ptr);
+  // Строка целиком в арене; NULL, если не поместилась
+  char* format(const char* pattern, ...);
+
+  size_t mark() const;
+  void rewind(size_t mark);
+  void reset();
+
+  size_t capacity() const;
+  size_t used() const;
+  size_t highWater() const;
+  uint32_t overflows() const;
+
+private:
+  uint8_t* buffer;
+  size_t size;
+  size_t offset;
+  size_t peak;
+  uint32_t overflowCount;
+  size_t lastBlock;
+
+  bool owns(const void* ptr) const;
+  void* allocateBlock(size_t size);
+};
+
+template <size_t Size>
+class StaticArena : public Arena {
+public:
+  StaticArena() : Arena(storage, Size) {}
+
+private:
+  alignas(8) uint8_t storage[Size];
+};
+
+// Сброс арены при выходе из области видимости запроса
+class ArenaScope {
+public:
+  explicit ArenaScope(Arena& arena);
+  ~ArenaScope();
+
+private:
+  Arena& arena;
+  size_t start;
+};
+
+// Адаптер для JsonDocument: документ и его строки живут в арене,
+// без арены (NULL) - обычная куча
+class ArenaJsonAllocator : public ArduinoJson::Allocator {
+public:
+  explicit ArenaJsonAllocator(Arena* arena);
+
+  void* allocate(size_t size) override;
+  void deallocate(void* ptr) override;
+  void* reallocate(void* ptr, size_t newSize) override;
+
+private:
+  Arena* arena;
+};
+
+extern Arena& webArena;
+
+Arena* acquireFetchArena();
+void releaseFetchArena(Arena* arena);
+int fetchArenaCount();
+Arena* fetchArenaAt(int index);
+
+#endif
@@ -0,0 +1,255 @@
+#include "candle_chart.h"
+#include "quote_provider.h"
+#include "arena.h"
+#include "log_ring.h"
+#include "upstream.h"
+#include "fetch_pool.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+
+#define CHART_LOAD_IDLE 0
+#define CHART_LOAD_RUNNING 1
+#define CHART_LOAD_DONE 2
+#define CHART_LOAD_FAILED 3
+
+// Один график в кэше: обычно его и смотрят, пока страница открыта.
+// Пока идет загрузка, chart принадлежит задаче загрузки
+static CandleChart chart;
+static int loadState = CHART_LOAD_IDLE;
+static unsigned long chartLoadedAt = 0;
+static Arena* chartArena = NULL;
+
+bool isValidChartInterval(int interval) {
+  return interval == 1 || interval == 10 || interval == 60;
+}
+
+// "2025-10-17 10:31:00" -> минуты от полуночи
+static uint16_t minuteOfDay(const char* begin) {
+  if (begin == NULL || strlen(begin) < 16) return 0;
+  return atoi(begin + 11) * 60 + atoi(begin + 14);
+}
+
+// Все корзины заняты: соседние сливаются попарно, каждая вдвое шире
+static void mergeBuckets(CandleChart& c) {
+  for (int i = 0; i < c.bucketCount / 2; i++) {
+    ChartBucket merged = c.buckets[2 * i];
+    const ChartBucket& next = c.buckets[2 * i + 1];
+    if (next.low < merged.low) {
+      merged.low = next.low;
+      merged.lowMinute = next.lowMinute;
+    }
+    if (next.high > merged.high) {
+      merged.high = next.high;
+      merged.highMinute = next.highMinute;
+    }
+    c.buckets[i] = merged;
+  }
+  c.bucketCount /= 2;
+  c.bucketSpan *= 2;
+}
+
+// После слияния заполненных корзин счетчик свечей кратен новой ширине,
+// поэтому новая корзина всегда начинается с границы
+static void addCandle(CandleChart& c, uint16_t minute, float high, float low) {
+  if (c.candles % c.bucketSpan == 0) {
+    if (c.bucketCount == CHART_BUCKETS) mergeBuckets(c);
+    ChartBucket& bucket = c.buckets[c.bucketCount++];
+    bucket.low = low;
+    bucket.high = high;
+    bucket.lowMinute = minute;
+    bucket.highMinute = minute;
+  } else {
+    ChartBucket& bucket = c.buckets[c.bucketCount - 1];
+    if (low < bucket.low) {
+      bucket.low = low;
+      bucket.lowMinute = minute;
+    }
+    if (high > bucket.high) {
+      bucket.high = high;
+      bucket.highMinute = minute;
+    }
+  }
+  c.candles++;
+}
+
+// Страница свечей от поздних к ранним. Строки разбираются по одной, арена
+// откатывается после каждой. Возвращает число строк или -1; свеча другого
+// дня завершает график (dayEnded)
+static int readCandlePage(Stream& stream, CandleChart& c, Arena* arena, bool& dayEnded) {
+  ArenaJsonAllocator allocator(arena);
+  size_t start = arena->mark();
+  
+  int beginColumn = -1;
+  int highColumn = -1;
+  int lowColumn = -1;
+  int closeColumn = -1;
+  if (!stream.find("\"columns\"") || !stream.find(":")) return -1;
+  {
+    JsonDocument columns(&allocator);
+    if (deserializeJson(columns, stream)) return -1;
+    int index = 0;
+    for (JsonVariantConst column : columns.as<JsonArrayConst>()) {
+      const char* name = column | "";
+      if (strcmp(name, "begin") == 0) beginColumn = index;
+      else if (strcmp(name, "high") == 0) highColumn = index;
+      else if (strcmp(name, "low") == 0) lowColumn = index;
+      else if (strcmp(name, "close") == 0) closeColumn = index;
+      index++;
+    }
+  }
+  arena->rewind(start);
+  if (beginColumn < 0 || highColumn < 0 || lowColumn < 0 || closeColumn < 0) return -1;
+  if (!stream.find("\"data\"") || !stream.find("[")) return -1;
+  
+  int rows = 0;
+  do {
+    {
+      JsonDocument row(&allocator);
+      if (deserializeJson(row, stream)) break;
+      rows++;
+  
+      const char* begin = row[beginColumn];
+      if (begin != NULL) {
+        if (c.candles == 0) {
+          strlcpy(c.date, begin, sizeof(c.date));
+          c.lastClose = row[closeColumn].as<float>();
+        } else if (strncmp(begin, c.date, sizeof(c.date) - 1) != 0) {
+          dayEnded = true;
+          break;
+        }
+        addCandle(c, minuteOfDay(begin), row[highColumn].as<float>(), row[lowColumn].as<float>());
+      }
+    }
+    arena->rewind(start);
+  } while (rows < CHART_PAGE_SIZE && stream.findUntil(",", "]"));
+  
+  arena->rewind(start);
+  return rows;
+}
+
+// Последние свечи с конца (iss.reverse) постранично, пока не начнется
+// предыдущий день: часы устройства для этого не нужны
+static bool fetchCandles(CandleChart& c, Arena* arena, unsigned long startTime) {
+  QuoteProvider& provider = quoteProvider(c.market);
+  // Все страницы с одного адреса, чтобы не смешать ряды зеркал
+  int upstream = preferredUpstream();
+  bool dayEnded = false;
+  
+  for (int page = 0; page < CHART_MAX_PAGES && !dayEnded; page++) {
+    String path = String(provider.path()) + "/boards/" + provider.board() + "/securities/" + c.symbol +
+                  "/candles.json?iss.meta=off&iss.reverse=true&candles.columns=begin,high,low,close&interval=" +
+                  String(c.interval) + "&start=" + String(page * CHART_PAGE_SIZE);
+  
+    unsigned long pageStart = millis();
+    HTTPClient http;
+    int httpCode = upstreamGet(http, upstream, path);
+    if (httpCode != HTTP_CODE_OK) {
+      http.end();
+      recordUpstreamResult(upstream, false, millis() - pageStart);
+      logEvent(LOG_FETCH_HTTP_ERROR, c.symbol.c_str(), httpCode, millis() - startTime);
+      return page > 0;
+    }
+  
+    int rows = readCandlePage(http.getStream(), c, arena, dayEnded);
+    http.end();
+    recordUpstreamResult(upstream, true, millis() - pageStart);
+    if (rows < 0) {
+      logEvent(LOG_FETCH_JSON_ERROR, c.symbol.c_str(), -1);
+      return page > 0;
+    }
+    if (rows < CHART_PAGE_SIZE) break;
+  }
+  
+  return true;
+}
+
+static int loadChartState() {
+  return __atomic_load_n(&loadState, __ATOMIC_ACQUIRE);
+}
+
+static void storeChartState(int state) {
+  __atomic_store_n(&loadState, state, __ATOMIC_RELEASE);
+}
+
+static void chartTask(void* arg) {
+  unsigned long startTime = millis();
+  bool ok = fetchCandles(chart, chartArena, startTime);
+  releaseFetchArena(chartArena);
+  chartArena = NULL;
+  if (ok) {
+    chartLoadedAt = millis();
+    logEvent(LOG_CHART_LOADED, chart.symbol.c_str(), chart.candles, millis() - startTime);
+  }
+  storeChartState(ok ? CHART_LOAD_DONE : CHART_LOAD_FAILED);
+  vTaskDelete(NULL);
+}
+  
+// Загрузка допускается, как запрос пула: под TLS-соединение и стек задачи
+// должно хватать кучи, арена разбора берется из общих арен запросов
+static bool startChartLoad(const String& symbol, int market, int interval) {
+  if (ESP.getFreeHeap() < FETCH_HEAP_RESERVE + FETCH_TLS_HEAP_COST + CHART_TASK_STACK_SIZE ||
+      ESP.getMaxAllocHeap() < FETCH_TLS_MAX_BLOCK) {
+    return false;
+  }
+  chartArena = acquireFetchArena();
+  if (chartArena == NULL) return false;
+  
+  chart.symbol = symbol;
+  chart.market = market;
+  chart.interval = interval;
+  chart.date[0] = '\0';
+  chart.candles = 0;
+  chart.bucketSpan = 1;
+  chart.bucketCount = 0;
+  chart.lastClose = 0;
+  storeChartState(CHART_LOAD_RUNNING);
+  if (xTaskCreate(chartTask, "chart", CHART_TASK_STACK_SIZE, NULL, CHART_TASK_PRIORITY, NULL) != pdPASS) {
+    releaseFetchArena(chartArena);
+    chartArena = NULL;
+    storeChartState(CHART_LOAD_IDLE);
+    return false;
+  }
+  return true;
+}
+  
+int requestCandleChart(const String& symbol, int market, int interval, const CandleChart** out) {
+  int state = loadChartState();
+  bool sameChart = chart.symbol == symbol && chart.market == market && chart.interval == interval;
+  if (state == CHART_LOAD_RUNNING) return sameChart ? CHART_LOADING : CHART_BUSY;
+  if (sameChart && state == CHART_LOAD_DONE && millis() - chartLoadedAt < CHART_CACHE_MS) {
+    *out = &chart;
+    return CHART_READY;
+  }
+  // Отказ сообщается один раз, следующий запрос загружает заново
+  if (sameChart && state == CHART_LOAD_FAILED) {
+    storeChartState(CHART_LOAD_IDLE);
+    return CHART_FAILED;
+  }
+  
+  if (WiFi.status() != WL_CONNECTED) return CHART_FAILED;
+  return startChartLoad(symbol, market, interval) ? CHART_LOADING : CHART_BUSY;
+}
+
+// Ряд для страницы: точки [минута, цена] от ранних к поздним,
+// у каждой корзины минимум и максимум в порядке времени
+void printCandleChart(Print& out, const CandleChart& c, const TickerData* ticker) {
+  out.printf("{\"symbol\":\"%s\",\"market\":\"%s\",\"board\":\"%s\",\"date\":\"%s\",\"interval\":%d,",
+             c.symbol.c_str(), marketName(c.market), quoteProvider(c.market).board(), c.date, c.interval);
+  out.printf("\"candles\":%u,\"bucketCandles\":%u,\"last\":%.7g,", c.candles, c.bucketSpan, c.lastClose);
+  if (ticker) out.printf("\"threshold\":%.7g,\"isBuy\":%s,", ticker->threshold, ticker->isBuySignal ? "true" : "false");
+  
+  out.print("\"points\":[");
+  bool first = true;
+  for (int i = c.bucketCount - 1; i >= 0; i--) {
+    const ChartBucket& bucket = c.buckets[i];
+    bool lowFirst = bucket.lowMinute <= bucket.highMinute;
+    out.printf("%s[%u,%.7g]", first ? "" : ",", lowFirst ? bucket.lowMinute : bucket.highMinute,
+               lowFirst ? bucket.low : bucket.high);
+    if (bucket.low != bucket.high || bucket.lowMinute != bucket.highMinute) {
+      out.printf(",[%u,%.7g]", lowFirst ? bucket.highMinute : bucket.lowMinute, lowFirst ? bucket.high : bucket.low);
+    }
+    first = false;
+  }
+  out.print("]}");
+}
@@ -0,0 +1,50 @@
+#ifndef CANDLE_CHART_H
+#define CANDLE_CHART_H
+
+#include "config.h"
+
+// Внутридневной график по свечам ISS: свечи разбираются из потока по одной
+// и сразу сворачиваются в корзины min/max, память не зависит от их числа
+#define CHART_BUCKETS 60 // до двух точек на корзину
+#define CHART_PAGE_SIZE 500 // строк на странице candles.json
+#define CHART_MAX_PAGES 4
+#define CHART_CACHE_MS 60000
+#define CHART_DEFAULT_INTERVAL 1 // минутные свечи
+// Страницы свечей грузит отдельная задача, не основной цикл
+#define CHART_TASK_STACK_SIZE 8192
+#define CHART_TASK_PRIORITY 1
+
+// Ответ на запрос графика
+#define CHART_READY 0   // график в кэше
+#define CHART_LOADING 1 // загрузка идет, спросить позже
+#define CHART_BUSY 2    // грузится другой график или не хватает памяти
+#define CHART_FAILED 3  // биржа не ответила
+
+// Корзина: минимум и максимум цены с их временем (минуты от полуночи)
+struct ChartBucket {
+  float low;
+  float high;
+  uint16_t lowMinute;
+  uint16_t highMinute;
+};
+
+struct CandleChart {
+  String symbol;
+  int market;
+  int interval;
+  char date[11]; // торговый день последней свечи, YYYY-MM-DD
+  uint16_t candles;
+  uint16_t bucketSpan; // свечей в корзине
+  int bucketCount;
+  float lastClose;
+  ChartBucket buckets[CHART_BUCKETS]; // от поздних к ранним
+};
+
+bool isValidChartInterval(int interval);
+// Последний торговый день бумаги; повтор в течение CHART_CACHE_MS - из кэша,
+// иначе запускается загрузка. chart заполняется при CHART_READY
+int requestCandleChart(const String& symbol, int market, int interval, const CandleChart** chart);
+// JSON для /api/chart; ticker - порог для линии на графике или NULL
+void printCandleChart(Print& out, const CandleChart& chart, const TickerData* ticker);
+
+#endif
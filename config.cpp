@@ -4,5 +4,22 @@
 const char* ssid = "Master";
 const char* password = "1111222233334444!";
 
-// MOEX ISS API Base URL
-const String baseUrl = "https://iss.moex.com/iss/engines/stock/markets/shares/securities/";
\ No newline at end of file
+// Обновление прошивки: espota (порт 3232) и POST /ota
+const char* otaPassword = "admin";
+
+// MOEX ISS API: адреса по порядку предпочтения, путь рынка добавляет поставщик
+// котировок. Медленный основной дублируется на следующий, отказавший - пропускается
+const char* const issUrls[] = {
+  "https://iss.moex.com/iss/",
+#if ISS_PLAIN_HTTP_MIRROR
+  "http://iss.moex.com/iss/", // без TLS: соединение быстрее и дешевле по памяти
+#endif
+  // "http://192.168.1.10:8080/iss/", // локальный кэширующий прокси
+};
+const int issUrlCount = sizeof(issUrls) / sizeof(issUrls[0]);
+
+// MOEX ISS streaming (STOMP over WebSocket), пустой URL отключает поток.
+// Для отладки можно указать локальный ws://host:port/path
+const String streamUrl = "wss://iss.moex.com/infocx/v3/websocket";
+const String streamLogin = "guest";
+const String streamPasscode = "guest";
@@ -2,23 +2,56 @@
 #define CONFIG_H
 
 #include <Arduino.h>
-#include <LiquidCrystal.h>
 #include <WebServer.h>
+#include "display_driver.h"
 
 // Forward declarations
-class LiquidCrystal;
 class WebServer;
 
 // Wi-Fi Network Credentials
 extern const char* ssid;
 extern const char* password;
 
-// MOEX ISS API Base URL
-extern const String baseUrl;
+// Пароль обновления прошивки: ArduinoOTA и загрузка по ссылке из веб-интерфейса
+extern const char* otaPassword;
+
+// MOEX ISS API base URLs: основной, зеркала, локальный прокси
+extern const char* const issUrls[];
+extern const int issUrlCount;
+// Запасной адрес ISS без TLS: соединение дешевле по памяти, но котировки
+// и запросы идут открытым текстом. Включается флагом сборки
+#ifndef ISS_PLAIN_HTTP_MIRROR
+#define ISS_PLAIN_HTTP_MIRROR 0
+#endif
+
+// MOEX ISS streaming endpoint and credentials
+extern const String streamUrl;
+extern const String streamLogin;
+extern const String streamPasscode;
+
+// Display configuration: parallel HD44780 or I2C PCF8574 backpack
+#define DISPLAY_BACKEND_PARALLEL 0
+#define DISPLAY_BACKEND_I2C 1
+#ifndef DISPLAY_BACKEND
+#define DISPLAY_BACKEND DISPLAY_BACKEND_PARALLEL
+#endif
+#ifndef DISPLAY_COLS
+#define DISPLAY_COLS 16
+#endif
+#ifndef DISPLAY_ROWS
+#define DISPLAY_ROWS 2
+#endif
+#define DISPLAY_I2C_ADDRESS 0x27
 
 // EEPROM storage configuration
 #define EEPROM_SIZE 1024
 #define MAX_TICKERS 10
+// Коды ОФЗ длиннее акций: SU26238RMFS4
+#define MAX_SYMBOL_LENGTH 12
+#define EEPROM_LAN_MODE_ADDR (EEPROM_SIZE - 12)
+#define EEPROM_POWER_MODE_ADDR (EEPROM_SIZE - 11)
+#define EEPROM_DISPLAY_MODE_ADDR (EEPROM_SIZE - 10)
+#define EEPROM_FETCH_CONCURRENCY_ADDR (EEPROM_SIZE - 9)
 #define EEPROM_UPDATE_INTERVAL_ADDR (EEPROM_SIZE - 8)
 #define EEPROM_DISPLAY_INTERVAL_ADDR (EEPROM_SIZE - 4)
 
@@ -27,10 +60,11 @@ struct TickerData {
   String symbol;
   float threshold;
   bool isBuySignal;
+  uint8_t market; // MARKET_* из quote_provider.h
 };
 
 // Global variables declarations
-extern LiquidCrystal lcd;
+extern DisplayDriver& lcd;
 extern WebServer server;
 extern TickerData tickers[MAX_TICKERS];
 extern int numTickers;
@@ -38,10 +72,16 @@ extern String stockPrices[MAX_TICKERS];
 extern char updateIndicators[MAX_TICKERS];
 extern long updateInterval;
 extern long displayChangeInterval;
-extern int displayedIndices[2];
+extern int fetchConcurrency;
+extern int displayMode;
+extern int powerMode;
+extern int lanMode;
+// Растет при каждом сохранении настроек: по нему сбрасывается кэш страницы
+extern uint32_t configVersion;
+extern int displayedIndices[DISPLAY_ROWS];
 extern int nextLineToReplace;
 extern int nextTickerIndex;
-extern unsigned long lastUpdateTime;
-extern unsigned long lastDisplayChangeTime;
+extern int priceUpdateJob;
+extern int displayRotateJob;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "display_driver.h"
+#include <Wire.h>
+
+// Коды команд HD44780 (LCD_CLEARDISPLAY и др.) берутся из LiquidCrystal.h
+
+// PCF8574 pins
+#define PCF_RS 0x01
+#define PCF_EN 0x04
+#define PCF_BACKLIGHT 0x08
+
+// ---- Parallel ----
+
+ParallelLcdBus::ParallelLcdBus(uint8_t cols, uint8_t rows, uint8_t rs, uint8_t enable,
+                               uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
+  : lcd(rs, enable, d4, d5, d6, d7), cols(cols), numRows(rows) {}
+
+void ParallelLcdBus::begin() {
+  lcd.begin(cols, numRows);
+}
+
+void ParallelLcdBus::clear() {
+  lcd.clear();
+  transactions++;
+}
+
+void ParallelLcdBus::home() {
+  lcd.home();
+  transactions++;
+}
+
+void ParallelLcdBus::setCursor(uint8_t col, uint8_t row) {
+  lcd.setCursor(col, row);
+  transactions++;
+}
+
+void ParallelLcdBus::createChar(uint8_t location, uint8_t charmap[]) {
+  lcd.createChar(location, charmap);
+  transactions += 9;
+}
+
+void ParallelLcdBus::scrollDisplayLeft() {
+  lcd.scrollDisplayLeft();
+  transactions++;
+}
+
+size_t ParallelLcdBus::write(uint8_t value) {
+  transactions++;
+  return lcd.write(value);
+}
+
+// На параллельной шине каждый байт - отдельная передача, группировать нечего
+size_t ParallelLcdBus::write(const uint8_t* data, size_t size) {
+  transactions += size;
+  return lcd.write(data, size);
+}
+
+// ---- I2C PCF8574 ----
+
+I2CLcdBus::I2CLcdBus(uint8_t cols, uint8_t rows, uint8_t address)
+  : cols(cols), numRows(rows), address(address), pending(0), batchDepth(0) {}
+
+void I2CLcdBus::begin() {
+  Wire.begin();
+  delay(50);
+  
+  // Переход в 4-битный режим по даташиту HD44780 (рис. 24)
+  uint8_t resetDelays[3] = {5, 1, 1};
+  for (int i = 0; i < 3; i++) {
+    queueNibble(0x03, 0);
+    flush();
+    delay(resetDelays[i]);
+  }
+  queueNibble(0x02, 0);
+  flush();
+  
+  command(LCD_FUNCTIONSET | LCD_4BITMODE | (numRows > 1 ? LCD_2LINE : 0));
+  command(LCD_DISPLAYCONTROL | LCD_DISPLAYON);
+  clear();
+  command(LCD_ENTRYMODESET | LCD_ENTRYLEFT);
+}
+
+void I2CLcdBus::queueNibble(uint8_t nibble, uint8_t mode) {
+  if (pending + 2 > I2C_BATCH_SIZE) flush();
+  uint8_t data = (nibble << 4) | mode | PCF_BACKLIGHT;
+  // Передача байта по I2C (~90 мкс на 100 кГц) дольше любого требуемого
+  // HD44780 интервала, поэтому стробы можно слать подряд в одной транзакции
+  buffer[pending++] = data | PCF_EN;
+  buffer[pending++] = data;
+}
+
+void I2CLcdBus::send(uint8_t value, uint8_t mode) {
+  queueNibble(value >> 4, mode);
+  queueNibble(value & 0x0F, mode);
+  if (batchDepth == 0) flush();
+}
+
+void I2CLcdBus::command(uint8_t value) {
+  send(value, 0);
+}
+
+void I2CLcdBus::flush() {
+  if (pending == 0) return;
+  Wire.beginTransmission(address);
+  Wire.write(buffer, pending);
+  Wire.endTransmission();
+  transactions++;
+  pending = 0;
+}
+
+void I2CLcdBus::beginBatch() {
+  batchDepth++;
+}
+
+void I2CLcdBus::endBatch() {
+  if (batchDepth > 0) batchDepth--;
+  if (batchDepth == 0) flush();
+}
+
+void I2CLcdBus::clear() {
+  command(LCD_CLEARDISPLAY);
+  flush();
+  delayMicroseconds(2000);
+}
+
+void I2CLcdBus::home() {
+  command(LCD_RETURNHOME);
+  flush();
+  delayMicroseconds(2000);
+}
+
+void I2CLcdBus::setCursor(uint8_t col, uint8_t row) {
+  // Строки 2 и 3 дисплея 20x4 - продолжение строк 0 и 1 в DDRAM
+  uint8_t rowOffsets[4] = {0x00, 0x40, (uint8_t)(0x00 + cols), (uint8_t)(0x40 + cols)};
+  if (row >= numRows) row = numRows - 1;
+  command(LCD_SETDDRAMADDR | (col + rowOffsets[row]));
+}
+
+void I2CLcdBus::createChar(uint8_t location, uint8_t charmap[]) {
+  beginBatch();
+  command(LCD_SETCGRAMADDR | ((location & 0x7) << 3));
+  for (int i = 0; i < 8; i++) send(charmap[i], PCF_RS);
+  endBatch();
+}
+
+void I2CLcdBus::scrollDisplayLeft() {
+  command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT);
+}
+
+size_t I2CLcdBus::write(uint8_t value) {
+  send(value, PCF_RS);
+  return 1;
+}
+
+size_t I2CLcdBus::write(const uint8_t* data, size_t size) {
+  beginBatch();
+  for (size_t i = 0; i < size; i++) send(data[i], PCF_RS);
+  endBatch();
+  return size;
+}
@@ -0,0 +1,99 @@
+#ifndef DISPLAY_DRIVER_H
+#define DISPLAY_DRIVER_H
+
+#include <Arduino.h>
+#include <Print.h>
+#include <LiquidCrystal.h>
+
+// Общий интерфейс символьных дисплеев HD44780. Наследует Print,
+// поэтому lcd.print(...) работает с любым подключением
+class DisplayDriver : public Print {
+public:
+  virtual void begin() = 0;
+  virtual uint8_t columns() const = 0;
+  virtual uint8_t rows() const = 0;
+  virtual void clear() = 0;
+  virtual void home() = 0;
+  virtual void setCursor(uint8_t col, uint8_t row) = 0;
+  virtual void createChar(uint8_t location, uint8_t charmap[]) = 0;
+  virtual void scrollDisplayLeft() = 0;
+  virtual size_t write(uint8_t value) = 0;
+  using Print::write;
+  
+  // Вывод len символов с позиции (col, row) одной операцией
+  virtual void writeRegion(uint8_t col, uint8_t row, const char* data, uint8_t len) {
+    beginBatch();
+    setCursor(col, row);
+    write((const uint8_t*)data, len);
+    endBatch();
+  }
+  
+  // Команды между beginBatch() и endBatch() отправляются одной транзакцией шины
+  virtual void beginBatch() {}
+  virtual void endBatch() {}
+  
+  // Число транзакций шины с момента запуска
+  uint32_t busTransactions() const { return transactions; }
+
+protected:
+  uint32_t transactions = 0;
+};
+
+// Параллельное 4-битное подключение через LiquidCrystal
+class ParallelLcdBus : public DisplayDriver {
+public:
+  ParallelLcdBus(uint8_t cols, uint8_t rows, uint8_t rs, uint8_t enable,
+                 uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7);
+  void begin() override;
+  uint8_t columns() const override { return cols; }
+  uint8_t rows() const override { return numRows; }
+  void clear() override;
+  void home() override;
+  void setCursor(uint8_t col, uint8_t row) override;
+  void createChar(uint8_t location, uint8_t charmap[]) override;
+  void scrollDisplayLeft() override;
+  size_t write(uint8_t value) override;
+  size_t write(const uint8_t* data, size_t size) override;
+
+private:
+  LiquidCrystal lcd;
+  uint8_t cols;
+  uint8_t numRows;
+};
+
+// Модуль PCF8574 на I2C: P0=RS, P1=RW, P2=E, P3=подсветка, P4-P7=D4-D7.
+// Каждый полубайт - два байта расширителю (строб E), до I2C_BATCH_SIZE
+// байт уходят одной транзакцией вместо отдельной на каждый полубайт
+#define I2C_BATCH_SIZE 120
+
+class I2CLcdBus : public DisplayDriver {
+public:
+  I2CLcdBus(uint8_t cols, uint8_t rows, uint8_t address);
+  void begin() override;
+  uint8_t columns() const override { return cols; }
+  uint8_t rows() const override { return numRows; }
+  void clear() override;
+  void home() override;
+  void setCursor(uint8_t col, uint8_t row) override;
+  void createChar(uint8_t location, uint8_t charmap[]) override;
+  void scrollDisplayLeft() override;
+  size_t write(uint8_t value) override;
+  size_t write(const uint8_t* data, size_t size) override;
+  void beginBatch() override;
+  void endBatch() override;
+
+private:
+  void queueNibble(uint8_t nibble, uint8_t mode);
+  void send(uint8_t value, uint8_t mode);
+  void command(uint8_t value);
+  void flush();
+  
+  uint8_t cols;
+  uint8_t numRows;
+  uint8_t address;
+  uint8_t buffer[I2C_BATCH_SIZE];
+  uint8_t pending;
+  uint8_t batchDepth;
+};
+
+#endif
@@ -1,6 +1,12 @@
 #include "eeprom_storage.h"
 #include "config.h"
 #include "lcd_display.h" // Добавляем для resetDisplayIndices
+#include "fetch_pool.h"
+#include "marquee.h"
+#include "scheduler.h"
+#include "power.h"
+#include "lan_fanout.h"
+#include "quote_provider.h"
 #include <EEPROM.h>
 
 void saveTickersToEEPROM() {
@@ -17,9 +23,15 @@ void saveTickersToEEPROM() {
     byte* thresholdBytes = (byte*)&tickers[i].threshold;
     for (int j = 0; j < sizeof(float); j++) EEPROM.write(address++, thresholdBytes[j]);
     
-    EEPROM.write(address++, tickers[i].isBuySignal ? 1 : 0);
+    // Бит 0 - сигнал покупки, старшие - рынок; старые записи читаются как акции
+    EEPROM.write(address++, (tickers[i].isBuySignal ? 1 : 0) | tickers[i].market << 1);
   }
   
+  EEPROM.write(EEPROM_FETCH_CONCURRENCY_ADDR, fetchConcurrency);
+  EEPROM.write(EEPROM_DISPLAY_MODE_ADDR, displayMode);
+  EEPROM.write(EEPROM_POWER_MODE_ADDR, powerMode);
+  EEPROM.write(EEPROM_LAN_MODE_ADDR, lanMode);
+  
   byte* updateIntervalBytes = (byte*)&updateInterval;
   for (int i = 0; i < sizeof(long); i++) EEPROM.write(EEPROM_UPDATE_INTERVAL_ADDR + i, updateIntervalBytes[i]);
   
@@ -27,6 +39,7 @@ void saveTickersToEEPROM() {
   for (int i = 0; i < sizeof(long); i++) EEPROM.write(EEPROM_DISPLAY_INTERVAL_ADDR + i, displayChangeIntervalBytes[i]);
   
   EEPROM.commit();
+  configVersion++;
 }
 
 void loadTickersFromEEPROM() {
@@ -37,13 +50,17 @@ void loadTickersFromEEPROM() {
     numTickers = 0;
     updateInterval = 600000;
     displayChangeInterval = 3000;
+    fetchConcurrency = FETCH_POOL_DEFAULT_WORKERS;
+    displayMode = DISPLAY_MODE_ROTATE;
+    powerMode = POWER_MODE_PERFORMANCE;
+    lanMode = LAN_MODE_OFF;
     return;
   }
   
   for (int i = 0; i < numTickers; i++) {
     String symbol = "";
     char c = EEPROM.read(address++);
-    while (c != 0 && symbol.length() < 10) {
+    while (c != 0 && symbol.length() < MAX_SYMBOL_LENGTH) {
       symbol += c;
       c = EEPROM.read(address++);
     }
@@ -54,7 +71,10 @@ void loadTickersFromEEPROM() {
     for (int j = 0; j < sizeof(float); j++) thresholdBytes[j] = EEPROM.read(address++);
     tickers[i].threshold = threshold;
     
-    tickers[i].isBuySignal = (EEPROM.read(address++) == 1);
+    byte flags = EEPROM.read(address++);
+    tickers[i].isBuySignal = (flags & 1) != 0;
+    tickers[i].market = flags >> 1;
+    if (tickers[i].market >= MARKET_COUNT) tickers[i].market = MARKET_SHARES;
   }
   
   byte* updateIntervalBytes = (byte*)&updateInterval;
@@ -63,17 +83,35 @@ void loadTickersFromEEPROM() {
   byte* displayChangeIntervalBytes = (byte*)&displayChangeInterval;
   for (int i = 0; i < sizeof(long); i++) displayChangeIntervalBytes[i] = EEPROM.read(EEPROM_DISPLAY_INTERVAL_ADDR + i);
   
+  fetchConcurrency = EEPROM.read(EEPROM_FETCH_CONCURRENCY_ADDR);
+  displayMode = EEPROM.read(EEPROM_DISPLAY_MODE_ADDR);
+  powerMode = EEPROM.read(EEPROM_POWER_MODE_ADDR);
+  lanMode = EEPROM.read(EEPROM_LAN_MODE_ADDR);
+  
   if (updateInterval < 60000) updateInterval = 600000;
   if (displayChangeInterval < 1000) displayChangeInterval = 3000;
+  if (fetchConcurrency < 1 || fetchConcurrency > FETCH_POOL_MAX_WORKERS) fetchConcurrency = FETCH_POOL_DEFAULT_WORKERS;
+  if (displayMode != DISPLAY_MODE_MARQUEE) displayMode = DISPLAY_MODE_ROTATE;
+  if (powerMode < 0 || powerMode >= POWER_MODE_COUNT) powerMode = POWER_MODE_PERFORMANCE;
+  if (lanMode < 0 || lanMode >= LAN_MODE_COUNT) lanMode = LAN_MODE_OFF;
 }
 
 void clearAllTickers() {
   numTickers = 0;
   updateInterval = 600000;
   displayChangeInterval = 3000;
+  fetchConcurrency = FETCH_POOL_DEFAULT_WORKERS;
+  displayMode = DISPLAY_MODE_ROTATE;
+  powerMode = POWER_MODE_PERFORMANCE;
+  lanMode = LAN_MODE_OFF;
   
   for (int i = 0; i < EEPROM_SIZE; i++) EEPROM.write(i, 0);
   
+  EEPROM.write(EEPROM_FETCH_CONCURRENCY_ADDR, fetchConcurrency);
+  EEPROM.write(EEPROM_DISPLAY_MODE_ADDR, displayMode);
+  EEPROM.write(EEPROM_POWER_MODE_ADDR, powerMode);
+  EEPROM.write(EEPROM_LAN_MODE_ADDR, lanMode);
+  
   byte* updateIntervalBytes = (byte*)&updateInterval;
   for (int i = 0; i < sizeof(long); i++) EEPROM.write(EEPROM_UPDATE_INTERVAL_ADDR + i, updateIntervalBytes[i]);
   
@@ -81,11 +119,15 @@ void clearAllTickers() {
   for (int i = 0; i < sizeof(long); i++) EEPROM.write(EEPROM_DISPLAY_INTERVAL_ADDR + i, displayChangeIntervalBytes[i]);
   
   EEPROM.commit();
+  configVersion++;
   
+  stopMarquee();
   lcd.clear();
   lcd.print("All tickers");
   lcd.setCursor(0, 1);
   lcd.print("deleted");
   delay(2000);
+  setJobPeriod(priceUpdateJob, updateInterval);
+  applyPowerMode();
   resetDisplayIndices();
 }
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "fetch_pool.h"
+#include "config.h"
+#include "quote_provider.h"
+#include "upstream.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#define FETCH_WORKER_DONE -1
+#define FETCH_HEDGE_DONE -2
+
+struct FetchJob {
+  QuoteProvider* provider;
+  const String* symbols;
+  String* results;
+  int count;
+  int next;
+  int inFlight;    // живые соединения, включая дубли
+  int hedgeLegs;   // допущено дублей за пакет
+  QueueHandle_t done;
+  SemaphoreHandle_t admission;
+};
+
+static bool heapAdmits(int inFlight) {
+  return ESP.getFreeHeap() >= FETCH_HEAP_RESERVE + (uint32_t)inFlight * FETCH_TLS_HEAP_COST &&
+         ESP.getMaxAllocHeap() >= FETCH_TLS_MAX_BLOCK;
+}
+
+// Не начинать новое TLS-соединение, пока в куче нет места под его буферы.
+// Одно соединение пропускается всегда, иначе пул может зависнуть навсегда.
+static void admitRequest(FetchJob* job) {
+  while (true) {
+    xSemaphoreTake(job->admission, portMAX_DELAY);
+    bool admitted = job->inFlight == 0 || heapAdmits(job->inFlight);
+    if (admitted) job->inFlight++;
+    xSemaphoreGive(job->admission);
+    
+    if (admitted) return;
+    vTaskDelay(pdMS_TO_TICKS(50));
+  }
+}
+
+static void releaseRequest(FetchJob* job) {
+  xSemaphoreTake(job->admission, portMAX_DELAY);
+  job->inFlight--;
+  xSemaphoreGive(job->admission);
+}
+
+// Дубль всегда идет параллельно основной ноге: без места в куче его нет
+static bool admitHedgeLeg(void* context) {
+  FetchJob* job = (FetchJob*)context;
+  xSemaphoreTake(job->admission, portMAX_DELAY);
+  bool admitted = heapAdmits(job->inFlight);
+  if (admitted) {
+    job->inFlight++;
+    __atomic_add_fetch(&job->hedgeLegs, 1, __ATOMIC_RELEASE);
+  }
+  xSemaphoreGive(job->admission);
+  return admitted;
+}
+
+static void releaseHedgeLeg(void* context) {
+  FetchJob* job = (FetchJob*)context;
+  releaseRequest(job);
+  int doneMarker = FETCH_HEDGE_DONE;
+  xQueueSend(job->done, &doneMarker, portMAX_DELAY);
+}
+
+static void deliverHedgePrice(void* context, int index, const String& price) {
+  FetchJob* job = (FetchJob*)context;
+  job->results[index] = price;
+  xQueueSend(job->done, &index, portMAX_DELAY);
+}
+
+static void fetchWorker(void* arg) {
+  FetchJob* job = (FetchJob*)arg;
+  
+  while (true) {
+    int index = __atomic_fetch_add(&job->next, 1, __ATOMIC_SEQ_CST);
+    if (index >= job->count) break;
+    
+    admitRequest(job);
+    UpstreamSlot slot = {admitHedgeLeg, releaseHedgeLeg, deliverHedgePrice, job, index};
+    String price = job->provider->fetchPrice(job->symbols[index], &slot);
+    releaseRequest(job);
+    
+    // Пустая строка - цену раньше выдал дубль
+    if (price.length() > 0) {
+      job->results[index] = price;
+      xQueueSend(job->done, &index, portMAX_DELAY);
+    }
+  }
+  
+  int doneMarker = FETCH_WORKER_DONE;
+  xQueueSend(job->done, &doneMarker, portMAX_DELAY);
+  vTaskDelete(NULL);
+}
+
+static void fetchPricesSequential(QuoteProvider& provider, const String* symbols, String* results, int count,
+                                  FetchResultCallback onResult) {
+  for (int i = 0; i < count; i++) {
+    results[i] = provider.fetchPrice(symbols[i], NULL);
+    onResult(i, results[i]);
+  }
+}
+
+void fetchPricesParallel(QuoteProvider& provider, const String* symbols, String* results, int count,
+                         int concurrency, FetchResultCallback onResult) {
+  if (count <= 0) return;
+  
+  int workers = constrain(concurrency, 1, FETCH_POOL_MAX_WORKERS);
+  if (workers > count) workers = count;
+  if (workers == 1) {
+    fetchPricesSequential(provider, symbols, results, count, onResult);
+    return;
+  }
+  
+  FetchJob job;
+  job.provider = &provider;
+  job.symbols = symbols;
+  job.results = results;
+  job.count = count;
+  job.next = 0;
+  job.inFlight = 0;
+  job.hedgeLegs = 0;
+  // Цены, конец каждой рабочей задачи и каждого дубля
+  job.done = xQueueCreate(2 * count + workers, sizeof(int));
+  job.admission = xSemaphoreCreateMutex();
+  
+  if (job.done == NULL || job.admission == NULL) {
+    // Нет памяти под очередь - последовательный проход
+    fetchPricesSequential(provider, symbols, results, count, onResult);
+    if (job.done) vQueueDelete(job.done);
+    if (job.admission) vSemaphoreDelete(job.admission);
+    return;
+  }
+  
+  int started = 0;
+  for (int w = 0; w < workers; w++) {
+    // Рабочие задачи распределяются по обоим ядрам
+    if (xTaskCreatePinnedToCore(fetchWorker, "fetch", FETCH_WORKER_STACK_SIZE,
+                                &job, 1, NULL, w % 2) == pdPASS) {
+      started++;
+    }
+  }
+  
+  if (started == 0) {
+    fetchPricesSequential(provider, symbols, results, count, onResult);
+    vQueueDelete(job.done);
+    vSemaphoreDelete(job.admission);
+    return;
+  }
+  
+  // Результаты применяются в вызывающей задаче, чтобы LCD трогал только loop().
+  // Пакет живет, пока не закончатся все дубли: проигравшие тоже держат job
+  int finished = 0;
+  int hedgesDone = 0;
+  while (finished < started || hedgesDone < __atomic_load_n(&job.hedgeLegs, __ATOMIC_ACQUIRE)) {
+    int index;
+    xQueueReceive(job.done, &index, portMAX_DELAY);
+    if (index == FETCH_WORKER_DONE) finished++;
+    else if (index == FETCH_HEDGE_DONE) hedgesDone++;
+    else onResult(index, results[index]);
+  }
+  
+  vQueueDelete(job.done);
+  vSemaphoreDelete(job.admission);
+}
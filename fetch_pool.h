@@ -0,0 +1,24 @@
+#ifndef FETCH_POOL_H
+#define FETCH_POOL_H
+
+#include "config.h"
+
+// Пул параллельных запросов цен
+#define FETCH_POOL_MAX_WORKERS 4
+#define FETCH_POOL_DEFAULT_WORKERS 2
+#define FETCH_WORKER_STACK_SIZE 8192
+// Оценка кучи на одно TLS-соединение и неприкосновенный запас
+#define FETCH_TLS_HEAP_COST 45000
+#define FETCH_TLS_MAX_BLOCK 17000
+#define FETCH_HEAP_RESERVE 20000
+
+class QuoteProvider;
+
+// Вызывается в задаче loop() по мере готовности каждой цены
+typedef void (*FetchResultCallback)(int index, const String& price);
+
+// Все бумаги пакета - одного рынка: поставщик выбирается один раз на пакет
+void fetchPricesParallel(QuoteProvider& provider, const String* symbols, String* results, int count,
+                         int concurrency, FetchResultCallback onResult);
+
+#endif
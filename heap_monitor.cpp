@@ -0,0 +1,68 @@
+#include "heap_monitor.h"
+#include "arena.h"
+#include "log_ring.h"
+#include <esp_heap_caps.h>
+
+static HeapSample history[HEAP_HISTORY_SIZE];
+static int historyCount = 0;
+static int historyNext = 0;
+static uint32_t lowestLargestBlock = UINT32_MAX;
+
+HeapSample currentHeapSample() {
+  HeapSample sample;
+  sample.uptimeSec = millis() / 1000;
+  sample.freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  sample.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  sample.fragmentation = sample.freeBytes > 0 ? 100 - (uint8_t)((uint64_t)sample.largestBlock * 100 / sample.freeBytes) : 0;
+  return sample;
+}
+
+void sampleHeap() {
+  HeapSample sample = currentHeapSample();
+  if (sample.largestBlock < lowestLargestBlock) lowestLargestBlock = sample.largestBlock;
+  
+  history[historyNext] = sample;
+  historyNext = (historyNext + 1) % HEAP_HISTORY_SIZE;
+  if (historyCount < HEAP_HISTORY_SIZE) historyCount++;
+  
+  logEvent(LOG_HEAP_SAMPLE, "", sample.freeBytes, sample.largestBlock, sample.fragmentation);
+}
+
+uint32_t minLargestBlock() {
+  return lowestLargestBlock;
+}
+
+__attribute__((weak)) uint32_t heapAllocationCount() {
+  return 0;
+}
+
+static void printArena(Print& out, const char* name, Arena& arena, bool last) {
+  out.printf("{\"name\":\"%s\",\"capacity\":%u,\"highWater\":%u,\"overflows\":%lu}%s",
+             name, (unsigned)arena.capacity(), (unsigned)arena.highWater(),
+             (unsigned long)arena.overflows(), last ? "" : ",");
+}
+
+// JSON пишется напрямую в поток: история из 144 точек не собирается в памяти
+void printHeapReport(Print& out) {
+  HeapSample now = currentHeapSample();
+  out.printf("{\"free\":%lu,\"largestBlock\":%lu,\"fragmentation\":%u,",
+             (unsigned long)now.freeBytes, (unsigned long)now.largestBlock, now.fragmentation);
+  out.printf("\"minFree\":%lu,\"minLargestBlock\":%lu,",
+             (unsigned long)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+             (unsigned long)min(lowestLargestBlock, now.largestBlock));
+  
+  out.print("\"arenas\":[");
+  printArena(out, "web", webArena, false);
+  for (int i = 0; i < fetchArenaCount(); i++) {
+    printArena(out, "fetch", *fetchArenaAt(i), i == fetchArenaCount() - 1);
+  }
+  
+  out.print("],\"history\":[");
+  int oldest = (historyNext - historyCount + HEAP_HISTORY_SIZE) % HEAP_HISTORY_SIZE;
+  for (int i = 0; i < historyCount; i++) {
+    const HeapSample& sample = history[(oldest + i) % HEAP_HISTORY_SIZE];
+    out.printf("%s[%lu,%lu,%lu,%u]", i ? "," : "", (unsigned long)sample.uptimeSec,
+               (unsigned long)sample.freeBytes, (unsigned long)sample.largestBlock, sample.fragmentation);
+  }
+  out.print("]}");
+}
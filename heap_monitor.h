@@ -0,0 +1,25 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+
+// Снимок кучи раз в 10 минут, история за последние сутки
+#define HEAP_SAMPLE_INTERVAL_MS 600000
+#define HEAP_HISTORY_SIZE 144
+
+struct HeapSample {
+  uint32_t uptimeSec;
+  uint32_t freeBytes;
+  uint32_t largestBlock;
+  uint8_t fragmentation; // 100 - largestBlock * 100 / freeBytes
+};
+
+void sampleHeap();
+HeapSample currentHeapSample();
+uint32_t minLargestBlock();
+void printHeapReport(Print& out);
+// Выделения кучи с загрузки. На устройстве счетчика нет (0),
+// симулятор подставляет свой
+uint32_t heapAllocationCount();
+
+#endif
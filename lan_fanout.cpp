@@ -0,0 +1,596 @@
+#include "lan_fanout.h"
+#include "config.h"
+#include "network.h"
+#include "lcd_display.h"
+#include "fetch_pool.h"
+#include "quote_provider.h"
+#include "log_ring.h"
+#include <WiFi.h>
+#include <NetworkUdp.h>
+#include <esp_random.h>
+
+// Кадр: заголовок, содержимое и CRC-16/CCITT всего предыдущего.
+// Числа - little-endian, символ - длина и байты без нуля
+#define LAN_MAGIC 0x5154 // "TQ"
+#define LAN_VERSION 3
+#define LAN_FRAME_ANNOUNCE 1
+#define LAN_FRAME_PRICES 2
+#define LAN_HEADER_SIZE 12
+#define LAN_CRC_SIZE 2
+#define LAN_SYMBOL_SIZE (MAX_SYMBOL_LENGTH + 1)
+#define LAN_FRAMES_PER_POLL 8
+
+// Флаги анонса
+#define LAN_FLAG_CANDIDATE 0x01
+#define LAN_FLAG_LEADER 0x02
+
+struct LanPeer {
+  uint32_t id;
+  unsigned long lastSeen;
+  uint8_t flags;
+  uint32_t lastSeq;
+};
+
+// Бумага ведомого, которую ведущий опрашивает за него
+struct SharedSymbol {
+  char symbol[LAN_SYMBOL_SIZE];
+  uint8_t market;
+  unsigned long lastRequested;
+  String price;
+};
+
+static NetworkUDP udp;
+static bool udpStarted = false;
+static uint32_t deviceId = 0;
+static uint32_t txSeq = 0;
+static uint32_t leaderId = 0;
+static unsigned long startedAt = 0;
+static unsigned long lastAnnounce = 0;
+static unsigned long lastPricesAt = 0;
+static unsigned long pricesValidMs = 0;
+
+static LanPeer peers[LAN_MAX_PEERS];
+static int numPeers = 0;
+static SharedSymbol shared[LAN_MAX_SYMBOLS];
+static int numShared = 0;
+static LanStats stats = {};
+
+// ---- кадры ----
+
+static uint16_t crc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+class FrameWriter {
+public:
+  FrameWriter() : len(0) {}
+  explicit FrameWriter(uint8_t type) { begin(type); }
+  
+  void begin(uint8_t type) {
+    len = 0;
+    put16(LAN_MAGIC);
+    put8(LAN_VERSION);
+    put8(type);
+    put32(lanDeviceId());
+    put32(++txSeq);
+  }
+  
+  bool fits(size_t size) const { return len + size + LAN_CRC_SIZE <= LAN_MAX_FRAME; }
+  size_t size() const { return len; }
+  void put8(uint8_t value) { data[len++] = value; }
+  void put16(uint16_t value) {
+    put8(value & 0xFF);
+    put8(value >> 8);
+  }
+  void put32(uint32_t value) {
+    put16(value & 0xFFFF);
+    put16(value >> 16);
+  }
+  void putSymbol(const char* symbol, size_t symbolLen) {
+    put8(symbolLen);
+    memcpy(data + len, symbol, symbolLen);
+    len += symbolLen;
+  }
+  void patch8(size_t offset, uint8_t value) { data[offset] = value; }
+  
+  bool send() {
+    uint16_t crc = crc16(data, len);
+    put16(crc);
+    if (!udp.beginMulticastPacket()) return false;
+    udp.write(data, len);
+    if (!udp.endPacket()) return false;
+    stats.framesSent++;
+    return true;
+  }
+  
+private:
+  uint8_t data[LAN_MAX_FRAME];
+  size_t len;
+};
+
+class FrameReader {
+public:
+  FrameReader(const uint8_t* data, size_t len) : data(data), len(len), pos(0), ok(true) {}
+  
+  bool valid() const { return ok; }
+  bool atEnd() const { return pos >= len; }
+  uint8_t get8() {
+    if (pos + 1 > len) {
+      ok = false;
+      return 0;
+    }
+    return data[pos++];
+  }
+  uint16_t get16() {
+    uint16_t low = get8();
+    return low | (uint16_t)get8() << 8;
+  }
+  uint32_t get32() {
+    uint32_t low = get16();
+    return low | (uint32_t)get16() << 16;
+  }
+  // Символ длиной до MAX_SYMBOL_LENGTH в буфер LAN_SYMBOL_SIZE
+  bool getSymbol(char* symbol) {
+    uint8_t symbolLen = get8();
+    if (!ok || symbolLen == 0 || symbolLen >= LAN_SYMBOL_SIZE || pos + symbolLen > len) {
+      ok = false;
+      return false;
+    }
+    memcpy(symbol, data + pos, symbolLen);
+    symbol[symbolLen] = '\0';
+    pos += symbolLen;
+    return true;
+  }
+  
+private:
+  const uint8_t* data;
+  size_t len;
+  size_t pos;
+  bool ok;
+};
+
+// Цена передается целым числом и количеством знаков после точки: "313.50" -> 31350, 2
+static bool encodePrice(const String& price, int32_t* mantissa, uint8_t* decimals) {
+  int64_t value = 0;
+  int digits = 0;
+  int fraction = -1;
+  bool negative = false;
+  
+  for (unsigned int i = 0; i < price.length(); i++) {
+    char c = price[i];
+    if (c == '-' && i == 0) {
+      negative = true;
+    } else if (c == '.' && fraction < 0) {
+      fraction = 0;
+    } else if (isDigit(c)) {
+      value = value * 10 + (c - '0');
+      if (++digits > 9) return false;
+      if (fraction >= 0) fraction++;
+    } else {
+      return false;
+    }
+  }
+  
+  if (digits == 0) return false;
+  *mantissa = negative ? -value : value;
+  *decimals = fraction > 0 ? fraction : 0;
+  return true;
+}
+
+static String decodePrice(int32_t mantissa, uint8_t decimals) {
+  char digits[16];
+  snprintf(digits, sizeof(digits), "%ld", (long)(mantissa < 0 ? -(int64_t)mantissa : mantissa));
+  
+  // Ведущие нули дробной части: 5, 2 -> "005" -> "0.05"
+  String padded = digits;
+  while ((int)padded.length() <= decimals) padded = "0" + padded;
+  
+  String price = mantissa < 0 ? "-" : "";
+  if (decimals == 0) return price + padded;
+  int point = padded.length() - decimals;
+  return price + padded.substring(0, point) + "." + padded.substring(point);
+}
+
+// ---- участники и выборы ----
+
+uint32_t lanDeviceId() {
+  // Младшие четыре байта MAC - уникальная часть адреса
+  if (deviceId == 0) deviceId = (uint32_t)(ESP.getEfuseMac() >> 16);
+  return deviceId;
+}
+
+static bool isAlive(const LanPeer& peer) {
+  return millis() - peer.lastSeen < LAN_LEADER_TIMEOUT_MS;
+}
+
+static LanPeer* findPeer(uint32_t id, bool create) {
+  for (int i = 0; i < numPeers; i++) {
+    if (peers[i].id == id) return &peers[i];
+  }
+  if (!create) return NULL;
+  
+  // Место пропавшего участника переиспользуется
+  int slot = numPeers < LAN_MAX_PEERS ? numPeers++ : -1;
+  for (int i = 0; slot < 0 && i < numPeers; i++) {
+    if (!isAlive(peers[i])) slot = i;
+  }
+  if (slot < 0) return NULL;
+  
+  peers[slot].id = id;
+  peers[slot].lastSeen = millis();
+  peers[slot].flags = 0;
+  peers[slot].lastSeq = 0;
+  return &peers[slot];
+}
+
+// Себя устройство выбирает, лишь прослушав группу LAN_LEADER_TIMEOUT_MS:
+// за это время оно узнает действующего ведущего и других кандидатов
+static bool isReadyCandidate() {
+  return lanMode == LAN_MODE_AUTO && millis() - startedAt >= LAN_LEADER_TIMEOUT_MS;
+}
+
+static void formatId(uint32_t id, char* out, size_t size) {
+  if (id == 0) strlcpy(out, "none", size);
+  else snprintf(out, size, "%08lx", (unsigned long)id);
+}
+
+// Действующий ведущий сохраняет роль, пока его слышно; из нескольких
+// объявивших себя ведущими (после разделения сети) остается меньший номер.
+// Без ведущего выбирается кандидат с наименьшим номером
+static void electLeader() {
+  uint32_t claimed = isLanLeader() ? deviceId : 0;
+  uint32_t candidate = isReadyCandidate() ? deviceId : 0;
+  for (int i = 0; i < numPeers; i++) {
+    if (!isAlive(peers[i])) continue;
+    if ((peers[i].flags & LAN_FLAG_LEADER) && (claimed == 0 || peers[i].id < claimed)) claimed = peers[i].id;
+    if ((peers[i].flags & LAN_FLAG_CANDIDATE) && (candidate == 0 || peers[i].id < candidate)) candidate = peers[i].id;
+  }
+  
+  uint32_t elected = claimed != 0 ? claimed : candidate;
+  if (elected == leaderId) return;
+  
+  uint32_t previous = leaderId;
+  leaderId = elected;
+  stats.leaderChanges++;
+  
+  char text[LOG_TEXT_SIZE];
+  formatId(leaderId, text, sizeof(text));
+  logEvent(LOG_LAN_LEADER, text, lanPeerCount());
+  
+  // Новый ведущий сразу раздает цены; ведомый без ведущего опрашивает сам
+  if (leaderId == deviceId || (previous != 0 && previous != deviceId)) {
+    lastPricesAt = 0;
+    scheduleStockPriceUpdate();
+  }
+}
+
+// ---- подписки ведомых ----
+
+// Один код бывает на разных рынках: бумага - пара символа и рынка
+static bool isOwnSymbol(const char* symbol, uint8_t market) {
+  for (int i = 0; i < numTickers; i++) {
+    if (tickers[i].market == market && tickers[i].symbol == symbol) return true;
+  }
+  return false;
+}
+
+static void expireSubscriptions() {
+  int kept = 0;
+  for (int i = 0; i < numShared; i++) {
+    if (millis() - shared[i].lastRequested >= LAN_SUBSCRIPTION_TTL_MS) continue;
+    if (kept != i) shared[kept] = shared[i];
+    kept++;
+  }
+  for (int i = kept; i < numShared; i++) shared[i].price = "";
+  numShared = kept;
+}
+
+static void subscribe(const char* symbol, uint8_t market) {
+  if (market >= MARKET_COUNT) return;
+  for (int i = 0; i < numShared; i++) {
+    if (shared[i].market == market && strcmp(shared[i].symbol, symbol) == 0) {
+      shared[i].lastRequested = millis();
+      return;
+    }
+  }
+  if (numShared >= LAN_MAX_SYMBOLS) return;
+  
+  SharedSymbol& entry = shared[numShared++];
+  strlcpy(entry.symbol, symbol, sizeof(entry.symbol));
+  entry.market = market;
+  entry.lastRequested = millis();
+  entry.price = "";
+}
+
+// ---- отправка ----
+
+// Анонс: флаги, число бумаг, записи "символ, рынок"
+static void sendAnnounce() {
+  lastAnnounce = millis();
+  FrameWriter frame(LAN_FRAME_ANNOUNCE);
+  uint8_t flags = (lanMode == LAN_MODE_AUTO ? LAN_FLAG_CANDIDATE : 0) | (isLanLeader() ? LAN_FLAG_LEADER : 0);
+  frame.put8(flags);
+  
+  size_t countAt = frame.size();
+  uint8_t count = 0;
+  frame.put8(0);
+  for (int i = 0; i < numTickers; i++) {
+    const String& symbol = tickers[i].symbol;
+    if (symbol.length() == 0 || symbol.length() >= LAN_SYMBOL_SIZE || !frame.fits(2 + symbol.length())) continue;
+    frame.putSymbol(symbol.c_str(), symbol.length());
+    frame.put8(tickers[i].market);
+    count++;
+  }
+  frame.patch8(countAt, count);
+  frame.send();
+}
+
+// Кадр цен: срок годности (мс), число записей, записи "символ, рынок, цена, знаки".
+// Не поместившиеся записи уходят следующим кадром
+class PriceFrameBuilder {
+public:
+  PriceFrameBuilder() : open(false), count(0), countAt(0) {}
+  ~PriceFrameBuilder() { flush(); }
+  
+  void add(const char* symbol, uint8_t market, const String& price) {
+    int32_t mantissa;
+    uint8_t decimals;
+    size_t symbolLen = strlen(symbol);
+    if (symbolLen == 0 || symbolLen >= LAN_SYMBOL_SIZE || !encodePrice(price, &mantissa, &decimals)) return;
+  
+    size_t entrySize = 1 + symbolLen + 1 + 4 + 1;
+    if (open && (!frame.fits(entrySize) || count == 255)) flush();
+    if (!open) {
+      frame.begin(LAN_FRAME_PRICES);
+      frame.put32(2 * updateInterval + LAN_LEADER_TIMEOUT_MS);
+      countAt = frame.size();
+      frame.put8(0);
+      open = true;
+    }
+    frame.putSymbol(symbol, symbolLen);
+    frame.put8(market);
+    frame.put32((uint32_t)mantissa);
+    frame.put8(decimals);
+    count++;
+  }
+  
+  void flush() {
+    if (!open) return;
+    frame.patch8(countAt, count);
+    frame.send();
+    open = false;
+    count = 0;
+  }
+  
+private:
+  FrameWriter frame;
+  bool open;
+  uint8_t count;
+  size_t countAt;
+};
+
+static bool isUsablePrice(const String& price) {
+  return price.length() > 0 && price != "Error";
+}
+
+static int fetchSlots[LAN_MAX_SYMBOLS];
+
+static void storeSharedPrice(int index, const String& price) {
+  if (isUsablePrice(price)) shared[fetchSlots[index]].price = price;
+}
+
+void shareLanPrices() {
+  if (!isLanLeader()) return;
+  expireSubscriptions();
+  
+  // Чужие бумаги запрашиваются тем же пулом пакетами по рынкам, свои уже получены
+  for (int market = 0; market < MARKET_COUNT; market++) {
+    String symbols[LAN_MAX_SYMBOLS];
+    String results[LAN_MAX_SYMBOLS];
+    int count = 0;
+    for (int i = 0; i < numShared; i++) {
+      if (shared[i].market != market || isOwnSymbol(shared[i].symbol, market)) continue;
+      fetchSlots[count] = i;
+      symbols[count++] = shared[i].symbol;
+    }
+    fetchPricesParallel(quoteProvider(market), symbols, results, count, fetchConcurrency, storeSharedPrice);
+  }
+  
+  PriceFrameBuilder builder;
+  for (int i = 0; i < numTickers; i++) {
+    if (updateIndicators[i] != 'x' && isUsablePrice(stockPrices[i])) {
+      builder.add(tickers[i].symbol.c_str(), tickers[i].market, stockPrices[i]);
+    }
+  }
+  for (int i = 0; i < numShared; i++) {
+    if (!isOwnSymbol(shared[i].symbol, shared[i].market) && isUsablePrice(shared[i].price)) {
+      builder.add(shared[i].symbol, shared[i].market, shared[i].price);
+    }
+  }
+}
+
+// ---- прием ----
+
+static void applyPrices(FrameReader& reader) {
+  uint32_t validMs = reader.get32();
+  uint8_t count = reader.get8();
+  
+  bool displayChanged = false;
+  for (int n = 0; n < count && reader.valid(); n++) {
+    char symbol[LAN_SYMBOL_SIZE];
+    if (!reader.getSymbol(symbol)) break;
+    uint8_t market = reader.get8();
+    int32_t mantissa = (int32_t)reader.get32();
+    uint8_t decimals = reader.get8();
+    if (!reader.valid() || decimals > 9) break;
+  
+    String price = decodePrice(mantissa, decimals);
+    for (int i = 0; i < numTickers; i++) {
+      if (tickers[i].market != market || tickers[i].symbol != symbol) continue;
+      stats.pricesApplied++;
+      if (stockPrices[i] == price && updateIndicators[i] == ' ') continue;
+      stockPrices[i] = price;
+      updateIndicators[i] = ' ';
+      invalidateTickerLine(i);
+      if (isMarqueeMode() || isTickerDisplayed(i)) displayChanged = true;
+    }
+  }
+  
+  if (reader.valid()) {
+    lastPricesAt = millis();
+    pricesValidMs = validMs;
+  } else {
+    stats.badFrames++;
+  }
+  if (displayChanged) updateDisplay();
+}
+
+static void handleFrame(const uint8_t* data, size_t len) {
+  if (len < LAN_HEADER_SIZE + LAN_CRC_SIZE) {
+    stats.badFrames++;
+    return;
+  }
+  uint16_t crc = data[len - 2] | (uint16_t)data[len - 1] << 8;
+  if (crc16(data, len - LAN_CRC_SIZE) != crc) {
+    stats.badFrames++;
+    return;
+  }
+  
+  FrameReader reader(data, len - LAN_CRC_SIZE);
+  uint16_t magic = reader.get16();
+  uint8_t version = reader.get8();
+  uint8_t type = reader.get8();
+  uint32_t sender = reader.get32();
+  uint32_t seq = reader.get32();
+  if (magic != LAN_MAGIC || version != LAN_VERSION || sender == 0) {
+    stats.badFrames++;
+    return;
+  }
+  // Собственные кадры возвращаются через multicast loopback
+  if (sender == lanDeviceId()) return;
+  stats.framesReceived++;
+  
+  LanPeer* peer = findPeer(sender, true);
+  if (peer == NULL) return;
+  
+  if (peer->lastSeq != 0) {
+    int32_t delta = (int32_t)(seq - peer->lastSeq);
+    if (delta <= 0 && delta > -LAN_SEQ_WINDOW) {
+      stats.duplicates++;
+      return;
+    }
+    if (delta > 1 && delta < LAN_SEQ_WINDOW) stats.lost += delta - 1;
+  }
+  peer->lastSeq = seq;
+  peer->lastSeen = millis();
+  
+  if (type == LAN_FRAME_ANNOUNCE) {
+    peer->flags = reader.get8();
+    uint8_t count = reader.get8();
+    for (int n = 0; n < count && reader.valid(); n++) {
+      char symbol[LAN_SYMBOL_SIZE];
+      if (!reader.getSymbol(symbol)) break;
+      uint8_t market = reader.get8();
+      if (reader.valid() && lanMode == LAN_MODE_AUTO) subscribe(symbol, market);
+    }
+    // Подписки помнит каждый кандидат: новый ведущий обслужит их сразу
+    if (!reader.valid()) stats.badFrames++;
+  } else if (type == LAN_FRAME_PRICES) {
+    if (sender == leaderId) applyPrices(reader);
+  }
+}
+
+static void stopLan() {
+  udp.stop();
+  udpStarted = false;
+  numPeers = 0;
+  lastPricesAt = 0;
+  if (leaderId != 0) {
+    leaderId = 0;
+    stats.leaderChanges++;
+    logEvent(LOG_LAN_LEADER, "none", 0);
+  }
+}
+
+void handleLanFanout() {
+  if (lanMode == LAN_MODE_OFF || WiFi.status() != WL_CONNECTED) {
+    if (udpStarted) stopLan();
+    return;
+  }
+  
+  if (!udpStarted) {
+    if (!udp.beginMulticast(LAN_GROUP_ADDRESS, LAN_PORT)) return;
+    udpStarted = true;
+    startedAt = millis();
+    if (txSeq == 0) txSeq = esp_random() | 1;
+    sendAnnounce();
+  }
+  
+  for (int frames = 0; frames < LAN_FRAMES_PER_POLL; frames++) {
+    int size = udp.parsePacket();
+    if (size <= 0) break;
+    if (size > LAN_MAX_FRAME) {
+      udp.flush();
+      stats.badFrames++;
+      continue;
+    }
+    uint8_t buffer[LAN_MAX_FRAME];
+    int len = udp.read(buffer, size);
+    if (len > 0) handleFrame(buffer, len);
+  }
+  
+  if (millis() - lastAnnounce >= LAN_ANNOUNCE_MS) sendAnnounce();
+  electLeader();
+}
+
+// ---- состояние ----
+
+bool isLanLeader() {
+  return udpStarted && lanMode == LAN_MODE_AUTO && leaderId == deviceId && deviceId != 0;
+}
+
+bool isLanFed() {
+  if (!udpStarted || leaderId == 0 || leaderId == deviceId || lastPricesAt == 0) return false;
+  LanPeer* leader = findPeer(leaderId, false);
+  return leader && isAlive(*leader) && millis() - lastPricesAt < pricesValidMs;
+}
+
+uint32_t lanLeaderId() {
+  return leaderId;
+}
+
+int lanPeerCount() {
+  int alive = 0;
+  for (int i = 0; i < numPeers; i++) {
+    if (isAlive(peers[i])) alive++;
+  }
+  return alive;
+}
+
+int lanSharedSymbolCount() {
+  return numShared;
+}
+
+const LanStats& lanStats() {
+  return stats;
+}
+
+const char* lanModeName(int mode) {
+  switch (mode) {
+    case LAN_MODE_AUTO: return "auto";
+    case LAN_MODE_FOLLOWER: return "follower";
+    default: return "off";
+  }
+}
+
+int parseLanMode(const String& name) {
+  for (int mode = 0; mode < LAN_MODE_COUNT; mode++) {
+    if (name == lanModeName(mode)) return mode;
+  }
+  return -1;
+}
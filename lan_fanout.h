@@ -0,0 +1,51 @@
+#ifndef LAN_FANOUT_H
+#define LAN_FANOUT_H
+
+#include "config.h"
+
+// Раздача котировок по локальной сети: один ведущий опрашивает биржу
+// за всех и рассылает цены группе UDP multicast, ведомые их применяют
+#define LAN_MODE_OFF 0
+#define LAN_MODE_AUTO 1     // участвует в выборах ведущего
+#define LAN_MODE_FOLLOWER 2 // только принимает, ведущим не становится
+#define LAN_MODE_COUNT 3
+
+#define LAN_GROUP_ADDRESS IPAddress(239, 255, 54, 1)
+#define LAN_PORT 5454
+#define LAN_POLL_MS 20
+// Анонс раз в 5 с; ведущий, не слышный три анонса, считается пропавшим
+#define LAN_ANNOUNCE_MS 5000
+#define LAN_LEADER_TIMEOUT_MS 15000
+#define LAN_SUBSCRIPTION_TTL_MS 60000
+#define LAN_MAX_PEERS 16
+#define LAN_MAX_SYMBOLS 32
+#define LAN_MAX_FRAME 512
+// Номер кадра меньше последнего больше чем на окно - отправитель перезагрузился
+#define LAN_SEQ_WINDOW 64
+
+struct LanStats {
+  uint32_t framesSent;
+  uint32_t framesReceived;
+  uint32_t badFrames;
+  uint32_t duplicates;
+  uint32_t lost;
+  uint32_t pricesApplied;
+  uint32_t leaderChanges;
+};
+
+void handleLanFanout();
+// Ведомый, которому ведущий присылает свежие цены: опрос биржи не нужен
+bool isLanFed();
+bool isLanLeader();
+// Ведущий: дозапросить чужие бумаги и разослать все цены
+void shareLanPrices();
+
+uint32_t lanDeviceId();
+uint32_t lanLeaderId();
+int lanPeerCount();
+int lanSharedSymbolCount();
+const LanStats& lanStats();
+const char* lanModeName(int mode);
+int parseLanMode(const String& name);
+
+#endif
@@ -1,6 +1,10 @@
 #include "lcd_display.h"
 #include "config.h"
-#include <LiquidCrystal.h>
+#include "marquee.h"
+#include "scheduler.h"
+#include "log_ring.h"
+#include "price_history.h"
+#include "heap_monitor.h"
 
 // Custom characters for arrows
 byte upArrow[8] = {
@@ -11,14 +15,48 @@ byte downArrow[8] = {
   B00100, B00100, B00100, B00100, B10101, B01110, B00100, B00000
 }; 
 
+// Раскладка строки тикера под ширину дисплея: индикатор, символ, пробел,
+// цена, пробел, стрелка, звездочка. 16 колонок - 4+7, 20 колонок - 6+9
+template <uint8_t Cols>
+struct TickerLineLayout {
+  static_assert(Cols >= 16, "ticker line needs at least 16 columns");
+  static const uint8_t symbolWidth = Cols >= 20 ? 6 : 4;
+  static const uint8_t priceWidth = Cols - symbolWidth - 5;
+};
+
+typedef TickerLineLayout<DISPLAY_COLS> LineLayout;
+
+// Кадр - перерисовка строки тикера или шаг бегущей строки
+static uint32_t frameCount = 0;
+static bool statusLineActive = false;
+static DisplayCallStats callStats[DISPLAY_CALL_COUNT] = {
+  {"rotate", 0, 0, 0, 0, 0},
+  {"line", 0, 0, 0, 0, 0},
+};
+
+static void recordCall(int call, unsigned long startMicros, uint32_t allocationsBefore) {
+  DisplayCallStats& stats = callStats[call];
+  uint32_t elapsed = micros() - startMicros;
+  stats.calls++;
+  stats.totalMicros += elapsed;
+  if (elapsed > stats.maxMicros) stats.maxMicros = elapsed;
+  stats.allocations += heapAllocationCount() - allocationsBefore;
+}
+
+// Строки под тикеры: нижнюю может занимать строка состояния
+static int tickerRows() {
+  return statusLineActive ? DISPLAY_ROWS - 1 : DISPLAY_ROWS;
+}
+
 void initLCD() {
-  lcd.begin(16, 2);
+  lcd.begin();
   lcd.createChar(1, upArrow);
   lcd.createChar(2, downArrow);
 }
 
 void updateDisplay() {
   if (numTickers == 0) {
+    stopMarquee();
     lcd.clear();
     lcd.print("No tickers");
     lcd.setCursor(0, 1);
@@ -26,42 +64,56 @@ void updateDisplay() {
     return;
   }
   
-  int numLines = min(numTickers, 2);
+  if (isMarqueeMode()) {
+    // Лента выводится своей задачей, здесь только обновляется ее текст
+    startMarquee();
+    rebuildMarqueeTape();
+    return;
+  }
+  
+  int numLines = min(numTickers, tickerRows());
   for (int line = 0; line < numLines; line++) {
     displayTickerLine(line, displayedIndices[line]);
   }
-}
-
-void displayTickerLine(int displayLine, int tickerIndex) {
-  String symbol = tickers[tickerIndex].symbol;
-  String price = stockPrices[tickerIndex];
   
-  String displayText = "";
-  displayText += updateIndicators[tickerIndex];
-  
-  if (symbol.length() > 4) {
-    displayText += symbol.substring(0, 4);
-  } else {
-    displayText += symbol;
-    for (int i = symbol.length(); i < 4; i++) displayText += " ";
+  char blank[DISPLAY_COLS];
+  memset(blank, ' ', sizeof(blank));
+  for (int line = numLines; line < tickerRows(); line++) {
+    lcd.writeRegion(0, line, blank, DISPLAY_COLS);
   }
-  
-  displayText += " ";
-  
-  String priceText = price;
-  if (priceText == "Error") priceText = "Error";
-  
-  if (priceText.length() < 7) {
-    for (int i = priceText.length(); i < 7; i++) displayText += " ";
-    displayText += priceText;
-  } else {
-    displayText += priceText.substring(0, 7);
+}
+
+// Аппаратный сдвиг работает только когда у каждой строки есть скрытая
+// часть DDRAM, на дисплеях из 4 строк ее нет - там остается смена строк
+bool isMarqueeMode() {
+  return displayMode == DISPLAY_MODE_MARQUEE && DISPLAY_ROWS == 2 && !statusLineActive;
+}
+
+bool isTickerDisplayed(int tickerIndex) {
+  int numLines = min(numTickers, tickerRows());
+  for (int line = 0; line < numLines; line++) {
+    if (displayedIndices[line] == tickerIndex) return true;
   }
-  
-  displayText += " ";
-  
+  return false;
+}
+
+// Страницы строки тикера: цена или изменение к прошлому закрытию
+#define LINE_VIEW_PRICE 0
+#define LINE_VIEW_CHANGE 1
+#define LINE_VIEW_COUNT 2
+
+// Готовые строки дисплея; пересобираются только после изменения цены,
+// индикатора или порога, смена строк сводится к выводу готового буфера
+static char lineCache[MAX_TICKERS][LINE_VIEW_COUNT][DISPLAY_COLS];
+static bool lineCacheValid[MAX_TICKERS][LINE_VIEW_COUNT];
+static uint8_t lineViews[DISPLAY_ROWS];
+static uint8_t nextLineView = LINE_VIEW_PRICE;
+
+// Стрелка относительно порога; звездочка - сигнал покупки ниже порога
+char tickerSignal(int tickerIndex, bool* showStar) {
+  const String& price = stockPrices[tickerIndex];
   char arrowChar = ' ';
-  bool showStar = false;
+  *showStar = false;
   
   if (price != "Error") {
     float currentPrice = price.toFloat();
@@ -70,7 +122,7 @@ void displayTickerLine(int displayLine, int tickerIndex) {
       if (currentPrice > tickers[tickerIndex].threshold) arrowChar = 2;
       else if (currentPrice < tickers[tickerIndex].threshold) {
         arrowChar = 1;
-        showStar = true;
+        *showStar = true;
       }
     } else {
       if (currentPrice > tickers[tickerIndex].threshold) arrowChar = 1;
@@ -78,19 +130,169 @@ void displayTickerLine(int displayLine, int tickerIndex) {
     }
   }
   
-  displayText += char(arrowChar);
-  displayText += (showStar ? "*" : " ");
+  return arrowChar;
+}
+
+// Индикатор, символ и значение, выровненное вправо по полю цены
+static int buildLineStart(int tickerIndex, const char* value, unsigned int valueLength, char* line) {
+  const String& symbol = tickers[tickerIndex].symbol;
+  int pos = 0;
+  
+  line[pos++] = updateIndicators[tickerIndex];
+  
+  for (unsigned int i = 0; i < LineLayout::symbolWidth; i++) line[pos++] = i < symbol.length() ? symbol[i] : ' ';
+  line[pos++] = ' ';
+  
+  if (valueLength > LineLayout::priceWidth) valueLength = LineLayout::priceWidth;
+  for (unsigned int i = valueLength; i < LineLayout::priceWidth; i++) line[pos++] = ' ';
+  for (unsigned int i = 0; i < valueLength; i++) line[pos++] = value[i];
+  line[pos++] = ' ';
+  return pos;
+}
+
+static void buildTickerLine(int tickerIndex, char* line) {
+  const String& price = stockPrices[tickerIndex];
+  int pos = buildLineStart(tickerIndex, price.c_str(), price.length(), line);
+  
+  bool showStar = false;
+  char arrowChar = tickerSignal(tickerIndex, &showStar);
+  
+  line[pos++] = arrowChar;
+  line[pos++] = showStar ? '*' : ' ';
+}
+
+// Изменение к прошлому закрытию, стрелка по его знаку; H или L - цена
+// вышла за диапазон закрытий 52 недель. Без истории - обычная строка
+static bool buildChangeLine(int tickerIndex, char* line) {
+  PriceStats stats;
+  float percent;
+  if (!dayChangePercent(tickerIndex, &stats, &percent)) return false;
+  
+  char text[16];
+  snprintf(text, sizeof(text), "%+.2f%%", percent);
+  if (strlen(text) > LineLayout::priceWidth) snprintf(text, sizeof(text), "%+.0f%%", percent);
+  int pos = buildLineStart(tickerIndex, text, strlen(text), line);
+  
+  float price = stockPrices[tickerIndex].toFloat();
+  char rangeChar = ' ';
+  if (stats.closes > 1 && price > stats.yearHigh) rangeChar = 'H';
+  else if (stats.closes > 1 && price < stats.yearLow) rangeChar = 'L';
+  
+  line[pos++] = percent > 0 ? 1 : percent < 0 ? 2 : ' ';
+  line[pos++] = rangeChar;
+  return true;
+}
+
+void invalidateTickerLine(int tickerIndex) {
+  if (tickerIndex < 0 || tickerIndex >= MAX_TICKERS) return;
+  for (int view = 0; view < LINE_VIEW_COUNT; view++) lineCacheValid[tickerIndex][view] = false;
+}
+
+void invalidateAllTickerLines() {
+  for (int i = 0; i < MAX_TICKERS; i++) invalidateTickerLine(i);
+}
+
+void displayTickerLine(int displayLine, int tickerIndex) {
+  unsigned long start = micros();
+  uint32_t allocations = heapAllocationCount();
+  int view = lineViews[displayLine];
+  char* line = lineCache[tickerIndex][view];
+  if (!lineCacheValid[tickerIndex][view]) {
+    if (view != LINE_VIEW_CHANGE || !buildChangeLine(tickerIndex, line)) buildTickerLine(tickerIndex, line);
+    lineCacheValid[tickerIndex][view] = true;
+    callStats[DISPLAY_CALL_LINE].rebuilds++;
+  }
+  
+  lcd.writeRegion(0, displayLine, line, DISPLAY_COLS);
+  frameCount++;
+  recordCall(DISPLAY_CALL_LINE, start, allocations);
+}
+
+// Замена по одной строке за раз, если тикеров больше, чем строк дисплея.
+// С историей цен строки чередуют цену и изменение за день: после полного
+// круга тикеров, а если все тикеры уже на экране - на каждом шаге
+static void rotateLines() {
+  if (isMarqueeMode() || numTickers == 0) return;
+  
+  if (numTickers <= tickerRows()) {
+    if (!hasPriceHistory()) return;
+    nextLineView = nextLineView == LINE_VIEW_PRICE ? LINE_VIEW_CHANGE : LINE_VIEW_PRICE;
+    for (int line = 0; line < numTickers; line++) {
+      lineViews[line] = nextLineView;
+      displayTickerLine(line, displayedIndices[line]);
+    }
+    return;
+  }
+  
+  if (nextLineToReplace >= tickerRows()) nextLineToReplace = 0;
+  displayedIndices[nextLineToReplace] = nextTickerIndex;
+  lineViews[nextLineToReplace] = nextLineView;
+  displayTickerLine(nextLineToReplace, nextTickerIndex);
   
-  lcd.setCursor(0, displayLine);
-  lcd.print(displayText);
+  nextTickerIndex = (nextTickerIndex + 1) % numTickers;
+  nextLineToReplace = (nextLineToReplace + 1) % tickerRows();
+  if (nextTickerIndex == 0 && hasPriceHistory()) {
+    nextLineView = nextLineView == LINE_VIEW_PRICE ? LINE_VIEW_CHANGE : LINE_VIEW_PRICE;
+  }
+}
+
+void rotateDisplayLines() {
+  unsigned long start = micros();
+  uint32_t allocations = heapAllocationCount();
+  rotateLines();
+  recordCall(DISPLAY_CALL_ROTATE, start, allocations);
+}
+
+void countDisplayFrame() {
+  frameCount++;
+}
+
+// Лента останавливается: ей нужны обе строки. Тикеры сменяются в
+// оставшихся строках, пока состояние не снято
+void showStatusLine(const char* text) {
+  if (!statusLineActive) {
+    stopMarquee();
+    statusLineActive = true;
+    updateDisplay();
+  }
+  
+  char line[DISPLAY_COLS];
+  size_t length = min(strlen(text), (size_t)DISPLAY_COLS);
+  memset(line, ' ', sizeof(line));
+  memcpy(line, text, length);
+  lcd.writeRegion(0, DISPLAY_ROWS - 1, line, DISPLAY_COLS);
+  frameCount++;
+}
+
+void clearStatusLine() {
+  if (!statusLineActive) return;
+  statusLineActive = false;
+  updateDisplay();
+}
+
+void logDisplayStats() {
+  uint32_t transactions = lcd.busTransactions();
+  logEvent(LOG_DISPLAY_STATS, "", transactions, frameCount, 0,
+           frameCount ? (float)transactions / frameCount : 0.0f);
+}
+
+bool getDisplayCallStats(int call, DisplayCallStats* stats) {
+  if (call < 0 || call >= DISPLAY_CALL_COUNT) return false;
+  *stats = callStats[call];
+  return true;
 }
 
 void resetDisplayIndices() {
-  displayedIndices[0] = 0;
-  displayedIndices[1] = numTickers > 1 ? 1 : 0;
-  nextTickerIndex = numTickers > 1 ? 2 : 0;
+  for (int line = 0; line < DISPLAY_ROWS; line++) {
+    displayedIndices[line] = line < numTickers ? line : 0;
+    lineViews[line] = LINE_VIEW_PRICE;
+  }
+  nextLineView = LINE_VIEW_PRICE;
+  nextTickerIndex = numTickers > DISPLAY_ROWS ? DISPLAY_ROWS : 0;
   nextLineToReplace = 0;
-  lastDisplayChangeTime = millis();
+  setJobPeriod(displayRotateJob, displayChangeInterval);
+  rescheduleJob(displayRotateJob, displayChangeInterval);
   
   for (int i = 0; i < MAX_TICKERS; i++) updateIndicators[i] = ' ';
+  invalidateAllTickerLines();
 }
\ No newline at end of file
@@ -3,13 +3,46 @@
 
 #include "config.h"
 
+#define LCD_DDRAM_WIDTH 40
+
+// Display modes
+#define DISPLAY_MODE_ROTATE 0
+#define DISPLAY_MODE_MARQUEE 1
+
+// Замер вызовов вывода тикеров: время по micros(), выделения кучи
+// (heapAllocationCount) и пересборки строки вместо копии из кэша
+#define DISPLAY_CALL_ROTATE 0
+#define DISPLAY_CALL_LINE 1
+#define DISPLAY_CALL_COUNT 2
+
+struct DisplayCallStats {
+  const char* name;
+  uint32_t calls;
+  uint64_t totalMicros;
+  uint32_t maxMicros;
+  uint32_t allocations;
+  uint32_t rebuilds;
+};
+
 // Custom characters for arrows
 extern byte upArrow[8];
 extern byte downArrow[8];
 
 void initLCD();
 void updateDisplay();
+bool isMarqueeMode();
+bool isTickerDisplayed(int tickerIndex);
 void displayTickerLine(int displayLine, int tickerIndex);
+char tickerSignal(int tickerIndex, bool* showStar);
+void invalidateTickerLine(int tickerIndex);
+void invalidateAllTickerLines();
 void resetDisplayIndices();
+void rotateDisplayLines();
+void countDisplayFrame();
+// Нижняя строка под состояние (обновление прошивки), тикеры - в остальных
+void showStatusLine(const char* text);
+void clearStatusLine();
+void logDisplayStats();
+bool getDisplayCallStats(int call, DisplayCallStats* stats);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "log_ring.h"
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Слот считается записанным, когда seq == номер записи + 1.
+// Читатель сверяет seq до и после копирования, как в seqlock
+struct LogSlot {
+  std::atomic<uint32_t> seq;
+  uint32_t timeMs;
+  uint16_t event;
+  char text[LOG_TEXT_SIZE];
+  int32_t args[3];
+  float value;
+};
+
+struct LogRecord {
+  uint32_t timeMs;
+  uint16_t event;
+  char text[LOG_TEXT_SIZE];
+  int32_t args[3];
+  float value;
+};
+
+// Набор аргументов, которые подставляются в шаблон сообщения
+enum LogLayout : uint8_t {
+  LAYOUT_NONE,
+  LAYOUT_TEXT,
+  LAYOUT_TEXT_INT,
+  LAYOUT_TEXT_INT_INT,
+  LAYOUT_TEXT_FLOAT_INT,
+  LAYOUT_INT,
+  LAYOUT_INT_INT_INT,
+  LAYOUT_INT_INT_FLOAT
+};
+
+struct LogFormat {
+  const char* pattern;
+  LogLayout layout;
+};
+
+static const LogFormat logFormats[LOG_EVENT_COUNT] = {
+  { "Updated price for %s: %.4f (%ld ms)", LAYOUT_TEXT_FLOAT_INT },
+  { "HTTP Error for %s: %ld (%ld ms)", LAYOUT_TEXT_INT_INT },
+  { "JSON parsing error for %s: code %ld", LAYOUT_TEXT_INT },
+  { "No price for %s", LAYOUT_TEXT },
+  { "Updated %ld prices in %ld ms with %ld workers", LAYOUT_INT_INT_INT },
+  { "Display: %ld bus transactions, %ld frames, %.1f per frame", LAYOUT_INT_INT_FLOAT },
+  { "%s -> %ld (%ld bytes)", LAYOUT_TEXT_INT_INT },
+  { "Ticker %s added at %ld", LAYOUT_TEXT_INT },
+  { "Ticker %s rejected: HTTP %ld", LAYOUT_TEXT_INT },
+  { "Ticker %s removed", LAYOUT_TEXT },
+  { "Settings: update %ld min, display %ld s, %ld workers", LAYOUT_INT_INT_INT },
+  { "Imported %ld tickers", LAYOUT_INT },
+  { "Import rejected: %s", LAYOUT_TEXT },
+  { "Stream connected to %s", LAYOUT_TEXT },
+  { "Stream handshake failed: %s", LAYOUT_TEXT },
+  { "Invalid stream URL: %s", LAYOUT_TEXT },
+  { "Stream error: %s", LAYOUT_TEXT },
+  { "Stream lost, falling back to polling", LAYOUT_NONE },
+  { "Securities index: %ld entries", LAYOUT_INT },
+  { "Securities index refreshed: %ld entries", LAYOUT_INT },
+  { "Securities index refresh failed, HTTP %ld", LAYOUT_INT },
+  { "Heap: %ld free, %ld largest block, %ld%% fragmented", LAYOUT_INT_INT_INT },
+  { "LAN leader: %s (%ld peers)", LAYOUT_TEXT_INT },
+  { "Chart %s: %ld candles in %ld ms", LAYOUT_TEXT_INT_INT },
+  { "Upstream %ld down after %ld failures, using %ld", LAYOUT_INT_INT_INT },
+  { "Price history: %ld series, %ld closes, %ld bytes", LAYOUT_INT_INT_INT },
+  { "Closes for %s: %ld tickers, file %ld bytes", LAYOUT_TEXT_INT_INT },
+  { "Price history compacted: %ld -> %ld bytes, %ld series", LAYOUT_INT_INT_INT },
+  { "OTA started: %s image, %ld bytes to download", LAYOUT_TEXT_INT },
+  { "OTA failed: %s (%ld bytes downloaded)", LAYOUT_TEXT_INT },
+  { "OTA done: %ld bytes downloaded, %ld bytes written in %ld ms", LAYOUT_INT_INT_INT },
+  { "OTA image confirmed after %ld ms", LAYOUT_INT },
+  { "OTA image not confirmed in %ld ms, rolling back", LAYOUT_INT }
+};
+
+static LogSlot ring[LOG_RING_SIZE];
+static std::atomic<uint32_t> head(0);
+static TaskHandle_t drainTask = NULL;
+
+// Вызывается из любой задачи; блокировок и выделения памяти нет
+void logEvent(LogEvent event, const char* text, int32_t arg0, int32_t arg1, int32_t arg2, float value) {
+  uint32_t seq = head.fetch_add(1, std::memory_order_relaxed);
+  LogSlot& slot = ring[seq & (LOG_RING_SIZE - 1)];
+  
+  slot.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  
+  slot.timeMs = millis();
+  slot.event = event;
+  strlcpy(slot.text, text ? text : "", LOG_TEXT_SIZE);
+  slot.args[0] = arg0;
+  slot.args[1] = arg1;
+  slot.args[2] = arg2;
+  slot.value = value;
+  
+  slot.seq.store(seq + 1, std::memory_order_release);
+}
+
+// Копия записи; false, если слот еще пишется или уже перезаписан
+static bool readRecord(uint32_t seq, LogRecord& record) {
+  LogSlot& slot = ring[seq & (LOG_RING_SIZE - 1)];
+  if (slot.seq.load(std::memory_order_acquire) != seq + 1) return false;
+  
+  record.timeMs = slot.timeMs;
+  record.event = slot.event;
+  memcpy(record.text, slot.text, LOG_TEXT_SIZE);
+  record.text[LOG_TEXT_SIZE - 1] = '\0';
+  memcpy(record.args, slot.args, sizeof(record.args));
+  record.value = slot.value;
+  
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.seq.load(std::memory_order_relaxed) == seq + 1 && record.event < LOG_EVENT_COUNT;
+}
+
+static void formatRecord(const LogRecord& record, char* buf, size_t size) {
+  const LogFormat& format = logFormats[record.event];
+  const int32_t* a = record.args;
+  int len = snprintf(buf, size, "[%lu.%03lu] ", (unsigned long)(record.timeMs / 1000),
+                     (unsigned long)(record.timeMs % 1000));
+  if (len < 0 || (size_t)len >= size) return;
+  
+  char* out = buf + len;
+  size_t left = size - len;
+  switch (format.layout) {
+    case LAYOUT_NONE:           snprintf(out, left, "%s", format.pattern); break;
+    case LAYOUT_TEXT:           snprintf(out, left, format.pattern, record.text); break;
+    case LAYOUT_TEXT_INT:       snprintf(out, left, format.pattern, record.text, (long)a[0]); break;
+    case LAYOUT_TEXT_INT_INT:   snprintf(out, left, format.pattern, record.text, (long)a[0], (long)a[1]); break;
+    case LAYOUT_TEXT_FLOAT_INT: snprintf(out, left, format.pattern, record.text, (double)record.value, (long)a[0]); break;
+    case LAYOUT_INT:            snprintf(out, left, format.pattern, (long)a[0]); break;
+    case LAYOUT_INT_INT_INT:    snprintf(out, left, format.pattern, (long)a[0], (long)a[1], (long)a[2]); break;
+    case LAYOUT_INT_INT_FLOAT:  snprintf(out, left, format.pattern, (long)a[0], (long)a[1], (double)record.value); break;
+  }
+}
+
+void printEventLog(Print& out, uint32_t fromSeq, uint32_t toSeq) {
+  uint32_t end = head.load(std::memory_order_acquire);
+  if (toSeq > end) toSeq = end;
+  uint32_t oldest = end > LOG_RING_SIZE ? end - LOG_RING_SIZE : 0;
+  
+  if (fromSeq < oldest) {
+    out.printf("... %lu entries lost\n", (unsigned long)(oldest - fromSeq));
+    fromSeq = oldest;
+  }
+  
+  char line[128];
+  for (uint32_t seq = fromSeq; seq < toSeq; seq++) {
+    LogRecord record;
+    if (!readRecord(seq, record)) continue;
+    formatRecord(record, line, sizeof(line));
+    out.println(line);
+  }
+}
+
+uint32_t eventLogHead() {
+  return head.load(std::memory_order_acquire);
+}
+
+// Форматирование и вывод в UART - в отдельной задаче на ядре 0,
+// пишущие задачи не ждут порт
+static void drainTaskLoop(void* arg) {
+  uint32_t cursor = 0;
+  while (true) {
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+    uint32_t end = eventLogHead();
+    if (end == cursor) continue;
+    printEventLog(Serial, cursor, end);
+    cursor = end;
+  }
+}
+
+void initEventLog() {
+#if LOG_SERIAL_DRAIN
+  if (drainTask == NULL) {
+    xTaskCreatePinnedToCore(drainTaskLoop, "logDrain", LOG_DRAIN_TASK_STACK_SIZE, NULL,
+                            LOG_DRAIN_TASK_PRIORITY, &drainTask, 0);
+  }
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <Arduino.h>
+#include <Print.h>
+
+// Двоичный журнал в RAM: запись - одно атомарное резервирование слота
+// и копирование аргументов, текст собирается только при чтении
+#define LOG_RING_SIZE 128 // степень двойки
+#define LOG_TEXT_SIZE 16
+#define LOG_SERIAL_DRAIN 1
+#define LOG_DRAIN_INTERVAL_MS 200
+#define LOG_DRAIN_TASK_STACK_SIZE 3072
+#define LOG_DRAIN_TASK_PRIORITY 1
+
+enum LogEvent : uint16_t {
+  LOG_FETCH_OK,
+  LOG_FETCH_HTTP_ERROR,
+  LOG_FETCH_JSON_ERROR,
+  LOG_FETCH_NO_DATA,
+  LOG_FETCH_BATCH,
+  LOG_DISPLAY_STATS,
+  LOG_WEB_REQUEST,
+  LOG_TICKER_ADDED,
+  LOG_TICKER_REJECTED,
+  LOG_TICKER_REMOVED,
+  LOG_SETTINGS_UPDATED,
+  LOG_IMPORT_DONE,
+  LOG_IMPORT_REJECTED,
+  LOG_STREAM_CONNECTED,
+  LOG_STREAM_HANDSHAKE_FAILED,
+  LOG_STREAM_INVALID_URL,
+  LOG_STREAM_ERROR,
+  LOG_STREAM_LOST,
+  LOG_INDEX_LOADED,
+  LOG_INDEX_REFRESHED,
+  LOG_INDEX_REFRESH_FAILED,
+  LOG_HEAP_SAMPLE,
+  LOG_LAN_LEADER,
+  LOG_CHART_LOADED,
+  LOG_UPSTREAM_DOWN,
+  LOG_HISTORY_LOADED,
+  LOG_HISTORY_RECORDED,
+  LOG_HISTORY_COMPACTED,
+  LOG_OTA_STARTED,
+  LOG_OTA_FAILED,
+  LOG_OTA_DONE,
+  LOG_OTA_CONFIRMED,
+  LOG_OTA_ROLLBACK,
+  LOG_EVENT_COUNT
+};
+
+void initEventLog();
+void logEvent(LogEvent event, const char* text = "", int32_t arg0 = 0, int32_t arg1 = 0,
+              int32_t arg2 = 0, float value = 0.0f);
+
+// Номер следующей записи; вывод записей из диапазона [fromSeq, toSeq)
+uint32_t eventLogHead();
+void printEventLog(Print& out, uint32_t fromSeq, uint32_t toSeq);
+
+#endif
@@ -0,0 +1,164 @@
+#include "marquee.h"
+#include "config.h"
+#include "lcd_display.h"
+#include "power.h"
+#include "price_history.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Текст ленты собирается в задаче loop(), задача бегущей строки читает
+// только этот буфер, поэтому String цен из другой задачи не трогаются
+static char tape[MARQUEE_TAPE_SIZE];
+static int tapeLength = 0;
+static int tapePos = 0;
+// Смещение окна дисплея внутри 40 колонок DDRAM
+static int displayShift = 0;
+
+static volatile bool marqueeRunning = false;
+// В режиме light sleep аппаратный таймер держит APB и не дает уснуть,
+// тогда шаг отсчитывается таймаутом задачи, который будит чип из сна
+static volatile bool tickWakeups = false;
+static hw_timer_t* marqueeTimer = NULL;
+static TaskHandle_t marqueeTask = NULL;
+static SemaphoreHandle_t tapeMutex = NULL;
+
+static void ARDUINO_ISR_ATTR onMarqueeTimer() {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(marqueeTask, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+// Вторая строка показывает ту же ленту со сдвигом на половину длины
+static char tapeChar(int line, int offset) {
+  int pos = tapePos + offset + (line == 1 ? tapeLength / 2 : 0);
+  return tape[pos % tapeLength];
+}
+
+static void fillVisibleColumns() {
+  lcd.home(); // сбрасывает и аппаратный сдвиг
+  displayShift = 0;
+  for (int line = 0; line < 2; line++) {
+    char text[DISPLAY_COLS];
+    for (int col = 0; col < DISPLAY_COLS; col++) text[col] = tapeChar(line, col);
+    lcd.writeRegion(0, line, text, DISPLAY_COLS);
+  }
+}
+
+// Один шаг: дописать колонку, которая появится справа, и сдвинуть экран.
+// Видимые символы остаются в DDRAM, повторно они не выводятся
+static void marqueeStep() {
+  int col = (displayShift + DISPLAY_COLS) % LCD_DDRAM_WIDTH;
+  lcd.beginBatch();
+  for (int line = 0; line < 2; line++) {
+    lcd.setCursor(col, line);
+    lcd.write(tapeChar(line, DISPLAY_COLS));
+  }
+  lcd.scrollDisplayLeft();
+  lcd.endBatch();
+  countDisplayFrame();
+  
+  displayShift = (displayShift + 1) % LCD_DDRAM_WIDTH;
+  tapePos = (tapePos + 1) % tapeLength;
+}
+
+static void marqueeTaskLoop(void* arg) {
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, tickWakeups && marqueeRunning ? pdMS_TO_TICKS(MARQUEE_STEP_MS) : portMAX_DELAY);
+    
+    xSemaphoreTake(tapeMutex, portMAX_DELAY);
+    if (marqueeRunning && tapeLength > 0) marqueeStep();
+    xSemaphoreGive(tapeMutex);
+  }
+}
+
+static int appendTape(char* buf, int len, const char* text, int textLen) {
+  for (int i = 0; i < textLen && len < MARQUEE_TAPE_SIZE; i++) buf[len++] = text[i];
+  return len;
+}
+
+void rebuildMarqueeTape() {
+  char buf[MARQUEE_TAPE_SIZE];
+  int len = 0;
+  
+  for (int i = 0; i < numTickers; i++) {
+    const String& symbol = tickers[i].symbol;
+    const String& price = stockPrices[i];
+    bool showStar = false;
+    char arrowChar = tickerSignal(i, &showStar);
+    
+    if (updateIndicators[i] != ' ') len = appendTape(buf, len, &updateIndicators[i], 1);
+    len = appendTape(buf, len, symbol.c_str(), symbol.length());
+    len = appendTape(buf, len, " ", 1);
+    len = appendTape(buf, len, price.c_str(), price.length());
+    if (arrowChar != ' ') len = appendTape(buf, len, &arrowChar, 1);
+    if (showStar) len = appendTape(buf, len, "*", 1);
+    
+    PriceStats stats;
+    float percent;
+    if (dayChangePercent(i, &stats, &percent)) {
+      char change[12];
+      int changeLength = snprintf(change, sizeof(change), " %+.2f%%", percent);
+      len = appendTape(buf, len, change, changeLength);
+    }
+    len = appendTape(buf, len, "   ", 3);
+  }
+  
+  // Короткая лента дополняется пробелами, чтобы не повторяться на экране
+  while (len < DISPLAY_COLS + 1) buf[len++] = ' ';
+  
+  xSemaphoreTake(tapeMutex, portMAX_DELAY);
+  memcpy(tape, buf, len);
+  tapeLength = len;
+  tapePos %= tapeLength;
+  xSemaphoreGive(tapeMutex);
+}
+
+void startMarquee() {
+  if (marqueeRunning) return;
+  
+  if (tapeMutex == NULL) {
+    tapeMutex = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(marqueeTaskLoop, "marquee", MARQUEE_TASK_STACK_SIZE, NULL,
+                            MARQUEE_TASK_PRIORITY, &marqueeTask, 1);
+    
+    // Шаг задается аппаратным таймером, а не millis() в loop(),
+    // поэтому скорость не зависит от занятости сети
+    marqueeTimer = timerBegin(1000000);
+    timerAttachInterrupt(marqueeTimer, &onMarqueeTimer);
+    timerAlarm(marqueeTimer, MARQUEE_STEP_MS * 1000, true, 0);
+  }
+  
+  rebuildMarqueeTape();
+  
+  xSemaphoreTake(tapeMutex, portMAX_DELAY);
+  tapePos = 0;
+  lcd.clear();
+  fillVisibleColumns();
+  marqueeRunning = true;
+  xSemaphoreGive(tapeMutex);
+  
+  tickWakeups = isLightSleepActive();
+  if (tickWakeups) {
+    xTaskNotifyGive(marqueeTask);
+  } else {
+    timerRestart(marqueeTimer);
+    timerStart(marqueeTimer);
+  }
+}
+
+void stopMarquee() {
+  if (!marqueeRunning) return;
+  
+  timerStop(marqueeTimer);
+  
+  xSemaphoreTake(tapeMutex, portMAX_DELAY);
+  marqueeRunning = false;
+  lcd.clear();
+  lcd.home();
+  displayShift = 0;
+  xSemaphoreGive(tapeMutex);
+}
+
+bool isMarqueeRunning() {
+  return marqueeRunning;
+}
@@ -0,0 +1,17 @@
+#ifndef MARQUEE_H
+#define MARQUEE_H
+
+#include "config.h"
+
+// Бегущая строка на аппаратном сдвиге HD44780
+#define MARQUEE_STEP_MS 250
+#define MARQUEE_TAPE_SIZE 256
+#define MARQUEE_TASK_STACK_SIZE 2048
+#define MARQUEE_TASK_PRIORITY 2
+
+void startMarquee();
+void stopMarquee();
+void rebuildMarqueeTape();
+bool isMarqueeRunning();
+
+#endif
@@ -1,9 +1,13 @@
 #include "network.h"
 #include "config.h"
 #include "lcd_display.h" // Добавляем для updateDisplay
+#include "fetch_pool.h"
+#include "quote_provider.h"
+#include "quote_stream.h"
+#include "lan_fanout.h"
+#include "scheduler.h"
+#include "log_ring.h"
 #include <WiFi.h>
-#include <HTTPClient.h>
-#include <ArduinoJson.h>
 
 void connectToWiFi() {
   lcd.print("Connecting...");
@@ -22,74 +26,101 @@ void connectToWiFi() {
   lcd.clear();
 }
 
-String getStockPrice(String symbol) {
-  if (WiFi.status() != WL_CONNECTED) return "Error";
-  
-  symbol.trim();
-  if (symbol.length() == 0 || symbol.length() > 4) return "Error";
-  
-  HTTPClient http;
-  String payload;
-  String url = baseUrl + symbol + ".json?iss.meta=off";
-  
-  http.begin(url);
-  int httpCode = http.GET();
+// Обрезка цены до 7 символов дисплея, не более 4 знаков после точки
+void truncatePrice(char* price) {
+  char* dot = strchr(price, '.');
+  if (dot && strlen(dot) > 5) dot[5] = '\0';
+  if (strlen(price) > 7) price[7] = '\0';
+}
+
+String formatPrice(String price) {
+  char buf[24];
+  strlcpy(buf, price.c_str(), sizeof(buf));
+  truncatePrice(buf);
+  return String(buf);
+}
+
+static bool updateRequested = false;
+
+// Применение результата из пула: ошибка оставляет прежнюю цену
+static void applyFetchedPrice(int index, const String& price) {
+  if (price != "Error") {
+    stockPrices[index] = price;
+    updateIndicators[index] = ' ';
+  } else {
+    updateIndicators[index] = 'x';
+  }
+  invalidateTickerLine(index);
+  updateDisplay();
+}
+
+// Бумаги опрашиваются пакетами по рынкам, у каждого пакета свой поставщик
+static int batchTickers[MAX_TICKERS];
+
+static void applyBatchPrice(int index, const String& price) {
+  applyFetchedPrice(batchTickers[index], price);
+}
+
+// includeStreamed = false - только бумаги, которых нет в потоке котировок
+static void pollStockPrices(bool includeStreamed) {
+  int total = 0;
+  for (int i = 0; i < numTickers; i++) {
+    if (!includeStreamed && tickers[i].market == MARKET_SHARES) continue;
+    updateIndicators[i] = '.';
+    invalidateTickerLine(i);
+    total++;
+  }
+  if (total == 0) return;
+  updateDisplay();
   
-  if (httpCode == HTTP_CODE_OK) {
-    payload = http.getString();
-    http.end();
+  unsigned long startTime = millis();
+  for (int market = 0; market < MARKET_COUNT; market++) {
+    if (!includeStreamed && market == MARKET_SHARES) continue;
     
-    DynamicJsonDocument doc(3072);
-    DeserializationError error = deserializeJson(doc, payload);
-    
-    if (error) return "Error";
-    
-    JsonArray marketdata = doc["marketdata"]["data"];
-    if (marketdata.isNull() || marketdata.size() == 0) return "Error";
-    
-    for (JsonArray row : marketdata) {
-      String boardId = row[1];
-      if (boardId == "TQBR") {
-        String price = row[12];
-        if (price != "null" && price.length() > 0) {
-          int dotIndex = price.indexOf('.');
-          if (dotIndex != -1) {
-            if (price.length() > dotIndex + 5) price = price.substring(0, dotIndex + 5);
-            if (price.length() > 7) price = price.substring(0, 7);
-          } else if (price.length() > 7) price = price.substring(0, 7);
-          return price;
-        }
-      }
+    String symbols[MAX_TICKERS];
+    String results[MAX_TICKERS];
+    int count = 0;
+    for (int i = 0; i < numTickers; i++) {
+      if (tickers[i].market != market) continue;
+      batchTickers[count] = i;
+      symbols[count++] = tickers[i].symbol;
     }
+    fetchPricesParallel(quoteProvider(market), symbols, results, count, fetchConcurrency, applyBatchPrice);
   }
-  
-  return "Error";
+  logEvent(LOG_FETCH_BATCH, "", total, millis() - startTime, fetchConcurrency);
+  logDisplayStats();
 }
 
 void updateAllStockPrices() {
+  updateRequested = false;
+  
   if (numTickers == 0) {
     lcd.clear();
     lcd.print("No tickers");
     lcd.setCursor(0, 1);
     lcd.print("Add via web");
+    shareLanPrices();
     return;
   }
   
-  for (int i = 0; i < numTickers; i++) {
-    String previousPrice = stockPrices[i];
-    updateIndicators[i] = '.';
-    updateDisplay();
-    delay(500);
-    
-    stockPrices[i] = getStockPrice(tickers[i].symbol);
-    
-    if (stockPrices[i] != "Error") updateIndicators[i] = ' ';
-    else {
-      updateIndicators[i] = 'x';
-      stockPrices[i] = previousPrice;
-    }
-    
-    updateDisplay();
-    delay(500);
+  pollStockPrices(true);
+  shareLanPrices();
+}
+
+// Запросить обновление цен на следующем проходе loop() вместо синхронного вызова
+void scheduleStockPriceUpdate() {
+  updateRequested = true;
+  rescheduleJob(priceUpdateJob, 0);
+}
+
+// Плановый опрос нужен только без потока котировок и без ведущего в сети,
+// запрошенный - всегда. Поток несет только акции: остальные рынки опрашиваются.
+// Ведущий с потоком все равно раздает цены ведомым
+void runScheduledPriceUpdate() {
+  if (updateRequested || (!isQuoteStreamActive() && !isLanFed())) {
+    updateAllStockPrices();
+  } else {
+    if (!isLanFed()) pollStockPrices(false);
+    shareLanPrices();
   }
 }
\ No newline at end of file
@@ -4,7 +4,10 @@
 #include "config.h"
 
 void connectToWiFi();
-String getStockPrice(String symbol);
+void truncatePrice(char* price);
+String formatPrice(String price);
 void updateAllStockPrices();
+void scheduleStockPriceUpdate();
+void runScheduledPriceUpdate();
 
 #endif
\ No newline at end of file
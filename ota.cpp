@@ -0,0 +1,484 @@
+#include "ota.h"
+#include "config.h"
+#include "fetch_pool.h"
+#include "lcd_display.h"
+#include "log_ring.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <Update.h>
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <esp_rom_crc.h>
+#include <rom/miniz.h>
+
+#define OTA_PREFS_NAMESPACE "ota"
+#define OTA_IMAGE_MAGIC 0xE9
+#define OTA_FAILED_SHOW_MS 10000
+
+#define GZIP_HEADER_SIZE 10
+#define GZIP_TRAILER_SIZE 8
+#define GZIP_FLAG_HCRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+
+#define HEATSHRINK_WINDOW_SIZE (1 << OTA_HEATSHRINK_WINDOW_BITS)
+
+// Счетчики пишет только задача обновления; state меняется последним
+// и публикует остальные поля для основного цикла
+static OtaStatus status = { OTA_STATE_IDLE, OTA_FORMAT_RAW, 0, 0, -1, 0, NULL };
+static String otaUrl;
+static char httpError[16];
+
+static OtaReport report;
+static bool hasReport = false;
+static bool pendingConfirm = false;
+static bool wifiSeen = false;
+static unsigned long failedAt = 0;
+
+static int loadState() {
+  return __atomic_load_n(&status.state, __ATOMIC_ACQUIRE);
+}
+
+static void storeState(int state) {
+  __atomic_store_n(&status.state, state, __ATOMIC_RELEASE);
+}
+
+// Ядро по умолчанию подтверждает новый образ сразу при загрузке;
+// здесь его подтверждает handleOta, когда прошивка поднялась и видит сеть
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+
+const char* otaFormatName(int format) {
+  switch (format) {
+    case OTA_FORMAT_GZIP: return "gzip";
+    case OTA_FORMAT_HEATSHRINK: return "heatshrink";
+    default: return "raw";
+  }
+}
+
+// ---- Запись в раздел ----
+
+static const char* writeImage(const uint8_t* data, size_t length) {
+  if (Update.write((uint8_t*)data, length) != length) return Update.errorString();
+  status.written += length;
+  return NULL;
+}
+
+// ---- gzip: словарь 32 КБ и состояние tinfl из ROM в куче ----
+
+static tinfl_decompressor* inflater = NULL;
+static uint8_t* inflateDict = NULL;
+static size_t dictPos = 0;
+static uint32_t inflateCrc = 0;
+static bool inflateDone = false;
+// Последние 8 байт загрузки - концовка gzip. tinfl читает с запасом и
+// может забрать ее начало, поэтому она берется из хвоста всего потока
+static uint8_t gzipTail[GZIP_TRAILER_SIZE];
+static uint32_t tailBytes = 0;
+
+// Длина заголовка gzip с необязательными полями; -1 - не gzip или не уместился
+static int gzipHeaderLength(const uint8_t* data, size_t length) {
+  if (length < GZIP_HEADER_SIZE || data[0] != 0x1F || data[1] != 0x8B || data[2] != 8) return -1;
+  uint8_t flags = data[3];
+  size_t pos = GZIP_HEADER_SIZE;
+  if (flags & GZIP_FLAG_EXTRA) {
+    if (pos + 2 > length) return -1;
+    pos += 2 + (data[pos] | data[pos + 1] << 8);
+  }
+  if (flags & GZIP_FLAG_NAME) {
+    while (pos < length && data[pos] != 0) pos++;
+    pos++;
+  }
+  if (flags & GZIP_FLAG_COMMENT) {
+    while (pos < length && data[pos] != 0) pos++;
+    pos++;
+  }
+  if (flags & GZIP_FLAG_HCRC) pos += 2;
+  return pos <= length ? (int)pos : -1;
+}
+
+static bool beginInflate() {
+  inflater = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+  inflateDict = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+  if (inflater == NULL || inflateDict == NULL) return false;
+  
+  tinfl_init(inflater);
+  dictPos = 0;
+  inflateCrc = 0;
+  inflateDone = false;
+  tailBytes = 0;
+  return true;
+}
+
+static void keepTail(const uint8_t* in, size_t length) {
+  for (size_t i = length > GZIP_TRAILER_SIZE ? length - GZIP_TRAILER_SIZE : 0; i < length; i++) {
+    gzipTail[tailBytes++ % GZIP_TRAILER_SIZE] = in[i];
+  }
+}
+
+// Выход tinfl пишется в кольцевой словарь и сразу уходит в раздел
+static const char* inflateChunk(const uint8_t* in, size_t length) {
+  keepTail(in, length);
+  tinfl_status result = TINFL_STATUS_NEEDS_MORE_INPUT;
+  while (!inflateDone && (length > 0 || result == TINFL_STATUS_HAS_MORE_OUTPUT)) {
+    size_t inBytes = length;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - dictPos;
+    result = tinfl_decompress(inflater, in, &inBytes, inflateDict, inflateDict + dictPos, &outBytes,
+                              TINFL_FLAG_HAS_MORE_INPUT);
+    in += inBytes;
+    length -= inBytes;
+    if (outBytes > 0) {
+      inflateCrc = esp_rom_crc32_le(inflateCrc, inflateDict + dictPos, outBytes);
+      const char* error = writeImage(inflateDict + dictPos, outBytes);
+      if (error) return error;
+      dictPos = (dictPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+    }
+    if (result < 0) return "bad gzip data";
+    if (result == TINFL_STATUS_DONE) inflateDone = true;
+  }
+  return NULL;
+}
+
+// Концовка gzip: CRC32 и длина распакованного образа
+static const char* finishInflate() {
+  if (!inflateDone || tailBytes < GZIP_TRAILER_SIZE) return "gzip truncated";
+  uint8_t trailer[GZIP_TRAILER_SIZE];
+  for (int i = 0; i < GZIP_TRAILER_SIZE; i++) trailer[i] = gzipTail[(tailBytes + i) % GZIP_TRAILER_SIZE];
+  uint32_t crc = trailer[0] | trailer[1] << 8 | trailer[2] << 16 | (uint32_t)trailer[3] << 24;
+  uint32_t size = trailer[4] | trailer[5] << 8 | trailer[6] << 16 | (uint32_t)trailer[7] << 24;
+  if (crc != inflateCrc || size != status.written) return "gzip CRC mismatch";
+  return NULL;
+}
+
+// ---- heatshrink: окно 1 КБ, биты читаются старшим вперед ----
+
+static uint8_t* hsWindow = NULL;
+static uint16_t hsHead = 0;
+static uint32_t hsBits = 0;
+static int hsBitCount = 0;
+
+static bool beginHeatshrink() {
+  // Начальное окно нулевое, как у кодировщика
+  hsWindow = (uint8_t*)calloc(1, HEATSHRINK_WINDOW_SIZE);
+  hsHead = 0;
+  hsBits = 0;
+  hsBitCount = 0;
+  return hsWindow != NULL;
+}
+
+static uint32_t takeBits(int count) {
+  hsBitCount -= count;
+  return (hsBits >> hsBitCount) & ((1UL << count) - 1);
+}
+
+// Токен: 1 и байт литерала или 0, смещение-1 и длина-1 ссылки в окно.
+// Неполный токен ждет следующей порции, хвост из нулей в конце отбрасывается
+static const char* heatshrinkChunk(const uint8_t* in, size_t length) {
+  uint8_t out[256];
+  size_t outLength = 0;
+  
+  for (size_t i = 0; i < length; i++) {
+    hsBits = hsBits << 8 | in[i];
+    hsBitCount += 8;
+  
+    while (hsBitCount >= 9) {
+      int count = 1;
+      uint16_t offset = 0;
+      bool literal = (hsBits >> (hsBitCount - 1)) & 1;
+      if (literal) {
+        takeBits(1);
+      } else {
+        if (hsBitCount < 1 + OTA_HEATSHRINK_WINDOW_BITS + OTA_HEATSHRINK_LOOKAHEAD_BITS) break;
+        takeBits(1);
+        offset = takeBits(OTA_HEATSHRINK_WINDOW_BITS) + 1;
+        count = takeBits(OTA_HEATSHRINK_LOOKAHEAD_BITS) + 1;
+      }
+  
+      for (int n = 0; n < count; n++) {
+        uint8_t value = literal ? takeBits(8) : hsWindow[(hsHead - offset) & (HEATSHRINK_WINDOW_SIZE - 1)];
+        hsWindow[hsHead++ & (HEATSHRINK_WINDOW_SIZE - 1)] = value;
+        out[outLength++] = value;
+        if (outLength == sizeof(out)) {
+          const char* error = writeImage(out, outLength);
+          if (error) return error;
+          outLength = 0;
+        }
+      }
+    }
+  }
+  
+  return outLength > 0 ? writeImage(out, outLength) : NULL;
+}
+
+// ---- Загрузка ----
+
+// Формат по первым байтам: образ ESP32 начинается с 0xE9, gzip - с 1F 8B,
+// у потока heatshrink заголовка нет
+static int detectFormat(const uint8_t* data, size_t length) {
+  if (length > 0 && data[0] == OTA_IMAGE_MAGIC) return OTA_FORMAT_RAW;
+  if (length > 1 && data[0] == 0x1F && data[1] == 0x8B) return OTA_FORMAT_GZIP;
+  return OTA_FORMAT_HEATSHRINK;
+}
+
+// Распаковщик под формат и раздел; consumed - байты заголовка gzip
+static const char* beginImage(const uint8_t* data, size_t length, size_t* consumed) {
+  status.format = detectFormat(data, length);
+  *consumed = 0;
+  if (status.format == OTA_FORMAT_GZIP) {
+    int headerLength = gzipHeaderLength(data, length);
+    if (headerLength < 0) return "bad gzip header";
+    if (!beginInflate()) return "no memory for gzip";
+    *consumed = headerLength;
+  } else if (status.format == OTA_FORMAT_HEATSHRINK) {
+    if (!beginHeatshrink()) return "no memory";
+  }
+  
+  logEvent(LOG_OTA_STARTED, otaFormatName(status.format), status.total);
+  // Размер известен только у несжатого образа; сектора стираются по ходу записи
+  size_t imageSize = status.format == OTA_FORMAT_RAW && status.total > 0 ? status.total : UPDATE_SIZE_UNKNOWN;
+  if (!Update.begin(imageSize)) return Update.errorString();
+  return NULL;
+}
+
+static const char* feedImage(const uint8_t* data, size_t length) {
+  switch (status.format) {
+    case OTA_FORMAT_GZIP: return inflateChunk(data, length);
+    case OTA_FORMAT_HEATSHRINK: return heatshrinkChunk(data, length);
+    default: return writeImage(data, length);
+  }
+}
+
+static void freeDecoders() {
+  free(inflater);
+  free(inflateDict);
+  free(hsWindow);
+  inflater = NULL;
+  inflateDict = NULL;
+  hsWindow = NULL;
+}
+
+// Первая порция набирается целиком: по ней определяется формат
+static const char* streamImage(HTTPClient& http, uint8_t* buffer) {
+  Stream& stream = http.getStream();
+  unsigned long lastData = millis();
+  bool started = false;
+  size_t filled = 0;
+  
+  while (true) {
+    bool complete = status.total >= 0 && (int32_t)status.received >= status.total;
+    size_t available = complete ? 0 : stream.available();
+    if (available > 0) {
+      size_t length = stream.readBytes(buffer + filled, min(available, (size_t)OTA_CHUNK_SIZE - filled));
+      status.received += length;
+      filled += length;
+      lastData = millis();
+      if (filled < OTA_CHUNK_SIZE && !started) continue;
+    } else if (!complete && http.connected()) {
+      if (millis() - lastData > OTA_STALL_TIMEOUT_MS) return "download stalled";
+      delay(1);
+      continue;
+    }
+  
+    size_t consumed = 0;
+    if (!started && filled > 0) {
+      const char* error = beginImage(buffer, filled, &consumed);
+      if (error) return error;
+      started = true;
+    }
+    if (filled > consumed) {
+      const char* error = feedImage(buffer + consumed, filled - consumed);
+      if (error) return error;
+    }
+    filled = 0;
+    if (available == 0) break;
+  }
+  
+  if (!started) return "empty image";
+  if (status.total >= 0 && (int32_t)status.received < status.total) return "download truncated";
+  if (status.format == OTA_FORMAT_GZIP) return finishInflate();
+  return NULL;
+}
+
+static const char* runUpdate() {
+  uint8_t* buffer = (uint8_t*)malloc(OTA_CHUNK_SIZE);
+  if (buffer == NULL) return "no memory";
+  
+  HTTPClient http;
+  // HTTP/1.0: тело без chunked-кодирования читается прямо из сокета
+  http.useHTTP10(true);
+  http.setTimeout(OTA_STALL_TIMEOUT_MS);
+  const char* error = NULL;
+  if (!http.begin(otaUrl)) {
+    error = "bad URL";
+  } else {
+    int httpCode = http.GET();
+    if (httpCode == HTTP_CODE_OK) {
+      status.total = http.getSize();
+      error = streamImage(http, buffer);
+      // Образ проверяется при активации раздела: контрольная сумма и SHA-256
+      if (error == NULL && !Update.end(true)) error = Update.errorString();
+    } else {
+      snprintf(httpError, sizeof(httpError), "HTTP %d", httpCode);
+      error = httpError;
+    }
+  }
+  
+  http.end();
+  free(buffer);
+  freeDecoders();
+  if (error && Update.isRunning()) Update.abort();
+  return error;
+}
+
+static void saveReport() {
+  report.format = status.format;
+  report.received = status.received;
+  report.written = status.written;
+  report.elapsedMs = status.elapsedMs;
+  hasReport = true;
+  
+  Preferences prefs;
+  prefs.begin(OTA_PREFS_NAMESPACE);
+  prefs.putUInt("format", report.format);
+  prefs.putUInt("received", report.received);
+  prefs.putUInt("written", report.written);
+  prefs.putUInt("ms", report.elapsedMs);
+  prefs.end();
+}
+
+static void otaTask(void* arg) {
+  unsigned long startTime = millis();
+  const char* error = runUpdate();
+  status.elapsedMs = millis() - startTime;
+  
+  if (error) {
+    status.error = error;
+    storeState(OTA_STATE_FAILED);
+    logEvent(LOG_OTA_FAILED, error, status.received);
+    vTaskDelete(NULL);
+    return;
+  }
+  
+  saveReport();
+  storeState(OTA_STATE_DONE);
+  logEvent(LOG_OTA_DONE, "", status.received, status.written, status.elapsedMs);
+  // Основной цикл успевает показать итог на дисплее
+  vTaskDelay(pdMS_TO_TICKS(OTA_RESTART_DELAY_MS));
+  ESP.restart();
+}
+
+bool startOtaUpdate(const String& url) {
+  if (isOtaRunning() || loadState() == OTA_STATE_DONE || Update.isRunning()) return false;
+  // Стек, буфер и TLS, если ссылка https; словарь gzip проверяется позже
+  uint32_t needed = FETCH_HEAP_RESERVE + OTA_TASK_STACK_SIZE + OTA_CHUNK_SIZE;
+  if (url.startsWith("https://")) needed += FETCH_TLS_HEAP_COST;
+  if (ESP.getFreeHeap() < needed) return false;
+  
+  otaUrl = url;
+  failedAt = 0;
+  status.format = OTA_FORMAT_RAW;
+  status.received = 0;
+  status.written = 0;
+  status.total = -1;
+  status.elapsedMs = 0;
+  status.error = NULL;
+  storeState(OTA_STATE_RUNNING);
+  if (xTaskCreatePinnedToCore(otaTask, "ota", OTA_TASK_STACK_SIZE, NULL, OTA_TASK_PRIORITY, NULL,
+                              tskNO_AFFINITY) != pdPASS) {
+    storeState(OTA_STATE_IDLE);
+    return false;
+  }
+  return true;
+}
+
+bool isOtaRunning() {
+  return loadState() == OTA_STATE_RUNNING;
+}
+
+OtaStatus otaStatus() {
+  OtaStatus copy = status;
+  copy.state = loadState();
+  return copy;
+}
+
+bool lastOtaReport(OtaReport* out) {
+  if (hasReport) *out = report;
+  return hasReport;
+}
+
+bool isOtaPendingConfirm() {
+  return pendingConfirm;
+}
+
+void initOta() {
+  Preferences prefs;
+  if (prefs.begin(OTA_PREFS_NAMESPACE, true)) {
+    hasReport = prefs.isKey("ms");
+    report.format = prefs.getUInt("format");
+    report.received = prefs.getUInt("received");
+    report.written = prefs.getUInt("written");
+    report.elapsedMs = prefs.getUInt("ms");
+    prefs.end();
+  }
+  
+  // Без CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE состояние ожидания не выставляется
+  esp_ota_img_states_t state;
+  if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) == ESP_OK) {
+    pendingConfirm = state == ESP_OTA_IMG_PENDING_VERIFY;
+  }
+}
+
+// Новый образ поднял сеть и проработал минуту - подтверждается. Падение до
+// этого откатывает загрузчик, образ без сети откатывается здесь
+static void confirmImage() {
+  if (WiFi.status() == WL_CONNECTED) wifiSeen = true;
+  if (wifiSeen && millis() >= OTA_CONFIRM_MS) {
+    esp_ota_mark_app_valid_cancel_rollback();
+    pendingConfirm = false;
+    logEvent(LOG_OTA_CONFIRMED, "", millis());
+  } else if (!wifiSeen && millis() >= OTA_CONFIRM_TIMEOUT_MS) {
+    logEvent(LOG_OTA_ROLLBACK, "", millis());
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+  }
+}
+
+// Нижняя строка дисплея: ход загрузки, итог или ошибка
+static void showOtaStatus(const OtaStatus& current) {
+  static const char* shortNames[] = { "bin", "gz", "hs" };
+  char text[DISPLAY_COLS + 1];
+  if (current.state == OTA_STATE_DONE) {
+    snprintf(text, sizeof(text), "OTA ok, restart");
+  } else if (current.state == OTA_STATE_FAILED) {
+    snprintf(text, sizeof(text), "OTA error");
+  } else if (current.total > 0) {
+    snprintf(text, sizeof(text), "OTA %s %lu%% %luK", shortNames[current.format],
+             (unsigned long)((uint64_t)current.received * 100 / current.total), (unsigned long)(current.written / 1024));
+  } else {
+    snprintf(text, sizeof(text), "OTA %s %luK", shortNames[current.format], (unsigned long)(current.written / 1024));
+  }
+  showStatusLine(text);
+}
+
+void handleOta() {
+  if (pendingConfirm) confirmImage();
+  
+  static unsigned long lastRefresh = 0;
+  int state = loadState();
+  if (state == OTA_STATE_IDLE || millis() - lastRefresh < OTA_STATUS_REFRESH_MS) return;
+  lastRefresh = millis();
+  
+  if (state == OTA_STATE_FAILED) {
+    if (failedAt == 0) {
+      failedAt = millis();
+      showOtaStatus(otaStatus());
+    } else if (millis() - failedAt >= OTA_FAILED_SHOW_MS) {
+      failedAt = 0;
+      storeState(OTA_STATE_IDLE);
+      clearStatusLine();
+    }
+    return;
+  }
+  showOtaStatus(otaStatus());
+}
@@ -0,0 +1,65 @@
+#ifndef OTA_H
+#define OTA_H
+
+#include "config.h"
+
+// Обновление по ссылке: образ скачивается фоновой задачей и пишется в
+// неактивный раздел по ходу загрузки. Образ может быть сжат gzip или
+// heatshrink, распаковка идет потоком, целиком он в памяти не бывает
+#define OTA_TASK_STACK_SIZE 6144
+// Ниже основного цикла, ленты и опроса биржи: им не мешает
+#define OTA_TASK_PRIORITY 0
+#define OTA_CHUNK_SIZE 1024
+#define OTA_STALL_TIMEOUT_MS 15000
+#define OTA_STATUS_REFRESH_MS 500
+#define OTA_RESTART_DELAY_MS 3000
+// Параметры сжатия heatshrink: окно 2^10, длина ссылки до 2^5
+// (heatshrink -e -w 10 -l 5)
+#define OTA_HEATSHRINK_WINDOW_BITS 10
+#define OTA_HEATSHRINK_LOOKAHEAD_BITS 5
+// Новый образ подтверждается после подключения к сети и минуты работы;
+// без сети за 10 минут - откат на прежний
+#define OTA_CONFIRM_MS 60000
+#define OTA_CONFIRM_TIMEOUT_MS 600000
+
+#define OTA_FORMAT_RAW 0
+#define OTA_FORMAT_GZIP 1
+#define OTA_FORMAT_HEATSHRINK 2
+
+#define OTA_STATE_IDLE 0
+#define OTA_STATE_RUNNING 1
+#define OTA_STATE_DONE 2
+#define OTA_STATE_FAILED 3
+
+struct OtaStatus {
+  int state;
+  int format;
+  uint32_t received;  // скачано байт
+  uint32_t written;   // записано в раздел после распаковки
+  int32_t total;      // длина загрузки, -1 - неизвестна
+  uint32_t elapsedMs;
+  const char* error;
+};
+
+// Итог последнего обновления, хранится в NVS и переживает перезагрузку
+struct OtaReport {
+  int format;
+  uint32_t received;
+  uint32_t written;
+  uint32_t elapsedMs;
+};
+
+// При загрузке: прежний отчет, ожидание подтверждения нового образа
+void initOta();
+// Из основного цикла: строка на дисплее, подтверждение или откат образа
+void handleOta();
+// false - обновление уже идет или не хватает памяти
+bool startOtaUpdate(const String& url);
+bool isOtaRunning();
+OtaStatus otaStatus();
+bool lastOtaReport(OtaReport* report);
+// Образ загружен этим обновлением и еще не подтвержден
+bool isOtaPendingConfirm();
+const char* otaFormatName(int format);
+
+#endif
@@ -0,0 +1,121 @@
+#include "power.h"
+#include "config.h"
+#include "scheduler.h"
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <esp_pm.h>
+#include <esp_timer.h>
+
+#define POWER_MAX_MANAGED_JOBS 4
+
+struct ManagedJob {
+  int id;
+  unsigned long fastPeriod;
+};
+
+static ManagedJob managedJobs[POWER_MAX_MANAGED_JOBS];
+static int numManagedJobs = 0;
+static bool lightSleepActive = false;
+
+// Счетчики сна и бодрствования основного цикла по режимам
+static uint64_t asleepMicros[POWER_MODE_COUNT] = {0};
+static uint64_t awakeMicros[POWER_MODE_COUNT] = {0};
+static int accountedMode = POWER_MODE_PERFORMANCE;
+static uint64_t lastAccountTime = 0;
+static uint64_t lastAccountSleep = 0;
+
+static const uint8_t awakeMilliamps[POWER_MODE_COUNT] = {
+  POWER_AWAKE_MA_PERFORMANCE, POWER_AWAKE_MA_MODEM_SLEEP, POWER_AWAKE_MA_LIGHT_SLEEP
+};
+static const uint8_t asleepMilliamps[POWER_MODE_COUNT] = {
+  POWER_ASLEEP_MA_PERFORMANCE, POWER_ASLEEP_MA_MODEM_SLEEP, POWER_ASLEEP_MA_LIGHT_SLEEP
+};
+
+// Перенести накопленное время в счетчики текущего режима
+static void accountPowerTime() {
+  uint64_t now = esp_timer_get_time();
+  uint64_t slept = schedulerSleepMicros();
+  uint64_t sleepDelta = slept - lastAccountSleep;
+  uint64_t totalDelta = now - lastAccountTime;
+  
+  asleepMicros[accountedMode] += sleepDelta;
+  awakeMicros[accountedMode] += totalDelta > sleepDelta ? totalDelta - sleepDelta : 0;
+  lastAccountTime = now;
+  lastAccountSleep = slept;
+}
+
+// Автоматический light sleep требует CONFIG_PM_ENABLE и tickless idle в сборке ядра
+static bool configureLightSleep(bool enable) {
+  esp_pm_config_t config = {};
+  config.max_freq_mhz = getCpuFrequencyMhz();
+  config.min_freq_mhz = enable ? POWER_MIN_CPU_MHZ : config.max_freq_mhz;
+  config.light_sleep_enable = enable;
+  
+  esp_err_t err = esp_pm_configure(&config);
+  if (err != ESP_OK && enable) {
+    Serial.println("Light sleep not supported (" + String(esp_err_to_name(err)) + "), using modem sleep");
+  }
+  return err == ESP_OK && enable;
+}
+
+void registerPowerManagedJob(int jobId, unsigned long fastPeriodMs) {
+  if (jobId == SCHEDULER_NO_JOB || numManagedJobs >= POWER_MAX_MANAGED_JOBS) return;
+  managedJobs[numManagedJobs].id = jobId;
+  managedJobs[numManagedJobs].fastPeriod = fastPeriodMs;
+  numManagedJobs++;
+}
+
+void applyPowerMode() {
+  accountPowerTime();
+  
+  // Точка доступа не поддерживает modem sleep, портал работает без экономии
+  bool station = WiFi.getMode() == WIFI_STA;
+  int mode = station ? powerMode : POWER_MODE_PERFORMANCE;
+  
+  // MIN_MODEM просыпается на каждый DTIM, поэтому веб-интерфейс остается доступным
+  WiFi.setSleep(mode == POWER_MODE_PERFORMANCE ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM);
+  lightSleepActive = configureLightSleep(mode == POWER_MODE_LIGHT_SLEEP);
+  if (mode == POWER_MODE_LIGHT_SLEEP && !lightSleepActive) mode = POWER_MODE_MODEM_SLEEP;
+  accountedMode = mode;
+  
+  for (int i = 0; i < numManagedJobs; i++) {
+    unsigned long period = managedJobs[i].fastPeriod;
+    if (mode != POWER_MODE_PERFORMANCE && period < POWER_SAVE_POLL_MS) period = POWER_SAVE_POLL_MS;
+    setJobPeriod(managedJobs[i].id, period);
+  }
+  
+  Serial.println("Power mode: " + String(powerModeName(mode)) + (lightSleepActive ? " (auto light sleep)" : ""));
+}
+
+bool isLightSleepActive() {
+  return lightSleepActive;
+}
+
+const char* powerModeName(int mode) {
+  switch (mode) {
+    case POWER_MODE_MODEM_SLEEP: return "modem";
+    case POWER_MODE_LIGHT_SLEEP: return "light";
+    default: return "performance";
+  }
+}
+
+int parsePowerMode(const String& name) {
+  for (int mode = 0; mode < POWER_MODE_COUNT; mode++) {
+    if (name == powerModeName(mode)) return mode;
+  }
+  return -1;
+}
+
+// Средний ток - взвешенная по времени оценка, а не измерение
+bool getPowerStats(int mode, PowerStats* out) {
+  if (mode < 0 || mode >= POWER_MODE_COUNT) return false;
+  accountPowerTime();
+  
+  out->asleepMicros = asleepMicros[mode];
+  out->awakeMicros = awakeMicros[mode];
+  uint64_t total = out->asleepMicros + out->awakeMicros;
+  out->averageMilliamps = total > 0
+    ? (float)((out->awakeMicros * awakeMilliamps[mode] + out->asleepMicros * asleepMilliamps[mode]) / (double)total)
+    : 0.0f;
+  return true;
+}
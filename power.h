@@ -0,0 +1,38 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <Arduino.h>
+
+// Режимы энергопотребления
+#define POWER_MODE_PERFORMANCE 0 // Wi-Fi без сна, опрос каждые 10 мс
+#define POWER_MODE_MODEM_SLEEP 1 // радио спит между DTIM-маяками
+#define POWER_MODE_LIGHT_SLEEP 2 // + автоматический light sleep между заданиями
+#define POWER_MODE_COUNT 3
+
+// В экономичных режимах сервер и поток опрашиваются раз в интервал маяка
+// (100 TU = 102.4 мс), чаще радио все равно не принимает кадры
+#define POWER_SAVE_POLL_MS 100
+#define POWER_MIN_CPU_MHZ 40
+
+// Оценка тока по даташиту ESP32 для пересчета доли сна в средний ток, мА
+#define POWER_AWAKE_MA_PERFORMANCE 110
+#define POWER_AWAKE_MA_MODEM_SLEEP 40
+#define POWER_AWAKE_MA_LIGHT_SLEEP 40
+#define POWER_ASLEEP_MA_PERFORMANCE 100
+#define POWER_ASLEEP_MA_MODEM_SLEEP 25
+#define POWER_ASLEEP_MA_LIGHT_SLEEP 2
+
+struct PowerStats {
+  uint64_t asleepMicros;
+  uint64_t awakeMicros;
+  float averageMilliamps;
+};
+
+void registerPowerManagedJob(int jobId, unsigned long fastPeriodMs);
+void applyPowerMode();
+bool isLightSleepActive();
+const char* powerModeName(int mode);
+int parsePowerMode(const String& name);
+bool getPowerStats(int mode, PowerStats* out);
+
+#endif
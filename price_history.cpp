@@ -0,0 +1,491 @@
+#include "price_history.h"
+#include "config.h"
+#include "lcd_display.h"
+#include "log_ring.h"
+#include <LittleFS.h>
+#include <time.h>
+
+// Запись: тег и данные. Ряд - рынок, число знаков, длина и символ; номер
+// ряда - порядок в файле. День - разность дней с предыдущим днем, маска
+// рядов с закрытием и их разности цены в zigzag по порядку номеров, все в varint
+#define HISTORY_TAG_SERIES 0
+#define HISTORY_TAG_DAY 1
+#define HISTORY_FRAME_MAX (8 + PRICE_HISTORY_MAX_SERIES * 5)
+// До синхронизации по NTP часы считают секунды от загрузки
+#define HISTORY_MIN_EPOCH 1700000000
+
+struct HistoryHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+};
+
+// Ряд закрытий бумаги; цены - целые в единицах последнего знака.
+// Минимум и максимум по неделям лежат в кольце по номеру недели
+struct PriceSeries {
+  char symbol[MAX_SYMBOL_LENGTH + 1];
+  uint8_t market;
+  uint8_t decimals;
+  uint16_t closes;
+  uint16_t lastDay; // дни от 1970-01-01 по МСК
+  int32_t lastClose;
+  int32_t weekLow[PRICE_HISTORY_WEEKS];
+  int32_t weekHigh[PRICE_HISTORY_WEEKS];
+};
+
+static PriceSeries series[PRICE_HISTORY_MAX_SERIES];
+static int seriesCount = 0;
+static uint16_t lastFrameDay = 0;
+static size_t fileBytes = 0;
+static int currentDay = -1;
+
+static const int32_t powersOfTen[] = { 1, 10, 100, 1000, 10000 };
+
+typedef void (*SeriesHandler)(int id, const char* symbol, uint8_t market, uint8_t decimals);
+typedef void (*CloseHandler)(int id, uint16_t day, int32_t close);
+
+static int putVarint(uint8_t* out, uint32_t value) {
+  int length = 0;
+  while (value >= 0x80) {
+    out[length++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[length++] = value;
+  return length;
+}
+
+static bool readVarint(File& file, uint32_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    int b = file.read();
+    if (b < 0) return false;
+    *value |= (uint32_t)(b & 0x7F) << shift;
+    if ((b & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+// Малые разности любого знака - короткие varint
+static uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Дни от 1970-01-01 по календарной дате
+static int daysFromCivil(int year, int month, int day) {
+  year -= month <= 2;
+  int era = year / 400;
+  int yearOfEra = year - era * 400;
+  int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+static void formatDay(uint16_t day, char* out, size_t size) {
+  time_t t = (time_t)day * 86400;
+  struct tm parts;
+  gmtime_r(&t, &parts);
+  strftime(out, size, "%Y-%m-%d", &parts);
+}
+
+// 1970-01-01 - четверг
+static bool isWeekday(int day) {
+  int weekday = (day + 4) % 7;
+  return weekday >= 1 && weekday <= 5;
+}
+
+bool isClockSynced() {
+  return time(NULL) > HISTORY_MIN_EPOCH;
+}
+
+static int tradingDay() {
+  time_t shifted = time(NULL) + PRICE_HISTORY_DAY_SHIFT_S;
+  struct tm parts;
+  localtime_r(&shifted, &parts);
+  return daysFromCivil(parts.tm_year + 1900, parts.tm_mon + 1, parts.tm_mday);
+}
+
+static void clearWeek(PriceSeries& s, int week) {
+  s.weekLow[week % PRICE_HISTORY_WEEKS] = INT32_MAX;
+  s.weekHigh[week % PRICE_HISTORY_WEEKS] = INT32_MIN;
+}
+
+// Недели между последним закрытием и новым очищаются: в кольце остаются
+// только последние 53 недели
+static void addClose(PriceSeries& s, uint16_t day, int32_t close) {
+  int week = day / 7;
+  int lastWeek = s.lastDay / 7;
+  if (s.closes == 0 || week - lastWeek >= PRICE_HISTORY_WEEKS) {
+    for (int i = 0; i < PRICE_HISTORY_WEEKS; i++) clearWeek(s, i);
+  } else {
+    for (int w = lastWeek + 1; w <= week; w++) clearWeek(s, w);
+  }
+  
+  int slot = week % PRICE_HISTORY_WEEKS;
+  s.weekLow[slot] = min(s.weekLow[slot], close);
+  s.weekHigh[slot] = max(s.weekHigh[slot], close);
+  s.lastDay = day;
+  s.lastClose = close;
+  s.closes++;
+}
+
+// Диапазон по неделям, не старше 52 недель от today
+static bool yearRange(const PriceSeries& s, int today, int32_t* low, int32_t* high) {
+  int lastWeek = s.lastDay / 7;
+  int todayWeek = max(today / 7, lastWeek);
+  *low = INT32_MAX;
+  *high = INT32_MIN;
+  for (int i = 0; i < PRICE_HISTORY_WEEKS; i++) {
+    int week = lastWeek - ((lastWeek - i) % PRICE_HISTORY_WEEKS + PRICE_HISTORY_WEEKS) % PRICE_HISTORY_WEEKS;
+    if (week <= todayWeek - PRICE_HISTORY_WEEKS || s.weekHigh[i] < s.weekLow[i]) continue;
+    *low = min(*low, s.weekLow[i]);
+    *high = max(*high, s.weekHigh[i]);
+  }
+  return *high >= *low;
+}
+
+// Разбор файла по записям. Кадр дня передается целиком после проверки,
+// поэтому хвост, оборванный при сбое питания, отбрасывается. Возвращает
+// длину целой части файла, 0 - файл не наш
+static size_t readHistory(File& file, SeriesHandler onSeries, CloseHandler onClose, uint16_t* lastDay) {
+  HistoryHeader header;
+  if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+      header.magic != PRICE_HISTORY_MAGIC || header.version != PRICE_HISTORY_VERSION) {
+    return 0;
+  }
+  
+  int32_t closes[PRICE_HISTORY_MAX_SERIES] = {0};
+  int ids = 0;
+  uint16_t day = 0;
+  size_t valid = sizeof(header);
+  
+  while (file.available() > 0) {
+    int tag = file.read();
+    if (tag == HISTORY_TAG_SERIES) {
+      uint8_t meta[3];
+      char symbol[MAX_SYMBOL_LENGTH + 1];
+      if (ids >= PRICE_HISTORY_MAX_SERIES || file.read(meta, sizeof(meta)) != sizeof(meta)) break;
+      if (meta[1] > 4 || meta[2] == 0 || meta[2] > MAX_SYMBOL_LENGTH) break;
+      if (file.read((uint8_t*)symbol, meta[2]) != meta[2]) break;
+      symbol[meta[2]] = '\0';
+      onSeries(ids++, symbol, meta[0], meta[1]);
+    } else if (tag == HISTORY_TAG_DAY) {
+      uint32_t dayDelta;
+      uint32_t mask;
+      if (!readVarint(file, &dayDelta) || !readVarint(file, &mask) || mask >> ids != 0) break;
+  
+      int32_t frameCloses[PRICE_HISTORY_MAX_SERIES];
+      bool complete = true;
+      for (int id = 0; id < ids && complete; id++) {
+        uint32_t delta;
+        if ((mask & 1UL << id) == 0) continue;
+        complete = readVarint(file, &delta);
+        frameCloses[id] = closes[id] + unzigzag(delta);
+      }
+      if (!complete) break;
+  
+      day += dayDelta;
+      for (int id = 0; id < ids; id++) {
+        if ((mask & 1UL << id) == 0) continue;
+        closes[id] = frameCloses[id];
+        onClose(id, day, frameCloses[id]);
+      }
+    } else {
+      break;
+    }
+    valid = file.position();
+  }
+  
+  if (lastDay) *lastDay = day;
+  return valid;
+}
+
+static void loadSeries(int id, const char* symbol, uint8_t market, uint8_t decimals) {
+  PriceSeries& s = series[id];
+  memset(&s, 0, sizeof(s));
+  strlcpy(s.symbol, symbol, sizeof(s.symbol));
+  s.market = market;
+  s.decimals = decimals;
+  seriesCount = id + 1;
+}
+
+static void loadClose(int id, uint16_t day, int32_t close) {
+  addClose(series[id], day, close);
+}
+
+static int encodeSeries(uint8_t* out, const char* symbol, uint8_t market, uint8_t decimals) {
+  int length = 0;
+  out[length++] = HISTORY_TAG_SERIES;
+  out[length++] = market;
+  out[length++] = decimals;
+  out[length++] = strlen(symbol);
+  memcpy(out + length, symbol, strlen(symbol));
+  return length + strlen(symbol);
+}
+
+// deltas - по номерам рядов, записываются только отмеченные в mask
+static int encodeDay(uint8_t* out, uint32_t dayDelta, uint32_t mask, const int32_t* deltas) {
+  int length = 0;
+  out[length++] = HISTORY_TAG_DAY;
+  length += putVarint(out + length, dayDelta);
+  length += putVarint(out + length, mask);
+  for (int id = 0; id < PRICE_HISTORY_MAX_SERIES; id++) {
+    if (mask & 1UL << id) length += putVarint(out + length, zigzag(deltas[id]));
+  }
+  return length;
+}
+
+// Переписывание файла: ряды текущих тикеров и закрытия за последний год.
+// Кадры старого файла перекодируются на лету, по одному дню
+static File compactOut;
+static int compactIds[PRICE_HISTORY_MAX_SERIES];
+static int32_t compactCloses[PRICE_HISTORY_MAX_SERIES];
+static int compactSeries = 0;
+static int compactCutoff = 0;
+static uint16_t compactDay = 0;
+static uint16_t compactWrittenDay = 0;
+static int32_t compactFrameDeltas[PRICE_HISTORY_MAX_SERIES];
+static uint32_t compactFrameMask = 0;
+static bool compactOk = true;
+
+static void writeCompacted(const uint8_t* data, int length) {
+  if (compactOk) compactOk = compactOut.write(data, length) == (size_t)length;
+}
+
+static void flushCompactedDay() {
+  if (compactFrameMask == 0) return;
+  uint8_t frame[HISTORY_FRAME_MAX];
+  writeCompacted(frame, encodeDay(frame, compactDay - compactWrittenDay, compactFrameMask, compactFrameDeltas));
+  compactWrittenDay = compactDay;
+  compactFrameMask = 0;
+}
+
+static void compactSeriesRecord(int id, const char* symbol, uint8_t market, uint8_t decimals) {
+  compactIds[id] = -1;
+  for (int i = 0; i < numTickers; i++) {
+    if (tickers[i].market == market && tickers[i].symbol == symbol) {
+      uint8_t record[4 + MAX_SYMBOL_LENGTH];
+      writeCompacted(record, encodeSeries(record, symbol, market, decimals));
+      compactCloses[compactSeries] = 0;
+      compactIds[id] = compactSeries++;
+      return;
+    }
+  }
+}
+
+static void compactCloseRecord(int id, uint16_t day, int32_t close) {
+  int newId = compactIds[id];
+  if (newId < 0 || day < compactCutoff) return;
+  if (day != compactDay) flushCompactedDay();
+  compactDay = day;
+  compactFrameMask |= 1UL << newId;
+  compactFrameDeltas[newId] = close - compactCloses[newId];
+  compactCloses[newId] = close;
+}
+
+static void compactHistory(int today) {
+  File in = LittleFS.open(PRICE_HISTORY_PATH, FILE_READ);
+  compactOut = LittleFS.open(PRICE_HISTORY_TMP_PATH, FILE_WRITE);
+  if (!compactOut) {
+    if (in) in.close();
+    return;
+  }
+  
+  HistoryHeader header = { PRICE_HISTORY_MAGIC, PRICE_HISTORY_VERSION, 0 };
+  size_t before = in ? in.size() : 0;
+  compactOk = true;
+  compactSeries = 0;
+  compactCutoff = today - PRICE_HISTORY_KEEP_DAYS;
+  compactDay = 0;
+  compactWrittenDay = 0;
+  compactFrameMask = 0;
+  writeCompacted((const uint8_t*)&header, sizeof(header));
+  if (in) {
+    readHistory(in, compactSeriesRecord, compactCloseRecord, NULL);
+    in.close();
+  }
+  flushCompactedDay();
+  compactOut.close();
+  
+  // LittleFS заменяет старый файл при переименовании атомарно
+  if (!compactOk || !LittleFS.rename(PRICE_HISTORY_TMP_PATH, PRICE_HISTORY_PATH)) {
+    LittleFS.remove(PRICE_HISTORY_TMP_PATH);
+    return;
+  }
+  initPriceHistory();
+  logEvent(LOG_HISTORY_COMPACTED, "", before, fileBytes, seriesCount);
+}
+
+void initPriceHistory() {
+  seriesCount = 0;
+  lastFrameDay = 0;
+  fileBytes = 0;
+  // Остаток переписывания, прерванного до переименования
+  if (LittleFS.exists(PRICE_HISTORY_TMP_PATH)) LittleFS.remove(PRICE_HISTORY_TMP_PATH);
+  
+  File file = LittleFS.open(PRICE_HISTORY_PATH, FILE_READ);
+  if (!file) return;
+  size_t size = file.size();
+  fileBytes = readHistory(file, loadSeries, loadClose, &lastFrameDay);
+  file.close();
+  
+  int closes = 0;
+  for (int i = 0; i < seriesCount; i++) closes += series[i].closes;
+  logEvent(LOG_HISTORY_LOADED, "", seriesCount, closes, fileBytes);
+  
+  // Оборванная запись в конце или чужой файл: остается целая часть
+  if (fileBytes < size) compactHistory(lastFrameDay);
+}
+
+static int findSeries(const String& symbol, int market) {
+  for (int i = 0; i < seriesCount; i++) {
+    if (series[i].market == market && symbol == series[i].symbol) return i;
+  }
+  return -1;
+}
+
+// Оборванный хвост, который не удалось отбросить переписыванием, остается
+// в файле: запись после него потерялась бы при чтении, поэтому не пишется
+static bool appendRecord(const uint8_t* data, int length) {
+  File file = LittleFS.open(PRICE_HISTORY_PATH, fileBytes == 0 ? FILE_WRITE : FILE_APPEND);
+  if (!file) return false;
+  if (file.size() != fileBytes) {
+    file.close();
+    return false;
+  }
+  
+  bool ok = true;
+  if (fileBytes == 0) {
+    HistoryHeader header = { PRICE_HISTORY_MAGIC, PRICE_HISTORY_VERSION, 0 };
+    ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+    if (ok) fileBytes = sizeof(header);
+  }
+  ok = ok && file.write(data, length) == (size_t)length;
+  file.close();
+  if (ok) fileBytes += length;
+  return ok;
+}
+
+// Число знаков ряда берется по первой цене: не меньше копеек, не больше 4
+static uint8_t priceDecimals(const String& price) {
+  int dot = price.indexOf('.');
+  int decimals = dot < 0 ? 0 : price.length() - dot - 1;
+  return constrain(decimals, 2, 4);
+}
+
+static void addSeries(const TickerData& ticker, const String& price, int day) {
+  if (seriesCount == PRICE_HISTORY_MAX_SERIES) compactHistory(day);
+  if (seriesCount == PRICE_HISTORY_MAX_SERIES) return;
+  
+  uint8_t decimals = priceDecimals(price);
+  uint8_t record[4 + MAX_SYMBOL_LENGTH];
+  if (!appendRecord(record, encodeSeries(record, ticker.symbol.c_str(), ticker.market, decimals))) return;
+  loadSeries(seriesCount, ticker.symbol.c_str(), ticker.market, decimals);
+}
+
+static bool isUsablePrice(const String& price) {
+  return price.length() > 0 && price != "Error";
+}
+
+// Закрытия дня - последние известные цены. Цена, равная прошлому закрытию,
+// не пишется: это праздник или устройство весь день было без связи
+static void recordCloses(int day) {
+  int32_t closes[PRICE_HISTORY_MAX_SERIES];
+  int32_t deltas[PRICE_HISTORY_MAX_SERIES];
+  uint32_t mask = 0;
+  int count = 0;
+  
+  // Сначала ряды для новых тикеров: переписывание файла меняет номера рядов
+  for (int i = 0; i < numTickers; i++) {
+    if (isUsablePrice(stockPrices[i]) && findSeries(tickers[i].symbol, tickers[i].market) < 0) {
+      addSeries(tickers[i], stockPrices[i], day);
+    }
+  }
+  
+  for (int i = 0; i < numTickers; i++) {
+    if (!isUsablePrice(stockPrices[i])) continue;
+    int id = findSeries(tickers[i].symbol, tickers[i].market);
+    if (id < 0) continue;
+  
+    PriceSeries& s = series[id];
+    double scaled = round(strtod(stockPrices[i].c_str(), NULL) * powersOfTen[s.decimals]);
+    if (fabs(scaled) > INT32_MAX) continue;
+    int32_t close = (int32_t)scaled;
+    if (s.closes > 0 && (s.lastDay >= day || s.lastClose == close)) continue;
+  
+    if (mask & 1UL << id) continue;
+    mask |= 1UL << id;
+    closes[id] = close;
+    deltas[id] = close - s.lastClose;
+    count++;
+  }
+  if (count == 0) return;
+  
+  uint8_t frame[HISTORY_FRAME_MAX];
+  if (!appendRecord(frame, encodeDay(frame, day - lastFrameDay, mask, deltas))) {
+    // Недописанный кадр отбрасывается переписыванием файла
+    compactHistory(day);
+    return;
+  }
+  for (int id = 0; id < seriesCount; id++) {
+    if (mask & 1UL << id) addClose(series[id], day, closes[id]);
+  }
+  lastFrameDay = day;
+  
+  char date[11];
+  formatDay(day, date, sizeof(date));
+  logEvent(LOG_HISTORY_RECORDED, date, count, fileBytes);
+  if (fileBytes > PRICE_HISTORY_MAX_BYTES) compactHistory(day);
+  
+  invalidateAllTickerLines();
+  updateDisplay();
+}
+
+// День закрывается при смене даты; выходной не записывается - цена та же,
+// что в пятницу
+void handlePriceHistory() {
+  if (!isClockSynced()) return;
+  
+  int today = tradingDay();
+  if (currentDay < 0) currentDay = today;
+  if (today == currentDay) return;
+  
+  int closedDay = currentDay;
+  currentDay = today;
+  if (isWeekday(closedDay)) recordCloses(closedDay);
+}
+
+bool getPriceStats(const TickerData& ticker, PriceStats* out) {
+  int id = findSeries(ticker.symbol, ticker.market);
+  if (id < 0 || series[id].closes == 0) return false;
+  
+  const PriceSeries& s = series[id];
+  float scale = powersOfTen[s.decimals];
+  int32_t low;
+  int32_t high;
+  if (!yearRange(s, isClockSynced() ? tradingDay() : s.lastDay, &low, &high)) low = high = s.lastClose;
+  out->prevClose = s.lastClose / scale;
+  formatDay(s.lastDay, out->prevDate, sizeof(out->prevDate));
+  out->yearLow = low / scale;
+  out->yearHigh = high / scale;
+  out->closes = s.closes;
+  return true;
+}
+
+bool dayChangePercent(int tickerIndex, PriceStats* stats, float* percent) {
+  const String& price = stockPrices[tickerIndex];
+  if (!isUsablePrice(price) || !getPriceStats(tickers[tickerIndex], stats) || stats->prevClose == 0) return false;
+  *percent = (price.toFloat() - stats->prevClose) / stats->prevClose * 100;
+  return true;
+}
+
+bool hasPriceHistory() {
+  return seriesCount > 0;
+}
+
+size_t priceHistoryBytes() {
+  return fileBytes;
+}
@@ -0,0 +1,41 @@
+#ifndef PRICE_HISTORY_H
+#define PRICE_HISTORY_H
+
+#include "config.h"
+
+// Цены закрытия по дням в LittleFS: файл только дописывается, значения
+// хранятся разностями от предыдущего закрытия бумаги в varint
+#define PRICE_HISTORY_PATH "/history.bin"
+#define PRICE_HISTORY_TMP_PATH PRICE_HISTORY_PATH ".tmp"
+#define PRICE_HISTORY_MAGIC 0x54534850 // "PHST"
+#define PRICE_HISTORY_VERSION 1
+// Старые дни и снятые тикеры вычищаются переписыванием файла
+#define PRICE_HISTORY_MAX_BYTES 16384
+#define PRICE_HISTORY_MAX_SERIES 16
+#define PRICE_HISTORY_KEEP_DAYS 371
+// 52 недели и текущая
+#define PRICE_HISTORY_WEEKS 53
+#define PRICE_HISTORY_TIMEZONE "MSK-3"
+// День закрывается в 23:55 МСК, после вечерней сессии
+#define PRICE_HISTORY_DAY_SHIFT_S 300
+#define PRICE_HISTORY_CHECK_MS 60000
+
+struct PriceStats {
+  float prevClose;      // закрытие предыдущего торгового дня
+  char prevDate[11];    // его дата, YYYY-MM-DD
+  float yearLow;        // по закрытиям за 52 недели, с точностью до недели
+  float yearHigh;
+  uint16_t closes;      // закрытий в файле
+};
+
+void initPriceHistory();
+// Раз в минуту: при смене дня записывает закрытия текущих тикеров
+void handlePriceHistory();
+bool isClockSynced();
+bool hasPriceHistory();
+bool getPriceStats(const TickerData& ticker, PriceStats* out);
+// Изменение к предыдущему закрытию в процентах; false - нет истории или цены
+bool dayChangePercent(int tickerIndex, PriceStats* stats, float* percent);
+size_t priceHistoryBytes();
+
+#endif
@@ -0,0 +1,161 @@
+#include "quote_provider.h"
+#include "config.h"
+#include "network.h"
+#include "log_ring.h"
+#include "arena.h"
+#include "upstream.h"
+#include <WiFi.h>
+#include <ArduinoJson.h>
+
+// Раскладка рынка ISS: путь, режим торгов и столбцы цены. Второй столбец
+// берется, когда в первом null (облигации и фьючерсы вне сессии)
+struct SharesMarket {
+  static constexpr const char* name = "shares";
+  static constexpr const char* path = "engines/stock/markets/shares";
+  static constexpr const char* board = "TQBR";
+  static constexpr const char* priceColumn = "LAST";
+  static constexpr const char* fallbackColumn = nullptr;
+};
+
+struct BondsMarket {
+  static constexpr const char* name = "bonds";
+  static constexpr const char* path = "engines/stock/markets/bonds";
+  static constexpr const char* board = "TQOB";
+  static constexpr const char* priceColumn = "LAST";
+  static constexpr const char* fallbackColumn = "LCURRENTPRICE";
+};
+
+struct CurrencyMarket {
+  static constexpr const char* name = "currency";
+  static constexpr const char* path = "engines/currency/markets/selt";
+  static constexpr const char* board = "CETS";
+  static constexpr const char* priceColumn = "LAST";
+  static constexpr const char* fallbackColumn = "WAPRICE";
+};
+
+struct FuturesMarket {
+  static constexpr const char* name = "futures";
+  static constexpr const char* path = "engines/futures/markets/forts";
+  static constexpr const char* board = "RFUD";
+  static constexpr const char* priceColumn = "LAST";
+  static constexpr const char* fallbackColumn = "SETTLEPRICE";
+};
+
+static bool readPriceCell(JsonVariantConst cell, char* price, size_t size) {
+  serializeJson(cell, price, size);
+  return strcmp(price, "null") != 0 && price[0] != '\0';
+}
+
+// Разбор ответа прямо из потока; документ и строки парсера живут в арене запроса.
+// Столбцы ищутся по имени: ISS отдает только запрошенные, порядок не гарантирован
+template <typename Market>
+static String parsePrice(Stream& stream, const char* symbol, Arena* arena, unsigned long startTime) {
+  ArenaJsonAllocator allocator(arena);
+  JsonDocument filter(&allocator);
+  filter["marketdata"]["columns"] = true;
+  filter["marketdata"]["data"] = true;
+  
+  JsonDocument doc(&allocator);
+  DeserializationError error = deserializeJson(doc, stream, DeserializationOption::Filter(filter));
+  if (error) {
+    logEvent(LOG_FETCH_JSON_ERROR, symbol, error.code());
+    return "Error";
+  }
+  
+  int boardColumn = -1;
+  int priceColumn = -1;
+  int fallbackColumn = -1;
+  int index = 0;
+  for (JsonVariantConst column : doc["marketdata"]["columns"].as<JsonArrayConst>()) {
+    const char* name = column;
+    if (name == NULL) name = "";
+    if (strcmp(name, "BOARDID") == 0) boardColumn = index;
+    else if (strcmp(name, Market::priceColumn) == 0) priceColumn = index;
+    else if constexpr (Market::fallbackColumn != nullptr) {
+      if (strcmp(name, Market::fallbackColumn) == 0) fallbackColumn = index;
+    }
+    index++;
+  }
+  
+  if (boardColumn >= 0 && priceColumn >= 0) {
+    for (JsonArrayConst row : doc["marketdata"]["data"].as<JsonArrayConst>()) {
+      const char* boardId = row[boardColumn];
+      if (boardId == NULL || strcmp(boardId, Market::board) != 0) continue;
+  
+      char price[24];
+      bool found = readPriceCell(row[priceColumn], price, sizeof(price));
+      if constexpr (Market::fallbackColumn != nullptr) {
+        if (!found && fallbackColumn >= 0) found = readPriceCell(row[fallbackColumn], price, sizeof(price));
+      }
+      if (found) {
+        logEvent(LOG_FETCH_OK, symbol, millis() - startTime, 0, 0, atof(price));
+        truncatePrice(price);
+        return String(price);
+      }
+    }
+  }
+  
+  logEvent(LOG_FETCH_NO_DATA, symbol);
+  return "Error";
+}
+
+// Разбор специализирован под раскладку рынка при компиляции: добавленные
+// рынки не добавляют сравнений в разбор акций
+template <typename Market>
+class IssQuoteProvider : public QuoteProvider {
+public:
+  const char* name() const override { return Market::name; }
+  const char* path() const override { return Market::path; }
+  const char* board() const override { return Market::board; }
+
+  String fetchPrice(const String& symbol, const UpstreamSlot* slot) override {
+    if (WiFi.status() != WL_CONNECTED || !isValidSymbol(symbol)) return "Error";
+  
+    // Только нужная таблица и столбцы: ответ в разы короче полного
+    String path = String(Market::path) + "/securities/" + symbol +
+                  ".json?iss.meta=off&iss.only=marketdata&marketdata.columns=BOARDID," + Market::priceColumn;
+    if constexpr (Market::fallbackColumn != nullptr) {
+      path += ',';
+      path += Market::fallbackColumn;
+    }
+    return fetchFromUpstreams(path, symbol, parsePrice<Market>, slot);
+  }
+};
+
+static IssQuoteProvider<SharesMarket> sharesProvider;
+static IssQuoteProvider<BondsMarket> bondsProvider;
+static IssQuoteProvider<CurrencyMarket> currencyProvider;
+static IssQuoteProvider<FuturesMarket> futuresProvider;
+
+static QuoteProvider* const providers[MARKET_COUNT] = {
+  &sharesProvider, &bondsProvider, &currencyProvider, &futuresProvider
+};
+
+QuoteProvider& quoteProvider(int market) {
+  if (market < 0 || market >= MARKET_COUNT) market = MARKET_SHARES;
+  return *providers[market];
+}
+
+const char* marketName(int market) {
+  return quoteProvider(market).name();
+}
+
+int parseMarket(const String& name) {
+  for (int market = 0; market < MARKET_COUNT; market++) {
+    if (name == providers[market]->name()) return market;
+  }
+  return -1;
+}
+
+void normalizeSymbol(String& symbol, int market) {
+  symbol.trim();
+  if (market != MARKET_FUTURES) symbol.toUpperCase();
+}
+
+bool isValidSymbol(const String& symbol) {
+  if (symbol.length() == 0 || symbol.length() > MAX_SYMBOL_LENGTH) return false;
+  for (unsigned int i = 0; i < symbol.length(); i++) {
+    if (!isAlphaNumeric(symbol[i]) && symbol[i] != '_') return false;
+  }
+  return true;
+}
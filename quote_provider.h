@@ -0,0 +1,34 @@
+#ifndef QUOTE_PROVIDER_H
+#define QUOTE_PROVIDER_H
+
+#include "config.h"
+
+// Рынок тикера: у каждого свой адрес ISS, режим торгов и столбец цены
+#define MARKET_SHARES 0   // акции, TQBR
+#define MARKET_BONDS 1    // облигации, TQOB
+#define MARKET_CURRENCY 2 // валюта, CETS
+#define MARKET_FUTURES 3  // фьючерсы FORTS, RFUD
+#define MARKET_COUNT 4
+
+struct UpstreamSlot;
+
+// Источник цены одной бумаги; вызывается из рабочих задач пула
+class QuoteProvider {
+public:
+  virtual ~QuoteProvider() {}
+  virtual const char* name() const = 0;
+  // Путь рынка в ISS от базового адреса: engines/stock/markets/shares
+  virtual const char* path() const = 0;
+  virtual const char* board() const = 0;
+  // Цена для дисплея или "Error"; пустая строка - ее уже выдал дубль через slot
+  virtual String fetchPrice(const String& symbol, const UpstreamSlot* slot) = 0;
+};
+
+QuoteProvider& quoteProvider(int market);
+const char* marketName(int market);
+int parseMarket(const String& name);
+// Коды фьючерсов в ISS смешанного регистра (SiZ5), остальные - заглавные
+void normalizeSymbol(String& symbol, int market);
+bool isValidSymbol(const String& symbol);
+
+#endif
@@ -0,0 +1,451 @@
+#include "quote_stream.h"
+#include "config.h"
+#include "network.h"
+#include "lcd_display.h"
+#include "quote_provider.h"
+#include "log_ring.h"
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <ArduinoJson.h>
+#include <base64.h>
+#include <esp_random.h>
+
+#define WS_OP_CONTINUATION 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+#define STREAM_IO_TIMEOUT_MS 3000
+
+struct StreamUrl {
+  bool secure;
+  String host;
+  uint16_t port;
+  String path;
+};
+
+static WiFiClient plainClient;
+static WiFiClientSecure secureClient;
+static WiFiClient* streamClient = NULL;
+
+static bool streamConnected = false;
+static bool stompConnected = false;
+static unsigned long lastFrameTime = 0;
+static unsigned long lastHeartbeatSent = 0;
+static unsigned long nextRetryTime = 0;
+static unsigned long retryDelay = STREAM_RETRY_MIN_MS;
+
+// Сообщение WebSocket может прийти несколькими фрагментами
+static String messageBuffer;
+static bool dropMessage = false;
+
+static String subscribedSymbols[MAX_TICKERS];
+static int numSubscribed = 0;
+
+static bool parseStreamUrl(const String& url, StreamUrl& out) {
+  int hostStart;
+  if (url.startsWith("wss://")) {
+    out.secure = true;
+    hostStart = 6;
+  } else if (url.startsWith("ws://")) {
+    out.secure = false;
+    hostStart = 5;
+  } else {
+    return false;
+  }
+  
+  int pathStart = url.indexOf('/', hostStart);
+  String hostPort = pathStart == -1 ? url.substring(hostStart) : url.substring(hostStart, pathStart);
+  out.path = pathStart == -1 ? "/" : url.substring(pathStart);
+  
+  int colon = hostPort.indexOf(':');
+  if (colon == -1) {
+    out.host = hostPort;
+    out.port = out.secure ? 443 : 80;
+  } else {
+    out.host = hostPort.substring(0, colon);
+    out.port = hostPort.substring(colon + 1).toInt();
+  }
+  
+  return out.host.length() > 0 && out.port > 0;
+}
+
+static bool readExact(uint8_t* buf, size_t len) {
+  unsigned long lastProgress = millis();
+  size_t got = 0;
+  
+  while (got < len) {
+    int n = streamClient->read(buf + got, len - got);
+    if (n > 0) {
+      got += n;
+      lastProgress = millis();
+    } else if (!streamClient->connected() || millis() - lastProgress > STREAM_IO_TIMEOUT_MS) {
+      return false;
+    } else {
+      delay(1);
+    }
+  }
+  
+  return true;
+}
+
+static bool readLine(String& line) {
+  line = "";
+  uint8_t c;
+  while (line.length() < 512) {
+    if (!readExact(&c, 1)) return false;
+    if (c == '\n') return true;
+    if (c != '\r') line += (char)c;
+  }
+  return false;
+}
+
+// Кадры клиента обязаны быть замаскированы (RFC 6455, 5.3)
+static bool sendWsFrame(uint8_t opcode, const uint8_t* payload, size_t len) {
+  uint8_t header[14];
+  size_t h = 0;
+  
+  header[h++] = 0x80 | opcode;
+  if (len < 126) {
+    header[h++] = 0x80 | len;
+  } else if (len < 65536) {
+    header[h++] = 0x80 | 126;
+    header[h++] = (len >> 8) & 0xFF;
+    header[h++] = len & 0xFF;
+  } else {
+    header[h++] = 0x80 | 127;
+    for (int i = 7; i >= 0; i--) header[h++] = ((uint64_t)len >> (8 * i)) & 0xFF;
+  }
+  
+  uint32_t maskKey = esp_random();
+  uint8_t* mask = header + h;
+  memcpy(mask, &maskKey, 4);
+  h += 4;
+  
+  if (streamClient->write(header, h) != h) return false;
+  
+  uint8_t chunk[256];
+  for (size_t i = 0; i < len; i += sizeof(chunk)) {
+    size_t n = min(len - i, sizeof(chunk));
+    for (size_t j = 0; j < n; j++) chunk[j] = payload[i + j] ^ mask[(i + j) & 3];
+    if (streamClient->write(chunk, n) != n) return false;
+  }
+  
+  return true;
+}
+
+static bool sendStompFrame(const String& frame) {
+  // Кадр STOMP завершается нулевым байтом, c_str() его уже содержит
+  return sendWsFrame(WS_OP_TEXT, (const uint8_t*)frame.c_str(), frame.length() + 1);
+}
+
+static void closeStream() {
+  if (streamClient) streamClient->stop();
+  streamConnected = false;
+  stompConnected = false;
+  numSubscribed = 0;
+  messageBuffer = "";
+  dropMessage = false;
+}
+
+static void scheduleRetry() {
+  nextRetryTime = millis() + retryDelay;
+  retryDelay = min(retryDelay * 2, (unsigned long)STREAM_RETRY_MAX_MS);
+}
+
+static bool openWebSocket(const StreamUrl& url) {
+  if (url.secure) {
+    secureClient.setInsecure();
+    streamClient = &secureClient;
+  } else {
+    streamClient = &plainClient;
+  }
+  
+  if (!streamClient->connect(url.host.c_str(), url.port)) return false;
+  
+  uint8_t keyBytes[16];
+  for (int i = 0; i < 16; i++) keyBytes[i] = esp_random() & 0xFF;
+  
+  String request = "GET " + url.path + " HTTP/1.1\r\n";
+  request += "Host: " + url.host + "\r\n";
+  request += "Upgrade: websocket\r\n";
+  request += "Connection: Upgrade\r\n";
+  request += "Sec-WebSocket-Key: " + base64::encode(keyBytes, sizeof(keyBytes)) + "\r\n";
+  request += "Sec-WebSocket-Version: 13\r\n";
+  request += "Sec-WebSocket-Protocol: v12.stomp\r\n\r\n";
+  streamClient->print(request);
+  
+  String line;
+  if (!readLine(line) || !line.startsWith("HTTP/1.1 101")) {
+    logEvent(LOG_STREAM_HANDSHAKE_FAILED, line.c_str());
+    return false;
+  }
+  
+  // Заголовки ответа не нужны, пропускаем до пустой строки
+  while (readLine(line)) {
+    if (line.length() == 0) return true;
+  }
+  return false;
+}
+
+static bool connectStream() {
+  StreamUrl url;
+  if (!parseStreamUrl(streamUrl, url)) {
+    logEvent(LOG_STREAM_INVALID_URL, streamUrl.c_str());
+    return false;
+  }
+  
+  if (!openWebSocket(url)) {
+    closeStream();
+    return false;
+  }
+  
+  String frame = "CONNECT\n";
+  frame += "accept-version:1.2\n";
+  frame += "host:" + url.host + "\n";
+  frame += "login:" + streamLogin + "\n";
+  frame += "passcode:" + streamPasscode + "\n";
+  frame += "heart-beat:" + String(STREAM_HEARTBEAT_MS) + "," + String(STREAM_HEARTBEAT_MS) + "\n\n";
+  
+  if (!sendStompFrame(frame)) {
+    closeStream();
+    return false;
+  }
+  
+  streamConnected = true;
+  lastFrameTime = millis();
+  lastHeartbeatSent = millis();
+  logEvent(LOG_STREAM_CONNECTED, url.host.c_str());
+  return true;
+}
+
+// Поток несет только акции TQBR, остальные рынки опрашиваются
+static String streamedSymbol(int tickerIndex) {
+  return tickers[tickerIndex].market == MARKET_SHARES ? tickers[tickerIndex].symbol : String();
+}
+
+static bool subscriptionChanged() {
+  if (numSubscribed != numTickers) return true;
+  for (int i = 0; i < numTickers; i++) {
+    if (subscribedSymbols[i] != streamedSymbol(i)) return true;
+  }
+  return false;
+}
+
+static void resubscribe() {
+  for (int i = 0; i < numSubscribed; i++) {
+    if (subscribedSymbols[i].length() > 0) sendStompFrame("UNSUBSCRIBE\nid:" + String(i) + "\n\n");
+  }
+  
+  for (int i = 0; i < numTickers; i++) {
+    subscribedSymbols[i] = streamedSymbol(i);
+    if (subscribedSymbols[i].length() == 0) continue;
+    String frame = "SUBSCRIBE\n";
+    frame += "id:" + String(i) + "\n";
+    frame += "destination:" STREAM_DESTINATION "\n";
+    frame += "selector:TICKER=\"MXSE." STREAM_BOARD "." + tickers[i].symbol + "\"\n\n";
+    sendStompFrame(frame);
+  }
+  numSubscribed = numTickers;
+}
+
+// Тело MESSAGE - таблица ISS: {"columns":[...],"data":[[...]]},
+// возможно вложенная в "marketdata"
+static void applyStreamQuotes(const String& body) {
+  JsonDocument doc;
+  if (deserializeJson(doc, body)) return;
+  
+  JsonObject table = doc["marketdata"].is<JsonObject>() ? doc["marketdata"].as<JsonObject>() : doc.as<JsonObject>();
+  JsonArray columns = table["columns"];
+  JsonArray data = table["data"];
+  if (columns.isNull() || data.isNull()) return;
+  
+  int secCol = -1, boardCol = -1, lastCol = -1;
+  for (size_t i = 0; i < columns.size(); i++) {
+    String name = columns[i];
+    if (name == "SECID" || name == "TICKER") secCol = i;
+    else if (name == "BOARDID") boardCol = i;
+    else if (name == "LAST") lastCol = i;
+  }
+  if (secCol < 0 || lastCol < 0) return;
+  
+  bool displayChanged = false;
+  for (JsonArray row : data) {
+    if (boardCol >= 0 && row[boardCol] != STREAM_BOARD) continue;
+    
+    String secid = row[secCol];
+    int dot = secid.lastIndexOf('.');
+    if (dot != -1) secid = secid.substring(dot + 1);
+    
+    String price = row[lastCol];
+    if (price == "null" || price.length() == 0) continue;
+    
+    price = formatPrice(price);
+    for (int i = 0; i < numTickers; i++) {
+      if (tickers[i].market != MARKET_SHARES || tickers[i].symbol != secid) continue;
+      if (stockPrices[i] == price && updateIndicators[i] == ' ') continue;
+      stockPrices[i] = price;
+      updateIndicators[i] = ' ';
+      invalidateTickerLine(i);
+      if (isMarqueeMode() || isTickerDisplayed(i)) displayChanged = true;
+    }
+  }
+  
+  if (displayChanged) updateDisplay();
+}
+
+static void handleStompFrame(const String& frame) {
+  int len = frame.length();
+  int start = 0;
+  while (start < len && (frame[start] == '\n' || frame[start] == '\r')) start++;
+  if (start >= len) return; // heart-beat
+  
+  int eol = frame.indexOf('\n', start);
+  if (eol == -1) return;
+  String command = frame.substring(start, eol);
+  command.trim();
+  
+  int bodyStart = frame.indexOf("\n\n", eol);
+  int separator = 2;
+  if (bodyStart == -1) {
+    bodyStart = frame.indexOf("\r\n\r\n", eol);
+    separator = 4;
+  }
+  String body = bodyStart == -1 ? "" : frame.substring(bodyStart + separator);
+  
+  if (command == "CONNECTED") {
+    stompConnected = true;
+    retryDelay = STREAM_RETRY_MIN_MS;
+    resubscribe();
+  } else if (command == "MESSAGE") {
+    applyStreamQuotes(body);
+  } else if (command == "ERROR") {
+    logEvent(LOG_STREAM_ERROR, frame.c_str() + eol + 1);
+    closeStream();
+    scheduleRetry();
+  }
+}
+
+// Одно сообщение WebSocket может содержать несколько кадров STOMP
+static void handleStompPayload(const String& payload) {
+  int len = payload.length();
+  int start = 0;
+  for (int i = 0; i <= len; i++) {
+    if (i == len || payload[i] == '\0') {
+      if (i > start) handleStompFrame(payload.substring(start, i));
+      if (!streamConnected) return;
+      start = i + 1;
+    }
+  }
+}
+
+static bool readWsFrame() {
+  uint8_t header[2];
+  if (!readExact(header, 2)) return false;
+  
+  bool fin = header[0] & 0x80;
+  uint8_t opcode = header[0] & 0x0F;
+  bool masked = header[1] & 0x80;
+  uint64_t len = header[1] & 0x7F;
+  
+  if (len == 126) {
+    uint8_t ext[2];
+    if (!readExact(ext, 2)) return false;
+    len = (ext[0] << 8) | ext[1];
+  } else if (len == 127) {
+    uint8_t ext[8];
+    if (!readExact(ext, 8)) return false;
+    len = 0;
+    for (int i = 0; i < 8; i++) len = (len << 8) | ext[i];
+  }
+  
+  uint8_t mask[4] = {0, 0, 0, 0};
+  if (masked && !readExact(mask, 4)) return false;
+  
+  lastFrameTime = millis();
+  
+  if (opcode >= WS_OP_CLOSE) {
+    uint8_t payload[125];
+    if (len > sizeof(payload) || !readExact(payload, len)) return false;
+    for (size_t i = 0; i < len; i++) payload[i] ^= mask[i & 3];
+    
+    if (opcode == WS_OP_CLOSE) return false;
+    if (opcode == WS_OP_PING) sendWsFrame(WS_OP_PONG, payload, len);
+    return true;
+  }
+  
+  if (opcode != WS_OP_CONTINUATION) {
+    messageBuffer = "";
+    dropMessage = false;
+  }
+  
+  // Слишком большие сообщения вычитываются из сокета, но не разбираются
+  uint8_t chunk[128];
+  uint64_t offset = 0;
+  while (offset < len) {
+    size_t n = min((uint64_t)sizeof(chunk), len - offset);
+    if (!readExact(chunk, n)) return false;
+    for (size_t j = 0; j < n; j++) chunk[j] ^= mask[(offset + j) & 3];
+    
+    if (!dropMessage) {
+      if (messageBuffer.length() + n > STREAM_MAX_FRAME) {
+        dropMessage = true;
+        messageBuffer = "";
+      } else {
+        messageBuffer.concat((const char*)chunk, n);
+      }
+    }
+    offset += n;
+  }
+  
+  if (fin) {
+    if (!dropMessage) handleStompPayload(messageBuffer);
+    messageBuffer = "";
+    dropMessage = false;
+  }
+  
+  return true;
+}
+
+void handleQuoteStream() {
+  if (streamUrl.length() == 0 || WiFi.status() != WL_CONNECTED) {
+    if (streamConnected) closeStream();
+    return;
+  }
+  
+  if (!streamConnected) {
+    if (numTickers == 0 || (long)(millis() - nextRetryTime) < 0) return;
+    if (!connectStream()) scheduleRetry();
+    return;
+  }
+  
+  // Ограничение кадров за проход, чтобы не задерживать веб-сервер и дисплей
+  for (int frames = 0; frames < 8 && streamConnected && streamClient->available(); frames++) {
+    if (!readWsFrame()) {
+      closeStream();
+      scheduleRetry();
+      return;
+    }
+  }
+  if (!streamConnected) return;
+  
+  if (!streamClient->connected() || millis() - lastFrameTime > STREAM_STALE_MS) {
+    logEvent(LOG_STREAM_LOST);
+    closeStream();
+    scheduleRetry();
+    scheduleStockPriceUpdate();
+    return;
+  }
+  
+  if (stompConnected && subscriptionChanged()) resubscribe();
+  
+  if (millis() - lastHeartbeatSent >= STREAM_HEARTBEAT_MS) {
+    const uint8_t eol = '\n';
+    sendWsFrame(WS_OP_TEXT, &eol, 1);
+    lastHeartbeatSent = millis();
+  }
+}
+
+bool isQuoteStreamActive() {
+  return stompConnected && numSubscribed > 0 && millis() - lastFrameTime < STREAM_STALE_MS;
+}
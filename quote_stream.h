@@ -0,0 +1,18 @@
+#ifndef QUOTE_STREAM_H
+#define QUOTE_STREAM_H
+
+#include "config.h"
+
+// Подписка на котировки через STOMP поверх WebSocket
+#define STREAM_HEARTBEAT_MS 20000
+#define STREAM_STALE_MS 60000
+#define STREAM_RETRY_MIN_MS 5000
+#define STREAM_RETRY_MAX_MS 300000
+#define STREAM_MAX_FRAME 8192
+#define STREAM_DESTINATION "MXSE.securities"
+#define STREAM_BOARD "TQBR"
+
+void handleQuoteStream();
+bool isQuoteStreamActive();
+
+#endif
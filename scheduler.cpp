@@ -0,0 +1,205 @@
+#include "scheduler.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+struct Job {
+  const char* name;
+  JobCallback callback;
+  unsigned long period; // 0 - однократное задание
+  unsigned long deadline;
+  bool active;
+  uint32_t generation; // растет при каждом занятии слота
+  int heapPos;
+  uint32_t runs;
+  uint64_t totalMicros;
+  uint32_t maxMicros;
+};
+
+static Job jobs[SCHEDULER_MAX_JOBS];
+static int heap[SCHEDULER_MAX_JOBS];
+static int heapSize = 0;
+static uint64_t sleepMicros = 0;
+
+// Сравнение сроков с учетом переполнения millis()
+static bool isEarlier(unsigned long a, unsigned long b) {
+  return (long)(a - b) < 0;
+}
+
+static void heapSwap(int i, int j) {
+  int tmp = heap[i];
+  heap[i] = heap[j];
+  heap[j] = tmp;
+  jobs[heap[i]].heapPos = i;
+  jobs[heap[j]].heapPos = j;
+}
+
+static void siftUp(int i) {
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!isEarlier(jobs[heap[i]].deadline, jobs[heap[parent]].deadline)) break;
+    heapSwap(i, parent);
+    i = parent;
+  }
+}
+
+static void siftDown(int i) {
+  while (true) {
+    int left = 2 * i + 1;
+    int right = left + 1;
+    int smallest = i;
+    if (left < heapSize && isEarlier(jobs[heap[left]].deadline, jobs[heap[smallest]].deadline)) smallest = left;
+    if (right < heapSize && isEarlier(jobs[heap[right]].deadline, jobs[heap[smallest]].deadline)) smallest = right;
+    if (smallest == i) break;
+    heapSwap(i, smallest);
+    i = smallest;
+  }
+}
+
+static void heapInsert(int id) {
+  heap[heapSize] = id;
+  jobs[id].heapPos = heapSize;
+  heapSize++;
+  siftUp(heapSize - 1);
+}
+
+static void heapRemove(int id) {
+  int pos = jobs[id].heapPos;
+  if (pos < 0) return;
+  
+  heapSize--;
+  if (pos != heapSize) {
+    heapSwap(pos, heapSize);
+    siftDown(pos);
+    siftUp(pos);
+  }
+  jobs[id].heapPos = -1;
+}
+
+static bool isValidJob(int id) {
+  return id >= 0 && id < SCHEDULER_MAX_JOBS && jobs[id].active;
+}
+
+static int addJob(const char* name, unsigned long periodMs, unsigned long delayMs, JobCallback callback) {
+  for (int id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+    if (jobs[id].active) continue;
+    
+    jobs[id].name = name;
+    jobs[id].callback = callback;
+    jobs[id].period = periodMs;
+    jobs[id].deadline = millis() + delayMs;
+    jobs[id].active = true;
+    jobs[id].generation++;
+    jobs[id].runs = 0;
+    jobs[id].totalMicros = 0;
+    jobs[id].maxMicros = 0;
+    heapInsert(id);
+    return id;
+  }
+  
+  Serial.println("Scheduler: no free slot for " + String(name));
+  return SCHEDULER_NO_JOB;
+}
+
+int scheduleEvery(const char* name, unsigned long periodMs, JobCallback callback, unsigned long firstDelayMs) {
+  if (periodMs == 0) periodMs = 1;
+  return addJob(name, periodMs, firstDelayMs, callback);
+}
+
+int scheduleOnce(const char* name, unsigned long delayMs, JobCallback callback) {
+  return addJob(name, 0, delayMs, callback);
+}
+
+void rescheduleJob(int id, unsigned long delayMs) {
+  if (!isValidJob(id)) return;
+  heapRemove(id);
+  jobs[id].deadline = millis() + delayMs;
+  heapInsert(id);
+}
+
+// Новый период; если срок по нему наступает раньше текущего - переносится
+void setJobPeriod(int id, unsigned long periodMs) {
+  if (!isValidJob(id) || jobs[id].period == 0 || periodMs == 0) return;
+  jobs[id].period = periodMs;
+  
+  unsigned long deadline = millis() + periodMs;
+  if (isEarlier(deadline, jobs[id].deadline)) {
+    heapRemove(id);
+    jobs[id].deadline = deadline;
+    heapInsert(id);
+  }
+}
+
+void cancelJob(int id) {
+  if (!isValidJob(id)) return;
+  heapRemove(id);
+  jobs[id].active = false;
+  jobs[id].callback = nullptr;
+}
+
+void runDueJobs() {
+  while (heapSize > 0) {
+    int id = heap[0];
+    Job& job = jobs[id];
+    unsigned long now = millis();
+    if (isEarlier(now, job.deadline)) break;
+    
+    // Задание снимается с кучи до вызова, чтобы оно могло переназначить себя
+    heapRemove(id);
+    JobCallback callback = job.callback;
+    uint32_t generation = job.generation;
+    if (job.period > 0) {
+      // Фиксированный шаг; после долгой блокировки пропущенные сроки не догоняются
+      job.deadline += job.period;
+      if (isEarlier(job.deadline, now)) job.deadline = now + job.period;
+      heapInsert(id);
+    } else {
+      job.active = false;
+      job.callback = nullptr;
+    }
+    
+    unsigned long start = micros();
+    callback();
+    uint32_t elapsed = micros() - start;
+    
+    // Слот мог освободиться и достаться новому заданию прямо из callback
+    if (job.generation != generation) continue;
+    job.runs++;
+    job.totalMicros += elapsed;
+    if (elapsed > job.maxMicros) job.maxMicros = elapsed;
+  }
+}
+
+unsigned long msUntilNextJob() {
+  if (heapSize == 0) return SCHEDULER_MAX_SLEEP_MS;
+  
+  unsigned long now = millis();
+  unsigned long deadline = jobs[heap[0]].deadline;
+  if (!isEarlier(now, deadline)) return 0;
+  
+  unsigned long wait = deadline - now;
+  return wait < SCHEDULER_MAX_SLEEP_MS ? wait : SCHEDULER_MAX_SLEEP_MS;
+}
+
+// vTaskDelay отдает процессор другим задачам и idle-задаче вместо холостого цикла
+void sleepUntilNextJob() {
+  unsigned long wait = msUntilNextJob();
+  if (wait == 0) return;
+  
+  unsigned long start = micros();
+  vTaskDelay(pdMS_TO_TICKS(wait));
+  sleepMicros += micros() - start;
+}
+
+bool getJobStats(int id, JobStats* out) {
+  if (!isValidJob(id)) return false;
+  out->name = jobs[id].name;
+  out->period = jobs[id].period;
+  out->runs = jobs[id].runs;
+  out->totalMicros = jobs[id].totalMicros;
+  out->maxMicros = jobs[id].maxMicros;
+  return true;
+}
+
+uint64_t schedulerSleepMicros() {
+  return sleepMicros;
+}
@@ -0,0 +1,36 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include <functional>
+
+// Кооперативный планировщик на min-heap по сроку выполнения.
+// Задания выполняются только из loop(), между ними задача спит
+#define SCHEDULER_MAX_JOBS 16
+#define SCHEDULER_MAX_SLEEP_MS 1000
+#define SCHEDULER_NO_JOB -1
+
+typedef std::function<void()> JobCallback;
+
+struct JobStats {
+  const char* name;
+  unsigned long period;
+  uint32_t runs;
+  uint64_t totalMicros;
+  uint32_t maxMicros;
+};
+
+int scheduleEvery(const char* name, unsigned long periodMs, JobCallback callback, unsigned long firstDelayMs = 0);
+int scheduleOnce(const char* name, unsigned long delayMs, JobCallback callback);
+void rescheduleJob(int id, unsigned long delayMs);
+void setJobPeriod(int id, unsigned long periodMs);
+void cancelJob(int id);
+
+void runDueJobs();
+unsigned long msUntilNextJob();
+void sleepUntilNextJob();
+
+bool getJobStats(int id, JobStats* out);
+uint64_t schedulerSleepMicros();
+
+#endif
@@ -0,0 +1,259 @@
+#include "securities_index.h"
+#include "config.h"
+#include "log_ring.h"
+#include "quote_provider.h"
+#include "upstream.h"
+#include "fetch_pool.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+struct SecurityIndexHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+};
+
+#define INDEX_REFRESH_IDLE 0
+#define INDEX_REFRESH_RUNNING 1
+#define INDEX_REFRESH_DONE 2
+#define INDEX_REFRESH_FAILED 3
+
+// indexCount пишет задача загрузки, читает loop
+static uint16_t indexCount = 0;
+static int refreshState = INDEX_REFRESH_IDLE;
+static unsigned long lastRefreshTime = 0;
+static unsigned long nextRefreshDelay = 0;
+static bool refreshAttempted = false;
+
+// Копирование с обрезкой, не разрывая многобайтовые символы UTF-8
+static void copyField(char* dest, size_t size, const char* src) {
+  size_t len = src ? strlen(src) : 0;
+  if (len >= size) {
+    len = size - 1;
+    while (len > 0 && ((uint8_t)src[len] & 0xC0) == 0x80) len--;
+  }
+  if (len > 0) memcpy(dest, src, len);
+  dest[len] = '\0';
+}
+
+static int compareRecords(const void* a, const void* b) {
+  return strcmp(((const SecurityRecord*)a)->symbol, ((const SecurityRecord*)b)->symbol);
+}
+
+static bool readRecord(File& file, int index, SecurityRecord* record) {
+  if (!file.seek(sizeof(SecurityIndexHeader) + (size_t)index * sizeof(SecurityRecord))) return false;
+  return file.read((uint8_t*)record, sizeof(SecurityRecord)) == sizeof(SecurityRecord);
+}
+
+// Первая запись, символ которой не меньше key (по первым keyLen символам)
+static int lowerBound(File& file, const char* key, size_t keyLen) {
+  int lo = 0;
+  int hi = indexCount;
+  SecurityRecord record;
+  
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (!readRecord(file, mid, &record)) return indexCount;
+    if (strncmp(record.symbol, key, keyLen) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  
+  return lo;
+}
+
+void initSecuritiesIndex() {
+  indexCount = 0;
+  // Остаток обновления, прерванного до переименования
+  if (LittleFS.exists(SECURITIES_INDEX_TMP_PATH)) LittleFS.remove(SECURITIES_INDEX_TMP_PATH);
+  
+  File file = LittleFS.open(SECURITIES_INDEX_PATH, "r");
+  if (!file) return;
+  
+  SecurityIndexHeader header;
+  if (file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+      header.magic == SECURITIES_INDEX_MAGIC && header.version == SECURITIES_INDEX_VERSION &&
+      file.size() == sizeof(header) + (size_t)header.count * sizeof(SecurityRecord)) {
+    indexCount = header.count;
+  }
+  file.close();
+  
+  logEvent(LOG_INDEX_LOADED, "", indexCount);
+}
+
+static bool refreshSecuritiesIndex() {
+  if (WiFi.status() != WL_CONNECTED) return false;
+  
+  SecurityRecord* records = (SecurityRecord*)malloc(SECURITIES_INDEX_MAX_ENTRIES * sizeof(SecurityRecord));
+  if (records == NULL) return false;
+  
+  QuoteProvider& provider = quoteProvider(MARKET_SHARES);
+  String path = String(provider.path()) + "/boards/" + provider.board() +
+                "/securities.json?iss.meta=off&iss.only=securities&securities.columns=SECID,SHORTNAME,BOARDID,DECIMALS";
+  
+  unsigned long startTime = millis();
+  int upstream = preferredUpstream();
+  HTTPClient http;
+  int httpCode = upstreamGet(http, upstream, path);
+  
+  int count = 0;
+  if (httpCode == HTTP_CODE_OK) {
+    Stream& stream = http.getStream();
+    
+    // ISS отдает выбранные столбцы в порядке таблицы, а не запроса: номера по именам
+    int symbolColumn = -1;
+    int nameColumn = -1;
+    int boardColumn = -1;
+    int decimalsColumn = -1;
+    if (stream.find("\"columns\"") && stream.find(":")) {
+      JsonDocument columns;
+      if (!deserializeJson(columns, stream)) {
+        int index = 0;
+        for (JsonVariantConst column : columns.as<JsonArrayConst>()) {
+          const char* name = column | "";
+          if (strcmp(name, "SECID") == 0) symbolColumn = index;
+          else if (strcmp(name, "SHORTNAME") == 0) nameColumn = index;
+          else if (strcmp(name, "BOARDID") == 0) boardColumn = index;
+          else if (strcmp(name, "DECIMALS") == 0) decimalsColumn = index;
+          index++;
+        }
+      }
+    }
+    
+    // Строки "data" разбираются по одной, весь ответ в память не попадает
+    if (symbolColumn >= 0 && stream.find("\"data\"") && stream.find("[")) {
+      JsonDocument row;
+      do {
+        if (deserializeJson(row, stream)) break;
+        
+        const char* symbol = row[symbolColumn];
+        if (symbol == NULL || strlen(symbol) >= sizeof(records[0].symbol)) continue;
+        
+        SecurityRecord& record = records[count];
+        memset(&record, 0, sizeof(record));
+        copyField(record.symbol, sizeof(record.symbol), symbol);
+        if (nameColumn >= 0) copyField(record.shortName, sizeof(record.shortName), row[nameColumn].as<const char*>());
+        if (boardColumn >= 0) copyField(record.board, sizeof(record.board), row[boardColumn].as<const char*>());
+        record.decimals = decimalsColumn >= 0 ? (row[decimalsColumn] | 2) : 2;
+        count++;
+      } while (count < SECURITIES_INDEX_MAX_ENTRIES && stream.findUntil(",", "]"));
+    }
+  }
+  http.end();
+  recordUpstreamResult(upstream, httpCode == HTTP_CODE_OK, millis() - startTime);
+  
+  if (count == 0) {
+    free(records);
+    logEvent(LOG_INDEX_REFRESH_FAILED, "", httpCode);
+    return false;
+  }
+  
+  qsort(records, count, sizeof(SecurityRecord), compareRecords);
+  
+  // Запись во временный файл и переименование поверх старого, чтобы не
+  // оставить битый индекс: LittleFS заменяет файл атомарно
+  File file = LittleFS.open(SECURITIES_INDEX_TMP_PATH, "w");
+  bool ok = false;
+  if (file) {
+    SecurityIndexHeader header = { SECURITIES_INDEX_MAGIC, SECURITIES_INDEX_VERSION, (uint16_t)count };
+    ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+         file.write((const uint8_t*)records, count * sizeof(SecurityRecord)) == count * sizeof(SecurityRecord);
+    file.close();
+  }
+  free(records);
+  
+  if (!ok || !LittleFS.rename(SECURITIES_INDEX_TMP_PATH, SECURITIES_INDEX_PATH)) {
+    LittleFS.remove(SECURITIES_INDEX_TMP_PATH);
+    return false;
+  }
+  
+  __atomic_store_n(&indexCount, (uint16_t)count, __ATOMIC_RELEASE);
+  logEvent(LOG_INDEX_REFRESHED, "", count);
+  return true;
+}
+
+static int loadRefreshState() {
+  return __atomic_load_n(&refreshState, __ATOMIC_ACQUIRE);
+}
+
+static void storeRefreshState(int state) {
+  __atomic_store_n(&refreshState, state, __ATOMIC_RELEASE);
+}
+
+static void indexTask(void* arg) {
+  storeRefreshState(refreshSecuritiesIndex() ? INDEX_REFRESH_DONE : INDEX_REFRESH_FAILED);
+  vTaskDelete(NULL);
+}
+
+// Допуск как у загрузки графика, плюс буфер записей справочника
+static bool startIndexRefresh() {
+  if (ESP.getFreeHeap() < FETCH_HEAP_RESERVE + FETCH_TLS_HEAP_COST + SECURITIES_INDEX_TASK_STACK_SIZE +
+                          SECURITIES_INDEX_MAX_ENTRIES * sizeof(SecurityRecord) ||
+      ESP.getMaxAllocHeap() < FETCH_TLS_MAX_BLOCK) {
+    return false;
+  }
+  
+  storeRefreshState(INDEX_REFRESH_RUNNING);
+  if (xTaskCreate(indexTask, "secindex", SECURITIES_INDEX_TASK_STACK_SIZE, NULL,
+                  SECURITIES_INDEX_TASK_PRIORITY, NULL) != pdPASS) {
+    storeRefreshState(INDEX_REFRESH_IDLE);
+    return false;
+  }
+  return true;
+}
+
+// Обновление после загрузки, затем раз в сутки; после неудачи - повтор через 10 минут.
+// Не хватило кучи на запуск - попытка при следующем вызове
+void handleSecuritiesIndex() {
+  int state = loadRefreshState();
+  if (state == INDEX_REFRESH_RUNNING) return;
+  if (state != INDEX_REFRESH_IDLE) {
+    nextRefreshDelay = state == INDEX_REFRESH_DONE ? SECURITIES_INDEX_REFRESH_MS : SECURITIES_INDEX_RETRY_MS;
+    storeRefreshState(INDEX_REFRESH_IDLE);
+  }
+  
+  if (WiFi.status() != WL_CONNECTED) return;
+  if (refreshAttempted && millis() - lastRefreshTime < nextRefreshDelay) return;
+  if (!startIndexRefresh()) return;
+  
+  refreshAttempted = true;
+  lastRefreshTime = millis();
+}
+
+bool isSecuritiesIndexReady() {
+  return indexCount > 0;
+}
+
+bool findSecurity(const String& symbol, SecurityRecord* out) {
+  if (indexCount == 0 || symbol.length() == 0 || symbol.length() >= sizeof(out->symbol)) return false;
+  
+  File file = LittleFS.open(SECURITIES_INDEX_PATH, "r");
+  if (!file) return false;
+  
+  SecurityRecord record;
+  int pos = lowerBound(file, symbol.c_str(), sizeof(record.symbol));
+  bool found = pos < indexCount && readRecord(file, pos, &record) && symbol == record.symbol;
+  file.close();
+  
+  if (found && out) *out = record;
+  return found;
+}
+
+int searchSecurities(const String& prefix, SecurityRecord* out, int maxResults) {
+  if (indexCount == 0 || prefix.length() >= sizeof(out->symbol)) return 0;
+  
+  File file = LittleFS.open(SECURITIES_INDEX_PATH, "r");
+  if (!file) return 0;
+  
+  int count = 0;
+  int pos = lowerBound(file, prefix.c_str(), prefix.length());
+  while (pos < indexCount && count < maxResults && readRecord(file, pos, &out[count])) {
+    if (strncmp(out[count].symbol, prefix.c_str(), prefix.length()) != 0) break;
+    count++;
+    pos++;
+  }
+  file.close();
+  
+  return count;
+}
@@ -0,0 +1,33 @@
+#ifndef SECURITIES_INDEX_H
+#define SECURITIES_INDEX_H
+
+#include "config.h"
+
+// Отсортированный по символу справочник бумаг в LittleFS
+#define SECURITIES_INDEX_PATH "/securities.idx"
+#define SECURITIES_INDEX_TMP_PATH SECURITIES_INDEX_PATH ".tmp"
+#define SECURITIES_INDEX_MAGIC 0x58444953 // "SIDX"
+#define SECURITIES_INDEX_VERSION 1
+#define SECURITIES_INDEX_MAX_ENTRIES 600
+#define SECURITIES_INDEX_REFRESH_MS 86400000UL
+#define SECURITIES_INDEX_RETRY_MS 600000UL
+// Загрузка идет в своей задаче, как график: TLS и разбор не держат loop
+#define SECURITIES_INDEX_TASK_STACK_SIZE 8192
+#define SECURITIES_INDEX_TASK_PRIORITY 1
+
+// Запись фиксированной длины, чтобы искать по файлу двоичным поиском
+struct SecurityRecord {
+  char symbol[12];
+  char board[6];
+  uint8_t decimals;
+  uint8_t reserved;
+  char shortName[28];
+};
+
+void initSecuritiesIndex();
+void handleSecuritiesIndex();
+bool isSecuritiesIndexReady();
+bool findSecurity(const String& symbol, SecurityRecord* out);
+int searchSecurities(const String& prefix, SecurityRecord* out, int maxResults);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// Ядро Arduino-ESP32 для сборки прошивки на Linux. Время виртуальное:
+// millis()/delay() идут по часам симулятора, а не по системным
+#define ARDUINO 10819
+#define ESP32 1
+#define ARDUINO_ARCH_ESP32 1
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "binary.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+using std::abs;
+using std::max;
+using std::min;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define IRAM_ATTR
+#define ARDUINO_ISR_ATTR
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define F(s) (s)
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* dst, const char* src, size_t size);
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// Часы реального времени: после вызова идут от начала прогона в mock_iss
+void configTzTime(const char* tz, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+
+inline bool isAlphaNumeric(int c) { return isalnum(c) != 0; }
+inline bool isAlpha(int c) { return isalpha(c) != 0; }
+inline bool isDigit(int c) { return isdigit(c) != 0; }
+inline bool isSpace(int c) { return isspace(c) != 0; }
+inline bool isUpperCase(int c) { return isupper(c) != 0; }
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+uint32_t getCpuFrequencyMhz();
+
+// Аппаратный таймер: прерывание - событие в виртуальном времени
+struct hw_timer_s;
+typedef struct hw_timer_s hw_timer_t;
+
+hw_timer_t* timerBegin(uint32_t frequency);
+void timerEnd(hw_timer_t* timer);
+void timerAttachInterrupt(hw_timer_t* timer, void (*isr)(void));
+void timerDetachInterrupt(hw_timer_t* timer);
+void timerAlarm(hw_timer_t* timer, uint64_t alarmValue, bool autoreload, uint64_t reloadCount);
+void timerStart(hw_timer_t* timer);
+void timerStop(hw_timer_t* timer);
+void timerRestart(hw_timer_t* timer);
+
+class EspClass {
+public:
+  uint32_t getHeapSize();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint32_t getCpuFreqMHz() { return getCpuFrequencyMhz(); }
+  const char* getSdkVersion() { return "simulator"; }
+  uint64_t getEfuseMac();
+  // Перезагрузка завершает прогон: глобальное состояние прошивки не сбросить
+  [[noreturn]] void restart();
+};
+
+extern EspClass ESP;
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  void end() {}
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t value) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SIM_ARDUINOOTA_H
+#define SIM_ARDUINOOTA_H
+
+#include "Arduino.h"
+
+// Обновление по сети в симуляторе не принимается
+class ArduinoOTAClass {
+public:
+  ArduinoOTAClass& setPort(uint16_t port) { (void)port; return *this; }
+  ArduinoOTAClass& setHostname(const char* hostname) { (void)hostname; return *this; }
+  ArduinoOTAClass& setPassword(const char* password) { (void)password; return *this; }
+  void begin() {}
+  void end() {}
+  void handle() {}
+};
+
+extern ArduinoOTAClass ArduinoOTA;
+
+#endif
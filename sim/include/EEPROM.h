@@ -0,0 +1,40 @@
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+#include "Arduino.h"
+
+#define SIM_EEPROM_MAX_SIZE 4096
+
+// Образ EEPROM живет весь прогон; симулятор заполняет его до setup()
+class EEPROMClass {
+public:
+  bool begin(size_t size);
+  void end() {}
+  uint8_t read(int address);
+  void write(int address, uint8_t value);
+  bool commit();
+  uint16_t length() { return size; }
+  uint8_t* getDataPtr() { return data; }
+
+  template <typename T>
+  T& get(int address, T& value) {
+    for (size_t i = 0; i < sizeof(T); i++) ((uint8_t*)&value)[i] = read(address + i);
+    return value;
+  }
+  template <typename T>
+  const T& put(int address, const T& value) {
+    for (size_t i = 0; i < sizeof(T); i++) write(address + i, ((const uint8_t*)&value)[i]);
+    return value;
+  }
+
+  uint32_t commits() const { return commitCount; }
+
+private:
+  uint8_t data[SIM_EEPROM_MAX_SIZE] = {0};
+  size_t size = SIM_EEPROM_MAX_SIZE;
+  uint32_t commitCount = 0;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SIM_ESPMDNS_H
+#define SIM_ESPMDNS_H
+
+#include "Arduino.h"
+
+class MDNSResponder {
+public:
+  bool begin(const char* hostName) { (void)hostName; return true; }
+  void end() {}
+  void addService(const char*, const char*, uint16_t) {}
+};
+
+extern MDNSResponder MDNS;
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SIM_FS_H
+#define SIM_FS_H
+
+#include "Arduino.h"
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct SimFileNode;
+
+// Файл в памяти; содержимое общее для всех открытых дескрипторов
+class File : public Stream {
+public:
+  File() {}
+  File(std::shared_ptr<SimFileNode> node, const char* path, bool writable, bool append);
+
+  size_t write(uint8_t value) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush() override {}
+  size_t read(uint8_t* buf, size_t size);
+  size_t readBytes(char* buffer, size_t length) override { return read((uint8_t*)buffer, length); }
+  bool seek(uint32_t pos, SeekMode mode);
+  bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+  size_t position() const { return pos; }
+  size_t size() const;
+  void close();
+  const char* path() const { return filePath.c_str(); }
+  const char* name() const;
+  bool isDirectory() const { return false; }
+  operator bool() const { return node != nullptr; }
+
+private:
+  std::shared_ptr<SimFileNode> node;
+  String filePath;
+  size_t pos = 0;
+  bool writable = false;
+  bool append = false;
+};
+
+class FS {
+public:
+  File open(const char* path, const char* mode = FILE_READ, bool create = false);
+  File open(const String& path, const char* mode = FILE_READ, bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* pathFrom, const char* pathTo);
+  bool rename(const String& pathFrom, const String& pathTo) { return rename(pathFrom.c_str(), pathTo.c_str()); }
+  bool mkdir(const char* path) { (void)path; return true; }
+  bool mkdir(const String& path) { return mkdir(path.c_str()); }
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
+
+#endif
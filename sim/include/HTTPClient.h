@@ -0,0 +1,86 @@
+#ifndef SIM_HTTPCLIENT_H
+#define SIM_HTTPCLIENT_H
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include <string>
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_NOT_MODIFIED 304
+#define HTTP_CODE_NOT_FOUND 404
+#define HTTP_CODE_SERVICE_UNAVAILABLE 503
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#define HTTPCLIENT_DEFAULT_TCP_TIMEOUT 5000
+
+// Тело ответа макета целиком в памяти, читается как поток сокета
+class SimBodyStream : public Stream {
+public:
+  void assign(const std::string& data, uint32_t rate) {
+    body = data;
+    pos = 0;
+    bytesPerMs = rate;
+    pacedBytes = 0;
+  }
+  void clear() {
+    body.clear();
+    body.shrink_to_fit();
+    pos = 0;
+  }
+  size_t size() const { return body.size(); }
+
+  int available() override { return (int)(body.size() - pos); }
+  int read() override { return pos < body.size() ? (uint8_t)body[pos++] : -1; }
+  int peek() override { return pos < body.size() ? (uint8_t)body[pos] : -1; }
+  size_t readBytes(char* buffer, size_t length) override;
+  size_t write(uint8_t value) override { (void)value; return 0; }
+  using Print::write;
+
+private:
+  std::string body;
+  size_t pos = 0;
+  // Темп передачи соблюдает только readBytes
+  uint32_t bytesPerMs = 0;
+  uint64_t pacedBytes = 0;
+};
+
+// Запрос уходит в макет биржи (mock_iss.h); задача блокируется
+// на время задержки ответа в виртуальном времени
+class HTTPClient {
+public:
+  bool begin(const String& url);
+  void end();
+  void useHTTP10(bool usehttp10 = true) { http10 = usehttp10; }
+  void setTimeout(uint16_t timeout) { timeoutMs = timeout; }
+  void setConnectTimeout(int32_t timeout) { connectTimeoutMs = timeout; }
+  void setReuse(bool reuse) { (void)reuse; }
+  void addHeader(const String& name, const String& value) { (void)name; (void)value; }
+
+  int GET();
+  int getSize() { return (int)body.size(); }
+  bool connected() { return body.available() > 0; }
+  Stream& getStream() { return body; }
+  WiFiClient* getStreamPtr() { return NULL; }
+  String getString();
+  static String errorToString(int error);
+
+private:
+  String url;
+  SimBodyStream body;
+  bool http10 = false;
+  uint16_t timeoutMs = HTTPCLIENT_DEFAULT_TCP_TIMEOUT;
+  int32_t connectTimeoutMs = HTTPCLIENT_DEFAULT_TCP_TIMEOUT;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef SIM_IPADDRESS_H
+#define SIM_IPADDRESS_H
+
+#include "Print.h"
+
+class IPAddress : public Printable {
+public:
+  IPAddress() : IPAddress(0, 0, 0, 0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    octets[0] = a;
+    octets[1] = b;
+    octets[2] = c;
+    octets[3] = d;
+  }
+
+  uint8_t operator[](int index) const { return octets[index]; }
+  String toString() const;
+  size_t printTo(Print& p) const override { return p.print(toString()); }
+
+private:
+  uint8_t octets[4];
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef SIM_LITTLEFS_H
+#define SIM_LITTLEFS_H
+
+#include "FS.h"
+
+#define SIM_LITTLEFS_SIZE (1408 * 1024)
+
+namespace fs {
+
+class LittleFSFS : public FS {
+public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char* partitionLabel = "spiffs");
+  void end() {}
+  bool format();
+  size_t totalBytes() { return SIM_LITTLEFS_SIZE; }
+  size_t usedBytes();
+};
+
+}  // namespace fs
+
+extern fs::LittleFSFS LittleFS;
+
+#endif
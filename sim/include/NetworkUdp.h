@@ -0,0 +1,49 @@
+#ifndef SIM_NETWORKUDP_H
+#define SIM_NETWORKUDP_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+#define SIM_UDP_MAX_PACKET 1460
+
+// UDP поверх настоящих сокетов хоста: группа multicast на loopback,
+// так несколько запущенных симуляторов видят друг друга. Пакеты
+// ходят только пока станция подключена к сети
+class NetworkUDP : public Stream {
+public:
+  NetworkUDP() {}
+  ~NetworkUDP() { stop(); }
+
+  uint8_t beginMulticast(IPAddress address, uint16_t port);
+  void stop();
+
+  int beginMulticastPacket();
+  int endPacket();
+  size_t write(uint8_t value) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+
+  int parsePacket();
+  int available() override { return rxLength - rxPosition; }
+  int read() override { return available() > 0 ? rxBuffer[rxPosition++] : -1; }
+  int read(uint8_t* buffer, size_t length);
+  int peek() override { return available() > 0 ? rxBuffer[rxPosition] : -1; }
+  void flush() override { rxPosition = rxLength; }
+
+  IPAddress remoteIP() const { return remoteAddress; }
+  uint16_t remotePort() const { return remotePortNumber; }
+
+private:
+  int fd = -1;
+  IPAddress group;
+  uint16_t port = 0;
+  IPAddress remoteAddress;
+  uint16_t remotePortNumber = 0;
+  uint8_t txBuffer[SIM_UDP_MAX_PACKET];
+  int txLength = -1;
+  uint8_t rxBuffer[SIM_UDP_MAX_PACKET];
+  int rxLength = 0;
+  int rxPosition = 0;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+#include "Arduino.h"
+
+// NVS в памяти: пространства имен общие для всех экземпляров
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false);
+  void end();
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+
+  size_t putString(const char* key, const String& value);
+  size_t putInt(const char* key, int32_t value);
+  size_t putUInt(const char* key, uint32_t value);
+  size_t putULong(const char* key, uint32_t value) { return putUInt(key, value); }
+  size_t putBool(const char* key, bool value) { return putUInt(key, value ? 1 : 0); }
+  String getString(const char* key, const String& defaultValue = String());
+  int32_t getInt(const char* key, int32_t defaultValue = 0);
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+  uint32_t getULong(const char* key, uint32_t defaultValue = 0) { return getUInt(key, defaultValue); }
+  bool getBool(const char* key, bool defaultValue = false) { return getUInt(key, defaultValue ? 1 : 0) != 0; }
+
+  // Доступ сценария симулятора до setup()
+  static void preset(const char* name, const char* key, const char* value);
+
+private:
+  String space;
+  bool opened = false;
+  bool readOnly = false;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef SIM_PRINT_H
+#define SIM_PRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "WString.h"
+#include "Printable.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t value) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+  size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  size_t print(const String& s);
+  size_t print(const char str[]);
+  size_t print(char c);
+  size_t print(unsigned char value, int base = DEC);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(long long value, int base = DEC);
+  size_t print(unsigned long long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+  size_t print(const Printable& value);
+
+  size_t println(const String& s);
+  size_t println(const char str[]);
+  size_t println(char c);
+  size_t println(unsigned char value, int base = DEC);
+  size_t println(int value, int base = DEC);
+  size_t println(unsigned int value, int base = DEC);
+  size_t println(long value, int base = DEC);
+  size_t println(unsigned long value, int base = DEC);
+  size_t println(long long value, int base = DEC);
+  size_t println(unsigned long long value, int base = DEC);
+  size_t println(double value, int digits = 2);
+  size_t println(const Printable& value);
+  size_t println();
+
+private:
+  size_t printNumber(unsigned long long value, int base, bool negative);
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef SIM_STREAM_H
+#define SIM_STREAM_H
+
+#include "Print.h"
+
+// Потоки симулятора читают из памяти: пустой поток - конец данных,
+// ожидания таймаута нет
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { timeoutMs = timeout; }
+  unsigned long getTimeout() const { return timeoutMs; }
+
+  bool find(const char* target);
+  bool find(char target) { return find(&target, 1); }
+  bool find(const char* target, size_t length);
+  bool findUntil(const char* target, const char* terminator);
+
+  virtual size_t readBytes(char* buffer, size_t length);
+  size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+  size_t readBytesUntil(char terminator, char* buffer, size_t length);
+  String readString();
+  String readStringUntil(char terminator);
+
+protected:
+  unsigned long timeoutMs = 1000;
+};
+
+#endif
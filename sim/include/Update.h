@@ -0,0 +1,40 @@
+#ifndef SIM_UPDATE_H
+#define SIM_UPDATE_H
+
+#include "Arduino.h"
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+#define UPDATE_ERROR_OK 0
+#define UPDATE_ERROR_WRITE 1
+#define UPDATE_ERROR_SPACE 4
+#define UPDATE_ERROR_SIZE 5
+#define UPDATE_ERROR_MAGIC_BYTE 8
+#define UPDATE_ERROR_BAD_ARGUMENT 11
+#define UPDATE_ERROR_ABORT 12
+
+// Неактивный раздел приложения: байты не хранятся, запись занимает
+// время стирания и программирования каждого сектора
+class UpdateClass {
+public:
+  bool begin(size_t size = UPDATE_SIZE_UNKNOWN);
+  size_t write(uint8_t* data, size_t length);
+  bool end(bool evenIfRemaining = false);
+  void abort();
+  bool isRunning() { return running; }
+  bool hasError() { return error != UPDATE_ERROR_OK; }
+  uint8_t getError() { return error; }
+  const char* errorString();
+  size_t size() { return imageSize; }
+  size_t progress() { return written; }
+
+private:
+  bool running = false;
+  uint8_t error = UPDATE_ERROR_OK;
+  size_t imageSize = 0;
+  size_t written = 0;
+};
+
+extern UpdateClass Update;
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef SIM_WSTRING_H
+#define SIM_WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// String ядра Arduino. Буфер берется из malloc, как на устройстве,
+// поэтому строки видны в учете кучи симулятора
+class StringSumHelper;
+
+class String {
+public:
+  String(const char* cstr = "");
+  String(const char* cstr, unsigned int length);
+  String(const String& str);
+  String(String&& str);
+  explicit String(char c);
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimalPlaces = 2);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+  ~String();
+
+  String& operator=(const String& rhs);
+  String& operator=(String&& rhs);
+  // NULL освобождает буфер (так очищает строку ArduinoJson)
+  String& operator=(const char* cstr);
+
+  bool reserve(unsigned int size);
+  unsigned int length() const { return len; }
+  bool isEmpty() const { return len == 0; }
+  const char* c_str() const { return buffer ? buffer : ""; }
+
+  bool concat(const String& str);
+  bool concat(const char* cstr);
+  bool concat(const char* cstr, unsigned int length);
+  bool concat(const uint8_t* cstr, unsigned int length) { return concat((const char*)cstr, length); }
+  bool concat(char c);
+  bool concat(unsigned char value);
+  bool concat(int value);
+  bool concat(unsigned int value);
+  bool concat(long value);
+  bool concat(unsigned long value);
+  bool concat(long long value);
+  bool concat(unsigned long long value);
+  bool concat(float value);
+  bool concat(double value);
+
+  template <typename T>
+  String& operator+=(const T& rhs) {
+    concat(rhs);
+    return *this;
+  }
+
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, const String& rhs);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, const char* cstr);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, char c);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, unsigned char num);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, int num);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, unsigned int num);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, long num);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, unsigned long num);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, long long num);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, unsigned long long num);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, float num);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, double num);
+
+  int compareTo(const String& s) const;
+  bool equals(const String& s) const;
+  bool equals(const char* cstr) const;
+  bool equalsIgnoreCase(const String& s) const;
+  bool operator==(const String& rhs) const { return equals(rhs); }
+  bool operator==(const char* cstr) const { return equals(cstr); }
+  bool operator!=(const String& rhs) const { return !equals(rhs); }
+  bool operator!=(const char* cstr) const { return !equals(cstr); }
+  bool operator<(const String& rhs) const { return compareTo(rhs) < 0; }
+  bool operator>(const String& rhs) const { return compareTo(rhs) > 0; }
+  bool startsWith(const String& prefix) const;
+  bool startsWith(const String& prefix, unsigned int offset) const;
+  bool endsWith(const String& suffix) const;
+
+  char charAt(unsigned int index) const;
+  void setCharAt(unsigned int index, char c);
+  char operator[](unsigned int index) const;
+  char& operator[](unsigned int index);
+  void toCharArray(char* buf, unsigned int bufsize, unsigned int index = 0) const;
+
+  int indexOf(char ch, unsigned int fromIndex = 0) const;
+  int indexOf(const String& str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char ch) const;
+  int lastIndexOf(char ch, unsigned int fromIndex) const;
+  int lastIndexOf(const String& str) const;
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, len); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void replace(char find, char replace);
+  void replace(const String& find, const String& replace);
+  void remove(unsigned int index);
+  void remove(unsigned int index, unsigned int count);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+private:
+  char* buffer;
+  unsigned int capacity;
+  unsigned int len;
+
+  void invalidate();
+  bool grow(unsigned int size);
+  String& copy(const char* cstr, unsigned int length);
+};
+
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String& s) : String(s) {}
+  StringSumHelper(const char* p) : String(p) {}
+  StringSumHelper(char c) : String(c) {}
+  StringSumHelper(int num) : String(num) {}
+  StringSumHelper(unsigned int num) : String(num) {}
+  StringSumHelper(long num) : String(num) {}
+  StringSumHelper(unsigned long num) : String(num) {}
+  StringSumHelper(float num) : String(num) {}
+  StringSumHelper(double num) : String(num) {}
+};
+
+inline bool operator==(const char* lhs, const String& rhs) { return rhs.equals(lhs); }
+inline bool operator!=(const char* lhs, const String& rhs) { return !rhs.equals(lhs); }
+
+#endif
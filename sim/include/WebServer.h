@@ -0,0 +1,112 @@
+#ifndef SIM_WEBSERVER_H
+#define SIM_WEBSERVER_H
+
+#include "Arduino.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum HTTPMethod {
+  HTTP_ANY,
+  HTTP_GET,
+  HTTP_HEAD,
+  HTTP_POST,
+  HTTP_PUT,
+  HTTP_PATCH,
+  HTTP_DELETE,
+  HTTP_OPTIONS
+};
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+
+class WebServer;
+
+class RequestHandler {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+  typedef std::function<bool(WebServer&)> FilterFunction;
+
+  RequestHandler(const String& uri, HTTPMethod method, THandlerFunction handler)
+    : uri(uri), method(method), handler(handler) {}
+  RequestHandler& setFilter(FilterFunction filter) {
+    this->filter = filter;
+    return *this;
+  }
+
+private:
+  friend class WebServer;
+  String uri;
+  HTTPMethod method;
+  THandlerFunction handler;
+  FilterFunction filter;
+};
+
+// Запросы не приходят из сети: их подает сценарий симулятора
+// (--request), handleClient() обрабатывает один наступивший запрос
+class WebServer {
+public:
+  typedef RequestHandler::THandlerFunction THandlerFunction;
+
+  explicit WebServer(int port = 80) : port(port) {}
+
+  void begin() { started = true; }
+  void stop() { started = false; }
+  void handleClient();
+
+  RequestHandler& on(const String& uri, THandlerFunction handler) { return on(uri, HTTP_ANY, handler); }
+  RequestHandler& on(const String& uri, HTTPMethod method, THandlerFunction handler);
+  void onNotFound(THandlerFunction handler) { notFoundHandler = handler; }
+
+  String uri() const { return currentUri; }
+  HTTPMethod method() const { return currentMethod; }
+  String arg(const String& name) const;
+  String arg(int index) const;
+  String argName(int index) const;
+  int args() const { return (int)currentArgs.size(); }
+  bool hasArg(const String& name) const;
+
+  void collectHeaders(const char* headerKeys[], size_t headerKeysCount);
+  String header(const String& name) const;
+  bool hasHeader(const String& name) const;
+
+  void send(int code, const char* contentType = NULL, const String& content = String());
+  void send(int code, char* contentType, const String& content) { send(code, (const char*)contentType, content); }
+  void send(int code, const String& contentType, const String& content) { send(code, contentType.c_str(), content); }
+  void send(int code, const char* contentType, const char* content);
+  void send_P(int code, PGM_P contentType, PGM_P content);
+  void send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength);
+  void sendHeader(const String& name, const String& value, bool first = false);
+  void setContentLength(size_t length) { contentLength = length; }
+  void sendContent(const String& content) { sendContent(content.c_str(), content.length()); }
+  void sendContent(const char* content, size_t size);
+  void sendContent_P(PGM_P content) { sendContent(content, strlen(content)); }
+
+private:
+  typedef std::vector<std::pair<std::string, std::string> > Fields;
+
+  int port;
+  bool started = false;
+  std::vector<std::unique_ptr<RequestHandler> > handlers;
+  THandlerFunction notFoundHandler;
+
+  String currentUri;
+  HTTPMethod currentMethod = HTTP_GET;
+  Fields currentArgs;
+  Fields currentHeaders;
+  std::vector<std::string> collectedHeaders;
+
+  size_t contentLength = CONTENT_LENGTH_NOT_SET;
+  int responseCode = 0;
+  size_t responseBytes = 0;
+  bool responseChunked = false;
+  Fields responseHeaders;
+
+  void beginResponse(int code, const char* contentType, size_t length);
+  void transmit(const char* data, size_t size);
+  static const std::string* findField(const Fields& fields, const char* name);
+};
+
+#endif
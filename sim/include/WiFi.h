@@ -0,0 +1,67 @@
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+#include "Arduino.h"
+#include "esp_wifi.h"
+#include "IPAddress.h"
+
+#define WIFI_OFF WIFI_MODE_NULL
+#define WIFI_STA WIFI_MODE_STA
+#define WIFI_AP WIFI_MODE_AP
+#define WIFI_AP_STA WIFI_MODE_APSTA
+
+typedef enum {
+  WL_NO_SHIELD = 255,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+// Канал до точки доступа описан сценарием (sim_net.cpp): ассоциация,
+// обрывы по расписанию и автоматическое переподключение
+class WiFiClass {
+public:
+  wl_status_t begin(const char* ssid, const char* passphrase = NULL);
+  wl_status_t status();
+  bool disconnect(bool wifiOff = false);
+  bool mode(wifi_mode_t mode);
+  wifi_mode_t getMode();
+  bool setSleep(bool enabled) { return setSleep(enabled ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE); }
+  bool setSleep(wifi_ps_type_t sleepType);
+  wifi_ps_type_t getSleep();
+  bool softAP(const char* ssid, const char* passphrase = NULL);
+  IPAddress softAPIP();
+  IPAddress localIP();
+  String SSID();
+  int8_t RSSI();
+};
+
+extern WiFiClass WiFi;
+
+// TCP-клиент: соединяется только с потоком котировок из сценария
+// (--stream, sim_net.cpp), остальные адреса отклоняются
+class WiFiClient : public Stream {
+public:
+  virtual ~WiFiClient() {}
+  virtual int connect(const char* host, uint16_t port);
+  virtual void stop();
+  virtual uint8_t connected();
+  int available() override;
+  int read() override;
+  int peek() override;
+  virtual int read(uint8_t* buf, size_t size);
+  size_t write(uint8_t value) override { return write(&value, 1); }
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+  operator bool() { return connected(); }
+
+private:
+  // Номер соединения потока, 0 - не подключен
+  uint32_t sessionId = 0;
+};
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef SIM_WIFICLIENTSECURE_H
+#define SIM_WIFICLIENTSECURE_H
+
+#include "WiFi.h"
+
+class WiFiClientSecure : public WiFiClient {
+public:
+  void setInsecure() {}
+  void setCACert(const char* rootCA) { (void)rootCA; }
+};
+
+#endif
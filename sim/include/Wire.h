@@ -0,0 +1,28 @@
+#ifndef SIM_WIRE_H
+#define SIM_WIRE_H
+
+#include "Arduino.h"
+
+#define SIM_WIRE_BUFFER_SIZE 128
+
+// Шина I2C 100 кГц: транзакция занимает время передачи всех байт,
+// байты для PCF8574 дисплея разбираются моделью HD44780 (sim_lcd.h)
+class TwoWire {
+public:
+  bool begin() { return true; }
+  bool setClock(uint32_t frequency) { clockHz = frequency; return true; }
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t value);
+  size_t write(const uint8_t* data, size_t size);
+  uint8_t endTransmission(bool sendStop = true);
+
+private:
+  uint32_t clockHz = 100000;
+  uint8_t address = 0;
+  uint8_t buffer[SIM_WIRE_BUFFER_SIZE];
+  size_t length = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
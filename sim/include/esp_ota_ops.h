@@ -0,0 +1,29 @@
+#ifndef SIM_ESP_OTA_OPS_H
+#define SIM_ESP_OTA_OPS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+  ESP_OTA_IMG_NEW = 0,
+  ESP_OTA_IMG_PENDING_VERIFY = 1,
+  ESP_OTA_IMG_VALID = 2,
+  ESP_OTA_IMG_INVALID = 3,
+  ESP_OTA_IMG_ABORTED = 4,
+  ESP_OTA_IMG_UNDEFINED = -1
+} esp_ota_img_states_t;
+
+typedef struct {
+  const char* label;
+  uint32_t address;
+  uint32_t size;
+} esp_partition_t;
+
+// Загруженный образ ждет подтверждения, если прогон запущен с --pending-image
+const esp_partition_t* esp_ota_get_running_partition();
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state);
+esp_err_t esp_ota_mark_app_valid_cancel_rollback();
+// Откат - перезагрузка, она завершает прогон
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot();
+
+#endif
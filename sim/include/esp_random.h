@@ -0,0 +1,11 @@
+#ifndef SIM_ESP_RANDOM_H
+#define SIM_ESP_RANDOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Детерминированный генератор: прогон с тем же --seed повторяется побайтно
+uint32_t esp_random();
+void esp_fill_random(void* buf, size_t len);
+
+#endif
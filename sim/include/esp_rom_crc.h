@@ -0,0 +1,9 @@
+#ifndef SIM_ESP_ROM_CRC_H
+#define SIM_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// CRC32 как у gzip и zlib: esp_rom_crc32_le(0, ...) == crc32(0, ...)
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const* buf, uint32_t len);
+
+#endif
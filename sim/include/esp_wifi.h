@@ -0,0 +1,22 @@
+#ifndef SIM_ESP_WIFI_H
+#define SIM_ESP_WIFI_H
+
+#include "esp_err.h"
+
+typedef enum {
+  WIFI_MODE_NULL = 0,
+  WIFI_MODE_STA,
+  WIFI_MODE_AP,
+  WIFI_MODE_APSTA
+} wifi_mode_t;
+
+typedef enum {
+  WIFI_PS_NONE,
+  WIFI_PS_MIN_MODEM,
+  WIFI_PS_MAX_MODEM
+} wifi_ps_type_t;
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t* type);
+
+#endif
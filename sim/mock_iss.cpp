@@ -0,0 +1,341 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <vector>
+#include "mock_iss.h"
+
+#define MS_PER_MINUTE 60000ULL
+// Виртуальное время 0 - 10:00 пятницы 17.10.2025; сессия 07:00-23:50
+#define SIM_START_EPOCH 1760695200LL
+#define SESSION_OPEN_MINUTE 420
+#define SESSION_CLOSE_MINUTE 1430
+#define CANDLES_PAGE_SIZE 500
+
+struct MockSecurity {
+  const char* symbol;
+  const char* shortName;
+  double price;
+  int decimals;
+  // Для облигаций, валюты и фьючерсов: рынок в адресе, режим торгов
+  // и запасной столбец цены; у акций NULL (TQBR)
+  const char* path;
+  const char* board;
+  const char* fallbackColumn;
+};
+
+// Основные бумаги TQBR: цены порядка реальных, чтобы ширина строки была честной
+static const MockSecurity securities[] = {
+  {"AFLT", "Аэрофлот", 58.42, 2},
+  {"ALRS", "АЛРОСА ао", 51.37, 2},
+  {"CHMF", "СевСт-ао", 1163.4, 1},
+  {"GAZP", "ГАЗПРОМ ао", 127.55, 2},
+  {"GMKN", "ГМКНорНик", 119.86, 2},
+  {"LKOH", "ЛУКОЙЛ", 6925.5, 1},
+  {"MAGN", "ММК", 36.815, 3},
+  {"MGNT", "Магнит ао", 4501.5, 1},
+  {"MOEX", "МосБиржа", 178.35, 2},
+  {"MTSS", "МТС-ао", 221.7, 2},
+  {"NLMK", "НЛМК ао", 118.46, 2},
+  {"NVTK", "Новатэк ао", 1042.2, 1},
+  {"PLZL", "Полюс", 1842.6, 1},
+  {"ROSN", "Роснефть", 434.05, 2},
+  {"RUAL", "РУСАЛ ао", 31.525, 3},
+  {"SBER", "Сбербанк", 306.74, 2},
+  {"SBERP", "Сбербанк-п", 306.11, 2},
+  {"SNGS", "Сургнфгз", 23.165, 3},
+  {"TATN", "Татнфт 3ао", 617.3, 1},
+  {"VTBR", "ВТБ ао", 71.93, 2},
+  {"YDEX", "ЯНДЕКС", 3955.5, 1},
+  {"SU26238RMFS4", "ОФЗ 26238", 58.512, 3, "/markets/bonds/", "TQOB", "LCURRENTPRICE"},
+  {"SU26243RMFS4", "ОФЗ 26243", 70.145, 3, "/markets/bonds/", "TQOB", "LCURRENTPRICE"},
+  {"CNYRUB_TOM", "CNYRUB_TOM", 11.2345, 4, "/markets/selt/", "CETS", "WAPRICE"},
+  {"USD000UTSTOM", "USDRUB_TOM", 81.505, 4, "/markets/selt/", "CETS", "WAPRICE"},
+  {"SiZ5", "Si-12.25", 82500, 0, "/markets/forts/", "RFUD", "SETTLEPRICE"},
+  {"RIZ5", "RTS-12.25", 108150, 0, "/markets/forts/", "RFUD", "SETTLEPRICE"},
+};
+
+#define SECURITY_COUNT (sizeof(securities) / sizeof(securities[0]))
+
+enum UpstreamProfile { PROFILE_ISS, PROFILE_FLAKY, PROFILE_SLOW, PROFILE_CLOSED, PROFILE_DOWN };
+
+struct PriceState {
+  double price;
+  uint64_t updatedMs;
+};
+
+class IssUpstream : public MockUpstream {
+public:
+  IssUpstream(UpstreamProfile profile, uint64_t seed) : profile(profile), state(seed * 2654435761ULL + 1) {}
+
+  SimHttpResponse get(const std::string& url, uint64_t nowMs) override {
+    SimHttpResponse response;
+    response.status = 200;
+    response.latencyMs = latency();
+
+    if (profile == PROFILE_DOWN) {
+      response.status = 0;
+      return response;
+    }
+    if (profile == PROFILE_FLAKY) {
+      uint32_t roll = next() % 100;
+      if (roll < 10) {
+        response.status = 503;
+        response.body = "<html><body>Service Unavailable</body></html>";
+        return response;
+      }
+      if (roll < 15) response.latencyMs = 8000 + next() % 4000;
+    }
+
+    if (url.find("/boards/TQBR/securities.json") != std::string::npos) {
+      response.body = indexBody();
+    } else if (url.find("/candles.json") != std::string::npos) {
+      const MockSecurity* security = find(symbolFromUrl(url), url);
+      response.body = candlesBody(security, url, nowMs);
+    } else {
+      std::string symbol = symbolFromUrl(url);
+      // Неизвестная бумага: ISS отвечает 200 с пустыми таблицами
+      const MockSecurity* security = find(symbol, url);
+      double price = security ? priceAt(*security, nowMs) : 0;
+      response.body = security && security->path ? marketBody(security, price) : quoteBody(security, price);
+    }
+
+    // Оборванное соединение: тело приходит не полностью
+    if (profile == PROFILE_FLAKY && next() % 100 < 5) response.body.resize(response.body.size() / 2);
+    return response;
+  }
+
+  bool lastPrice(const std::string& symbol, uint64_t nowMs, std::string* last) override {
+    if (profile == PROFILE_DOWN || profile == PROFILE_CLOSED) return false;
+    const MockSecurity* security = find(symbol, "/markets/shares/");
+    if (security == NULL) return false;
+    char value[32];
+    snprintf(value, sizeof(value), "%.*f", security->decimals, priceAt(*security, nowMs));
+    *last = value;
+    return true;
+  }
+
+private:
+  UpstreamProfile profile;
+  uint64_t state;
+  std::map<std::string, PriceState> prices;
+
+  uint32_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (uint32_t)((state * 2685821657736338717ULL) >> 32);
+  }
+
+  double uniform() {
+    return (next() + 0.5) / 4294967296.0;
+  }
+
+  // Задержка ISS: 120-450 мс, изредка хвост в несколько секунд
+  uint32_t latency() {
+    if (profile == PROFILE_DOWN) return 3000;
+    if (profile == PROFILE_SLOW) return 1500 + next() % 4500;
+    if (next() % 100 == 0) return 2000 + next() % 3000;
+    return 120 + next() % 330;
+  }
+
+  static std::string symbolFromUrl(const std::string& url) {
+    size_t start = url.find("/securities/");
+    if (start == std::string::npos) return std::string();
+    start += strlen("/securities/");
+    size_t end = url.find_first_of("/.", start);
+    return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+  }
+
+  // Бумага ищется на своем рынке: запрос облигации к рынку акций пуст, как в ISS
+  static const MockSecurity* find(const std::string& symbol, const std::string& url) {
+    for (size_t i = 0; i < SECURITY_COUNT; i++) {
+      if (symbol != securities[i].symbol) continue;
+      const char* path = securities[i].path ? securities[i].path : "/markets/shares/";
+      if (url.find(path) != std::string::npos) return &securities[i];
+    }
+    return NULL;
+  }
+
+  // Случайное блуждание с шагом в минуту, считается лениво к моменту запроса
+  double priceAt(const MockSecurity& security, uint64_t nowMs) {
+    std::map<std::string, PriceState>::iterator it = prices.find(security.symbol);
+    if (it == prices.end()) {
+      PriceState initial = {security.price, nowMs};
+      it = prices.insert(std::make_pair(std::string(security.symbol), initial)).first;
+    }
+
+    PriceState& price = it->second;
+    uint64_t minutes = (nowMs - price.updatedMs) / MS_PER_MINUTE;
+    if (minutes > 0) {
+      // Сумма минутных шагов ~ N(0, sigma * sqrt(minutes)), sigma = 0.1%
+      double normal = sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+      price.price *= exp(0.001 * sqrt((double)minutes) * normal);
+      price.updatedMs += minutes * MS_PER_MINUTE;
+    }
+    return price.price;
+  }
+
+  std::string quoteBody(const MockSecurity* security, double price) {
+    std::string body =
+      "{\n\"securities\": {\"columns\": [\"SECID\", \"BOARDID\", \"SHORTNAME\", \"PREVPRICE\", \"DECIMALS\"], "
+      "\"data\": [";
+    std::string marketdata =
+      "\"marketdata\": {\"columns\": [\"SECID\", \"BOARDID\", \"BID\", \"BIDDEPTH\", \"OFFER\", \"OFFERDEPTH\", "
+      "\"SPREAD\", \"BIDDEPTHT\", \"OFFERDEPTHT\", \"OPEN\", \"LOW\", \"HIGH\", \"LAST\", \"LASTCHANGE\", "
+      "\"LASTCHANGEPRCNT\", \"QTY\", \"VALUE\", \"VALTODAY\", \"UPDATETIME\"], \"data\": [";
+
+    if (security) {
+      char row[512];
+      char last[32];
+      char bid[32];
+      char offer[32];
+      double tick = pow(10, -security->decimals);
+      snprintf(last, sizeof(last), "%.*f", security->decimals, price);
+      snprintf(bid, sizeof(bid), "%.*f", security->decimals, price - tick);
+      snprintf(offer, sizeof(offer), "%.*f", security->decimals, price + tick);
+      if (profile == PROFILE_CLOSED) strcpy(last, "null");
+
+      snprintf(row, sizeof(row), "[\"%s\", \"SMAL\", \"%s\", %.*f, %d], [\"%s\", \"TQBR\", \"%s\", %.*f, %d]",
+               security->symbol, security->shortName, security->decimals, security->price, security->decimals,
+               security->symbol, security->shortName, security->decimals, security->price, security->decimals);
+      body += row;
+
+      // Неполные лоты (SMAL) идут первыми - прошивка должна выбрать TQBR
+      snprintf(row, sizeof(row),
+               "[\"%s\", \"SMAL\", null, 0, null, 0, null, 0, 0, null, null, null, null, 0, 0, 0, 0, 0, null], "
+               "[\"%s\", \"TQBR\", %s, 1240, %s, 860, %g, 51210, 88470, %.*f, %s, %s, %s, %.*f, %.2f, 10, %.1f, "
+               "%.0f, \"14:32:07\"]",
+               security->symbol, security->symbol, bid, offer, tick, security->decimals, security->price, bid,
+               offer, last, security->decimals, price - security->price,
+               (price - security->price) / security->price * 100, price * 10, price * 1.8e6);
+      marketdata += row;
+    }
+
+    body += "]},\n";
+    body += marketdata;
+    body += "]}\n}";
+    return body;
+  }
+
+  // Облигации, валюта, фьючерсы: короткая таблица marketdata с запасным столбцом.
+  // Вне сессии LAST = null, а запасная цена (текущая, средневзвешенная, расчетная) есть
+  std::string marketBody(const MockSecurity* security, double price) {
+    char last[32];
+    char value[32];
+    char row[512];
+    snprintf(value, sizeof(value), "%.*f", security->decimals, price);
+    strcpy(last, profile == PROFILE_CLOSED ? "null" : value);
+
+    snprintf(row, sizeof(row),
+             "{\n\"marketdata\": {\"columns\": [\"SECID\", \"BOARDID\", \"OPEN\", \"LAST\", \"%s\", "
+             "\"UPDATETIME\"], \"data\": [[\"%s\", \"%s\", %.*f, %s, %s, \"14:32:07\"]]}\n}",
+             security->fallbackColumn, security->symbol, security->board, security->decimals, security->price, last,
+             value);
+    return row;
+  }
+
+  static long queryValue(const std::string& url, const char* name, long fallback) {
+    size_t pos = url.find(std::string(name) + "=");
+    if (pos == std::string::npos) return fallback;
+    return atol(url.c_str() + pos + strlen(name) + 1);
+  }
+
+  // Минутные цены сессии дня: свое зерно на бумагу и день, поэтому
+  // повторный запрос и следующая страница видят тот же ряд
+  static std::vector<double> sessionPath(const MockSecurity& security, long day) {
+    uint64_t seed = 1469598103934665603ULL ^ (uint64_t)(day + 1000);
+    for (const char* c = security.symbol; *c; c++) seed = (seed ^ (uint8_t)*c) * 1099511628211ULL;
+    std::vector<double> path;
+    double price = security.price;
+    for (int minute = SESSION_OPEN_MINUTE; minute < SESSION_CLOSE_MINUTE; minute++) {
+      seed ^= seed >> 12;
+      seed ^= seed << 25;
+      seed ^= seed >> 27;
+      double step = (double)((seed * 2685821657736338717ULL) >> 11) / 9007199254740992.0 - 0.5;
+      price *= 1 + step * 0.0035;
+      path.push_back(price);
+    }
+    return path;
+  }
+
+  static void formatTime(char* out, size_t size, long day, int minute, int second) {
+    time_t t = (time_t)(SIM_START_EPOCH - 10 * 3600 + day * 86400LL + minute * 60 + second);
+    struct tm parts;
+    gmtime_r(&t, &parts);
+    strftime(out, size, "%Y-%m-%d %H:%M:%S", &parts);
+  }
+
+  // Свечи от поздних к ранним (iss.reverse): текущий день до прошедшей
+  // минуты, за ним предыдущие; параметр candles.columns не поддержан
+  std::string candlesBody(const MockSecurity* security, const std::string& url, uint64_t nowMs) {
+    std::string body = "{\n\"candles\": {\n\t\"columns\": [\"open\", \"close\", \"high\", \"low\", \"value\", "
+                       "\"volume\", \"begin\", \"end\"], \n\t\"data\": [";
+    long interval = queryValue(url, "interval", 1);
+    long start = queryValue(url, "start", 0);
+    if (!security || (interval != 1 && interval != 10 && interval != 60)) return body + "\n\t]}\n}";
+
+    long minuteNow = 600 + (long)(nowMs / MS_PER_MINUTE);
+    long day = minuteNow / 1440;
+    long lastMinute = minuteNow % 1440; // свеча этой минуты еще не закрыта
+    const char* separator = "";
+    int written = 0;
+    long skipped = 0;
+    for (int days = 0; days < 5 && written < CANDLES_PAGE_SIZE; days++, day--, lastMinute = 1440) {
+      std::vector<double> path = sessionPath(*security, day);
+      int sessionEnd = lastMinute < SESSION_CLOSE_MINUTE ? (int)lastMinute : SESSION_CLOSE_MINUTE;
+      int first = sessionEnd - SESSION_OPEN_MINUTE - 1;
+      first -= first < 0 ? 0 : first % interval;
+      for (int offset = first; offset >= 0 && written < CANDLES_PAGE_SIZE; offset -= interval) {
+        if (skipped++ < start) continue;
+        double open = path[offset], close = open, high = open, low = open;
+        for (int i = offset; i < offset + interval && i + SESSION_OPEN_MINUTE < sessionEnd; i++) {
+          close = path[i];
+          if (close > high) high = close;
+          if (close < low) low = close;
+        }
+        char begin[24];
+        char end[24];
+        char row[256];
+        int minute = SESSION_OPEN_MINUTE + offset;
+        formatTime(begin, sizeof(begin), day, minute, 0);
+        formatTime(end, sizeof(end), day, minute + (int)interval - 1, 59);
+        snprintf(row, sizeof(row), "%s\n\t[%.*f, %.*f, %.*f, %.*f, %.1f, %d, \"%s\", \"%s\"]", separator,
+                 security->decimals, open, security->decimals, close, security->decimals, high,
+                 security->decimals, low, close * 1200, 1200, begin, end);
+        body += row;
+        separator = ",";
+        written++;
+      }
+    }
+    return body + "\n\t]}\n}";
+  }
+
+  // Столбцы из securities.columns ISS отдает в порядке таблицы, а не запроса
+  static std::string indexBody() {
+    std::string body =
+      "{\n\"securities\": {\n\t\"columns\": [\"SECID\", \"BOARDID\", \"SHORTNAME\", \"DECIMALS\"], \n\t\"data\": [\n";
+    const char* separator = "";
+    for (size_t i = 0; i < SECURITY_COUNT; i++) {
+      if (securities[i].path) continue;
+      char row[128];
+      snprintf(row, sizeof(row), "%s\t[\"%s\", \"TQBR\", \"%s\", %d]", separator, securities[i].symbol,
+               securities[i].shortName, securities[i].decimals);
+      body += row;
+      separator = ",\n";
+    }
+    body += "\n]}}";
+    return body;
+  }
+};
+
+MockUpstream* createUpstream(const char* name, uint64_t seed) {
+  if (strcmp(name, "iss") == 0) return new IssUpstream(PROFILE_ISS, seed);
+  if (strcmp(name, "flaky") == 0) return new IssUpstream(PROFILE_FLAKY, seed);
+  if (strcmp(name, "slow") == 0) return new IssUpstream(PROFILE_SLOW, seed);
+  if (strcmp(name, "closed") == 0) return new IssUpstream(PROFILE_CLOSED, seed);
+  if (strcmp(name, "down") == 0) return new IssUpstream(PROFILE_DOWN, seed);
+  return NULL;
+}
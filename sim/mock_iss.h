@@ -0,0 +1,37 @@
+#ifndef MOCK_ISS_H
+#define MOCK_ISS_H
+
+#include <stdint.h>
+#include <string>
+
+// Ответ макета: status <= 0 - соединение отклонено, задержка больше
+// таймаута клиента превращается в HTTPC_ERROR_READ_TIMEOUT. bytesPerMs -
+// скорость передачи тела, 0 - тело приходит сразу
+struct SimHttpResponse {
+  int status;
+  std::string body;
+  uint32_t latencyMs;
+  uint32_t bytesPerMs = 0;
+};
+
+// Макет ISS Московской биржи: отвечает на запросы прошивки
+// в том же формате JSON, что и iss.moex.com
+class MockUpstream {
+public:
+  virtual ~MockUpstream() {}
+  virtual SimHttpResponse get(const std::string& url, uint64_t nowMs) = 0;
+  // Цена LAST акции TQBR для потока котировок, false - цены нет
+  virtual bool lastPrice(const std::string& symbol, uint64_t nowMs, std::string* last) {
+    (void)symbol;
+    (void)nowMs;
+    (void)last;
+    return false;
+  }
+};
+
+// iss - нормальная биржа, flaky - 503, таймауты и обрезанный JSON,
+// slow - долгие ответы, closed - торги закрыты (LAST = null), down - нет ответа.
+// NULL - неизвестное имя
+MockUpstream* createUpstream(const char* name, uint64_t seed);
+
+#endif
@@ -0,0 +1,630 @@
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <base64.h>
+#include <esp_random.h>
+#include <stdarg.h>
+#include "sim_core.h"
+#include "sim_kernel.h"
+
+FILE* simSerialOut = NULL;
+HardwareSerial Serial;
+EspClass ESP;
+
+// ---- String ----
+
+String::String(const char* cstr) : buffer(NULL), capacity(0), len(0) {
+  if (cstr) copy(cstr, strlen(cstr));
+}
+
+String::String(const char* cstr, unsigned int length) : buffer(NULL), capacity(0), len(0) {
+  if (cstr) copy(cstr, length);
+}
+
+String::String(const String& str) : buffer(NULL), capacity(0), len(0) {
+  copy(str.c_str(), str.len);
+}
+
+String::String(String&& str) : buffer(str.buffer), capacity(str.capacity), len(str.len) {
+  str.buffer = NULL;
+  str.capacity = 0;
+  str.len = 0;
+}
+
+String::String(char c) : buffer(NULL), capacity(0), len(0) {
+  copy(&c, 1);
+}
+
+static String formatInteger(long long value, unsigned char base) {
+  char buf[8 * sizeof(long long) + 2];
+  char* p = buf + sizeof(buf) - 1;
+  *p = '\0';
+  bool negative = value < 0 && base == 10;
+  unsigned long long v = negative ? -(unsigned long long)value : (unsigned long long)value;
+  do {
+    int digit = v % base;
+    *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    v /= base;
+  } while (v);
+  if (negative) *--p = '-';
+  return String(p);
+}
+
+static String formatUnsigned(unsigned long long value, unsigned char base) {
+  char buf[8 * sizeof(long long) + 1];
+  char* p = buf + sizeof(buf) - 1;
+  *p = '\0';
+  do {
+    int digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value);
+  return String(p);
+}
+
+static String formatDouble(double value, unsigned int decimalPlaces) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  return String(buf);
+}
+
+String::String(unsigned char value, unsigned char base) : String(formatUnsigned(value, base)) {}
+String::String(int value, unsigned char base) : String(formatInteger(value, base)) {}
+String::String(unsigned int value, unsigned char base) : String(formatUnsigned(value, base)) {}
+String::String(long value, unsigned char base) : String(formatInteger(value, base)) {}
+String::String(unsigned long value, unsigned char base) : String(formatUnsigned(value, base)) {}
+String::String(long long value, unsigned char base) : String(formatInteger(value, base)) {}
+String::String(unsigned long long value, unsigned char base) : String(formatUnsigned(value, base)) {}
+String::String(float value, unsigned int decimalPlaces) : String(formatDouble(value, decimalPlaces)) {}
+String::String(double value, unsigned int decimalPlaces) : String(formatDouble(value, decimalPlaces)) {}
+
+String::~String() {
+  free(buffer);
+}
+
+void String::invalidate() {
+  free(buffer);
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+}
+
+bool String::grow(unsigned int size) {
+  if (buffer && capacity >= size) return true;
+  char* grown = (char*)realloc(buffer, size + 1);
+  if (grown == NULL) return false;
+  if (buffer == NULL) grown[0] = '\0';
+  buffer = grown;
+  capacity = size;
+  return true;
+}
+
+bool String::reserve(unsigned int size) {
+  return grow(size);
+}
+
+String& String::copy(const char* cstr, unsigned int length) {
+  if (length == 0) {
+    if (buffer) buffer[0] = '\0';
+    len = 0;
+    return *this;
+  }
+  if (!grow(length)) {
+    invalidate();
+    return *this;
+  }
+  memmove(buffer, cstr, length);
+  buffer[length] = '\0';
+  len = length;
+  return *this;
+}
+
+String& String::operator=(const String& rhs) {
+  if (this != &rhs) copy(rhs.c_str(), rhs.len);
+  return *this;
+}
+
+String& String::operator=(String&& rhs) {
+  if (this != &rhs) {
+    free(buffer);
+    buffer = rhs.buffer;
+    capacity = rhs.capacity;
+    len = rhs.len;
+    rhs.buffer = NULL;
+    rhs.capacity = 0;
+    rhs.len = 0;
+  }
+  return *this;
+}
+
+String& String::operator=(const char* cstr) {
+  if (cstr) copy(cstr, strlen(cstr));
+  else invalidate();
+  return *this;
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+  if (cstr == NULL) return false;
+  if (length == 0) return true;
+  // Источник может лежать в нашем же буфере
+  if (buffer && cstr >= buffer && cstr < buffer + capacity) {
+    size_t offset = cstr - buffer;
+    if (!grow(len + length)) return false;
+    cstr = buffer + offset;
+  } else if (!grow(len + length)) {
+    return false;
+  }
+  memmove(buffer + len, cstr, length);
+  len += length;
+  buffer[len] = '\0';
+  return true;
+}
+
+bool String::concat(const String& str) { return concat(str.c_str(), str.len); }
+bool String::concat(const char* cstr) { return cstr ? concat(cstr, strlen(cstr)) : false; }
+bool String::concat(char c) { return concat(&c, 1); }
+bool String::concat(unsigned char value) { return concat(String(value)); }
+bool String::concat(int value) { return concat(String(value)); }
+bool String::concat(unsigned int value) { return concat(String(value)); }
+bool String::concat(long value) { return concat(String(value)); }
+bool String::concat(unsigned long value) { return concat(String(value)); }
+bool String::concat(long long value) { return concat(String(value)); }
+bool String::concat(unsigned long long value) { return concat(String(value)); }
+bool String::concat(float value) { return concat(String(value)); }
+bool String::concat(double value) { return concat(String(value)); }
+
+#define SUM_OPERATOR(type)                                              \
+  StringSumHelper& operator+(const StringSumHelper& lhs, type rhs) {    \
+    StringSumHelper& a = const_cast<StringSumHelper&>(lhs);             \
+    a.concat(rhs);                                                      \
+    return a;                                                           \
+  }
+
+SUM_OPERATOR(const String&)
+SUM_OPERATOR(const char*)
+SUM_OPERATOR(char)
+SUM_OPERATOR(unsigned char)
+SUM_OPERATOR(int)
+SUM_OPERATOR(unsigned int)
+SUM_OPERATOR(long)
+SUM_OPERATOR(unsigned long)
+SUM_OPERATOR(long long)
+SUM_OPERATOR(unsigned long long)
+SUM_OPERATOR(float)
+SUM_OPERATOR(double)
+
+int String::compareTo(const String& s) const {
+  return strcmp(c_str(), s.c_str());
+}
+
+bool String::equals(const String& s) const {
+  return len == s.len && strcmp(c_str(), s.c_str()) == 0;
+}
+
+bool String::equals(const char* cstr) const {
+  return strcmp(c_str(), cstr ? cstr : "") == 0;
+}
+
+bool String::equalsIgnoreCase(const String& s) const {
+  return len == s.len && strcasecmp(c_str(), s.c_str()) == 0;
+}
+
+bool String::startsWith(const String& prefix) const {
+  return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String& prefix, unsigned int offset) const {
+  if (offset > len || prefix.len > len - offset) return false;
+  return strncmp(c_str() + offset, prefix.c_str(), prefix.len) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+  if (suffix.len > len) return false;
+  return strcmp(c_str() + len - suffix.len, suffix.c_str()) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+  return operator[](index);
+}
+
+void String::setCharAt(unsigned int index, char c) {
+  if (index < len) buffer[index] = c;
+}
+
+char String::operator[](unsigned int index) const {
+  return index < len ? buffer[index] : '\0';
+}
+
+char& String::operator[](unsigned int index) {
+  static char dummy;
+  if (index >= len) {
+    dummy = '\0';
+    return dummy;
+  }
+  return buffer[index];
+}
+
+void String::toCharArray(char* buf, unsigned int bufsize, unsigned int index) const {
+  if (bufsize == 0 || buf == NULL) return;
+  if (index >= len) {
+    buf[0] = '\0';
+    return;
+  }
+  unsigned int n = std::min(bufsize - 1, len - index);
+  memcpy(buf, buffer + index, n);
+  buf[n] = '\0';
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  if (fromIndex >= len) return -1;
+  const char* found = strchr(buffer + fromIndex, ch);
+  return found ? (int)(found - buffer) : -1;
+}
+
+int String::indexOf(const String& str, unsigned int fromIndex) const {
+  if (fromIndex >= len) return -1;
+  const char* found = strstr(buffer + fromIndex, str.c_str());
+  return found ? (int)(found - buffer) : -1;
+}
+
+int String::lastIndexOf(char ch) const {
+  return len ? lastIndexOf(ch, len - 1) : -1;
+}
+
+int String::lastIndexOf(char ch, unsigned int fromIndex) const {
+  if (len == 0) return -1;
+  if (fromIndex >= len) fromIndex = len - 1;
+  for (int i = fromIndex; i >= 0; i--) {
+    if (buffer[i] == ch) return i;
+  }
+  return -1;
+}
+
+int String::lastIndexOf(const String& str) const {
+  if (str.len == 0 || str.len > len) return -1;
+  for (int i = len - str.len; i >= 0; i--) {
+    if (strncmp(buffer + i, str.c_str(), str.len) == 0) return i;
+  }
+  return -1;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) std::swap(beginIndex, endIndex);
+  if (beginIndex >= len) return String();
+  if (endIndex > len) endIndex = len;
+  return String(buffer + beginIndex, endIndex - beginIndex);
+}
+
+void String::replace(char find, char replace) {
+  for (unsigned int i = 0; i < len; i++) {
+    if (buffer[i] == find) buffer[i] = replace;
+  }
+}
+
+void String::replace(const String& find, const String& replace) {
+  if (len == 0 || find.len == 0) return;
+  String result;
+  unsigned int pos = 0;
+  while (true) {
+    int found = indexOf(find, pos);
+    if (found < 0) break;
+    result.concat(buffer + pos, found - pos);
+    result.concat(replace);
+    pos = found + find.len;
+  }
+  result.concat(buffer + pos, len - pos);
+  *this = std::move(result);
+}
+
+void String::remove(unsigned int index) {
+  remove(index, (unsigned int)-1);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index >= len || count == 0) return;
+  if (count > len - index) count = len - index;
+  memmove(buffer + index, buffer + index + count, len - index - count + 1);
+  len -= count;
+}
+
+void String::toLowerCase() {
+  for (unsigned int i = 0; i < len; i++) buffer[i] = tolower((unsigned char)buffer[i]);
+}
+
+void String::toUpperCase() {
+  for (unsigned int i = 0; i < len; i++) buffer[i] = toupper((unsigned char)buffer[i]);
+}
+
+void String::trim() {
+  if (len == 0) return;
+  unsigned int begin = 0;
+  while (begin < len && isspace((unsigned char)buffer[begin])) begin++;
+  unsigned int end = len;
+  while (end > begin && isspace((unsigned char)buffer[end - 1])) end--;
+  len = end - begin;
+  memmove(buffer, buffer + begin, len);
+  buffer[len] = '\0';
+}
+
+long String::toInt() const {
+  return atol(c_str());
+}
+
+float String::toFloat() const {
+  return (float)atof(c_str());
+}
+
+double String::toDouble() const {
+  return atof(c_str());
+}
+
+// ---- Print ----
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (write(*buffer++)) n++;
+    else break;
+  }
+  return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+  char stackBuffer[64];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, args);
+  va_end(args);
+  if (length < 0) return 0;
+  if ((size_t)length < sizeof(stackBuffer)) return write((const uint8_t*)stackBuffer, length);
+
+  char* heapBuffer = (char*)malloc(length + 1);
+  if (heapBuffer == NULL) return 0;
+  va_start(args, format);
+  vsnprintf(heapBuffer, length + 1, format, args);
+  va_end(args);
+  size_t written = write((const uint8_t*)heapBuffer, length);
+  free(heapBuffer);
+  return written;
+}
+
+size_t Print::printNumber(unsigned long long value, int base, bool negative) {
+  if (base < 2) base = 10;
+  char buf[8 * sizeof(long long) + 2];
+  char* p = buf + sizeof(buf) - 1;
+  *p = '\0';
+  do {
+    int digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value);
+  if (negative) *--p = '-';
+  return write(p);
+}
+
+size_t Print::print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+size_t Print::print(const char str[]) { return write(str); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(unsigned char value, int base) { return printNumber(value, base, false); }
+size_t Print::print(int value, int base) { return print((long long)value, base); }
+size_t Print::print(unsigned int value, int base) { return printNumber(value, base, false); }
+size_t Print::print(long value, int base) { return print((long long)value, base); }
+size_t Print::print(unsigned long value, int base) { return printNumber(value, base, false); }
+size_t Print::print(unsigned long long value, int base) { return printNumber(value, base, false); }
+
+size_t Print::print(long long value, int base) {
+  if (base == 10 && value < 0) return printNumber(-(unsigned long long)value, base, true);
+  return printNumber((unsigned long long)value, base, false);
+}
+
+size_t Print::print(double value, int digits) {
+  if (isnan(value)) return print("nan");
+  if (isinf(value)) return print("inf");
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", digits, value);
+  return print(buf);
+}
+
+size_t Print::print(const Printable& value) { return value.printTo(*this); }
+
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const String& s) { return print(s) + println(); }
+size_t Print::println(const char str[]) { return print(str) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char value, int base) { return print(value, base) + println(); }
+size_t Print::println(int value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned int value, int base) { return print(value, base) + println(); }
+size_t Print::println(long value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned long value, int base) { return print(value, base) + println(); }
+size_t Print::println(long long value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned long long value, int base) { return print(value, base) + println(); }
+size_t Print::println(double value, int digits) { return print(value, digits) + println(); }
+size_t Print::println(const Printable& value) { return print(value) + println(); }
+
+// ---- Stream ----
+
+bool Stream::find(const char* target) {
+  return find(target, strlen(target));
+}
+
+bool Stream::find(const char* target, size_t length) {
+  if (length == 0) return true;
+  size_t index = 0;
+  int c;
+  while ((c = read()) >= 0) {
+    if (c == (uint8_t)target[index]) {
+      if (++index == length) return true;
+    } else {
+      index = c == (uint8_t)target[0] ? 1 : 0;
+      if (index == length) return true;
+    }
+  }
+  return false;
+}
+
+bool Stream::findUntil(const char* target, const char* terminator) {
+  size_t targetLength = strlen(target);
+  size_t terminatorLength = terminator ? strlen(terminator) : 0;
+  size_t targetIndex = 0;
+  size_t terminatorIndex = 0;
+  int c;
+  while ((c = read()) >= 0) {
+    targetIndex = c == (uint8_t)target[targetIndex] ? targetIndex + 1 : (c == (uint8_t)target[0] ? 1 : 0);
+    if (targetIndex == targetLength) return true;
+    if (terminatorLength > 0) {
+      terminatorIndex = c == (uint8_t)terminator[terminatorIndex]
+        ? terminatorIndex + 1 : (c == (uint8_t)terminator[0] ? 1 : 0);
+      if (terminatorIndex == terminatorLength) return false;
+    }
+  }
+  return false;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = read();
+    if (c < 0) break;
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = read();
+    if (c < 0 || c == terminator) break;
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+String Stream::readString() {
+  String result;
+  int c;
+  while ((c = read()) >= 0) result += (char)c;
+  return result;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String result;
+  int c;
+  while ((c = read()) >= 0 && c != terminator) result += (char)c;
+  return result;
+}
+
+// ---- Serial, ESP и прочее ядро ----
+
+size_t HardwareSerial::write(uint8_t value) {
+  if (simSerialOut) fputc(value, simSerialOut);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (simSerialOut) fwrite(buffer, 1, size, simSerialOut);
+  return size;
+}
+
+static uint64_t efuseMac = 0x0000A1B2C3D4E5F6ULL;
+
+void simSetDeviceId(uint32_t id) {
+  efuseMac = (uint64_t)id << 16 | 0xE5F6;
+}
+
+uint64_t EspClass::getEfuseMac() {
+  return efuseMac;
+}
+
+void EspClass::restart() {
+  simStop("ESP.restart()");
+  abort();
+}
+
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+  return String(buf);
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+  switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    default: return "UNKNOWN ERROR";
+  }
+}
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t length = strlen(src);
+  if (size > 0) {
+    size_t n = length < size - 1 ? length : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return length;
+}
+#endif
+
+uint32_t getCpuFrequencyMhz() {
+  return 240;
+}
+
+// xorshift64*: быстрый и одинаковый на всех платформах
+static uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+
+void simSeedRandom(uint64_t seed) {
+  randomState = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+uint32_t simRandom() {
+  randomState ^= randomState >> 12;
+  randomState ^= randomState << 25;
+  randomState ^= randomState >> 27;
+  return (uint32_t)((randomState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+uint32_t esp_random() {
+  return simRandom();
+}
+
+void esp_fill_random(void* buf, size_t len) {
+  uint8_t* p = (uint8_t*)buf;
+  for (size_t i = 0; i < len; i++) p[i] = simRandom() & 0xFF;
+}
+
+long random(long max) {
+  return max > 0 ? (long)(simRandom() % (uint32_t)max) : 0;
+}
+
+long random(long min, long max) {
+  return min >= max ? min : min + random(max - min);
+}
+
+void randomSeed(unsigned long seed) {
+  simSeedRandom(seed);
+}
+
+String base64::encode(const uint8_t* data, size_t length) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  String out;
+  out.reserve((length + 2) / 3 * 4);
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t n = (uint32_t)data[i] << 16;
+    if (i + 1 < length) n |= (uint32_t)data[i + 1] << 8;
+    if (i + 2 < length) n |= data[i + 2];
+    out += alphabet[(n >> 18) & 0x3F];
+    out += alphabet[(n >> 12) & 0x3F];
+    out += i + 1 < length ? alphabet[(n >> 6) & 0x3F] : '=';
+    out += i + 2 < length ? alphabet[n & 0x3F] : '=';
+  }
+  return out;
+}
+
+String base64::encode(const String& text) {
+  return encode((const uint8_t*)text.c_str(), text.length());
+}
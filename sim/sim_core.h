@@ -0,0 +1,17 @@
+#ifndef SIM_CORE_H
+#define SIM_CORE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Вывод Serial прошивки: NULL - отбрасывать
+extern FILE* simSerialOut;
+
+// Общий детерминированный генератор для esp_random() и random()
+void simSeedRandom(uint64_t seed);
+uint32_t simRandom();
+
+// MAC устройства: у каждого экземпляра в одной сети свой (--device-id)
+void simSetDeviceId(uint32_t id);
+
+#endif
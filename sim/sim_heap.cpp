@@ -0,0 +1,318 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include "sim_heap.h"
+#include "heap_monitor.h"
+
+// malloc glibc под обертками ниже
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+// ---- Модель кучи устройства ----
+// Каждому блоку, выделенному после simHeapStart(), назначается место в
+// регионах DRAM first-fit по адресам, как в multi_heap: так видны
+// наибольший свободный блок и фрагментация. Память процессу отдает glibc,
+// модель только считает. Ядро симулятора однопоточное, поэтому хватает
+// одного флага против рекурсии из собственных контейнеров модели
+
+static size_t deviceHeap = 200 * 1024;
+static size_t usedBytes = 0;
+static size_t minFree = SIZE_MAX;
+static size_t minLargest = SIZE_MAX;
+static uint32_t allocations = 0;
+static uint32_t failedAllocations = 0;
+static bool modelActive = false;
+static bool inModel = false;
+
+struct ModelBlock {
+  uint32_t offset;
+  uint32_t size;
+};
+
+// Свободные блоки по смещению и их размеры; регионы разнесены
+// на SIM_HEAP_REGION_STRIDE и не сливаются между собой
+static std::map<uint32_t, uint32_t>* freeBlocks = NULL;
+static std::multiset<uint32_t>* freeSizes = NULL;
+static std::unordered_map<void*, ModelBlock>* liveBlocks = NULL;
+
+static uint32_t blockSize(size_t request) {
+  size_t aligned = (request + SIM_HEAP_ALIGN - 1) & ~(size_t)(SIM_HEAP_ALIGN - 1);
+  if (aligned < SIM_HEAP_ALIGN) aligned = SIM_HEAP_ALIGN;
+  return (uint32_t)(aligned + SIM_HEAP_BLOCK_OVERHEAD);
+}
+
+static void addFree(uint32_t offset, uint32_t size) {
+  std::map<uint32_t, uint32_t>::iterator next = freeBlocks->lower_bound(offset);
+  if (next != freeBlocks->end() && offset + size == next->first) {
+    size += next->second;
+    freeSizes->erase(freeSizes->find(next->second));
+    next = freeBlocks->erase(next);
+  }
+  if (next != freeBlocks->begin()) {
+    std::map<uint32_t, uint32_t>::iterator prev = next;
+    --prev;
+    if (prev->first + prev->second == offset) {
+      freeSizes->erase(freeSizes->find(prev->second));
+      offset = prev->first;
+      size += prev->second;
+      freeBlocks->erase(prev);
+    }
+  }
+  (*freeBlocks)[offset] = size;
+  freeSizes->insert(size);
+}
+
+static void takeFree(std::map<uint32_t, uint32_t>::iterator block, uint32_t size) {
+  uint32_t offset = block->first;
+  uint32_t available = block->second;
+  freeSizes->erase(freeSizes->find(available));
+  freeBlocks->erase(block);
+  if (available - size >= SIM_HEAP_MIN_SPLIT) {
+    (*freeBlocks)[offset + size] = available - size;
+    freeSizes->insert(available - size);
+  }
+}
+
+static size_t largestFree() {
+  return freeSizes->empty() ? 0 : *freeSizes->rbegin();
+}
+
+static void noteLow() {
+  size_t free = deviceHeap - usedBytes;
+  if (free < minFree) minFree = free;
+  size_t largest = largestFree();
+  if (largest < minLargest) minLargest = largest;
+}
+
+static void modelAlloc(void* ptr, size_t request) {
+  uint32_t size = blockSize(request);
+  for (std::map<uint32_t, uint32_t>::iterator it = freeBlocks->begin(); it != freeBlocks->end(); ++it) {
+    if (it->second < size) continue;
+    // Остаток меньше минимального блока уходит в выделенный
+    if (it->second - size < SIM_HEAP_MIN_SPLIT) size = it->second;
+    ModelBlock block = {it->first, size};
+    takeFree(it, size);
+    (*liveBlocks)[ptr] = block;
+    usedBytes += size;
+    noteLow();
+    return;
+  }
+  // На устройстве здесь вернулся бы NULL
+  failedAllocations++;
+}
+
+static void modelFree(void* ptr) {
+  std::unordered_map<void*, ModelBlock>::iterator it = liveBlocks->find(ptr);
+  // Выделено до simHeapStart() или не поместилось в модель
+  if (it == liveBlocks->end()) return;
+  usedBytes -= it->second.size;
+  addFree(it->second.offset, it->second.size);
+  liveBlocks->erase(it);
+}
+
+// realloc multi_heap: уменьшение на месте, рост за счет соседнего
+// свободного блока, иначе новое место и копия
+static void modelRealloc(void* oldPtr, void* newPtr, size_t request) {
+  std::unordered_map<void*, ModelBlock>::iterator it = liveBlocks->find(oldPtr);
+  if (it == liveBlocks->end()) {
+    modelAlloc(newPtr, request);
+    return;
+  }
+  ModelBlock block = it->second;
+  uint32_t size = blockSize(request);
+  if (size <= block.size) {
+    if (block.size - size >= SIM_HEAP_MIN_SPLIT) {
+      addFree(block.offset + size, block.size - size);
+      usedBytes -= block.size - size;
+      block.size = size;
+    }
+  } else {
+    std::map<uint32_t, uint32_t>::iterator next = freeBlocks->find(block.offset + block.size);
+    if (next != freeBlocks->end() && block.size + next->second >= size) {
+      uint32_t grow = size - block.size;
+      if (next->second - grow < SIM_HEAP_MIN_SPLIT) grow = next->second;
+      takeFree(next, grow);
+      usedBytes += grow;
+      block.size += grow;
+      noteLow();
+    } else {
+      liveBlocks->erase(it);
+      usedBytes -= block.size;
+      addFree(block.offset, block.size);
+      modelAlloc(newPtr, request);
+      return;
+    }
+  }
+  liveBlocks->erase(it);
+  (*liveBlocks)[newPtr] = block;
+}
+
+extern "C" void* malloc(size_t size) {
+  void* ptr = __libc_malloc(size);
+  if (ptr && modelActive && !inModel) {
+    inModel = true;
+    allocations++;
+    modelAlloc(ptr, size);
+    inModel = false;
+  }
+  return ptr;
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  void* ptr = __libc_calloc(count, size);
+  if (ptr && modelActive && !inModel) {
+    inModel = true;
+    allocations++;
+    modelAlloc(ptr, count * size);
+    inModel = false;
+  }
+  return ptr;
+}
+
+extern "C" void* realloc(void* oldPtr, size_t size) {
+  void* ptr = __libc_realloc(oldPtr, size);
+  if (modelActive && !inModel) {
+    inModel = true;
+    if (size != 0) allocations++;
+    if (!oldPtr) {
+      if (ptr) modelAlloc(ptr, size);
+    } else if (size == 0) {
+      modelFree(oldPtr);
+    } else if (ptr) {
+      modelRealloc(oldPtr, ptr, size);
+    }
+    inModel = false;
+  }
+  return ptr;
+}
+
+extern "C" void free(void* ptr) {
+  if (ptr && modelActive && !inModel) {
+    inModel = true;
+    modelFree(ptr);
+    inModel = false;
+  }
+  __libc_free(ptr);
+}
+
+void simHeapStart(size_t deviceHeapBytes) {
+  inModel = true;
+  // Контейнеры модели не освобождаются: free() зовется и после main()
+  freeBlocks = new std::map<uint32_t, uint32_t>();
+  freeSizes = new std::multiset<uint32_t>();
+  liveBlocks = new std::unordered_map<void*, ModelBlock>();
+  deviceHeap = deviceHeapBytes;
+  // Куча ESP32 - несколько регионов DRAM, блок не больше региона
+  uint32_t offset = 0;
+  for (size_t left = deviceHeap; left > 0;) {
+    uint32_t size = (uint32_t)std::min(left, (size_t)SIM_HEAP_MAX_BLOCK);
+    addFree(offset, size);
+    left -= size;
+    offset += SIM_HEAP_REGION_STRIDE;
+  }
+  usedBytes = 0;
+  minFree = deviceHeap;
+  minLargest = largestFree();
+  allocations = 0;
+  failedAllocations = 0;
+  inModel = false;
+  modelActive = true;
+}
+
+size_t simHeapUsed() {
+  return usedBytes;
+}
+
+size_t simHeapFree() {
+  return usedBytes < deviceHeap ? deviceHeap - usedBytes : 0;
+}
+
+size_t simHeapMinFree() {
+  return minFree;
+}
+
+size_t simHeapSize() {
+  return deviceHeap;
+}
+
+size_t simHeapLargestFree() {
+  return modelActive ? largestFree() : std::min(deviceHeap, (size_t)SIM_HEAP_MAX_BLOCK);
+}
+
+size_t simHeapMinLargestFree() {
+  return minLargest;
+}
+
+uint32_t simHeapAllocations() {
+  return allocations;
+}
+
+uint32_t simHeapFailedAllocations() {
+  return failedAllocations;
+}
+
+int simHeapRegions(SimHeapRegion* regions, int maxRegions) {
+  int count = 0;
+  for (size_t left = deviceHeap; left > 0 && count < maxRegions; count++) {
+    regions[count].size = std::min(left, (size_t)SIM_HEAP_MAX_BLOCK);
+    regions[count].freeBytes = 0;
+    regions[count].largestBlock = 0;
+    regions[count].freeBlocks = 0;
+    left -= regions[count].size;
+  }
+  if (!modelActive) return count;
+  for (std::map<uint32_t, uint32_t>::const_iterator it = freeBlocks->begin(); it != freeBlocks->end(); ++it) {
+    int index = it->first / SIM_HEAP_REGION_STRIDE;
+    if (index >= count) break;
+    regions[index].freeBytes += it->second;
+    regions[index].largestBlock = std::max(regions[index].largestBlock, (size_t)it->second);
+    regions[index].freeBlocks++;
+  }
+  return count;
+}
+
+uint32_t heapAllocationCount() {
+  return allocations;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  (void)caps;
+  return simHeapFree();
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  (void)caps;
+  return simHeapMinFree();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  (void)caps;
+  // Как multi_heap: размер, который можно запросить у malloc
+  size_t largest = simHeapLargestFree();
+  return largest > SIM_HEAP_BLOCK_OVERHEAD ? largest - SIM_HEAP_BLOCK_OVERHEAD : 0;
+}
+
+size_t heap_caps_get_total_size(uint32_t caps) {
+  (void)caps;
+  return deviceHeap;
+}
+
+uint32_t EspClass::getHeapSize() {
+  return deviceHeap;
+}
+
+uint32_t EspClass::getFreeHeap() {
+  return simHeapFree();
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  return simHeapMinFree();
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+  return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
@@ -0,0 +1,41 @@
+#ifndef SIM_HEAP_H
+#define SIM_HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Наибольший блок кучи ESP32 ограничен размером региона DRAM
+#define SIM_HEAP_MAX_BLOCK 113792
+// Регионы модели разнесены, чтобы свободные блоки не сливались через границу
+#define SIM_HEAP_REGION_STRIDE 0x1000000
+// Выравнивание и заголовок блока multi_heap
+#define SIM_HEAP_ALIGN 4
+#define SIM_HEAP_BLOCK_OVERHEAD 8
+// Меньший остаток не отделяется от выделенного блока
+#define SIM_HEAP_MIN_SPLIT 16
+
+// Куча устройства: размер задается сценарием, блоки malloc, выделенные
+// после simHeapStart(), раскладываются по регионам first-fit
+void simHeapStart(size_t deviceHeapBytes);
+size_t simHeapUsed();
+size_t simHeapFree();
+size_t simHeapMinFree();
+size_t simHeapSize();
+// Наибольший свободный блок с заголовком и его минимум с начала прогона
+size_t simHeapLargestFree();
+size_t simHeapMinLargestFree();
+// Вызовы malloc/calloc/realloc и те, что не нашли места в модели
+uint32_t simHeapAllocations();
+uint32_t simHeapFailedAllocations();
+
+struct SimHeapRegion {
+  size_t size;
+  size_t freeBytes;
+  size_t largestBlock;
+  uint32_t freeBlocks;
+};
+
+// Состояние регионов сейчас, возвращает их число
+int simHeapRegions(SimHeapRegion* regions, int maxRegions);
+
+#endif
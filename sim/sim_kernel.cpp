@@ -0,0 +1,317 @@
+#include "sim_kernel.h"
+#include <setjmp.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Стек хоста: прошивке на ПК нужно больше, чем на ESP32 (printf, ArduinoJson)
+#define SIM_STACK_SIZE (512 * 1024)
+
+enum SimTaskState { TASK_READY, TASK_BLOCKED, TASK_DONE };
+
+struct SimTask {
+  SimTaskFunction function;
+  void* arg;
+  char name[16];
+  int priority;
+  SimTaskState state;
+  uint64_t readySeq;
+  uint64_t deadline;
+  const void* waitObject;
+  bool timedOut;
+  uint32_t notifyCount;
+  void* reservation;
+  uint8_t* stack;
+  bool started;
+  ucontext_t startContext;
+  jmp_buf context;
+  SimTask* next;
+};
+
+static SimTask* tasks = NULL;
+static SimTask* current = NULL;
+static SimTask* starting = NULL;
+static jmp_buf schedulerContext;
+static uint64_t virtualClock = 0;
+static uint64_t readyCounter = 0;
+static SimAlarm* alarms = NULL;
+static SimIdleHook idleHook = NULL;
+static bool stopped = false;
+static const char* stopReason = NULL;
+
+uint64_t simNow() {
+  return virtualClock;
+}
+
+static void makeReady(SimTask* task, bool timedOut) {
+  task->state = TASK_READY;
+  task->timedOut = timedOut;
+  task->waitObject = NULL;
+  task->deadline = SIM_FOREVER;
+  task->readySeq = ++readyCounter;
+}
+
+// Переключение через _setjmp/_longjmp: в отличие от swapcontext
+// не трогает маску сигналов, системного вызова на каждый переход нет
+static void switchToScheduler() {
+  if (!_setjmp(current->context)) _longjmp(schedulerContext, 1);
+}
+
+static void taskEntry() {
+  SimTask* task = starting;
+  task->function(task->arg);
+  // Задача FreeRTOS не должна возвращаться; считаем это удалением
+  simDeleteTask(NULL);
+}
+
+SimTask* simCreateTask(SimTaskFunction function, void* arg, const char* name, int priority,
+                       size_t reserveBytes) {
+  SimTask* task = (SimTask*)calloc(1, sizeof(SimTask));
+  if (task == NULL) return NULL;
+
+  task->stack = (uint8_t*)mmap(NULL, SIM_STACK_SIZE, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (task->stack == MAP_FAILED) {
+    free(task);
+    return NULL;
+  }
+  // Защитная страница внизу стека: переполнение падает сразу, а не портит соседей
+  mprotect(task->stack, sysconf(_SC_PAGESIZE), PROT_NONE);
+
+  task->reservation = reserveBytes > 0 ? malloc(reserveBytes) : NULL;
+  task->function = function;
+  task->arg = arg;
+  snprintf(task->name, sizeof(task->name), "%s", name ? name : "task");
+  task->priority = priority;
+
+  getcontext(&task->startContext);
+  task->startContext.uc_stack.ss_sp = task->stack;
+  task->startContext.uc_stack.ss_size = SIM_STACK_SIZE;
+  task->startContext.uc_link = NULL;
+  makecontext(&task->startContext, taskEntry, 0);
+
+  makeReady(task, false);
+  SimTask** tail = &tasks;
+  while (*tail) tail = &(*tail)->next;
+  *tail = task;
+  return task;
+}
+
+SimTask* simCurrentTask() {
+  return current;
+}
+
+const char* simTaskName(SimTask* task) {
+  return task ? task->name : "main";
+}
+
+int simTaskPriority(SimTask* task) {
+  return task ? task->priority : 0;
+}
+
+void simSetTaskPriority(SimTask* task, int priority) {
+  if (task) task->priority = priority;
+}
+
+static void releaseTask(SimTask* task) {
+  for (SimTask** link = &tasks; *link; link = &(*link)->next) {
+    if (*link == task) {
+      *link = task->next;
+      break;
+    }
+  }
+  munmap(task->stack, SIM_STACK_SIZE);
+  free(task->reservation);
+  free(task);
+}
+
+void simDeleteTask(SimTask* task) {
+  if (task == NULL) task = current;
+  if (task == NULL) return;
+
+  task->state = TASK_DONE;
+  if (task != current) {
+    releaseTask(task);
+    return;
+  }
+  // Свой стек освобождает планировщик, когда задача с него уйдет
+  _longjmp(schedulerContext, 1);
+}
+
+bool simWaitUntil(const void* object, uint64_t deadline) {
+  if (current == NULL) {
+    // До запуска задач (подготовка сценария) ждать некого
+    if (deadline != SIM_FOREVER && deadline > virtualClock) virtualClock = deadline;
+    return false;
+  }
+
+  SimTask* task = current;
+  task->state = TASK_BLOCKED;
+  task->waitObject = object;
+  task->deadline = deadline;
+  task->timedOut = false;
+  switchToScheduler();
+  return !task->timedOut;
+}
+
+void simSleep(uint64_t micros) {
+  simWaitUntil(NULL, virtualClock + micros);
+}
+
+void simYield() {
+  if (current == NULL) return;
+  makeReady(current, false);
+  switchToScheduler();
+}
+
+void simWake(const void* object) {
+  if (object == NULL) return;
+  for (SimTask* task = tasks; task; task = task->next) {
+    if (task->state == TASK_BLOCKED && task->waitObject == object) makeReady(task, false);
+  }
+}
+
+void simNotify(SimTask* task) {
+  if (task == NULL) return;
+  task->notifyCount++;
+  if (task->state == TASK_BLOCKED && task->waitObject == &task->notifyCount) makeReady(task, false);
+}
+
+uint32_t simTakeNotify(bool clear, uint64_t deadline) {
+  SimTask* task = current;
+  if (task == NULL) return 0;
+
+  while (task->notifyCount == 0) {
+    if (virtualClock >= deadline) return 0;
+    simWaitUntil(&task->notifyCount, deadline);
+  }
+
+  uint32_t value = task->notifyCount;
+  task->notifyCount = clear ? 0 : value - 1;
+  return value;
+}
+
+void simArm(SimAlarm* alarm, uint64_t at) {
+  simDisarm(alarm);
+  alarm->at = at;
+  alarm->armed = true;
+  alarm->next = alarms;
+  alarms = alarm;
+}
+
+void simDisarm(SimAlarm* alarm) {
+  if (!alarm->armed) return;
+  for (SimAlarm** link = &alarms; *link; link = &(*link)->next) {
+    if (*link == alarm) {
+      *link = alarm->next;
+      break;
+    }
+  }
+  alarm->armed = false;
+}
+
+void simSetIdleHook(SimIdleHook hook) {
+  idleHook = hook;
+}
+
+// Готовая задача с наибольшим приоритетом; при равенстве - дольше всех ждущая
+static SimTask* pickReady() {
+  SimTask* best = NULL;
+  for (SimTask* task = tasks; task; task = task->next) {
+    if (task->state != TASK_READY) continue;
+    if (best == NULL || task->priority > best->priority ||
+        (task->priority == best->priority && task->readySeq < best->readySeq)) {
+      best = task;
+    }
+  }
+  return best;
+}
+
+static void runTask(SimTask* task) {
+  current = task;
+  if (!_setjmp(schedulerContext)) {
+    if (!task->started) {
+      task->started = true;
+      starting = task;
+      setcontext(&task->startContext);
+    }
+    _longjmp(task->context, 1);
+  }
+  current = NULL;
+  if (task->state == TASK_DONE) releaseTask(task);
+}
+
+static uint64_t nextEventTime() {
+  uint64_t next = SIM_FOREVER;
+  for (SimTask* task = tasks; task; task = task->next) {
+    if (task->state == TASK_BLOCKED && task->deadline < next) next = task->deadline;
+  }
+  for (SimAlarm* alarm = alarms; alarm; alarm = alarm->next) {
+    if (alarm->at < next) next = alarm->at;
+  }
+  return next;
+}
+
+static void fireAlarms() {
+  while (true) {
+    SimAlarm* due = NULL;
+    for (SimAlarm* alarm = alarms; alarm; alarm = alarm->next) {
+      if (alarm->at <= virtualClock && (due == NULL || alarm->at < due->at)) due = alarm;
+    }
+    if (due == NULL) return;
+    simDisarm(due);
+    due->fire(due);
+  }
+}
+
+static void expireDeadlines() {
+  for (SimTask* task = tasks; task; task = task->next) {
+    if (task->state == TASK_BLOCKED && task->deadline <= virtualClock) makeReady(task, true);
+  }
+}
+
+bool simRun(uint64_t until) {
+  while (!stopped) {
+    SimTask* task = pickReady();
+    if (task) {
+      runTask(task);
+      continue;
+    }
+
+    uint64_t next = nextEventTime();
+    if (next == SIM_FOREVER) {
+      simStop("all tasks blocked forever");
+      break;
+    }
+    if (next > until) {
+      if (idleHook) idleHook(virtualClock, until);
+      virtualClock = until;
+      return true;
+    }
+
+    if (idleHook) idleHook(virtualClock, next);
+    virtualClock = next;
+    fireAlarms();
+    expireDeadlines();
+  }
+  return false;
+}
+
+void simStop(const char* reason) {
+  stopped = true;
+  stopReason = reason;
+  // Задача, остановившая прогон, больше не продолжается
+  if (current) {
+    current->state = TASK_BLOCKED;
+    current->waitObject = NULL;
+    current->deadline = SIM_FOREVER;
+    switchToScheduler();
+  }
+}
+
+const char* simStopReason() {
+  return stopReason;
+}
@@ -0,0 +1,59 @@
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Ядро симулятора: виртуальные часы и кооперативные задачи.
+// Код задачи выполняется мгновенно, время идет только пока все задачи
+// заблокированы (delay, очередь, ответ сети) - поэтому прогон детерминирован
+#define SIM_FOREVER UINT64_MAX
+
+typedef void (*SimTaskFunction)(void*);
+
+struct SimTask;
+
+// Отложенное событие: срабатывает, когда часы доходят до at
+struct SimAlarm {
+  uint64_t at;
+  void (*fire)(SimAlarm* alarm);
+  bool armed;
+  SimAlarm* next;
+};
+
+uint64_t simNow();
+
+// На устройстве стек задачи берется из кучи: reserveBytes занимаются
+// через malloc на время жизни задачи, сам стек хоста выделяется отдельно
+SimTask* simCreateTask(SimTaskFunction function, void* arg, const char* name, int priority,
+                       size_t reserveBytes);
+SimTask* simCurrentTask();
+const char* simTaskName(SimTask* task);
+int simTaskPriority(SimTask* task);
+void simSetTaskPriority(SimTask* task, int priority);
+void simDeleteTask(SimTask* task);
+
+// Блокировка текущей задачи до момента deadline или до simWake(object).
+// false - вышел срок
+bool simWaitUntil(const void* object, uint64_t deadline);
+void simSleep(uint64_t micros);
+void simYield();
+void simWake(const void* object);
+
+// Уведомления задач (счетчик, как ulTaskNotifyTake)
+void simNotify(SimTask* task);
+uint32_t simTakeNotify(bool clear, uint64_t deadline);
+
+void simArm(SimAlarm* alarm, uint64_t at);
+void simDisarm(SimAlarm* alarm);
+
+// Вызывается перед каждым продвижением часов, когда задачи стоят
+typedef void (*SimIdleHook)(uint64_t now, uint64_t next);
+void simSetIdleHook(SimIdleHook hook);
+
+// Прогон до момента until; false - взаимная блокировка или simStop()
+bool simRun(uint64_t until);
+void simStop(const char* reason);
+const char* simStopReason();
+
+#endif
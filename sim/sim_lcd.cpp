@@ -0,0 +1,307 @@
+#include <Arduino.h>
+#include <LiquidCrystal.h>
+#include <Wire.h>
+#include "sim_lcd.h"
+
+// Время передачи байта: 4-битный режим LiquidCrystal - два строба E,
+// после каждого delayMicroseconds(100); clear/home ждут 2 мс
+#define LCD_PARALLEL_BYTE_US 200
+#define LCD_SLOW_COMMAND_US 2000
+#define PCF_RS 0x01
+#define PCF_EN 0x04
+
+SimHd44780 simLcd;
+TwoWire Wire;
+
+static uint32_t frames = 0;
+static uint32_t i2cTransactions = 0;
+static uint64_t i2cBytes = 0;
+static char shown[4][SIM_LCD_LINE_WIDTH * 4 + 1];
+
+// ---- модель HD44780 ----
+
+void SimHd44780::setGeometry(uint8_t columns, uint8_t lines) {
+  cols = columns;
+  numRows = lines;
+}
+
+void SimHd44780::reset() {
+  memset(ddram, ' ', sizeof(ddram));
+  memset(cgram, 0, sizeof(cgram));
+  address = 0;
+  cgramMode = false;
+  increment = true;
+  shift = 0;
+  fourBit = false;
+  highNibblePending = false;
+  dirty = true;
+}
+
+void SimHd44780::command(uint8_t value) {
+  commands++;
+  if (value & 0x80) {
+    cgramMode = false;
+    address = value & 0x7F;
+  } else if (value & 0x40) {
+    cgramMode = true;
+    address = value & 0x3F;
+  } else if (value & 0x20) {
+    fourBit = !(value & LCD_8BITMODE);
+  } else if (value & 0x10) {
+    if (value & LCD_DISPLAYMOVE) {
+      shift = (value & LCD_MOVERIGHT) ? (shift + SIM_LCD_LINE_WIDTH - 1) % SIM_LCD_LINE_WIDTH
+                                      : (shift + 1) % SIM_LCD_LINE_WIDTH;
+      dirty = true;
+    } else {
+      address += (value & LCD_MOVERIGHT) ? 1 : -1;
+    }
+  } else if (value & 0x08) {
+    displayOn = (value & LCD_DISPLAYON) != 0;
+    dirty = true;
+  } else if (value & 0x04) {
+    increment = (value & LCD_ENTRYLEFT) != 0;
+  } else if (value & 0x02) {
+    address = 0;
+    shift = 0;
+    cgramMode = false;
+    dirty = true;
+  } else if (value & 0x01) {
+    memset(ddram, ' ', sizeof(ddram));
+    address = 0;
+    shift = 0;
+    increment = true;
+    cgramMode = false;
+    clears++;
+    dirty = true;
+  }
+}
+
+void SimHd44780::data(uint8_t value) {
+  dataWrites++;
+  if (cgramMode) {
+    cgram[address & 0x3F] = value & 0x1F;
+    address = (address + (increment ? 1 : -1)) & 0x3F;
+    dirty = true;
+    return;
+  }
+
+  uint8_t line = address >= 0x40 ? 1 : 0;
+  uint8_t pos = address & 0x3F;
+  if (pos < SIM_LCD_LINE_WIDTH) ddram[line][pos] = value;
+  dirty = true;
+
+  // В двухстрочном режиме счетчик переходит 0x27 -> 0x40 и 0x67 -> 0x00
+  if (increment) {
+    address = address == 0x27 ? 0x40 : address == 0x67 ? 0x00 : address + 1;
+  } else {
+    address = address == 0x40 ? 0x27 : address == 0x00 ? 0x67 : address - 1;
+  }
+}
+
+void SimHd44780::nibble(uint8_t value, bool rs) {
+  value &= 0x0F;
+  // До перехода в 4-битный режим каждый строб - целая команда (младшие линии не подключены)
+  if (!fourBit) {
+    if (!rs) command(value << 4);
+    highNibblePending = false;
+    return;
+  }
+  if (!highNibblePending) {
+    pendingHigh = value;
+    highNibblePending = true;
+    return;
+  }
+  highNibblePending = false;
+  uint8_t byte = (pendingHigh << 4) | value;
+  if (rs) data(byte);
+  else command(byte);
+}
+
+const char* SimHd44780::glyph(uint8_t row, uint8_t col) const {
+  static char buf[2];
+  if (!displayOn) return " ";
+
+  uint8_t line = row % 2;
+  uint8_t pos = ((row / 2) * cols + col + shift) % SIM_LCD_LINE_WIDTH;
+  uint8_t code = ddram[line][pos];
+
+  if (code < 16) {
+    // Пользовательский символ: стрелка вверх шире всего в верхней половине
+    const uint8_t* map = cgram + (code & 0x07) * 8;
+    int widestRow = -1;
+    int widestBits = 0;
+    for (int i = 0; i < 8; i++) {
+      int bits = __builtin_popcount(map[i]);
+      if (bits > widestBits) {
+        widestBits = bits;
+        widestRow = i;
+      }
+    }
+    if (widestRow < 0) return " ";
+    return widestRow < 4 ? "\xE2\x86\x91" : "\xE2\x86\x93";
+  }
+  if (code == 0xFF) return "\xE2\x96\x88";
+  if (code < 0x20 || code > 0x7E) return "?";
+  buf[0] = (char)code;
+  buf[1] = '\0';
+  return buf;
+}
+
+// ---- вывод кадров ----
+
+static void renderRow(uint8_t row, char* out) {
+  out[0] = '\0';
+  for (uint8_t col = 0; col < simLcd.columns(); col++) strcat(out, simLcd.glyph(row, col));
+}
+
+void simLcdPresent(uint64_t now, uint64_t holdMicros, SimLcdOutput output, FILE* out) {
+  if (!simLcd.dirty || holdMicros < SIM_LCD_FRAME_HOLD_US) return;
+  simLcd.dirty = false;
+
+  char rows[4][SIM_LCD_LINE_WIDTH * 4 + 1];
+  bool changed = false;
+  uint8_t numRows = simLcd.rows() > 4 ? 4 : simLcd.rows();
+  for (uint8_t row = 0; row < numRows; row++) {
+    renderRow(row, rows[row]);
+    if (strcmp(rows[row], shown[row]) != 0) changed = true;
+  }
+  if (!changed) return;
+
+  frames++;
+  memcpy(shown, rows, sizeof(rows));
+  if (output == LCD_OUTPUT_NONE || out == NULL) return;
+
+  unsigned long seconds = now / 1000000;
+  unsigned int millisPart = (now / 1000) % 1000;
+  // В режиме live кадр перерисовывается на месте
+  if (output == LCD_OUTPUT_LIVE) fputs("\x1b[H", out);
+  fprintf(out, "%4lud %02lu:%02lu:%02lu.%03u\n", seconds / 86400, seconds / 3600 % 24, seconds / 60 % 60,
+          seconds % 60, millisPart);
+  fputc('+', out);
+  for (uint8_t col = 0; col < simLcd.columns(); col++) fputc('-', out);
+  fputs("+\n", out);
+  for (uint8_t row = 0; row < numRows; row++) fprintf(out, "|%s|\n", rows[row]);
+  fputc('+', out);
+  for (uint8_t col = 0; col < simLcd.columns(); col++) fputc('-', out);
+  fputs("+\n", out);
+  fflush(out);
+}
+
+uint32_t simLcdFrames() {
+  return frames;
+}
+
+uint32_t simI2cTransactions() {
+  return i2cTransactions;
+}
+
+uint64_t simI2cBytes() {
+  return i2cBytes;
+}
+
+// ---- LiquidCrystal ----
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) {
+  (void)rs;
+  (void)enable;
+  (void)d0;
+  (void)d1;
+  (void)d2;
+  (void)d3;
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t rows, uint8_t charsize) {
+  (void)charsize;
+  numLines = rows;
+  rowOffsets[0] = 0x00;
+  rowOffsets[1] = 0x40;
+  rowOffsets[2] = 0x00 + cols;
+  rowOffsets[3] = 0x40 + cols;
+  simLcd.setGeometry(cols, rows);
+
+  // Последовательность инициализации библиотеки: 4-битный режим, дисплей включен
+  delayMicroseconds(50000);
+  simLcd.nibble(0x03, false);
+  delayMicroseconds(4500);
+  simLcd.nibble(0x03, false);
+  delayMicroseconds(4500);
+  simLcd.nibble(0x03, false);
+  delayMicroseconds(150);
+  simLcd.nibble(0x02, false);
+  command(LCD_FUNCTIONSET | LCD_4BITMODE | (rows > 1 ? LCD_2LINE : LCD_1LINE));
+  display();
+  clear();
+  command(LCD_ENTRYMODESET | LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT);
+}
+
+void LiquidCrystal::clear() {
+  command(LCD_CLEARDISPLAY);
+  delayMicroseconds(LCD_SLOW_COMMAND_US);
+}
+
+void LiquidCrystal::home() {
+  command(LCD_RETURNHOME);
+  delayMicroseconds(LCD_SLOW_COMMAND_US);
+}
+
+void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
+  command(LCD_SETCGRAMADDR | ((location & 0x7) << 3));
+  for (int i = 0; i < 8; i++) write(charmap[i]);
+}
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row) {
+  if (row >= 4) row = 3;
+  if (row >= numLines) row = numLines - 1;
+  command(LCD_SETDDRAMADDR | (col + rowOffsets[row]));
+}
+
+size_t LiquidCrystal::write(uint8_t value) {
+  simLcd.nibble(value >> 4, true);
+  simLcd.nibble(value, true);
+  delayMicroseconds(LCD_PARALLEL_BYTE_US);
+  return 1;
+}
+
+void LiquidCrystal::command(uint8_t value) {
+  simLcd.nibble(value >> 4, false);
+  simLcd.nibble(value, false);
+  delayMicroseconds(LCD_PARALLEL_BYTE_US);
+}
+
+// ---- Wire ----
+
+void TwoWire::beginTransmission(uint8_t target) {
+  address = target;
+  length = 0;
+}
+
+size_t TwoWire::write(uint8_t value) {
+  if (length >= SIM_WIRE_BUFFER_SIZE) return 0;
+  buffer[length++] = value;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t size) {
+  size_t n = 0;
+  while (n < size && write(data[n])) n++;
+  return n;
+}
+
+// Байты для расширителя PCF8574: полубайт защелкивается спадом E
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  (void)sendStop;
+  static uint8_t lastPins = 0;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t pins = buffer[i];
+    if ((lastPins & PCF_EN) && !(pins & PCF_EN)) simLcd.nibble(lastPins >> 4, lastPins & PCF_RS);
+    lastPins = pins;
+  }
+
+  i2cTransactions++;
+  i2cBytes += length + 1;
+  // Старт, адрес и данные, 9 тактов на байт
+  delayMicroseconds((uint32_t)((length + 1) * 9 * 1000000ULL / clockHz));
+  (void)address;
+  length = 0;
+  return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef SIM_LCD_H
+#define SIM_LCD_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#define SIM_LCD_LINE_WIDTH 40
+
+// Контроллер HD44780: DDRAM двух строк по 40 байт, CGRAM, счетчик адреса
+// и аппаратный сдвиг. Видимое окно считается так же, как на стекле
+class SimHd44780 {
+public:
+  void setGeometry(uint8_t cols, uint8_t rows);
+  void reset();
+  void command(uint8_t value);
+  void data(uint8_t value);
+  // 4-битная шина: полубайт, защелкнутый спадом E
+  void nibble(uint8_t value, bool rs);
+
+  uint8_t columns() const { return cols; }
+  uint8_t rows() const { return numRows; }
+  // Символ (UTF-8) в позиции стекла, пользовательские - стрелками
+  const char* glyph(uint8_t row, uint8_t col) const;
+
+  uint32_t commands = 0;
+  uint32_t dataWrites = 0;
+  uint32_t clears = 0;
+  bool dirty = false;
+
+private:
+  uint8_t cols = 16;
+  uint8_t numRows = 2;
+  uint8_t ddram[2][SIM_LCD_LINE_WIDTH];
+  uint8_t cgram[64];
+  uint8_t address = 0;
+  bool cgramMode = false;
+  bool increment = true;
+  bool displayOn = true;
+  uint8_t shift = 0;
+  bool fourBit = false;
+  bool highNibblePending = false;
+  uint8_t pendingHigh = 0;
+};
+
+extern SimHd44780 simLcd;
+
+enum SimLcdOutput { LCD_OUTPUT_NONE, LCD_OUTPUT_LOG, LCD_OUTPUT_LIVE };
+
+// Кадр - видимое содержимое, отличающееся от предыдущего и простоявшее
+// на стекле не меньше SIM_LCD_FRAME_HOLD_US. Промежуточные состояния
+// посреди вывода строки (байты идут по ~200 мкс) кадрами не считаются
+#define SIM_LCD_FRAME_HOLD_US 1000
+
+void simLcdPresent(uint64_t now, uint64_t holdMicros, SimLcdOutput output, FILE* out);
+uint32_t simLcdFrames();
+uint32_t simI2cTransactions();
+uint64_t simI2cBytes();
+
+#endif
@@ -0,0 +1,535 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Preferences.h>
+#include <WebServer.h>
+#include <WiFi.h>
+#include <time.h>
+#include <vector>
+#include "config.h"
+#include "lcd_display.h"
+#include "scheduler.h"
+#include "power.h"
+#include "arena.h"
+#include "eeprom_storage.h"
+#include "lan_fanout.h"
+#include "quote_provider.h"
+#include "upstream.h"
+#include "ota.h"
+#include "sim_kernel.h"
+#include "sim_core.h"
+#include "sim_heap.h"
+#include "sim_lcd.h"
+#include "sim_net.h"
+#include "sim_storage.h"
+#include "sim_ota.h"
+#include "mock_iss.h"
+
+// Скетч компилируется как обычный модуль
+void setup();
+void loop();
+
+#define MICROS_PER_HOUR 3600000000ULL
+#define MICROS_PER_DAY (24 * MICROS_PER_HOUR)
+#define LOOP_TASK_STACK_SIZE 8192
+#define LOOP_TASK_PRIORITY 1
+// Гистограмма задержек: 4 корзины на каждую степень двойки
+#define LATENCY_BUCKETS (64 * 4)
+
+struct SimOptions {
+  uint64_t durationMicros = MICROS_PER_DAY;
+  uint64_t seed = 1;
+  const char* tickers = "SBER,GAZP,LKOH,YDEX,VTBR";
+  long updateMinutes = 10;
+  long displaySeconds = 3;
+  int workers = FETCH_POOL_DEFAULT_WORKERS;
+  int displayMode = DISPLAY_MODE_ROTATE;
+  int powerMode = POWER_MODE_PERFORMANCE;
+  int lanMode = LAN_MODE_OFF;
+  uint32_t deviceId = 0;
+  const char* upstream = "iss";
+  const char* mirror = "iss";
+  const char* firmware = NULL;
+  bool pendingImage = false;
+  size_t heapBytes = 200 * 1024;
+  bool wifi = true;
+  bool portalServer = false;
+  std::vector<SimWifiOutage> outages;
+  bool stream = false;
+  std::vector<SimWifiOutage> streamStalls;
+  std::vector<SimScriptedRequest> requests;
+  SimLcdOutput lcdOutput = LCD_OUTPUT_NONE;
+  double speed = 0;
+};
+
+static SimOptions options;
+static uint64_t latencyBuckets[LATENCY_BUCKETS];
+static uint64_t latencySamples = 0;
+static uint64_t latencyMax = 0;
+static uint32_t bootFreeHeap = 0;
+static uint32_t bootLargestBlock = 0;
+static std::vector<uint32_t> hourlyFreeHeap;
+static std::vector<uint32_t> hourlyLargestBlock;
+static uint64_t nextHeapSample = MICROS_PER_HOUR;
+static struct timespec realStart;
+
+// ---- задержка итерации loop() ----
+
+static int latencyBucket(uint64_t micros) {
+  if (micros < 4) return (int)micros;
+  int exponent = 63 - __builtin_clzll(micros);
+  int sub = (int)((micros >> (exponent - 2)) & 3);
+  return exponent * 4 + sub;
+}
+
+// Верхняя граница корзины
+static uint64_t bucketLimit(int bucket) {
+  if (bucket < 4) return bucket;
+  int exponent = bucket / 4;
+  uint64_t step = 1ULL << (exponent - 2);
+  return (1ULL << exponent) + (bucket % 4 + 1) * step - 1;
+}
+
+static void recordLatency(uint64_t micros) {
+  latencyBuckets[latencyBucket(micros)]++;
+  latencySamples++;
+  if (micros > latencyMax) latencyMax = micros;
+}
+
+static uint64_t latencyPercentile(double fraction) {
+  uint64_t target = (uint64_t)(latencySamples * fraction);
+  uint64_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += latencyBuckets[i];
+    if (seen > target) return std::min(bucketLimit(i), latencyMax);
+  }
+  return latencyMax;
+}
+
+// Отдельный сервер портала, каким он был у WiFiManager до общего
+// сервера: три маршрута и свой слушающий порт. Только для сравнения кучи
+static WebServer portalServer(80);
+
+static void startPortalServer() {
+  portalServer.on("/", []() { portalServer.send(200, "text/html", ""); });
+  portalServer.on("/config", []() { portalServer.send(200, "text/html", ""); });
+  portalServer.on("/save", HTTP_POST, []() { portalServer.send(200, "text/html", ""); });
+  portalServer.begin();
+}
+
+// Задача loopTask ядра Arduino. Занятость итерации - время без сна
+// в планировщике: ожидание пула запросов и вывод на дисплей сюда входят
+static void loopTask(void* arg) {
+  (void)arg;
+  setup();
+  if (options.portalServer) startPortalServer();
+  bootFreeHeap = ESP.getFreeHeap();
+  bootLargestBlock = simHeapLargestFree();
+
+  while (true) {
+    uint64_t start = simNow();
+    uint64_t sleptBefore = schedulerSleepMicros();
+    loop();
+    uint64_t slept = schedulerSleepMicros() - sleptBefore;
+    uint64_t elapsed = simNow() - start;
+    recordLatency(elapsed > slept ? elapsed - slept : 0);
+  }
+}
+
+// ---- между событиями ----
+
+static double realSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - realStart.tv_sec) + (now.tv_nsec - realStart.tv_nsec) / 1e9;
+}
+
+static void idleHook(uint64_t now, uint64_t next) {
+  simLcdPresent(now, next - now, options.lcdOutput, stdout);
+
+  size_t freeHeap = simHeapFree();
+  size_t largestBlock = simHeapLargestFree();
+  while (nextHeapSample <= next && nextHeapSample <= options.durationMicros) {
+    hourlyFreeHeap.push_back((uint32_t)freeHeap);
+    hourlyLargestBlock.push_back((uint32_t)largestBlock);
+    nextHeapSample += MICROS_PER_HOUR;
+  }
+
+  // Живой вывод дисплея в масштабе реального времени
+  if (options.speed > 0) {
+    double ahead = now / 1e6 / options.speed - realSeconds();
+    if (ahead > 0.001) {
+      struct timespec pause;
+      pause.tv_sec = (time_t)ahead;
+      pause.tv_nsec = (long)((ahead - pause.tv_sec) * 1e9);
+      nanosleep(&pause, NULL);
+    }
+  }
+}
+
+// ---- параметры ----
+
+static const char* optionValue(const char* arg, const char* name) {
+  size_t len = strlen(name);
+  if (strncmp(arg, name, len) != 0 || arg[len] != '=') return NULL;
+  return arg + len + 1;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: ticker-sim [options]\n"
+          "  --days=N --hours=N       длительность прогона в виртуальном времени (1 день)\n"
+          "  --seed=N                 зерно генераторов\n"
+          "  --tickers=SBER,GAZP      бумаги в EEPROM, рынок префиксом: bonds:SU26238RMFS4\n"
+          "  --update=MIN --display=SEC --workers=N\n"
+          "  --mode=rotate|marquee --power=performance|modem|light\n"
+          "  --upstream=iss|flaky|slow|closed|down\n"
+          "  --mirror=iss|flaky|slow|closed|down  запасные адреса issUrls\n"
+          "  --lan=off|auto|follower  раздача котировок по сети (нужен --speed)\n"
+          "  --device-id=N            номер устройства в сети, у каждого экземпляра свой\n"
+          "  --heap=KB                куча устройства (200)\n"
+          "  --wifi-down=T:DUR        обрыв Wi-Fi, T и DUR в s/m/h/d\n"
+          "  --stream                 поток котировок STOMP вместо опроса акций\n"
+          "  --stream-stall=T:DUR     сервер потока молчит, соединение не закрыто\n"
+          "  --no-wifi                нет сохраненной сети (портал AP)\n"
+          "  --portal-server          второй WebServer портала, как до общего сервера\n"
+          "  --request=T:METHOD:URI   запрос к веб-интерфейсу\n"
+          "  --firmware=FILE          образ для POST /ota?url=" SIM_FIRMWARE_URL "fw.bin&password=...\n"
+          "  --pending-image          прошивка загружена обновлением и ждет подтверждения\n"
+          "  --lcd=none|log|live --speed=X\n"
+          "  --serial[=FILE]          вывод Serial прошивки\n");
+}
+
+static bool parseOptions(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value;
+    if ((value = optionValue(arg, "--days"))) {
+      options.durationMicros = (uint64_t)(atof(value) * MICROS_PER_DAY);
+    } else if ((value = optionValue(arg, "--hours"))) {
+      options.durationMicros = (uint64_t)(atof(value) * MICROS_PER_HOUR);
+    } else if ((value = optionValue(arg, "--seed"))) {
+      options.seed = strtoull(value, NULL, 10);
+    } else if ((value = optionValue(arg, "--tickers"))) {
+      options.tickers = value;
+    } else if ((value = optionValue(arg, "--update"))) {
+      options.updateMinutes = atol(value);
+    } else if ((value = optionValue(arg, "--display"))) {
+      options.displaySeconds = atol(value);
+    } else if ((value = optionValue(arg, "--workers"))) {
+      options.workers = constrain(atoi(value), 1, FETCH_POOL_MAX_WORKERS);
+    } else if ((value = optionValue(arg, "--mode"))) {
+      if (strcmp(value, "rotate") == 0) options.displayMode = DISPLAY_MODE_ROTATE;
+      else if (strcmp(value, "marquee") == 0) options.displayMode = DISPLAY_MODE_MARQUEE;
+      else return false;
+    } else if ((value = optionValue(arg, "--power"))) {
+      options.powerMode = parsePowerMode(value);
+      if (options.powerMode < 0) return false;
+    } else if ((value = optionValue(arg, "--lan"))) {
+      options.lanMode = parseLanMode(value);
+      if (options.lanMode < 0) return false;
+    } else if ((value = optionValue(arg, "--device-id"))) {
+      options.deviceId = strtoul(value, NULL, 10);
+      if (options.deviceId == 0) return false;
+    } else if ((value = optionValue(arg, "--upstream"))) {
+      options.upstream = value;
+    } else if ((value = optionValue(arg, "--mirror"))) {
+      options.mirror = value;
+    } else if ((value = optionValue(arg, "--heap"))) {
+      options.heapBytes = (size_t)atol(value) * 1024;
+    } else if ((value = optionValue(arg, "--wifi-down"))) {
+      SimWifiOutage outage;
+      if (!simParseOutage(value, &outage)) return false;
+      options.outages.push_back(outage);
+    } else if (strcmp(arg, "--stream") == 0) {
+      options.stream = true;
+    } else if ((value = optionValue(arg, "--stream-stall"))) {
+      SimWifiOutage stall;
+      if (!simParseOutage(value, &stall)) return false;
+      options.stream = true;
+      options.streamStalls.push_back(stall);
+    } else if (strcmp(arg, "--no-wifi") == 0) {
+      options.wifi = false;
+    } else if (strcmp(arg, "--portal-server") == 0) {
+      options.portalServer = true;
+    } else if ((value = optionValue(arg, "--request"))) {
+      SimScriptedRequest request;
+      if (!simParseRequest(value, &request)) return false;
+      options.requests.push_back(request);
+    } else if ((value = optionValue(arg, "--firmware"))) {
+      options.firmware = value;
+    } else if (strcmp(arg, "--pending-image") == 0) {
+      options.pendingImage = true;
+    } else if ((value = optionValue(arg, "--lcd"))) {
+      if (strcmp(value, "none") == 0) options.lcdOutput = LCD_OUTPUT_NONE;
+      else if (strcmp(value, "log") == 0) options.lcdOutput = LCD_OUTPUT_LOG;
+      else if (strcmp(value, "live") == 0) options.lcdOutput = LCD_OUTPUT_LIVE;
+      else return false;
+    } else if ((value = optionValue(arg, "--speed"))) {
+      options.speed = atof(value);
+    } else if (strcmp(arg, "--serial") == 0) {
+      simSerialOut = stderr;
+    } else if ((value = optionValue(arg, "--serial"))) {
+      simSerialOut = fopen(value, "w");
+      if (simSerialOut == NULL) return false;
+    } else {
+      return false;
+    }
+  }
+  if (options.lcdOutput == LCD_OUTPUT_LIVE && options.speed == 0) options.speed = 1;
+  return options.durationMicros > 0;
+}
+
+// Состояние, с которым устройство включается: бумаги и настройки в EEPROM,
+// сохраненная сеть в NVS
+static void provisionDevice() {
+  numTickers = 0;
+  String list = options.tickers;
+  while (list.length() > 0 && numTickers < MAX_TICKERS) {
+    int comma = list.indexOf(',');
+    String symbol = comma < 0 ? list : list.substring(0, comma);
+    list = comma < 0 ? String() : list.substring(comma + 1);
+    int market = MARKET_SHARES;
+    int colon = symbol.indexOf(':');
+    if (colon > 0) {
+      market = parseMarket(symbol.substring(0, colon));
+      symbol = symbol.substring(colon + 1);
+    }
+    normalizeSymbol(symbol, market);
+    if (market < 0 || !isValidSymbol(symbol)) continue;
+    tickers[numTickers].symbol = symbol;
+    tickers[numTickers].threshold = 0;
+    tickers[numTickers].isBuySignal = false;
+    tickers[numTickers].market = market;
+    numTickers++;
+  }
+  updateInterval = options.updateMinutes * 60000;
+  displayChangeInterval = options.displaySeconds * 1000;
+  fetchConcurrency = options.workers;
+  displayMode = options.displayMode;
+  powerMode = options.powerMode;
+  lanMode = options.lanMode;
+
+  EEPROM.begin(EEPROM_SIZE);
+  saveTickersToEEPROM();
+  if (options.wifi) Preferences::preset("wifi-config", "ssid", SIM_WIFI_SSID);
+}
+
+// ---- отчет ----
+
+// Как в heap_monitor: доля свободного, недоступная одним блоком
+static unsigned fragmentation(size_t freeBytes, size_t largestBlock) {
+  return freeBytes > 0 ? 100 - (unsigned)((uint64_t)std::min(largestBlock, freeBytes) * 100 / freeBytes) : 0;
+}
+
+static void printReport(bool completed, uint32_t eepromCommitsBefore) {
+  double virtualSeconds = simNow() / 1e6;
+  double elapsed = realSeconds();
+  printf("\n=== ticker-sim: %.2f h virtual in %.2f s real (x%.0f) ===\n", virtualSeconds / 3600, elapsed,
+         elapsed > 0 ? virtualSeconds / elapsed : 0);
+  if (!completed) printf("stopped early: %s\n", simStopReason());
+
+  printf("\nloop() iteration busy time, us (%llu iterations)\n", (unsigned long long)latencySamples);
+  printf("  p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n", (unsigned long long)latencyPercentile(0.5),
+         (unsigned long long)latencyPercentile(0.9), (unsigned long long)latencyPercentile(0.99),
+         (unsigned long long)latencyPercentile(0.999), (unsigned long long)latencyMax);
+
+  printf("\njobs%*s runs     avg us     max us\n", 10, "");
+  for (int id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+    JobStats stats;
+    if (!getJobStats(id, &stats) || stats.runs == 0) continue;
+    printf("  %-12s %8u %10llu %10u\n", stats.name, stats.runs,
+           (unsigned long long)(stats.totalMicros / stats.runs), stats.maxMicros);
+  }
+
+  printf("\ndisplay calls%*s calls     avg us     max us  allocs/call   rebuilds\n", 1, "");
+  for (int call = 0; call < DISPLAY_CALL_COUNT; call++) {
+    DisplayCallStats stats;
+    if (!getDisplayCallStats(call, &stats) || stats.calls == 0) continue;
+    printf("  %-12s %8u %10llu %10u %12.2f %10u\n", stats.name, stats.calls,
+           (unsigned long long)(stats.totalMicros / stats.calls), stats.maxMicros,
+           (double)stats.allocations / stats.calls, stats.rebuilds);
+  }
+
+  PowerStats power;
+  if (getPowerStats(powerMode, &power)) {
+    printf("\npower: %s, asleep %.1f%%, ~%.1f mA\n", powerModeName(powerMode),
+           100.0 * power.asleepMicros / std::max<uint64_t>(1, power.asleepMicros + power.awakeMicros),
+           power.averageMilliamps);
+  }
+
+  const SimFetchStats& fetch = simFetchStats();
+  printf("\nupstream %s: %u requests, %u ok, %u http errors, %u timeouts, %u refused, %u lost\n", options.upstream,
+         fetch.requests, fetch.ok, fetch.httpErrors, fetch.timeouts, fetch.notConnected, fetch.connectionLost);
+  printf("  %llu body bytes, latency avg %llu ms, max %u ms\n", (unsigned long long)fetch.bodyBytes,
+         (unsigned long long)(fetch.latencyMsTotal / std::max<uint32_t>(1, fetch.ok + fetch.httpErrors)),
+         fetch.latencyMsMax);
+  for (int i = 0; i < upstreamCount(); i++) {
+    UpstreamStats stats = upstreamStats(i);
+    printf("  [%d] %s: %u requests, %u failed, p50 %u ms, p95 %u ms, hedge after %u ms, %u hedges (%u won), "
+           "%u failovers\n", i, upstreamUrl(i), stats.requests, stats.failures, stats.p50Ms, stats.p95Ms,
+           hedgeDelayMs(i), stats.hedges, stats.hedgeWins, stats.failovers);
+  }
+  if (options.stream) {
+    const SimStreamStats& stream = simStreamStats();
+    printf("stream: %u connects, %u refused, %u closed by client, %u subscribes, %u prices, "
+           "heart-beats %u sent / %u received\n", stream.connects, stream.refused, stream.closedByClient,
+           stream.subscribes, stream.messages, stream.heartbeatsSent, stream.heartbeatsReceived);
+    printf("  upstream requests: %u while streaming, %u otherwise\n", stream.pollsWhileStreaming,
+           stream.pollsOtherwise);
+    // Последняя цена потока против показанной прошивкой
+    for (int i = 0; i < numTickers; i++) {
+      std::map<std::string, std::string>::const_iterator sent = stream.lastSent.find(tickers[i].symbol.c_str());
+      if (sent == stream.lastSent.end()) continue;
+      printf("  %s: streamed %s, shown %s\n", tickers[i].symbol.c_str(), sent->second.c_str(),
+             stockPrices[i].c_str());
+    }
+  }
+  printf("wifi: %s, %u outages, mode %d\n", WiFi.status() == WL_CONNECTED ? "connected" : "down",
+         simWifiOutages(), (int)WiFi.getMode());
+
+  if (lanMode != LAN_MODE_OFF) {
+    const LanStats& lan = lanStats();
+    printf("lan %s: device %08x, leader %08x, %d peers, %d shared symbols\n", lanModeName(lanMode), lanDeviceId(),
+           lanLeaderId(), lanPeerCount(), lanSharedSymbolCount());
+    printf("  frames: %u sent, %u received, %u bad, %u duplicate, %u lost; %u prices applied, %u leader changes\n",
+           lan.framesSent, lan.framesReceived, lan.badFrames, lan.duplicates, lan.lost, lan.pricesApplied,
+           lan.leaderChanges);
+  }
+
+  OtaStatus ota = otaStatus();
+  const SimOtaStats& flash = simOtaStats();
+  bool otaStarted = ota.state != OTA_STATE_IDLE || ota.error;
+  if (otaStarted || options.pendingImage) {
+    printf("\nota:");
+    if (otaStarted) {
+      printf(" %s image, %u bytes downloaded, %u bytes written in %u ms%s%s", otaFormatName(ota.format),
+             ota.received, ota.written, ota.elapsedMs, ota.error ? ", error: " : "", ota.error ? ota.error : "");
+      if (ota.format == OTA_FORMAT_GZIP) printf("; tinfl read %u bytes past deflate end", flash.inflateReadAhead);
+    }
+    printf("\n  flash: %u sectors, %llu ms, crc32 %08x; image %s%s%s\n", flash.sectorsWritten,
+           (unsigned long long)flash.flashMs, flash.imageCrc, flash.activated ? "activated" : "not activated", flash.confirmed ? ", running image confirmed" : "",
+           flash.rolledBack ? ", rolled back" : "");
+  }
+
+  printf("\nlcd: %u data writes, %u commands, %u clears, %u bus transactions, %u frames\n", simLcd.dataWrites,
+         simLcd.commands, simLcd.clears, lcd.busTransactions(), simLcdFrames());
+  if (simI2cTransactions() > 0) {
+    printf("  i2c: %u transactions, %llu bytes\n", simI2cTransactions(), (unsigned long long)simI2cBytes());
+  }
+
+  const SimWebStats& web = simWebStats();
+  if (web.requests > 0 || web.unreachable > 0) {
+    printf("\nweb: %u requests, %u unreachable, %llu bytes sent, %llu us busy\n", web.requests, web.unreachable,
+           (unsigned long long)web.responseBytes, (unsigned long long)web.busyMicros);
+    for (std::map<std::string, uint32_t>::const_iterator it = web.perPath.begin(); it != web.perPath.end(); ++it) {
+      printf("  %-20s %u\n", it->first.c_str(), it->second);
+    }
+    for (std::map<int, uint32_t>::const_iterator it = web.perStatus.begin(); it != web.perStatus.end(); ++it) {
+      printf("  status %d: %u\n", it->first, it->second);
+    }
+  }
+
+  printf("\nheap of %u: boot free %u, min free %u, final free %u\n", (unsigned)simHeapSize(), bootFreeHeap,
+         (unsigned)simHeapMinFree(), (unsigned)simHeapFree());
+  unsigned worstFragmentation = 0;
+  for (size_t i = 0; i < hourlyLargestBlock.size(); i++) {
+    worstFragmentation = std::max(worstFragmentation, fragmentation(hourlyFreeHeap[i], hourlyLargestBlock[i]));
+  }
+  printf("  largest block: boot %u, min %u, final %u; fragmentation final %u%%, worst hourly %u%%\n",
+         bootLargestBlock, (unsigned)simHeapMinLargestFree(), (unsigned)simHeapLargestFree(),
+         fragmentation(simHeapFree(), simHeapLargestFree()), worstFragmentation);
+  printf("  %u allocations, %u did not fit\n", simHeapAllocations(), simHeapFailedAllocations());
+  SimHeapRegion regions[8];
+  int regionCount = simHeapRegions(regions, 8);
+  for (int i = 0; i < regionCount; i++) {
+    printf("  region %d of %u: free %u in %u blocks, largest %u, fragmentation %u%%\n", i, (unsigned)regions[i].size,
+           (unsigned)regions[i].freeBytes, regions[i].freeBlocks, (unsigned)regions[i].largestBlock,
+           fragmentation(regions[i].freeBytes, regions[i].largestBlock));
+  }
+  if (!hourlyFreeHeap.empty()) {
+    printf("  hourly free:");
+    for (size_t i = 0; i < hourlyFreeHeap.size(); i++) printf("%s%u", i % 12 == 0 ? "\n   " : " ", hourlyFreeHeap[i]);
+    printf("\n  hourly largest block / fragmentation %%:");
+    for (size_t i = 0; i < hourlyLargestBlock.size(); i++) {
+      printf("%s%u/%u", i % 8 == 0 ? "\n   " : " ", hourlyLargestBlock[i],
+             fragmentation(hourlyFreeHeap[i], hourlyLargestBlock[i]));
+    }
+    printf("\n");
+  }
+  // Утечка видна как разница средних за первые и последние сутки
+  if (hourlyFreeHeap.size() >= 48) {
+    double first = 0;
+    double last = 0;
+    for (size_t i = 0; i < 24; i++) {
+      first += hourlyFreeHeap[i];
+      last += hourlyFreeHeap[hourlyFreeHeap.size() - 24 + i];
+    }
+    printf("  first day avg %.0f, last day avg %.0f, drift %.0f B/day\n", first / 24, last / 24,
+           (last - first) / 24 / (hourlyFreeHeap.size() / 24.0 - 1));
+  }
+  printf("  arena overflows: web %u", webArena.overflows());
+  for (int i = 0; i < fetchArenaCount(); i++) printf(", fetch%d %u", i, fetchArenaAt(i)->overflows());
+  printf("\n");
+
+  const SimStorageStats& storage = simStorageStats();
+  printf("\nstorage: %u EEPROM commits, %u NVS writes, LittleFS %llu B written, %llu B read\n",
+         storage.eepromCommits - eepromCommitsBefore, storage.nvsWrites,
+         (unsigned long long)storage.fsBytesWritten, (unsigned long long)storage.fsBytesRead);
+}
+
+int main(int argc, char** argv) {
+  if (!parseOptions(argc, argv)) {
+    usage();
+    return 2;
+  }
+
+  MockUpstream* upstream = createUpstream(options.upstream, options.seed);
+  if (upstream == NULL) {
+    usage();
+    return 2;
+  }
+  // Первый адрес - основной макет, остальные - зеркала со своим профилем
+  for (int i = 1; i < upstreamCount(); i++) {
+    MockUpstream* mirror = createUpstream(options.mirror, options.seed + i);
+    if (mirror == NULL) {
+      usage();
+      return 2;
+    }
+    simNetAddMirror(upstreamUrl(i), mirror);
+  }
+  if (options.firmware) {
+    MockUpstream* server = createFirmwareServer(options.firmware);
+    if (server == NULL) {
+      fprintf(stderr, "cannot read %s\n", options.firmware);
+      return 2;
+    }
+    simNetAddMirror(SIM_FIRMWARE_URL, server);
+  }
+  simSetPendingImage(options.pendingImage);
+
+  simSeedRandom(options.seed);
+  if (options.deviceId != 0) simSetDeviceId(options.deviceId);
+  simNetConfigure(options.wifi, options.outages, upstream);
+  if (options.stream) simNetEnableStream(options.streamStalls);
+  for (size_t i = 0; i < options.requests.size(); i++) simQueueRequest(options.requests[i]);
+  provisionDevice();
+  uint32_t eepromCommitsBefore = simStorageStats().eepromCommits;
+
+  simLcd.reset();
+  simLcd.setGeometry(lcd.columns(), lcd.rows());
+  if (options.lcdOutput == LCD_OUTPUT_LIVE) fputs("\x1b[2J", stdout);
+  hourlyFreeHeap.reserve(options.durationMicros / MICROS_PER_HOUR + 1);
+  hourlyLargestBlock.reserve(options.durationMicros / MICROS_PER_HOUR + 1);
+
+  // Все, что выделено до этой точки, - хост, а не устройство
+  simHeapStart(options.heapBytes);
+  simSetIdleHook(idleHook);
+  clock_gettime(CLOCK_MONOTONIC, &realStart);
+  simCreateTask(loopTask, NULL, "loopTask", LOOP_TASK_PRIORITY, LOOP_TASK_STACK_SIZE);
+
+  bool completed = simRun(options.durationMicros);
+  printReport(completed, eepromCommitsBefore);
+
+  const char* reason = simStopReason();
+  return completed || (reason && strcmp(reason, "ESP.restart()") == 0) ? 0 : 1;
+}
@@ -0,0 +1,916 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <WebServer.h>
+#include <ESPmDNS.h>
+#include <ArduinoOTA.h>
+#include <NetworkUdp.h>
+#include <esp_pm.h>
+#include <algorithm>
+#include <deque>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "sim_core.h"
+#include "sim_net.h"
+#include "mock_iss.h"
+
+// Передача ответа веб-интерфейса: ~1 МБ/с через стек lwIP
+#define SIM_WEB_US_PER_BYTE 1
+#define SIM_HTTP_STATUS_LINE_BYTES 64
+// Поток котировок: TCP и TLS, задержка кадра, проверка цен макета
+#define SIM_STREAM_CONNECT_MS 600
+#define SIM_STREAM_LATENCY_MS 40
+#define SIM_STREAM_TICK_MS 1000
+#define SIM_STREAM_HEARTBEAT_MS 20000
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+ArduinoOTAClass ArduinoOTA;
+
+static bool wifiAvailable = true;
+static std::vector<SimWifiOutage> outages;
+static MockUpstream* upstream = NULL;
+// Зеркала: запрос уходит в макет, адрес которого - начало URL
+static std::vector<std::pair<std::string, MockUpstream*> > mirrors;
+
+static bool stationStarted = false;
+static bool apActive = false;
+static std::string stationSsid;
+static uint64_t associatedAtMs = 0;
+static wifi_mode_t wifiMode = WIFI_MODE_NULL;
+static wifi_ps_type_t powerSave = WIFI_PS_MIN_MODEM;
+
+static std::vector<SimScriptedRequest> scriptedRequests;
+static size_t nextRequest = 0;
+// Клиент ведет себя как браузер: помнит ETag страниц и перепроверяет их
+static std::map<std::string, std::string> clientEtags;
+
+static SimFetchStats fetchStats;
+static SimWebStats webStats;
+static SimStreamStats streamStats;
+
+void simNetConfigure(bool available, const std::vector<SimWifiOutage>& scheduledOutages, MockUpstream* mock) {
+  wifiAvailable = available;
+  outages = scheduledOutages;
+  upstream = mock;
+}
+
+void simNetAddMirror(const std::string& urlPrefix, MockUpstream* mock) {
+  mirrors.push_back(std::make_pair(urlPrefix, mock));
+}
+
+static MockUpstream* upstreamFor(const std::string& url) {
+  for (size_t i = 0; i < mirrors.size(); i++) {
+    if (url.compare(0, mirrors[i].first.size(), mirrors[i].first) == 0) return mirrors[i].second;
+  }
+  return upstream;
+}
+
+const SimFetchStats& simFetchStats() {
+  return fetchStats;
+}
+
+const SimStreamStats& simStreamStats() {
+  return streamStats;
+}
+
+const SimWebStats& simWebStats() {
+  return webStats;
+}
+
+uint32_t simWifiOutages() {
+  uint32_t started = 0;
+  for (size_t i = 0; i < outages.size(); i++) {
+    if (outages[i].startMs <= millis()) started++;
+  }
+  return started;
+}
+
+// ---- разбор сценария ----
+
+// Длительность: число с суффиксом ms, s, m, h или d (без суффикса - секунды)
+static bool parseDuration(const char* text, const char** end, uint64_t* ms) {
+  char* rest;
+  double value = strtod(text, &rest);
+  if (rest == text || value < 0) return false;
+
+  double scale = 1000;
+  if (strncmp(rest, "ms", 2) == 0) {
+    scale = 1;
+    rest += 2;
+  } else if (*rest == 's') {
+    rest++;
+  } else if (*rest == 'm') {
+    scale = 60000;
+    rest++;
+  } else if (*rest == 'h') {
+    scale = 3600000;
+    rest++;
+  } else if (*rest == 'd') {
+    scale = 86400000;
+    rest++;
+  }
+  *ms = (uint64_t)(value * scale);
+  *end = rest;
+  return true;
+}
+
+bool simParseOutage(const char* spec, SimWifiOutage* outage) {
+  const char* rest;
+  if (!parseDuration(spec, &rest, &outage->startMs) || *rest != ':') return false;
+  return parseDuration(rest + 1, &rest, &outage->durationMs) && *rest == '\0';
+}
+
+bool simParseRequest(const char* spec, SimScriptedRequest* request) {
+  const char* rest;
+  if (!parseDuration(spec, &rest, &request->atMs) || *rest != ':') return false;
+
+  const char* method = rest + 1;
+  const char* colon = strchr(method, ':');
+  if (colon == NULL || colon == method || colon[1] != '/') return false;
+  request->method.assign(method, colon - method);
+
+  const char* uri = colon + 1;
+  const char* question = strchr(uri, '?');
+  if (question) {
+    request->uri.assign(uri, question - uri);
+    request->query = question + 1;
+  } else {
+    request->uri = uri;
+    request->query.clear();
+  }
+  return true;
+}
+
+void simQueueRequest(const SimScriptedRequest& request) {
+  std::vector<SimScriptedRequest>::iterator it = scriptedRequests.begin() + nextRequest;
+  while (it != scriptedRequests.end() && it->atMs <= request.atMs) ++it;
+  scriptedRequests.insert(it, request);
+}
+
+// ---- Wi-Fi ----
+
+static bool stationUp(uint64_t nowMs) {
+  if (!stationStarted || !wifiAvailable || stationSsid != SIM_WIFI_SSID) return false;
+  if (nowMs < associatedAtMs) return false;
+  for (size_t i = 0; i < outages.size(); i++) {
+    const SimWifiOutage& outage = outages[i];
+    if (nowMs >= outage.startMs && nowMs < outage.startMs + outage.durationMs + SIM_WIFI_ASSOCIATE_MS) return false;
+  }
+  return true;
+}
+
+// Был ли обрыв в промежутке (fromMs, toMs]
+static bool linkDropped(uint64_t fromMs, uint64_t toMs) {
+  if (!stationUp(toMs)) return true;
+  for (size_t i = 0; i < outages.size(); i++) {
+    if (outages[i].startMs > fromMs && outages[i].startMs <= toMs) return true;
+  }
+  return false;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase) {
+  (void)passphrase;
+  stationStarted = true;
+  stationSsid = ssid ? ssid : "";
+  associatedAtMs = millis() + SIM_WIFI_ASSOCIATE_MS;
+  wifiMode = apActive ? WIFI_MODE_APSTA : WIFI_MODE_STA;
+  return WL_DISCONNECTED;
+}
+
+wl_status_t WiFiClass::status() {
+  if (!stationStarted) return WL_IDLE_STATUS;
+  if (stationUp(millis())) return WL_CONNECTED;
+  if (!wifiAvailable || stationSsid != SIM_WIFI_SSID) return WL_NO_SSID_AVAIL;
+  return millis() < associatedAtMs ? WL_DISCONNECTED : WL_CONNECTION_LOST;
+}
+
+bool WiFiClass::disconnect(bool wifiOff) {
+  stationStarted = false;
+  if (wifiOff) {
+    apActive = false;
+    wifiMode = WIFI_MODE_NULL;
+  }
+  return true;
+}
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+  wifiMode = mode;
+  apActive = mode == WIFI_MODE_AP || mode == WIFI_MODE_APSTA;
+  return true;
+}
+
+wifi_mode_t WiFiClass::getMode() {
+  return wifiMode;
+}
+
+bool WiFiClass::setSleep(wifi_ps_type_t sleepType) {
+  return esp_wifi_set_ps(sleepType) == ESP_OK;
+}
+
+wifi_ps_type_t WiFiClass::getSleep() {
+  return powerSave;
+}
+
+bool WiFiClass::softAP(const char* ssid, const char* passphrase) {
+  (void)ssid;
+  (void)passphrase;
+  apActive = true;
+  wifiMode = stationStarted ? WIFI_MODE_APSTA : WIFI_MODE_AP;
+  return true;
+}
+
+IPAddress WiFiClass::softAPIP() {
+  return apActive ? IPAddress(192, 168, 4, 1) : IPAddress();
+}
+
+IPAddress WiFiClass::localIP() {
+  return stationUp(millis()) ? IPAddress(192, 168, 1, 50) : IPAddress();
+}
+
+String WiFiClass::SSID() {
+  return String(stationSsid.c_str());
+}
+
+int8_t WiFiClass::RSSI() {
+  return stationUp(millis()) ? -61 : 0;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type) {
+  powerSave = type;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t* type) {
+  if (type == NULL) return ESP_ERR_INVALID_ARG;
+  *type = powerSave;
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_configure(const void* config) {
+  (void)config;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+// ---- Поток котировок ----
+
+// Сервер потока один и принимает любой адрес: кроме потока прошивка
+// WiFiClient не открывает. Кадры сервера становятся доступны клиенту
+// через SIM_STREAM_LATENCY_MS после отправки
+struct StreamSession {
+  uint32_t id = 0;
+  uint64_t checkedMs = 0;
+  std::string input;
+  bool upgraded = false;
+  bool stompConnected = false;
+  std::deque<std::pair<uint64_t, std::string> > output;
+  size_t outputPos = 0;
+  // id подписки -> бумага, последняя отправленная цена бумаги
+  std::map<std::string, std::string> subscriptions;
+  std::map<std::string, std::string> sentPrices;
+  uint64_t nextTickMs = 0;
+  uint64_t lastSentMs = 0;
+};
+
+static bool streamEnabled = false;
+static std::vector<SimWifiOutage> streamStalls;
+static StreamSession stream;
+static uint32_t lastSessionId = 0;
+
+void simNetEnableStream(const std::vector<SimWifiOutage>& stalls) {
+  streamEnabled = true;
+  streamStalls = stalls;
+}
+
+static bool streamStalled(uint64_t nowMs) {
+  for (size_t i = 0; i < streamStalls.size(); i++) {
+    if (nowMs >= streamStalls[i].startMs && nowMs < streamStalls[i].startMs + streamStalls[i].durationMs) return true;
+  }
+  return false;
+}
+
+// Сервер отдает цены: есть подписки и он не молчит
+static bool streamServing(uint64_t nowMs) {
+  return stream.id != 0 && stream.stompConnected && !stream.subscriptions.empty() && !streamStalled(nowMs);
+}
+
+static void sendServerFrame(const std::string& payload, uint64_t nowMs) {
+  std::string frame(1, (char)0x81);
+  if (payload.size() < 126) {
+    frame += (char)payload.size();
+  } else {
+    frame += (char)126;
+    frame += (char)(payload.size() >> 8);
+    frame += (char)(payload.size() & 0xFF);
+  }
+  frame += payload;
+  stream.output.push_back(std::make_pair(nowMs + SIM_STREAM_LATENCY_MS, frame));
+  stream.lastSentMs = nowMs;
+}
+
+static std::string stompHeader(const std::string& frame, const char* name) {
+  std::string key = std::string("\n") + name + ":";
+  size_t start = frame.find(key);
+  if (start == std::string::npos) return std::string();
+  start += key.size();
+  return frame.substr(start, frame.find('\n', start) - start);
+}
+
+static void handleClientStomp(const std::string& frame, uint64_t nowMs) {
+  std::string command = frame.substr(0, frame.find('\n'));
+  if (command == "CONNECT") {
+    stream.stompConnected = true;
+    stream.nextTickMs = nowMs;
+    sendServerFrame(std::string("CONNECTED\nversion:1.2\nheart-beat:") + std::to_string(SIM_STREAM_HEARTBEAT_MS) +
+                    "," + std::to_string(SIM_STREAM_HEARTBEAT_MS) + "\n\n" + '\0', nowMs);
+  } else if (command == "SUBSCRIBE") {
+    // selector:TICKER="MXSE.TQBR.SBER"
+    std::string selector = stompHeader(frame, "selector");
+    size_t end = selector.rfind('"');
+    size_t dot = selector.rfind('.', end);
+    if (end == std::string::npos || dot == std::string::npos) return;
+    stream.subscriptions[stompHeader(frame, "id")] = selector.substr(dot + 1, end - dot - 1);
+    streamStats.subscribes++;
+  } else if (command == "UNSUBSCRIBE") {
+    stream.subscriptions.erase(stompHeader(frame, "id"));
+  } else if (command == "DISCONNECT") {
+    stream.id = 0;
+  }
+}
+
+// Кадры клиента замаскированы; одно сообщение - heart-beat или кадры STOMP до \0
+static void parseClientFrames(uint64_t nowMs) {
+  while (stream.id != 0 && stream.input.size() >= 2) {
+    const uint8_t* data = (const uint8_t*)stream.input.data();
+    size_t length = data[1] & 0x7F;
+    size_t header = 2;
+    if (length == 126) {
+      if (stream.input.size() < 4) return;
+      length = (data[2] << 8) | data[3];
+      header = 4;
+    } else if (length == 127) {
+      if (stream.input.size() < 10) return;
+      length = 0;
+      for (int i = 0; i < 8; i++) length = (length << 8) | data[2 + i];
+      header = 10;
+    }
+    bool masked = data[1] & 0x80;
+    if (masked) header += 4;
+    if (stream.input.size() < header + length) return;
+
+    std::string payload = stream.input.substr(header, length);
+    if (masked) {
+      for (size_t i = 0; i < length; i++) payload[i] ^= data[header - 4 + (i & 3)];
+    }
+    stream.input.erase(0, header + length);
+
+    if (payload.find_first_not_of("\r\n") == std::string::npos) {
+      streamStats.heartbeatsReceived++;
+      continue;
+    }
+    size_t start = 0;
+    while (start < payload.size()) {
+      size_t end = payload.find('\0', start);
+      if (end == std::string::npos) end = payload.size();
+      size_t first = payload.find_first_not_of("\r\n", start);
+      if (first < end) handleClientStomp(payload.substr(first, end - first), nowMs);
+      start = end + 1;
+    }
+  }
+}
+
+static void handleClientInput(uint64_t nowMs) {
+  if (!stream.upgraded) {
+    size_t end = stream.input.find("\r\n\r\n");
+    if (end == std::string::npos) return;
+    bool websocket = stream.input.find("Upgrade: websocket") != std::string::npos;
+    stream.input.erase(0, end + 4);
+    if (!websocket) {
+      stream.output.push_back(std::make_pair(nowMs + SIM_STREAM_LATENCY_MS, std::string("HTTP/1.1 400 Bad Request\r\n\r\n")));
+      return;
+    }
+    // Sec-WebSocket-Accept прошивка не проверяет
+    stream.output.push_back(std::make_pair(nowMs + SIM_STREAM_LATENCY_MS,
+                                            std::string("HTTP/1.1 101 Switching Protocols\r\n"
+                                                        "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                                                        "Sec-WebSocket-Protocol: v12.stomp\r\n\r\n")));
+    stream.upgraded = true;
+  }
+  parseClientFrames(nowMs);
+}
+
+// Кадры сервера к моменту nowMs: цены раз в SIM_STREAM_TICK_MS при изменении,
+// heart-beat при молчании. Обрыв Wi-Fi закрывает соединение
+static void pumpStream(uint64_t nowMs) {
+  if (stream.id == 0) return;
+  if (linkDropped(stream.checkedMs, nowMs)) {
+    stream.id = 0;
+    return;
+  }
+  stream.checkedMs = nowMs;
+  if (!stream.stompConnected || streamStalled(nowMs)) return;
+
+  // После молчания сервер не досылает пропущенное
+  if (nowMs > stream.nextTickMs + SIM_STREAM_TICK_MS) stream.nextTickMs = nowMs;
+  while (stream.nextTickMs <= nowMs) {
+    uint64_t tickMs = stream.nextTickMs;
+    stream.nextTickMs += SIM_STREAM_TICK_MS;
+    for (std::map<std::string, std::string>::const_iterator it = stream.subscriptions.begin();
+         it != stream.subscriptions.end(); ++it) {
+      std::string last;
+      if (!upstream || !upstream->lastPrice(it->second, tickMs, &last)) continue;
+      if (stream.sentPrices[it->second] == last) continue;
+      stream.sentPrices[it->second] = last;
+      streamStats.lastSent[it->second] = last;
+      streamStats.messages++;
+      std::string body = "{\"columns\":[\"SECID\",\"BOARDID\",\"LAST\"],\"data\":[[\"MXSE.TQBR." + it->second +
+                         "\",\"TQBR\"," + last + "]]}";
+      sendServerFrame("MESSAGE\nsubscription:" + it->first + "\ndestination:MXSE.securities\n\n" + body + '\0',
+                      tickMs);
+    }
+    if (tickMs - stream.lastSentMs >= SIM_STREAM_HEARTBEAT_MS) {
+      sendServerFrame("\n", tickMs);
+      streamStats.heartbeatsSent++;
+    }
+  }
+}
+
+static size_t streamReadable(uint64_t nowMs) {
+  size_t ready = 0;
+  for (size_t i = 0; i < stream.output.size() && stream.output[i].first <= nowMs; i++) {
+    ready += stream.output[i].second.size() - (i == 0 ? stream.outputPos : 0);
+  }
+  return ready;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  (void)host;
+  (void)port;
+  stop();
+  uint64_t startMs = millis();
+  if (!streamEnabled || !stationUp(startMs) || streamStalled(startMs)) {
+    streamStats.refused++;
+    return 0;
+  }
+  delay(SIM_STREAM_CONNECT_MS);
+  if (linkDropped(startMs, millis())) {
+    streamStats.refused++;
+    return 0;
+  }
+  // Новое соединение вытесняет прежнее
+  stream = StreamSession();
+  stream.id = ++lastSessionId;
+  stream.checkedMs = millis();
+  sessionId = stream.id;
+  streamStats.connects++;
+  return 1;
+}
+
+void WiFiClient::stop() {
+  if (sessionId != 0 && sessionId == stream.id) {
+    stream.id = 0;
+    streamStats.closedByClient++;
+  }
+  sessionId = 0;
+}
+
+uint8_t WiFiClient::connected() {
+  if (sessionId == 0) return 0;
+  pumpStream(millis());
+  // Непрочитанное остается доступным и после закрытия сервером
+  return sessionId == stream.id || streamReadable(millis()) > 0;
+}
+
+int WiFiClient::available() {
+  if (sessionId == 0 || sessionId != stream.id) return 0;
+  pumpStream(millis());
+  return (int)streamReadable(millis());
+}
+
+int WiFiClient::read() {
+  uint8_t value;
+  return read(&value, 1) == 1 ? value : -1;
+}
+
+int WiFiClient::peek() {
+  if (available() <= 0) return -1;
+  return (uint8_t)stream.output.front().second[stream.outputPos];
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+  if (available() <= 0) return -1;
+  uint64_t nowMs = millis();
+  size_t done = 0;
+  while (done < size && !stream.output.empty() && stream.output.front().first <= nowMs) {
+    const std::string& chunk = stream.output.front().second;
+    size_t n = std::min(size - done, chunk.size() - stream.outputPos);
+    memcpy(buf + done, chunk.data() + stream.outputPos, n);
+    done += n;
+    stream.outputPos += n;
+    if (stream.outputPos == chunk.size()) {
+      stream.output.pop_front();
+      stream.outputPos = 0;
+    }
+  }
+  return (int)done;
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+  if (sessionId == 0 || sessionId != stream.id) return 0;
+  uint64_t nowMs = millis();
+  pumpStream(nowMs);
+  if (stream.id == 0) return 0;
+  // Молчащий сервер не читает сокет, запись уходит в буфер TCP
+  stream.input.append((const char*)buf, size);
+  if (!streamStalled(nowMs)) handleClientInput(nowMs);
+  return size;
+}
+
+// ---- HTTPClient ----
+
+size_t SimBodyStream::readBytes(char* buffer, size_t length) {
+  size_t n = std::min(length, body.size() - pos);
+  memcpy(buffer, body.data() + pos, n);
+  pos += n;
+  if (bytesPerMs > 0) {
+    uint64_t dueMs = (pacedBytes + n) / bytesPerMs - pacedBytes / bytesPerMs;
+    pacedBytes += n;
+    if (dueMs > 0) delay(dueMs);
+  }
+  return n;
+}
+
+bool HTTPClient::begin(const String& target) {
+  url = target;
+  return true;
+}
+
+void HTTPClient::end() {
+  body.clear();
+}
+
+int HTTPClient::GET() {
+  fetchStats.requests++;
+  if (streamServing(millis())) streamStats.pollsWhileStreaming++;
+  else streamStats.pollsOtherwise++;
+  body.clear();
+
+  uint64_t startMs = millis();
+  MockUpstream* target = upstreamFor(url.c_str());
+  if (target == NULL || !stationUp(startMs)) {
+    fetchStats.notConnected++;
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+
+  SimHttpResponse response = target->get(url.c_str(), startMs);
+  // Сервер не отвечает: ожидание ограничено таймаутом соединения
+  if (response.status <= 0) {
+    delay(std::min<uint64_t>(response.latencyMs, (uint64_t)connectTimeoutMs));
+    fetchStats.notConnected++;
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  if (response.latencyMs > timeoutMs) {
+    delay(timeoutMs);
+    fetchStats.timeouts++;
+    return HTTPC_ERROR_READ_TIMEOUT;
+  }
+
+  delay(response.latencyMs);
+  if (linkDropped(startMs, millis())) {
+    fetchStats.connectionLost++;
+    return HTTPC_ERROR_CONNECTION_LOST;
+  }
+
+  fetchStats.latencyMsTotal += response.latencyMs;
+  fetchStats.latencyMsMax = std::max(fetchStats.latencyMsMax, response.latencyMs);
+  if (response.status == HTTP_CODE_OK) fetchStats.ok++;
+  else fetchStats.httpErrors++;
+
+  fetchStats.bodyBytes += response.body.size();
+  body.assign(response.body, response.bytesPerMs);
+  return response.status;
+}
+
+String HTTPClient::getString() {
+  String result;
+  result.reserve(body.available());
+  while (body.available()) result += (char)body.read();
+  return result;
+}
+
+String HTTPClient::errorToString(int error) {
+  switch (error) {
+    case HTTPC_ERROR_CONNECTION_REFUSED: return "connection refused";
+    case HTTPC_ERROR_SEND_HEADER_FAILED: return "send header failed";
+    case HTTPC_ERROR_SEND_PAYLOAD_FAILED: return "send payload failed";
+    case HTTPC_ERROR_NOT_CONNECTED: return "not connected";
+    case HTTPC_ERROR_CONNECTION_LOST: return "connection lost";
+    case HTTPC_ERROR_NO_STREAM: return "no stream";
+    case HTTPC_ERROR_NO_HTTP_SERVER: return "no HTTP server";
+    case HTTPC_ERROR_TOO_LESS_RAM: return "too less ram";
+    case HTTPC_ERROR_ENCODING: return "Transfer-Encoding not supported";
+    case HTTPC_ERROR_STREAM_WRITE: return "Stream write error";
+    case HTTPC_ERROR_READ_TIMEOUT: return "read Timeout";
+    default: return String();
+  }
+}
+
+// ---- WebServer ----
+
+static HTTPMethod parseMethod(const std::string& name) {
+  if (name == "GET") return HTTP_GET;
+  if (name == "HEAD") return HTTP_HEAD;
+  if (name == "POST") return HTTP_POST;
+  if (name == "PUT") return HTTP_PUT;
+  if (name == "PATCH") return HTTP_PATCH;
+  if (name == "DELETE") return HTTP_DELETE;
+  if (name == "OPTIONS") return HTTP_OPTIONS;
+  return HTTP_ANY;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static std::string urlDecode(const std::string& text) {
+  std::string decoded;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '+') {
+      decoded += ' ';
+    } else if (text[i] == '%' && i + 2 < text.size() && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+      decoded += (char)(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2]));
+      i += 2;
+    } else {
+      decoded += text[i];
+    }
+  }
+  return decoded;
+}
+
+RequestHandler& WebServer::on(const String& uri, HTTPMethod method, THandlerFunction handler) {
+  handlers.push_back(std::unique_ptr<RequestHandler>(new RequestHandler(uri, method, handler)));
+  return *handlers.back();
+}
+
+void WebServer::handleClient() {
+  if (!started || nextRequest >= scriptedRequests.size()) return;
+  if (scriptedRequests[nextRequest].atMs > millis()) return;
+  SimScriptedRequest request = scriptedRequests[nextRequest++];
+
+  // Клиент в сети станции или подключен к точке доступа
+  if (!apActive && !stationUp(millis())) {
+    webStats.unreachable++;
+    return;
+  }
+
+  currentUri = request.uri.c_str();
+  currentMethod = parseMethod(request.method);
+  currentArgs.clear();
+  currentHeaders.clear();
+  size_t start = 0;
+  while (start < request.query.size()) {
+    size_t end = request.query.find('&', start);
+    if (end == std::string::npos) end = request.query.size();
+    std::string pair = request.query.substr(start, end - start);
+    size_t eq = pair.find('=');
+    if (!pair.empty()) {
+      currentArgs.push_back(std::make_pair(urlDecode(pair.substr(0, eq)),
+                                           eq == std::string::npos ? std::string() : urlDecode(pair.substr(eq + 1))));
+    }
+    start = end + 1;
+  }
+  std::map<std::string, std::string>::const_iterator etag = clientEtags.find(request.uri);
+  if (currentMethod == HTTP_GET && etag != clientEtags.end() &&
+      std::find(collectedHeaders.begin(), collectedHeaders.end(), "If-None-Match") != collectedHeaders.end()) {
+    currentHeaders.push_back(std::make_pair(std::string("If-None-Match"), etag->second));
+  }
+
+  contentLength = CONTENT_LENGTH_NOT_SET;
+  responseCode = 0;
+  responseBytes = 0;
+  responseChunked = false;
+  responseHeaders.clear();
+  uint64_t startMicros = micros();
+
+  RequestHandler* match = NULL;
+  for (size_t i = 0; i < handlers.size(); i++) {
+    RequestHandler* handler = handlers[i].get();
+    if (handler->uri != currentUri) continue;
+    if (handler->method != HTTP_ANY && handler->method != currentMethod) continue;
+    if (handler->filter && !handler->filter(*this)) continue;
+    match = handler;
+    break;
+  }
+
+  if (match) match->handler();
+  else if (notFoundHandler) notFoundHandler();
+  else send(404, "text/plain", "Not found");
+
+  webStats.requests++;
+  webStats.perPath[request.uri]++;
+  webStats.perStatus[responseCode]++;
+  webStats.busyMicros += micros() - startMicros;
+  if (simSerialOut) {
+    fprintf(simSerialOut, "[sim] %s %s -> %d, %u B\n", request.method.c_str(), request.uri.c_str(), responseCode,
+            (unsigned)responseBytes);
+  }
+}
+
+const std::string* WebServer::findField(const Fields& fields, const char* name) {
+  for (size_t i = 0; i < fields.size(); i++) {
+    if (strcasecmp(fields[i].first.c_str(), name) == 0) return &fields[i].second;
+  }
+  return NULL;
+}
+
+String WebServer::arg(const String& name) const {
+  const std::string* value = findField(currentArgs, name.c_str());
+  return value ? String(value->c_str()) : String();
+}
+
+String WebServer::arg(int index) const {
+  return index >= 0 && index < args() ? String(currentArgs[index].second.c_str()) : String();
+}
+
+String WebServer::argName(int index) const {
+  return index >= 0 && index < args() ? String(currentArgs[index].first.c_str()) : String();
+}
+
+bool WebServer::hasArg(const String& name) const {
+  return findField(currentArgs, name.c_str()) != NULL;
+}
+
+void WebServer::collectHeaders(const char* headerKeys[], size_t headerKeysCount) {
+  collectedHeaders.clear();
+  for (size_t i = 0; i < headerKeysCount; i++) collectedHeaders.push_back(headerKeys[i]);
+}
+
+String WebServer::header(const String& name) const {
+  const std::string* value = findField(currentHeaders, name.c_str());
+  return value ? String(value->c_str()) : String();
+}
+
+bool WebServer::hasHeader(const String& name) const {
+  return findField(currentHeaders, name.c_str()) != NULL;
+}
+
+void WebServer::send(int code, const char* contentType, const String& content) {
+  beginResponse(code, contentType, content.length());
+  transmit(content.c_str(), content.length());
+}
+
+void WebServer::send(int code, const char* contentType, const char* content) {
+  size_t length = content ? strlen(content) : 0;
+  beginResponse(code, contentType, length);
+  transmit(content, length);
+}
+
+void WebServer::send_P(int code, PGM_P contentType, PGM_P content) {
+  send(code, contentType, content);
+}
+
+void WebServer::send_P(int code, PGM_P contentType, PGM_P content, size_t length) {
+  beginResponse(code, contentType, length);
+  transmit(content, length);
+}
+
+void WebServer::sendHeader(const String& name, const String& value, bool first) {
+  std::pair<std::string, std::string> field(name.c_str(), value.c_str());
+  if (strcasecmp(name.c_str(), "ETag") == 0) clientEtags[currentUri.c_str()] = value.c_str();
+  if (first) responseHeaders.insert(responseHeaders.begin(), field);
+  else responseHeaders.push_back(field);
+}
+
+void WebServer::sendContent(const char* content, size_t size) {
+  // Блок chunked: длина в hex и два CRLF
+  if (responseChunked) transmit(NULL, 8);
+  transmit(content, size);
+}
+
+void WebServer::beginResponse(int code, const char* contentType, size_t length) {
+  responseCode = code;
+  size_t declared = contentLength == CONTENT_LENGTH_NOT_SET ? length : contentLength;
+  responseChunked = declared == CONTENT_LENGTH_UNKNOWN;
+
+  size_t headerBytes = SIM_HTTP_STATUS_LINE_BYTES + (contentType ? strlen(contentType) : 0);
+  for (size_t i = 0; i < responseHeaders.size(); i++) {
+    headerBytes += responseHeaders[i].first.size() + responseHeaders[i].second.size() + 4;
+  }
+  responseHeaders.clear();
+  contentLength = CONTENT_LENGTH_NOT_SET;
+  transmit(NULL, headerBytes);
+}
+
+void WebServer::transmit(const char* data, size_t size) {
+  (void)data;
+  (void)port;
+  responseBytes += size;
+  webStats.responseBytes += size;
+  if (size > 0) delayMicroseconds(size * SIM_WEB_US_PER_BYTE);
+}
+
+// ---- NetworkUDP ----
+
+uint8_t NetworkUDP::beginMulticast(IPAddress address, uint16_t localPort) {
+  stop();
+  if (!stationUp(millis())) return 0;
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) return 0;
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+  sockaddr_in local = {};
+  local.sin_family = AF_INET;
+  local.sin_port = htons(localPort);
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  // Все экземпляры на одной машине: группа на интерфейсе loopback
+  ip_mreq membership = {};
+  membership.imr_multiaddr.s_addr = htonl((uint32_t)address[0] << 24 | address[1] << 16 | address[2] << 8 | address[3]);
+  membership.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+  in_addr loopback = membership.imr_interface;
+  uint8_t loop = 1;
+
+  if (bind(fd, (sockaddr*)&local, sizeof(local)) < 0 ||
+      setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0 ||
+      setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback)) < 0 ||
+      setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0) {
+    stop();
+    return 0;
+  }
+  group = address;
+  port = localPort;
+  return 1;
+}
+
+void NetworkUDP::stop() {
+  if (fd >= 0) close(fd);
+  fd = -1;
+  txLength = -1;
+  rxLength = rxPosition = 0;
+}
+
+int NetworkUDP::beginMulticastPacket() {
+  if (fd < 0) return 0;
+  txLength = 0;
+  return 1;
+}
+
+size_t NetworkUDP::write(uint8_t value) {
+  return write(&value, 1);
+}
+
+size_t NetworkUDP::write(const uint8_t* buffer, size_t size) {
+  if (txLength < 0) return 0;
+  size = std::min(size, (size_t)(SIM_UDP_MAX_PACKET - txLength));
+  memcpy(txBuffer + txLength, buffer, size);
+  txLength += size;
+  return size;
+}
+
+int NetworkUDP::endPacket() {
+  int length = txLength;
+  txLength = -1;
+  // Без связи пакет пропадает в радиоканале, ошибки отправки нет
+  if (length < 0 || fd < 0) return 0;
+  if (!stationUp(millis())) return 1;
+
+  sockaddr_in target = {};
+  target.sin_family = AF_INET;
+  target.sin_port = htons(port);
+  target.sin_addr.s_addr = htonl((uint32_t)group[0] << 24 | group[1] << 16 | group[2] << 8 | group[3]);
+  return sendto(fd, txBuffer, length, 0, (sockaddr*)&target, sizeof(target)) == length;
+}
+
+int NetworkUDP::parsePacket() {
+  rxLength = rxPosition = 0;
+  if (fd < 0) return 0;
+
+  sockaddr_in from = {};
+  socklen_t fromLength = sizeof(from);
+  ssize_t received;
+  // Принятое во время обрыва теряется
+  while ((received = recvfrom(fd, rxBuffer, sizeof(rxBuffer), MSG_DONTWAIT, (sockaddr*)&from, &fromLength)) >= 0) {
+    if (!stationUp(millis())) continue;
+    uint32_t address = ntohl(from.sin_addr.s_addr);
+    remoteAddress = IPAddress(address >> 24, address >> 16, address >> 8, address);
+    remotePortNumber = ntohs(from.sin_port);
+    rxLength = received;
+    return rxLength;
+  }
+  return 0;
+}
+
+int NetworkUDP::read(uint8_t* buffer, size_t length) {
+  int count = std::min((int)length, available());
+  memcpy(buffer, rxBuffer + rxPosition, count);
+  rxPosition += count;
+  return count;
+}
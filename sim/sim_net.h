@@ -0,0 +1,81 @@
+#ifndef SIM_NET_H
+#define SIM_NET_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class MockUpstream;
+
+// Обрыв связи с точкой доступа: с startMs на durationMs, после чего
+// станция переподключается за SIM_WIFI_ASSOCIATE_MS
+struct SimWifiOutage {
+  uint64_t startMs;
+  uint64_t durationMs;
+};
+
+#define SIM_WIFI_ASSOCIATE_MS 2000
+#define SIM_WIFI_SSID "SimNet"
+
+// Запрос к веб-интерфейсу из сценария: --request=T:METHOD:URI?query
+struct SimScriptedRequest {
+  uint64_t atMs;
+  std::string method;
+  std::string uri;
+  std::string query;
+};
+
+struct SimFetchStats {
+  uint32_t requests = 0;
+  uint32_t ok = 0;
+  uint32_t httpErrors = 0;
+  uint32_t notConnected = 0;
+  uint32_t connectionLost = 0;
+  uint32_t timeouts = 0;
+  uint64_t bodyBytes = 0;
+  uint64_t latencyMsTotal = 0;
+  uint32_t latencyMsMax = 0;
+};
+
+// Поток котировок: STOMP поверх WebSocket, цены берутся у макета биржи
+struct SimStreamStats {
+  uint32_t connects = 0;
+  uint32_t refused = 0;
+  uint32_t subscribes = 0;
+  uint32_t messages = 0;
+  uint32_t heartbeatsSent = 0;
+  uint32_t heartbeatsReceived = 0;
+  uint32_t closedByClient = 0;
+  // Запросы к бирже, пока поток отдает цены, и все остальные
+  uint32_t pollsWhileStreaming = 0;
+  uint32_t pollsOtherwise = 0;
+  std::map<std::string, std::string> lastSent;
+};
+
+struct SimWebStats {
+  uint32_t requests = 0;
+  uint32_t unreachable = 0;
+  uint64_t responseBytes = 0;
+  uint64_t busyMicros = 0;
+  std::map<std::string, uint32_t> perPath;
+  std::map<int, uint32_t> perStatus;
+};
+
+// wifiAvailable = false - сеть из настроек не находится, прошивка уходит в AP
+void simNetConfigure(bool wifiAvailable, const std::vector<SimWifiOutage>& outages, MockUpstream* upstream);
+// Запросы на адреса с этим началом обслуживает отдельный макет
+void simNetAddMirror(const std::string& urlPrefix, MockUpstream* mirror);
+bool simParseOutage(const char* spec, SimWifiOutage* outage);
+// Поток котировок включен; в окна stalls сервер молчит, не закрывая
+// соединения, и не принимает новых (формат окна как у --wifi-down)
+void simNetEnableStream(const std::vector<SimWifiOutage>& stalls);
+bool simParseRequest(const char* spec, SimScriptedRequest* request);
+void simQueueRequest(const SimScriptedRequest& request);
+
+const SimFetchStats& simFetchStats();
+const SimWebStats& simWebStats();
+const SimStreamStats& simStreamStats();
+uint32_t simWifiOutages();
+
+#endif
@@ -0,0 +1,210 @@
+#include <Arduino.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include <esp_rom_crc.h>
+#include <rom/miniz.h>
+#include <stdio.h>
+#include <string.h>
+#include "sim_ota.h"
+#include "mock_iss.h"
+
+UpdateClass Update;
+
+static SimOtaStats otaStats;
+static esp_ota_img_states_t runningState = ESP_OTA_IMG_VALID;
+static const esp_partition_t runningPartition = { "app0", 0x10000, SIM_OTA_PARTITION_SIZE };
+
+// ---- Сервер образов ----
+
+class FirmwareServer : public MockUpstream {
+public:
+  explicit FirmwareServer(const std::string& data) : image(data) {}
+
+  SimHttpResponse get(const std::string& url, uint64_t nowMs) override {
+    (void)nowMs;
+    SimHttpResponse response;
+    response.latencyMs = 40;
+    response.bytesPerMs = SIM_FIRMWARE_BYTES_PER_MS;
+    // Любое имя под адресом сервера - тот же файл
+    response.status = url.compare(0, strlen(SIM_FIRMWARE_URL), SIM_FIRMWARE_URL) == 0 ? 200 : 404;
+    if (response.status == 200) response.body = image;
+    return response;
+  }
+
+private:
+  std::string image;
+};
+
+MockUpstream* createFirmwareServer(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) return NULL;
+  std::string data;
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) data.append(buffer, n);
+  fclose(file);
+  return new FirmwareServer(data);
+}
+
+// ---- Раздел и загрузчик ----
+
+void simSetPendingImage(bool pending) {
+  runningState = pending ? ESP_OTA_IMG_PENDING_VERIFY : ESP_OTA_IMG_VALID;
+}
+
+const SimOtaStats& simOtaStats() {
+  return otaStats;
+}
+
+const esp_partition_t* esp_ota_get_running_partition() {
+  return &runningPartition;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state) {
+  if (partition != &runningPartition || state == NULL) return ESP_ERR_INVALID_ARG;
+  *state = runningState;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback() {
+  runningState = ESP_OTA_IMG_VALID;
+  otaStats.confirmed = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot() {
+  runningState = ESP_OTA_IMG_INVALID;
+  otaStats.rolledBack = true;
+  ESP.restart();
+}
+
+// ---- Update ----
+
+bool UpdateClass::begin(size_t size) {
+  if (running) {
+    error = UPDATE_ERROR_BAD_ARGUMENT;
+    return false;
+  }
+  if (size == 0) {
+    error = UPDATE_ERROR_SIZE;
+    return false;
+  }
+  if (size != UPDATE_SIZE_UNKNOWN && size > SIM_OTA_PARTITION_SIZE) {
+    error = UPDATE_ERROR_SPACE;
+    return false;
+  }
+  imageSize = size == UPDATE_SIZE_UNKNOWN ? SIM_OTA_PARTITION_SIZE : size;
+  written = 0;
+  error = UPDATE_ERROR_OK;
+  running = true;
+  otaStats.activated = false;
+  otaStats.imageCrc = 0;
+  otaStats.inflateReadAhead = 0;
+  return true;
+}
+
+// Сектор стирается и пишется, когда в него попадает первый байт
+size_t UpdateClass::write(uint8_t* data, size_t length) {
+  if (!running || hasError()) return 0;
+  if (written == 0 && length > 0 && data[0] != 0xE9) {
+    error = UPDATE_ERROR_MAGIC_BYTE;
+    return 0;
+  }
+  if (written + length > imageSize) {
+    error = UPDATE_ERROR_SPACE;
+    return 0;
+  }
+
+  otaStats.imageCrc = crc32(otaStats.imageCrc, data, length);
+  uint32_t sectorsBefore = (written + SIM_FLASH_SECTOR_SIZE - 1) / SIM_FLASH_SECTOR_SIZE;
+  written += length;
+  uint32_t sectors = (written + SIM_FLASH_SECTOR_SIZE - 1) / SIM_FLASH_SECTOR_SIZE - sectorsBefore;
+  if (sectors > 0) {
+    otaStats.sectorsWritten += sectors;
+    otaStats.flashMs += sectors * SIM_FLASH_SECTOR_MS;
+    delay(sectors * SIM_FLASH_SECTOR_MS);
+  }
+  return length;
+}
+
+bool UpdateClass::end(bool evenIfRemaining) {
+  if (!running || hasError()) return false;
+  if (!evenIfRemaining && written < imageSize) {
+    error = UPDATE_ERROR_SIZE;
+    return false;
+  }
+  running = false;
+  otaStats.imageBytes = written;
+  otaStats.activated = true;
+  return true;
+}
+
+void UpdateClass::abort() {
+  running = false;
+  error = UPDATE_ERROR_ABORT;
+}
+
+const char* UpdateClass::errorString() {
+  switch (error) {
+    case UPDATE_ERROR_OK: return "No Error";
+    case UPDATE_ERROR_WRITE: return "Flash Write Failed";
+    case UPDATE_ERROR_SPACE: return "Not Enough Space";
+    case UPDATE_ERROR_SIZE: return "Bad Size Given";
+    case UPDATE_ERROR_MAGIC_BYTE: return "Wrong Magic Byte";
+    case UPDATE_ERROR_BAD_ARGUMENT: return "Bad Argument";
+    case UPDATE_ERROR_ABORT: return "Aborted";
+    default: return "UNKNOWN";
+  }
+}
+
+// ---- ROM: CRC32 и tinfl ----
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const* buf, uint32_t len) {
+  return crc32(crc, buf, len);
+}
+
+// Поток deflate без заголовка zlib, как у tinfl без TINFL_FLAG_PARSE_ZLIB_HEADER.
+// После конца потока (started 2) или ошибки (3) состояние zlib освобождается.
+// ROM-версия набирает битовый буфер с запасом и к концу потока успевает
+// прочитать до 4 байт после него - здесь они так же числятся прочитанными
+#define SIM_TINFL_READ_AHEAD 4
+
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* pIn_buf_next, size_t* pIn_buf_size,
+                              uint8_t* pOut_buf_start, uint8_t* pOut_buf_next, size_t* pOut_buf_size,
+                              const uint32_t decomp_flags) {
+  (void)pOut_buf_start;
+  (void)decomp_flags;
+  if (r->started > 1) {
+    *pIn_buf_size = 0;
+    *pOut_buf_size = 0;
+    return r->started == 2 ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+  }
+  if (!r->started) {
+    memset(&r->stream, 0, sizeof(r->stream));
+    if (inflateInit2(&r->stream, -MAX_WBITS) != Z_OK) return TINFL_STATUS_FAILED;
+    r->started = 1;
+  }
+
+  r->stream.next_in = (Bytef*)pIn_buf_next;
+  r->stream.avail_in = *pIn_buf_size;
+  r->stream.next_out = pOut_buf_next;
+  r->stream.avail_out = *pOut_buf_size;
+  int result = inflate(&r->stream, Z_NO_FLUSH);
+  *pIn_buf_size -= r->stream.avail_in;
+  *pOut_buf_size -= r->stream.avail_out;
+
+  if (result == Z_STREAM_END) {
+    size_t readAhead = r->stream.avail_in < SIM_TINFL_READ_AHEAD ? r->stream.avail_in : SIM_TINFL_READ_AHEAD;
+    *pIn_buf_size += readAhead;
+    otaStats.inflateReadAhead += readAhead;
+    inflateEnd(&r->stream);
+    r->started = 2;
+    return TINFL_STATUS_DONE;
+  }
+  if (result != Z_OK && result != Z_BUF_ERROR) {
+    inflateEnd(&r->stream);
+    r->started = 3;
+    return TINFL_STATUS_FAILED;
+  }
+  return r->stream.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
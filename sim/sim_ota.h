@@ -0,0 +1,34 @@
+#ifndef SIM_OTA_H
+#define SIM_OTA_H
+
+#include <stdint.h>
+
+class MockUpstream;
+
+// Сервер образов прошивки: --firmware=FILE отдает файл по этому адресу
+#define SIM_FIRMWARE_URL "http://firmware.sim/"
+// Wi-Fi станции при загрузке образа: ~100 КБ/с по HTTP
+#define SIM_FIRMWARE_BYTES_PER_MS 100
+// Стирание и программирование сектора 4 КБ
+#define SIM_FLASH_SECTOR_SIZE 4096
+#define SIM_FLASH_SECTOR_MS 25
+#define SIM_OTA_PARTITION_SIZE 0x140000
+
+struct SimOtaStats {
+  uint32_t sectorsWritten;
+  uint64_t flashMs;
+  uint32_t imageBytes;   // записано в раздел последним обновлением
+  uint32_t imageCrc;     // CRC32 записанного, для сверки с исходным .bin
+  uint32_t inflateReadAhead;  // байт после конца deflate, прочитанных tinfl
+  bool activated;        // образ принят и станет загрузочным
+  bool rolledBack;
+  bool confirmed;
+};
+
+// NULL - файл не читается
+MockUpstream* createFirmwareServer(const char* path);
+// Загруженный образ еще не подтвержден: проверка отката
+void simSetPendingImage(bool pending);
+const SimOtaStats& simOtaStats();
+
+#endif
@@ -0,0 +1,309 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "sim_kernel.h"
+
+// FreeRTOS, аппаратные таймеры и функции времени Arduino поверх sim_kernel
+
+struct SimQueue {
+  uint8_t* storage;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  UBaseType_t count;
+  UBaseType_t head;
+  // Адреса полей - объекты ожидания для отправителей и получателей
+  char sendWait;
+  char receiveWait;
+};
+
+static uint64_t deadlineAfter(TickType_t ticks) {
+  return ticks == portMAX_DELAY ? SIM_FOREVER : simNow() + (uint64_t)ticks * 1000;
+}
+
+// ---- задачи ----
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                                   void* parameters, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t coreId) {
+  (void)coreId;
+  SimTask* task = simCreateTask(function, parameters, name, priority, stackDepth);
+  if (created) *created = task;
+  return task ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                       void* parameters, UBaseType_t priority, TaskHandle_t* created) {
+  return xTaskCreatePinnedToCore(function, name, stackDepth, parameters, priority, created, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  simDeleteTask(task);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (ticks == 0) simYield();
+  else simSleep((uint64_t)ticks * 1000);
+}
+
+void taskYIELD() {
+  simYield();
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)(simNow() / 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return simCurrentTask();
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+  return simTaskPriority(task ? task : simCurrentTask());
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority) {
+  simSetTaskPriority(task ? task : simCurrentTask(), priority);
+}
+
+// Глубина стека не измеряется: стек хоста не соответствует стеку ESP32
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  (void)task;
+  return 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+  return simTakeNotify(clearCountOnExit != pdFALSE, deadlineAfter(ticksToWait));
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  simNotify(task);
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+  simNotify(task);
+  if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdFALSE;
+}
+
+// ---- очереди и семафоры ----
+
+static SimQueue* createQueue(UBaseType_t length, UBaseType_t itemSize, UBaseType_t initialCount) {
+  SimQueue* queue = (SimQueue*)calloc(1, sizeof(SimQueue));
+  if (queue == NULL) return NULL;
+  if (itemSize > 0) {
+    queue->storage = (uint8_t*)malloc((size_t)length * itemSize);
+    if (queue->storage == NULL) {
+      free(queue);
+      return NULL;
+    }
+  }
+  queue->length = length;
+  queue->itemSize = itemSize;
+  queue->count = initialCount;
+  return queue;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  return length > 0 ? createQueue(length, itemSize, 0) : NULL;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  if (queue == NULL) return;
+  free(queue->storage);
+  free(queue);
+}
+
+static bool queuePut(SimQueue* queue, const void* item, uint64_t deadline) {
+  while (queue->count == queue->length) {
+    if (simNow() >= deadline) return false;
+    simWaitUntil(&queue->sendWait, deadline);
+  }
+  if (queue->itemSize > 0) {
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->storage + (size_t)tail * queue->itemSize, item, queue->itemSize);
+  }
+  queue->count++;
+  simWake(&queue->receiveWait);
+  return true;
+}
+
+static bool queueGet(SimQueue* queue, void* buffer, uint64_t deadline) {
+  while (queue->count == 0) {
+    if (simNow() >= deadline) return false;
+    simWaitUntil(&queue->receiveWait, deadline);
+  }
+  if (queue->itemSize > 0) {
+    memcpy(buffer, queue->storage + (size_t)queue->head * queue->itemSize, queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+  }
+  queue->count--;
+  simWake(&queue->sendWait);
+  return true;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+  return queuePut(queue, item, deadlineAfter(ticksToWait)) ? pdPASS : errQUEUE_FULL;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higherPriorityTaskWoken) {
+  if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdFALSE;
+  return queuePut(queue, item, 0) ? pdPASS : errQUEUE_FULL;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+  return queueGet(queue, buffer, deadlineAfter(ticksToWait)) ? pdPASS : errQUEUE_EMPTY;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  queue->count = 0;
+  queue->head = 0;
+  simWake(&queue->sendWait);
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return queue->count;
+}
+
+// Мьютекс - очередь из одного пустого элемента, как в FreeRTOS
+// (наследование приоритета не моделируется)
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return createQueue(1, 0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return createQueue(1, 0, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+  return queueGet(semaphore, NULL, deadlineAfter(ticksToWait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  return queuePut(semaphore, NULL, 0) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken) {
+  if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdFALSE;
+  return xSemaphoreGive(semaphore);
+}
+
+// ---- аппаратные таймеры ----
+
+struct hw_timer_s {
+  SimAlarm alarm; // первым полем: обработчик получает указатель на него
+  uint32_t frequency;
+  uint64_t alarmTicks;
+  bool autoreload;
+  bool running;
+  void (*isr)(void);
+};
+
+static uint64_t timerPeriodMicros(hw_timer_t* timer) {
+  uint64_t period = timer->alarmTicks * 1000000ULL / timer->frequency;
+  return period > 0 ? period : 1;
+}
+
+static void fireTimer(SimAlarm* alarm) {
+  hw_timer_t* timer = (hw_timer_t*)alarm;
+  if (timer->autoreload && timer->running) simArm(&timer->alarm, alarm->at + timerPeriodMicros(timer));
+  else timer->running = false;
+  if (timer->isr) timer->isr();
+}
+
+static void armTimer(hw_timer_t* timer) {
+  if (timer->running && timer->alarmTicks > 0) simArm(&timer->alarm, simNow() + timerPeriodMicros(timer));
+}
+
+hw_timer_t* timerBegin(uint32_t frequency) {
+  if (frequency == 0) return NULL;
+  hw_timer_t* timer = (hw_timer_t*)calloc(1, sizeof(hw_timer_t));
+  if (timer == NULL) return NULL;
+  timer->alarm.fire = fireTimer;
+  timer->frequency = frequency;
+  timer->running = true;
+  return timer;
+}
+
+void timerEnd(hw_timer_t* timer) {
+  if (timer == NULL) return;
+  simDisarm(&timer->alarm);
+  free(timer);
+}
+
+void timerAttachInterrupt(hw_timer_t* timer, void (*isr)(void)) {
+  timer->isr = isr;
+}
+
+void timerDetachInterrupt(hw_timer_t* timer) {
+  timer->isr = NULL;
+}
+
+void timerAlarm(hw_timer_t* timer, uint64_t alarmValue, bool autoreload, uint64_t reloadCount) {
+  (void)reloadCount;
+  timer->alarmTicks = alarmValue;
+  timer->autoreload = autoreload;
+  armTimer(timer);
+}
+
+void timerStart(hw_timer_t* timer) {
+  timer->running = true;
+  armTimer(timer);
+}
+
+void timerStop(hw_timer_t* timer) {
+  timer->running = false;
+  simDisarm(&timer->alarm);
+}
+
+void timerRestart(hw_timer_t* timer) {
+  armTimer(timer);
+}
+
+// ---- время ----
+
+unsigned long millis() {
+  return (unsigned long)(simNow() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)simNow();
+}
+
+int64_t esp_timer_get_time() {
+  return (int64_t)simNow();
+}
+
+void delay(uint32_t ms) {
+  vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+// 10:00 МСК 17.10.2025 - начало торгового дня биржи в mock_iss.cpp.
+// До configTzTime time() считает секунды от загрузки, как ESP32 без SNTP
+#define SIM_CLOCK_EPOCH 1760684400LL
+
+static bool clockSynced = false;
+
+void configTzTime(const char* tz, const char* server1, const char* server2, const char* server3) {
+  (void)server1;
+  (void)server2;
+  (void)server3;
+  setenv("TZ", tz, 1);
+  tzset();
+  clockSynced = true;
+}
+
+extern "C" time_t time(time_t* out) noexcept {
+  time_t now = (time_t)(simNow() / 1000000) + (clockSynced ? SIM_CLOCK_EPOCH : 0);
+  if (out) *out = now;
+  return now;
+}
+
+// Активное ожидание на устройстве; здесь задача уступает процессор,
+// но время в loop() учитывается так же
+void delayMicroseconds(uint32_t us) {
+  if (us > 0) simSleep(us);
+}
+
+void yield() {
+  simYield();
+}
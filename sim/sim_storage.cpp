@@ -0,0 +1,241 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Preferences.h>
+#include <LittleFS.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "sim_storage.h"
+
+EEPROMClass EEPROM;
+fs::LittleFSFS LittleFS;
+
+static SimStorageStats stats;
+
+const SimStorageStats& simStorageStats() {
+  stats.eepromCommits = EEPROM.commits();
+  return stats;
+}
+
+// ---- EEPROM ----
+
+bool EEPROMClass::begin(size_t requested) {
+  if (requested == 0 || requested > SIM_EEPROM_MAX_SIZE) return false;
+  size = requested;
+  return true;
+}
+
+uint8_t EEPROMClass::read(int address) {
+  if (address < 0 || (size_t)address >= size) return 0;
+  return data[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  if (address < 0 || (size_t)address >= size) return;
+  data[address] = value;
+}
+
+bool EEPROMClass::commit() {
+  commitCount++;
+  return true;
+}
+
+// ---- Preferences ----
+
+typedef std::map<std::string, std::string> PreferenceSpace;
+static std::map<std::string, PreferenceSpace> preferenceSpaces;
+
+void Preferences::preset(const char* name, const char* key, const char* value) {
+  preferenceSpaces[name][key] = value;
+}
+
+bool Preferences::begin(const char* name, bool readOnlyMode) {
+  if (name == NULL || strlen(name) > 15) return false;
+  space = name;
+  readOnly = readOnlyMode;
+  opened = true;
+  return true;
+}
+
+void Preferences::end() {
+  opened = false;
+}
+
+bool Preferences::clear() {
+  if (!opened || readOnly) return false;
+  preferenceSpaces[space.c_str()].clear();
+  stats.nvsWrites++;
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  if (!opened || readOnly) return false;
+  stats.nvsWrites++;
+  return preferenceSpaces[space.c_str()].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  if (!opened) return false;
+  PreferenceSpace& values = preferenceSpaces[space.c_str()];
+  return values.find(key) != values.end();
+}
+
+size_t Preferences::putString(const char* key, const String& value) {
+  if (!opened || readOnly) return 0;
+  preferenceSpaces[space.c_str()][key] = value.c_str();
+  stats.nvsWrites++;
+  return value.length();
+}
+
+size_t Preferences::putInt(const char* key, int32_t value) {
+  return putString(key, String((long)value)) ? sizeof(value) : 0;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+  return putString(key, String((unsigned long)value)) ? sizeof(value) : 0;
+}
+
+String Preferences::getString(const char* key, const String& defaultValue) {
+  if (!opened) return defaultValue;
+  PreferenceSpace& values = preferenceSpaces[space.c_str()];
+  PreferenceSpace::iterator it = values.find(key);
+  return it == values.end() ? defaultValue : String(it->second.c_str());
+}
+
+int32_t Preferences::getInt(const char* key, int32_t defaultValue) {
+  return isKey(key) ? (int32_t)getString(key).toInt() : defaultValue;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+  return isKey(key) ? (uint32_t)strtoul(getString(key).c_str(), NULL, 10) : defaultValue;
+}
+
+// ---- LittleFS ----
+
+namespace fs {
+
+struct SimFileNode {
+  std::vector<uint8_t> data;
+};
+
+}  // namespace fs
+
+static std::map<std::string, std::shared_ptr<fs::SimFileNode> > files;
+
+fs::File::File(std::shared_ptr<SimFileNode> node, const char* path, bool writable, bool append)
+  : node(node), filePath(path), pos(append ? node->data.size() : 0), writable(writable), append(append) {}
+
+size_t fs::File::write(uint8_t value) {
+  return write(&value, 1);
+}
+
+size_t fs::File::write(const uint8_t* buf, size_t size) {
+  if (!node || !writable) return 0;
+  if (append) pos = node->data.size();
+  if (pos + size > node->data.size()) node->data.resize(pos + size);
+  memcpy(node->data.data() + pos, buf, size);
+  pos += size;
+  stats.fsBytesWritten += size;
+  return size;
+}
+
+int fs::File::available() {
+  return node && pos < node->data.size() ? (int)(node->data.size() - pos) : 0;
+}
+
+int fs::File::read() {
+  return available() ? node->data[pos++] : -1;
+}
+
+int fs::File::peek() {
+  return available() ? node->data[pos] : -1;
+}
+
+size_t fs::File::read(uint8_t* buf, size_t size) {
+  size_t n = std::min(size, (size_t)available());
+  if (n > 0) memcpy(buf, node->data.data() + pos, n);
+  pos += n;
+  stats.fsBytesRead += n;
+  return n;
+}
+
+bool fs::File::seek(uint32_t offset, SeekMode mode) {
+  if (!node) return false;
+  size_t base = mode == SeekSet ? 0 : mode == SeekCur ? pos : node->data.size();
+  size_t target = base + offset;
+  if (target > node->data.size()) return false;
+  pos = target;
+  return true;
+}
+
+size_t fs::File::size() const {
+  return node ? node->data.size() : 0;
+}
+
+void fs::File::close() {
+  node.reset();
+}
+
+const char* fs::File::name() const {
+  const char* slash = strrchr(filePath.c_str(), '/');
+  return slash ? slash + 1 : filePath.c_str();
+}
+
+fs::File fs::FS::open(const char* path, const char* mode, bool create) {
+  (void)create;
+  std::map<std::string, std::shared_ptr<SimFileNode> >::iterator it = files.find(path);
+  bool writable = mode[0] == 'w' || mode[0] == 'a' || strchr(mode, '+') != NULL;
+
+  if (mode[0] == 'r') {
+    if (it == files.end()) return File();
+    return File(it->second, path, writable, false);
+  }
+
+  std::shared_ptr<SimFileNode> node;
+  if (it == files.end()) {
+    node = std::make_shared<SimFileNode>();
+    files[path] = node;
+  } else {
+    node = it->second;
+  }
+  if (mode[0] == 'w') node->data.clear();
+  return File(node, path, writable, mode[0] == 'a');
+}
+
+bool fs::FS::exists(const char* path) {
+  return files.find(path) != files.end();
+}
+
+bool fs::FS::remove(const char* path) {
+  return files.erase(path) > 0;
+}
+
+bool fs::FS::rename(const char* pathFrom, const char* pathTo) {
+  std::map<std::string, std::shared_ptr<SimFileNode> >::iterator it = files.find(pathFrom);
+  if (it == files.end()) return false;
+  files[pathTo] = it->second;
+  files.erase(pathFrom);
+  return true;
+}
+
+bool fs::LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles,
+                           const char* partitionLabel) {
+  (void)formatOnFail;
+  (void)basePath;
+  (void)maxOpenFiles;
+  (void)partitionLabel;
+  return true;
+}
+
+bool fs::LittleFSFS::format() {
+  files.clear();
+  return true;
+}
+
+size_t fs::LittleFSFS::usedBytes() {
+  size_t used = 0;
+  for (std::map<std::string, std::shared_ptr<SimFileNode> >::iterator it = files.begin(); it != files.end(); ++it) {
+    used += it->second->data.size();
+  }
+  return used;
+}
@@ -0,0 +1,16 @@
+#ifndef SIM_STORAGE_H
+#define SIM_STORAGE_H
+
+#include <stdint.h>
+
+// Износ флеша за прогон
+struct SimStorageStats {
+  uint32_t eepromCommits;
+  uint32_t nvsWrites;
+  uint64_t fsBytesWritten;
+  uint64_t fsBytesRead;
+};
+
+const SimStorageStats& simStorageStats();
+
+#endif
@@ -2,12 +2,12 @@
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <Wire.h>
-#include <LiquidCrystal.h>
 #include <WebServer.h>
 #include <EEPROM.h>
 #include <ESPmDNS.h>
 #include <NetworkUdp.h>
 #include <ArduinoOTA.h>
+#include <LittleFS.h>
 #include "WiFiManager.h"
 
 #include "config.h"
@@ -15,13 +15,29 @@
 #include "network.h"
 #include "eeprom_storage.h"
 #include "web_server.h"
+#include "fetch_pool.h"
+#include "quote_stream.h"
+#include "securities_index.h"
+#include "marquee.h"
+#include "scheduler.h"
+#include "power.h"
+#include "log_ring.h"
+#include "heap_monitor.h"
+#include "lan_fanout.h"
+#include "price_history.h"
+#include "ota.h"
 
-// LCD Pin Configuration
-LiquidCrystal lcd(23, 22, 21, 19, 18, 5);
+// LCD Configuration
+#if DISPLAY_BACKEND == DISPLAY_BACKEND_I2C
+I2CLcdBus lcdDriver(DISPLAY_COLS, DISPLAY_ROWS, DISPLAY_I2C_ADDRESS);
+#else
+ParallelLcdBus lcdDriver(DISPLAY_COLS, DISPLAY_ROWS, 23, 22, 21, 19, 18, 5);
+#endif
+DisplayDriver& lcd = lcdDriver;
 
-// Web server on port 80
+// Web server on port 80, shared with the WiFi manager portal
 WebServer server(80);
-WiFiManager wifiManager(&lcd);
+WiFiManager wifiManager(&lcd, &server);
 // Global variables definitions
 TickerData tickers[MAX_TICKERS];
 int numTickers = 0;
@@ -29,17 +45,25 @@ String stockPrices[MAX_TICKERS];
 char updateIndicators[MAX_TICKERS];
 long updateInterval = 600000;
 long displayChangeInterval = 3000;
-int displayedIndices[2] = {0, 0};
+int fetchConcurrency = FETCH_POOL_DEFAULT_WORKERS;
+int displayMode = DISPLAY_MODE_ROTATE;
+int powerMode = POWER_MODE_PERFORMANCE;
+int lanMode = LAN_MODE_OFF;
+uint32_t configVersion = 0;
+int displayedIndices[DISPLAY_ROWS] = {0};
 int nextLineToReplace = 0;
 int nextTickerIndex = 0;
-unsigned long lastUpdateTime = 0;
-unsigned long lastDisplayChangeTime = 0;
-bool needRestart = false;
-unsigned long restartTime = 0;
+int priceUpdateJob = SCHEDULER_NO_JOB;
+int displayRotateJob = SCHEDULER_NO_JOB;
 
+// Main ticker logic is skipped while the AP portal is active
+bool isStationMode() {
+  return !wifiManager.isAPModeActive();
+}
 
 void setup() {
   Serial.begin(115200);
+  initEventLog();
   Serial.println("\n=== Initializing ESP32 Stock Ticker ===");
   
   initLCD(); // Теперь здесь создаются пользовательские символы
@@ -58,10 +82,20 @@ void setup() {
   Serial.println("Loaded " + String(numTickers) + " tickers from EEPROM");
   
   resetDisplayIndices();
+  initOta();
+  
+  if (LittleFS.begin(true)) {
+    initSecuritiesIndex();
+    initPriceHistory();
+  } else {
+    Serial.println("LittleFS mount failed");
+  }
   
   // Connect to Wi-Fi
   //connectToWiFi();
   wifiManager.begin();
+  // Часы по NTP нужны для дат в истории цен; SNTP сам повторяет запросы
+  configTzTime(PRICE_HISTORY_TIMEZONE, "pool.ntp.org", "time.google.com");
   
   // Set up web server routes
   server.on("/", handleRoot);
@@ -70,42 +104,26 @@ void setup() {
   server.on("/update", HTTP_POST, handleUpdateThreshold);
   server.on("/updateSettings", HTTP_POST, handleUpdateSettings);
   server.on("/clear", HTTP_POST, handleClearAll);
+  server.on("/export", HTTP_GET, handleExport);
+  server.on("/import", HTTP_POST, handleImport);
+  server.on("/api/search", HTTP_GET, handleSearch);
+  server.on("/api/jobs", HTTP_GET, handleJobs);
+  server.on("/api/power", HTTP_GET, handlePower);
+  server.on("/log", HTTP_GET, handleLog);
+  server.on("/api/heap", HTTP_GET, handleHeap);
+  server.on("/api/lan", HTTP_GET, handleLan);
+  server.on("/api/chart", HTTP_GET, handleChart);
+  server.on("/api/upstreams", HTTP_GET, handleUpstreams);
+  server.on("/api/history", HTTP_GET, handleHistory);
+  server.on("/ota", HTTP_POST, handleFirmwareUpdate);
+  server.on("/api/ota", HTTP_GET, handleOtaStatus);
   server.on("/style.css", handleCSS);
-  server.on("/wifi/config", HTTP_GET, []() {
-    if (wifiManager.isAPModeActive()) {
-        // В режиме AP перенаправляем на IP точки доступа
-        server.sendHeader("Location", "http://192.168.4.1/config");
-        server.send(302, "text/plain", "");
-    } else {
-        // В режиме STA показываем страницу настроек
-        server.send(200, "text/html", wifiManager.getConfigHTML());
-    }
-});
-
-server.on("/wifi/save", HTTP_POST, []() {
-    String ssid = server.arg("ssid");
-    String password = server.arg("password");
-    
-    String response = wifiManager.getSaveResponse(ssid, password);
-    
-    if (response.startsWith("Error:")) {
-        server.send(400, "text/plain", response);
-    } else {
-        server.send(200, "text/html", response);
-        
-        // Запланировать перезагрузку
-        needRestart = true;
-        restartTime = millis() + 3000;
-        
-            lcd.clear();
-            lcd.setCursor(0, 0);
-            lcd.print("Settings saved");
-            lcd.setCursor(0, 1);
-            lcd.print("Restarting...");
-    }
-});
+  // Повторная загрузка главной страницы браузером получает 304 по ETag
+  const char* collectedHeaders[] = { "If-None-Match" };
+  server.collectHeaders(collectedHeaders, 1);
   server.begin();
   Serial.println("HTTP server started on port 80");
+  Serial.println("Free heap: " + String(ESP.getFreeHeap()) + ", largest block: " + String(ESP.getMaxAllocHeap()));
   
   // Initial data fetch
   updateAllStockPrices();
@@ -113,43 +131,51 @@ server.on("/wifi/save", HTTP_POST, []() {
   // OTA setup
   ArduinoOTA.setPort(3232);
   ArduinoOTA.setHostname("TickerMashine");
-  ArduinoOTA.setPassword("admin");
+  ArduinoOTA.setPassword(otaPassword);
   ArduinoOTA.begin();
   
+  // Periodic jobs; loop() sleeps between their deadlines
+  scheduleEvery("wifi", 1000, []() {
+    static bool wasAPMode = wifiManager.isAPModeActive();
+    wifiManager.checkConnection();
+    if (wifiManager.isAPModeActive()) stopMarquee();
+    if (wifiManager.isAPModeActive() != wasAPMode) {
+      wasAPMode = wifiManager.isAPModeActive();
+      applyPowerMode();
+    }
+  });
+  // Частый опрос сокетов замедляется в экономичных режимах
+  registerPowerManagedJob(scheduleEvery("http", 10, []() { server.handleClient(); }), 10);
+  // Загрузка по ссылке идет своей задачей; espota на это время не принимается
+  registerPowerManagedJob(scheduleEvery("ota", 50, []() {
+    if (isStationMode() && !isOtaRunning()) ArduinoOTA.handle();
+    handleOta();
+  }), 50);
+  registerPowerManagedJob(scheduleEvery("stream", 20, []() {
+    if (isStationMode()) handleQuoteStream();
+  }), 20);
+  // Сам закрывает сокет без подключения к сети
+  registerPowerManagedJob(scheduleEvery("lan", LAN_POLL_MS, handleLanFanout), LAN_POLL_MS);
+  scheduleEvery("securities", 60000, []() {
+    if (isStationMode()) handleSecuritiesIndex();
+  });
+  scheduleEvery("heap", HEAP_SAMPLE_INTERVAL_MS, sampleHeap);
+  scheduleEvery("history", PRICE_HISTORY_CHECK_MS, []() {
+    if (isStationMode()) handlePriceHistory();
+  });
+  priceUpdateJob = scheduleEvery("prices", updateInterval, []() {
+    if (isStationMode()) runScheduledPriceUpdate();
+  }, updateInterval);
+  displayRotateJob = scheduleEvery("rotate", displayChangeInterval, []() {
+    if (isStationMode()) rotateDisplayLines();
+  }, displayChangeInterval);
+  applyPowerMode();
+  
   Serial.println("=== Setup completed ===");
 
 }
 
 void loop() {
-  if (needRestart && millis() > restartTime) {
-    ESP.restart();
-  }
-
-  wifiManager.checkConnection();
-  wifiManager.processClient();
-  wifiManager.update();
-  if (wifiManager.isAPModeActive()) {
-      // Пропустить основную логику если в режиме AP
-      delay(100);
-      return;
-  }
-  server.handleClient();
-  ArduinoOTA.handle();
-  unsigned long currentMillis = millis();
-
-  // Update data every updateInterval
-  if (currentMillis - lastUpdateTime >= updateInterval) {
-    updateAllStockPrices();
-    lastUpdateTime = currentMillis;
-  }
-  
-  // Rotate display lines if more than 2 tickers
-  if (numTickers > 2 && currentMillis - lastDisplayChangeTime >= displayChangeInterval) {
-    displayedIndices[nextLineToReplace] = nextTickerIndex;
-    displayTickerLine(nextLineToReplace, nextTickerIndex);
-    
-    nextTickerIndex = (nextTickerIndex + 1) % numTickers;
-    nextLineToReplace = 1 - nextLineToReplace;
-    lastDisplayChangeTime = currentMillis;
-  }
-}
\ No newline at end of file
+  runDueJobs();
+  sleepUntilNextJob();
+}
@@ -0,0 +1,372 @@
+#include "upstream.h"
+#include "arena.h"
+#include "log_ring.h"
+#include <HTTPClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <new>
+
+// Дубль: взведен, допускается пулом, идет, не допущен, отменен основной ногой
+#define HEDGE_ARMED 0
+#define HEDGE_STARTING 1
+#define HEDGE_STARTED 2
+#define HEDGE_DROPPED 3
+#define HEDGE_CANCELLED 4
+// Кто отдает цену: основная нога, она же после ожидания дубля, или дубль.
+// FAILED - дубль отказал раньше основной, его итог уже в запросе
+#define HEDGE_CLAIM_OPEN 0
+#define HEDGE_CLAIM_CALLER 1
+#define HEDGE_CLAIM_WAITING 2
+#define HEDGE_CLAIM_HEDGE 3
+#define HEDGE_CLAIM_FAILED 4
+
+#define HEDGE_WORKER_NONE 0
+#define HEDGE_WORKER_STARTING 1
+#define HEDGE_WORKER_READY 2
+
+// Счетчики пишутся из рабочих задач пула атомарно, без блокировок;
+// окно задержек может читаться во время записи - для p95 это не важно
+struct UpstreamState {
+  uint32_t requests;
+  uint32_t failures;
+  uint32_t consecutiveFailures;
+  uint32_t lastFailureMs;
+  uint32_t hedges;
+  uint32_t hedgeWins;
+  uint32_t failovers;
+  uint32_t sampleCount;
+  uint16_t latencyMs[UPSTREAM_LATENCY_SAMPLES];
+};
+
+static UpstreamState states[UPSTREAM_MAX_COUNT];
+
+int upstreamCount() {
+  return min(issUrlCount, UPSTREAM_MAX_COUNT);
+}
+
+const char* upstreamUrl(int upstream) {
+  return issUrls[constrain(upstream, 0, upstreamCount() - 1)];
+}
+
+static bool isHealthy(int upstream) {
+  UpstreamState& state = states[upstream];
+  return __atomic_load_n(&state.consecutiveFailures, __ATOMIC_RELAXED) < UPSTREAM_FAILURE_LIMIT ||
+         millis() - __atomic_load_n(&state.lastFailureMs, __ATOMIC_RELAXED) >= UPSTREAM_RETRY_MS;
+}
+
+int preferredUpstream() {
+  for (int i = 0; i < upstreamCount(); i++) {
+    if (isHealthy(i)) return i;
+  }
+  return 0;
+}
+
+// Следующий после primary исправный адрес, иначе просто следующий; -1 - адрес один
+static int secondaryUpstream(int primary) {
+  int count = upstreamCount();
+  if (count < 2) return -1;
+  for (int step = 1; step < count; step++) {
+    int candidate = (primary + step) % count;
+    if (isHealthy(candidate)) return candidate;
+  }
+  return (primary + 1) % count;
+}
+
+void recordUpstreamResult(int upstream, bool ok, uint32_t latencyMs) {
+  UpstreamState& state = states[upstream];
+  __atomic_fetch_add(&state.requests, 1, __ATOMIC_RELAXED);
+  
+  if (ok) {
+    __atomic_store_n(&state.consecutiveFailures, 0, __ATOMIC_RELAXED);
+    uint32_t slot = __atomic_fetch_add(&state.sampleCount, 1, __ATOMIC_RELAXED);
+    state.latencyMs[slot % UPSTREAM_LATENCY_SAMPLES] = min(latencyMs, (uint32_t)UINT16_MAX);
+    return;
+  }
+  
+  __atomic_fetch_add(&state.failures, 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&state.lastFailureMs, (uint32_t)millis(), __ATOMIC_RELAXED);
+  uint32_t failures = __atomic_add_fetch(&state.consecutiveFailures, 1, __ATOMIC_RELAXED);
+  if (failures == UPSTREAM_FAILURE_LIMIT) {
+    logEvent(LOG_UPSTREAM_DOWN, "", upstream, failures, preferredUpstream());
+  }
+}
+
+// Перцентиль по окну последних задержек; 0 - окно пустое
+static uint32_t latencyPercentile(const UpstreamState& state, int percent, uint32_t* samples) {
+  uint16_t sorted[UPSTREAM_LATENCY_SAMPLES];
+  int count = min(__atomic_load_n(&state.sampleCount, __ATOMIC_RELAXED), (uint32_t)UPSTREAM_LATENCY_SAMPLES);
+  memcpy(sorted, state.latencyMs, sizeof(sorted));
+  for (int i = 1; i < count; i++) {
+    uint16_t value = sorted[i];
+    int j = i;
+    for (; j > 0 && sorted[j - 1] > value; j--) sorted[j] = sorted[j - 1];
+    sorted[j] = value;
+  }
+  
+  if (samples) *samples = count;
+  return count > 0 ? sorted[(count - 1) * percent / 100] : 0;
+}
+
+// Порог дублирования следует за наблюдаемой задержкой адреса
+uint32_t hedgeDelayMs(int upstream) {
+  uint32_t samples;
+  uint32_t p95 = latencyPercentile(states[upstream], 95, &samples);
+  if (samples < UPSTREAM_MIN_SAMPLES) return UPSTREAM_HEDGE_DEFAULT_MS;
+  return constrain(p95, (uint32_t)UPSTREAM_HEDGE_MIN_MS, (uint32_t)UPSTREAM_HEDGE_MAX_MS);
+}
+
+UpstreamStats upstreamStats(int upstream) {
+  const UpstreamState& state = states[upstream];
+  UpstreamStats stats;
+  stats.requests = __atomic_load_n(&state.requests, __ATOMIC_RELAXED);
+  stats.failures = __atomic_load_n(&state.failures, __ATOMIC_RELAXED);
+  stats.consecutiveFailures = __atomic_load_n(&state.consecutiveFailures, __ATOMIC_RELAXED);
+  stats.hedges = __atomic_load_n(&state.hedges, __ATOMIC_RELAXED);
+  stats.hedgeWins = __atomic_load_n(&state.hedgeWins, __ATOMIC_RELAXED);
+  stats.failovers = __atomic_load_n(&state.failovers, __ATOMIC_RELAXED);
+  stats.p50Ms = latencyPercentile(state, 50, NULL);
+  stats.p95Ms = latencyPercentile(state, 95, &stats.samples);
+  return stats;
+}
+
+int upstreamGet(HTTPClient& http, int upstream, const String& path) {
+  // HTTP/1.0 без chunked-кодирования, чтобы разбирать тело прямо из сокета
+  http.useHTTP10(true);
+  http.setConnectTimeout(UPSTREAM_CONNECT_TIMEOUT_MS);
+  // До заголовков ответа действует таймаут сокета, после - таймаут потока
+  http.setTimeout(UPSTREAM_TTFB_TIMEOUT_MS);
+  http.begin(String(upstreamUrl(upstream)) + path);
+  int httpCode = http.GET();
+  if (httpCode == HTTP_CODE_OK) http.getStream().setTimeout(UPSTREAM_BODY_TIMEOUT_MS);
+  return httpCode;
+}
+
+// Один запрос к адресу и разбор ответа
+static String fetchOnce(int upstream, const String& path, const String& symbol, UpstreamParser parse,
+                        int* httpCodeOut) {
+  unsigned long startTime = millis();
+  HTTPClient http;
+  int httpCode = upstreamGet(http, upstream, path);
+  
+  String price = "Error";
+  if (httpCode == HTTP_CODE_OK) {
+    Arena* arena = acquireFetchArena();
+    price = parse(http.getStream(), symbol.c_str(), arena, startTime);
+    releaseFetchArena(arena);
+  } else {
+    logEvent(LOG_FETCH_HTTP_ERROR, symbol.c_str(), httpCode, millis() - startTime);
+  }
+  http.end();
+  
+  recordUpstreamResult(upstream, httpCode == HTTP_CODE_OK, millis() - startTime);
+  if (httpCodeOut) *httpCodeOut = httpCode;
+  return price;
+}
+
+// Дубль запроса. Основная нога идет в задаче пула, дубль - в общей задаче
+// дублей; состояние живет до последней ссылки, дубль может пережить вызов
+struct HedgedRequest {
+  String path;
+  String symbol;
+  UpstreamParser parse;
+  int upstream;
+  UpstreamSlot slot;
+  TaskHandle_t caller;
+  uint32_t deadline;
+  int arm;
+  int claim;
+  bool finished;
+  String price;
+  int httpCode;
+  int refs;
+};
+
+static QueueHandle_t hedgeQueue = NULL;
+static int hedgeWorkerState = HEDGE_WORKER_NONE;
+
+static void releaseHedgedRequest(HedgedRequest* request) {
+  if (__atomic_sub_fetch(&request->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+  delete request;
+}
+
+static bool isArmed(HedgedRequest* request) {
+  return __atomic_load_n(&request->arm, __ATOMIC_ACQUIRE) == HEDGE_ARMED;
+}
+
+// Дубль занимает соединение пакета с начала и до конца, даже проиграв
+static void runHedgeLeg(HedgedRequest* request) {
+  int arm = HEDGE_ARMED;
+  if (!__atomic_compare_exchange_n(&request->arm, &arm, HEDGE_STARTING, false, __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  bool admitted = request->slot.admitLeg(request->slot.context);
+  __atomic_store_n(&request->arm, admitted ? HEDGE_STARTED : HEDGE_DROPPED, __ATOMIC_RELEASE);
+  if (!admitted) return;
+  
+  UpstreamState& state = states[request->upstream];
+  __atomic_fetch_add(&state.hedges, 1, __ATOMIC_RELAXED);
+  int httpCode;
+  String price = fetchOnce(request->upstream, request->path, request->symbol, request->parse, &httpCode);
+  
+  // Итог записывается до решения: основная нога прочтет его и после отказа дубля
+  request->price = price;
+  request->httpCode = httpCode;
+  
+  // Основная нога еще ждет ответа - цену выдает сам дубль, отказ отмечается
+  int claim = HEDGE_CLAIM_OPEN;
+  int outcome = httpCode == HTTP_CODE_OK ? HEDGE_CLAIM_HEDGE : HEDGE_CLAIM_FAILED;
+  if (__atomic_compare_exchange_n(&request->claim, &claim, outcome, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    if (outcome == HEDGE_CLAIM_HEDGE) {
+      __atomic_fetch_add(&state.hedgeWins, 1, __ATOMIC_RELAXED);
+      request->slot.deliver(request->slot.context, request->slot.index, price);
+    }
+  } else if (claim == HEDGE_CLAIM_WAITING) {
+    // Основная отказала и ждет дубль
+    if (httpCode == HTTP_CODE_OK) __atomic_fetch_add(&state.hedgeWins, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&request->finished, true, __ATOMIC_RELEASE);
+    xTaskNotifyGive(request->caller);
+  }
+  request->slot.releaseLeg(request->slot.context);
+}
+
+// Взведенные дубли ждут своего срока; дубли идут по одному, поэтому
+// медленная биржа занимает не больше одного лишнего соединения
+static void hedgeWorker(void* arg) {
+  (void)arg;
+  HedgedRequest* pending[UPSTREAM_HEDGE_QUEUE_SIZE];
+  int count = 0;
+  
+  while (true) {
+    TickType_t wait = portMAX_DELAY;
+    uint32_t now = millis();
+    for (int i = 0; i < count; i++) {
+      int32_t left = (int32_t)(pending[i]->deadline - now);
+      TickType_t ticks = left > 0 ? pdMS_TO_TICKS(left) : 0;
+      if (ticks < wait) wait = ticks;
+    }
+    HedgedRequest* request;
+    if (count < UPSTREAM_HEDGE_QUEUE_SIZE) {
+      if (xQueueReceive(hedgeQueue, &request, wait) == pdTRUE) pending[count++] = request;
+    } else {
+      vTaskDelay(wait);
+    }
+    
+    for (int i = 0; i < count;) {
+      request = pending[i];
+      bool due = (int32_t)(request->deadline - millis()) <= 0;
+      if (isArmed(request) && !due) {
+        i++;
+        continue;
+      }
+      pending[i] = pending[--count];
+      if (isArmed(request)) runHedgeLeg(request);
+      releaseHedgedRequest(request);
+    }
+  }
+}
+
+// Задача дублей создается при первом запросе с запасным адресом
+static bool hedgeWorkerReady() {
+  int state = __atomic_load_n(&hedgeWorkerState, __ATOMIC_ACQUIRE);
+  if (state != HEDGE_WORKER_NONE) return state == HEDGE_WORKER_READY;
+  if (!__atomic_compare_exchange_n(&hedgeWorkerState, &state, HEDGE_WORKER_STARTING, false, __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  
+  if (hedgeQueue == NULL) hedgeQueue = xQueueCreate(UPSTREAM_HEDGE_QUEUE_SIZE, sizeof(HedgedRequest*));
+  bool ready = hedgeQueue != NULL &&
+               xTaskCreate(hedgeWorker, "hedge", UPSTREAM_HEDGE_STACK_SIZE, NULL, uxTaskPriorityGet(NULL), NULL) ==
+                 pdPASS;
+  __atomic_store_n(&hedgeWorkerState, ready ? HEDGE_WORKER_READY : HEDGE_WORKER_NONE, __ATOMIC_RELEASE);
+  return ready;
+}
+
+static HedgedRequest* armHedge(const String& path, const String& symbol, UpstreamParser parse, int upstream,
+                               const UpstreamSlot* slot, uint32_t delayMs) {
+  HedgedRequest* request = new (std::nothrow) HedgedRequest;
+  if (request == NULL) return NULL;
+  
+  request->path = path;
+  request->symbol = symbol;
+  request->parse = parse;
+  request->upstream = upstream;
+  request->slot = *slot;
+  request->caller = xTaskGetCurrentTaskHandle();
+  request->deadline = millis() + delayMs;
+  request->arm = HEDGE_ARMED;
+  request->claim = HEDGE_CLAIM_OPEN;
+  request->finished = false;
+  request->httpCode = 0;
+  request->refs = 2;
+  if (xQueueSend(hedgeQueue, &request, 0) != pdTRUE) {
+    delete request;
+    return NULL;
+  }
+  return request;
+}
+  
+// Основная нога закончилась: не начатый дубль отменяется, начинаемый
+// дожидается решения о допуске
+static int disarmHedge(HedgedRequest* request) {
+  while (true) {
+    int state = HEDGE_ARMED;
+    if (__atomic_compare_exchange_n(&request->arm, &state, HEDGE_CANCELLED, false, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_ACQUIRE)) {
+      return HEDGE_CANCELLED;
+    }
+    if (state != HEDGE_STARTING) return state;
+    vTaskDelay(1);
+  }
+}
+
+static String failover(int upstream, const String& path, const String& symbol, UpstreamParser parse) {
+  __atomic_fetch_add(&states[upstream].failovers, 1, __ATOMIC_RELAXED);
+  return fetchOnce(upstream, path, symbol, parse, NULL);
+}
+
+// Основная нога идет в вызывающей задаче. Дольше своего p95 - дубль на
+// следующий адрес из задачи дублей, отказ - переход на него
+String fetchFromUpstreams(const String& path, const String& symbol, UpstreamParser parse,
+                          const UpstreamSlot* slot) {
+  int primary = preferredUpstream();
+  int secondary = secondaryUpstream(primary);
+  HedgedRequest* request = NULL;
+  if (secondary >= 0 && slot != NULL && hedgeWorkerReady()) {
+    request = armHedge(path, symbol, parse, secondary, slot, hedgeDelayMs(primary));
+  }
+  
+  int httpCode;
+  String price = fetchOnce(primary, path, symbol, parse, &httpCode);
+  bool hedgeRunning = request != NULL && disarmHedge(request) == HEDGE_STARTED;
+  if (!hedgeRunning) {
+    if (request) releaseHedgedRequest(request);
+    // Ответ биржи, даже без цены, окончательный; отказ - повод спросить другой адрес
+    if (httpCode == HTTP_CODE_OK || secondary < 0) return price;
+    return failover(secondary, path, symbol, parse);
+  }
+  
+  int claim = HEDGE_CLAIM_OPEN;
+  int mine = httpCode == HTTP_CODE_OK ? HEDGE_CLAIM_CALLER : HEDGE_CLAIM_WAITING;
+  if (!__atomic_compare_exchange_n(&request->claim, &claim, mine, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    // Дубль отказал первым: ответ основной окончательный, при ее отказе - итог дубля
+    if (claim == HEDGE_CLAIM_FAILED) {
+      if (httpCode != HTTP_CODE_OK) price = request->price;
+      releaseHedgedRequest(request);
+      return price;
+    }
+    // Дубль ответил первым и уже выдал цену
+    releaseHedgedRequest(request);
+    return String();
+  }
+  if (mine == HEDGE_CLAIM_WAITING) {
+    while (!__atomic_load_n(&request->finished, __ATOMIC_ACQUIRE)) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    }
+    price = request->price;
+  }
+  releaseHedgedRequest(request);
+  return price;
+}
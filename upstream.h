@@ -0,0 +1,71 @@
+#ifndef UPSTREAM_H
+#define UPSTREAM_H
+
+#include "config.h"
+
+class Arena;
+class HTTPClient;
+
+// Таймауты по фазам запроса к ISS: соединение (с TLS), первый байт ответа, тело
+#define UPSTREAM_CONNECT_TIMEOUT_MS 3000
+#define UPSTREAM_TTFB_TIMEOUT_MS 4000
+#define UPSTREAM_BODY_TIMEOUT_MS 2000
+#define UPSTREAM_MAX_COUNT 4
+// Задержки последних успешных ответов; p95 - порог дублирования запроса
+#define UPSTREAM_LATENCY_SAMPLES 32
+#define UPSTREAM_MIN_SAMPLES 8
+#define UPSTREAM_HEDGE_DEFAULT_MS 1500
+#define UPSTREAM_HEDGE_MIN_MS 200
+#define UPSTREAM_HEDGE_MAX_MS 4000
+// Столько отказов подряд - адрес пропускается, через минуту пробуется снова
+#define UPSTREAM_FAILURE_LIMIT 3
+#define UPSTREAM_RETRY_MS 60000
+// Дубли идут из одной постоянной задачи, по одному
+#define UPSTREAM_HEDGE_STACK_SIZE 8192
+#define UPSTREAM_HEDGE_QUEUE_SIZE 4
+
+struct UpstreamStats {
+  uint32_t requests;
+  uint32_t failures;
+  uint32_t consecutiveFailures;
+  uint32_t hedges;    // дублирующих запросов на этот адрес
+  uint32_t hedgeWins; // из них ответили первыми
+  uint32_t failovers; // запросов после отказа предыдущего адреса
+  uint32_t p50Ms;
+  uint32_t p95Ms;
+  uint32_t samples;
+};
+
+// Разбор тела ответа; вызывается в задаче запроса
+typedef String (*UpstreamParser)(Stream& stream, const char* symbol, Arena* arena, unsigned long startTime);
+
+// Место запроса в пакете пула. Дубль может ответить раньше основной ноги:
+// тогда цену отдает deliver, а fetchFromUpstreams возвращает пустую строку.
+// Дубль числится соединением пакета от admitLeg до releaseLeg
+struct UpstreamSlot {
+  // false - куча не выдержит еще одно соединение
+  bool (*admitLeg)(void* context);
+  void (*releaseLeg)(void* context);
+  void (*deliver)(void* context, int index, const String& price);
+  void* context;
+  int index;
+};
+
+// GET по пути от базового адреса: основной адрес, при медленном ответе
+// (дольше его p95) - дубль на следующий, берется первый годный ответ; при
+// отказе - следующий адрес. Без slot дубля нет, только переход
+String fetchFromUpstreams(const String& path, const String& symbol, UpstreamParser parse,
+                          const UpstreamSlot* slot);
+
+// Одиночный запрос с таймаутами по фазам, тело - в http.getStream()
+int upstreamGet(HTTPClient& http, int upstream, const String& path);
+void recordUpstreamResult(int upstream, bool ok, uint32_t latencyMs);
+
+int upstreamCount();
+const char* upstreamUrl(int upstream);
+// Первый исправный адрес по порядку в issUrls
+int preferredUpstream();
+uint32_t hedgeDelayMs(int upstream);
+UpstreamStats upstreamStats(int upstream);
+
+#endif
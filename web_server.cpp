@@ -3,11 +3,79 @@
 #include "eeprom_storage.h"
 #include "network.h"
 #include "lcd_display.h"
+#include "fetch_pool.h"
+#include "securities_index.h"
+#include "marquee.h"
+#include "scheduler.h"
+#include "power.h"
+#include "log_ring.h"
+#include "arena.h"
+#include "heap_monitor.h"
+#include "lan_fanout.h"
+#include "quote_provider.h"
+#include "candle_chart.h"
+#include "upstream.h"
+#include "price_history.h"
+#include "ota.h"
 #include <WebServer.h>
 #include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include <esp_random.h>
 
-void handleRoot() {
-  String html = R"=====(
+// Print поверх sendContent: ответ уходит порциями, без сборки в одну String
+class ChunkedResponse : public Print {
+public:
+  size_t write(uint8_t c) override {
+    buffer[length++] = c;
+    if (length == sizeof(buffer)) flush();
+    return 1;
+  }
+  
+  size_t write(const uint8_t* data, size_t size) override {
+    size_t written = 0;
+    while (written < size) {
+      size_t part = min(size - written, sizeof(buffer) - length);
+      memcpy(buffer + length, data + written, part);
+      length += part;
+      written += part;
+      if (length == sizeof(buffer)) flush();
+    }
+    return written;
+  }
+  
+  void flush() override {
+    if (length > 0) server.sendContent(buffer, length);
+    sent += length;
+    length = 0;
+  }
+  
+  size_t sentBytes() const {
+    return sent + length;
+  }
+  
+private:
+  char buffer[512];
+  size_t length = 0;
+  size_t sent = 0;
+};
+
+// JSON-ответ сериализуется в буфер арены запроса и уходит одной отправкой
+static size_t sendJson(JsonDocument& doc) {
+  size_t length = measureJson(doc);
+  char* body = (char*)webArena.allocate(length + 1);
+  if (body == NULL) {
+    server.send(500, "text/plain", "Out of memory");
+    return 0;
+  }
+  serializeJson(doc, body, length + 1);
+  server.send_P(200, "application/json", body, length);
+  webArena.deallocate(body);
+  return length;
+}
+
+static void renderRootPage(Print& out) {
+  out.print(R"=====(
 <!DOCTYPE html>
 <html>
 <head>
@@ -23,7 +91,14 @@ void handleRoot() {
     <div class="section">
       <h2>Добавить Новый Тикер</h2>
       <form action="/add" method="post">
-        <input type="text" name="symbol" placeholder="Тикер (например, SBER)" required maxlength="4">
+        <input type="text" name="symbol" placeholder="Тикер (например, SBER)" required maxlength="12" list="securities" autocomplete="off" oninput="searchSecurities(this.value)">
+        <datalist id="securities"></datalist>
+        <select name="market">
+          <option value="shares">Акции (TQBR)</option>
+          <option value="bonds">Облигации (TQOB)</option>
+          <option value="currency">Валюта (CETS)</option>
+          <option value="futures">Фьючерсы (FORTS)</option>
+        </select>
         <input type="number" step="0.0001" name="threshold" placeholder="Пороговая цена" required>
         <label class="checkbox-label">
           <input type="checkbox" name="isBuy"> Сигнал покупки (звездочка когда цена ниже порога)
@@ -37,70 +112,333 @@ void handleRoot() {
       <table>
         <tr>
           <th>Тикер</th>
+          <th>Цена</th>
+          <th>52 недели</th>
           <th>Порог</th>
           <th>Тип сигнала</th>
           <th>Действие</th>
         </tr>
-)=====";
+)=====");
 
   for (int i = 0; i < numTickers; i++) {
-    html += "<tr>";
-    html += "<td>" + tickers[i].symbol + "</td>";
-    html += "<td>";
-    html += "<form action='/update' method='post' class='inline-form'>";
-    html += "<input type='hidden' name='symbol' value='" + tickers[i].symbol + "'>";
-    html += "<input type='number' step='0.0001' name='threshold' value='" + String(tickers[i].threshold, 5) + "' required>";
-    html += "<label class='checkbox-label'>";
-    html += "<input type='checkbox' name='isBuy' " + String(tickers[i].isBuySignal ? "checked" : "") + "> Покупка";
-    html += "</label>";
-    html += "<button type='submit'>Обновить</button>";
-    html += "</form>";
-    html += "</td>";
-    html += "<td>" + String(tickers[i].isBuySignal ? "Покупка" : "Продажа") + "</td>";
-    html += "<td>";
-    html += "<form action='/remove' method='post' class='inline-form'>";
-    html += "<input type='hidden' name='symbol' value='" + tickers[i].symbol + "'>";
-    html += "<button type='submit' class='remove-btn'>Удалить</button>";
-    html += "</form>";
-    html += "</td>";
-    html += "</tr>";
-  }
-
-  html += R"=====(
+    out.print("<tr>");
+    out.print("<td>");
+    out.print("<a href='#chart' onclick=\"showChart('");
+    out.print(tickers[i].symbol);
+    out.print("', '");
+    out.print(marketName(tickers[i].market));
+    out.print("')\">");
+    out.print(tickers[i].symbol);
+    out.print("</a>");
+    if (tickers[i].market != MARKET_SHARES) {
+      out.print(" <small>");
+      out.print(quoteProvider(tickers[i].market).board());
+      out.print("</small>");
+    }
+    out.print("</td>");
+    // Цена и история меняются без смены настроек: ячейки заполняет скрипт
+    out.print("<td class='price'></td><td class='range'></td>");
+    out.print("<td>");
+    out.print("<form action='/update' method='post' class='inline-form'>");
+    out.print("<input type='hidden' name='symbol' value='");
+    out.print(tickers[i].symbol);
+    out.print("'><input type='hidden' name='market' value='");
+    out.print(marketName(tickers[i].market));
+    out.print("'>");
+    out.print("<input type='number' step='0.0001' name='threshold' value='");
+    out.print(tickers[i].threshold, 5);
+    out.print("' required>");
+    out.print("<label class='checkbox-label'>");
+    out.print("<input type='checkbox' name='isBuy' ");
+    out.print(tickers[i].isBuySignal ? "checked" : "");
+    out.print("> Покупка");
+    out.print("</label>");
+    out.print("<button type='submit'>Обновить</button>");
+    out.print("</form>");
+    out.print("</td>");
+    out.print("<td>");
+    out.print(tickers[i].isBuySignal ? "Покупка" : "Продажа");
+    out.print("</td>");
+    out.print("<td>");
+    out.print("<form action='/remove' method='post' class='inline-form'>");
+    out.print("<input type='hidden' name='symbol' value='");
+    out.print(tickers[i].symbol);
+    out.print("'><input type='hidden' name='market' value='");
+    out.print(marketName(tickers[i].market));
+    out.print("'>");
+    out.print("<button type='submit' class='remove-btn'>Удалить</button>");
+    out.print("</form>");
+    out.print("</td>");
+    out.print("</tr>");
+  }
+
+  out.print(R"=====(
       </table>
     </div>
     
+    <div class="section" id="chart" style="display:none">
+      <h2 id="chartTitle"></h2>
+      <svg id="chartPlot" viewBox="0 0 600 220" width="100%"></svg>
+    </div>
+    
     <div class="section">
       <h2>Настройки Интервалов</h2>
       <form action="/updateSettings" method="post">
         <label>Интервал обновления цен (минуты, мин. 1):</label>
-        <input type="number" step="1" min="1" name="updateInterval" value=")=====";
-  html += String(updateInterval / 60000.0, 0);
-  html += R"=====(" required>
+        <input type="number" step="1" min="1" name="updateInterval" value=")=====");
+  out.print(updateInterval / 60000.0, 0);
+  out.print(R"=====(" required>
         <label>Интервал смены тикеров на дисплее (секунды, мин. 1):</label>
-        <input type="number" step="1" min="1" name="displayChangeInterval" value=")=====";
-  html += String(displayChangeInterval / 1000.0, 0);
-  html += R"=====(" required>
+        <input type="number" step="1" min="1" name="displayChangeInterval" value=")=====");
+  out.print(displayChangeInterval / 1000.0, 0);
+  out.print(R"=====(" required>
+        <label>Параллельных запросов к бирже (1-)=====");
+  out.print(FETCH_POOL_MAX_WORKERS);
+  out.print(R"=====():</label>
+        <input type="number" step="1" min="1" max=")=====");
+  out.print(FETCH_POOL_MAX_WORKERS);
+  out.print(R"=====(" name="fetchConcurrency" value=")=====");
+  out.print(fetchConcurrency);
+  out.print(R"=====(" required>
+        <label>Режим дисплея:</label>
+        <select name="displayMode">
+          <option value="rotate")=====");
+  out.print(displayMode == DISPLAY_MODE_ROTATE ? " selected" : "");
+  out.print(R"=====(>Смена строк</option>
+          <option value="marquee")=====");
+  out.print(displayMode == DISPLAY_MODE_MARQUEE ? " selected" : "");
+  out.print(R"=====(>Бегущая лента</option>
+        </select>
+        <label>Энергосбережение:</label>
+        <select name="powerMode">
+          <option value="performance")=====");
+  out.print(powerMode == POWER_MODE_PERFORMANCE ? " selected" : "");
+  out.print(R"=====(>Выключено</option>
+          <option value="modem")=====");
+  out.print(powerMode == POWER_MODE_MODEM_SLEEP ? " selected" : "");
+  out.print(R"=====(>Modem sleep (DTIM)</option>
+          <option value="light")=====");
+  out.print(powerMode == POWER_MODE_LIGHT_SLEEP ? " selected" : "");
+  out.print(R"=====(>Light sleep</option>
+        </select>
+        <label>Котировки по локальной сети:</label>
+        <select name="lanMode">
+          <option value="off")=====");
+  out.print(lanMode == LAN_MODE_OFF ? " selected" : "");
+  out.print(R"=====(>Выключено</option>
+          <option value="auto")=====");
+  out.print(lanMode == LAN_MODE_AUTO ? " selected" : "");
+  out.print(R"=====(>Авто (выбор ведущего)</option>
+          <option value="follower")=====");
+  out.print(lanMode == LAN_MODE_FOLLOWER ? " selected" : "");
+  out.print(R"=====(>Только ведомый</option>
+        </select>
         <button type="submit">Обновить Настройки</button>
       </form>
     </div>
     
+    <div class="section">
+      <h2>Импорт / Экспорт</h2>
+      <p><a href="/export">Скачать CSV</a> | <a href="/export?format=json">Скачать JSON</a></p>
+      <form action="/import" method="post">
+        <textarea name="data" rows="6" placeholder="SBER,300.5,buy&#10;GAZP,150,sell" required></textarea>
+        <button type="submit">Заменить Тикеры</button>
+      </form>
+    </div>
+    
+    <div class="section">
+      <h2>Обновление Прошивки</h2>
+      <form action="/ota" method="post">
+        <input type="url" name="url" placeholder="http://192.168.1.10:8000/firmware.bin.gz" required>
+        <input type="password" name="password" placeholder="Пароль OTA" required>
+        <button type="submit">Обновить</button>
+      </form>
+      <p><a href="/api/ota">Состояние обновления</a></p>
+    </div>
+    
     <div class="section">
       <h2>Опасная зона</h2>
       <form action="/clear" method="post" onsubmit="return confirm('Вы уверены что хотите удалить ВСЕ тикеры? Это действие нельзя отменить!');">
         <button type="submit" class="danger-btn">Удалить Все Тикеры</button>
       </form>
-    </div>)=====";
+    </div>)=====");
 
-   html += R"=====(<div class="section">
+   out.print(R"=====(<div class="section">
                     <h2><a href='/wifi/config'>WiFi Settings</a></h2>
                    </div>
   </div>
+  <script>
+    function hhmm(m) {
+      return String(Math.floor(m / 60)).padStart(2, '0') + ':' + String(m % 60).padStart(2, '0');
+    }
+    
+    // Ряд уже прорежен устройством: не больше двух точек на корзину
+    function showChart(symbol, market) {
+      document.getElementById('chart').style.display = '';
+      var title = document.getElementById('chartTitle'), svg = document.getElementById('chartPlot');
+      title.textContent = symbol + ': загрузка...';
+      fetch('/api/chart?symbol=' + encodeURIComponent(symbol) + '&market=' + market).then(r => r.status == 202 ? null : r.ok ? r.json() : Promise.reject(r.status)).then(c => {
+        if (!c) { setTimeout(() => showChart(symbol, market), 1000); return; }
+        title.textContent = c.symbol + ' ' + c.date + ' (' + c.candles + ' свечей по ' + c.interval + ' мин)';
+        var pts = c.points, prices = pts.map(p => p[1]);
+        if ('threshold' in c) prices.push(c.threshold);
+        if (!pts.length) { svg.innerHTML = '<text x="300" y="110" text-anchor="middle">Нет сделок</text>'; return; }
+        var lo = Math.min(...prices), hi = Math.max(...prices), t0 = pts[0][0], t1 = pts[pts.length - 1][0];
+        var x = t => 50 + (t - t0) / Math.max(t1 - t0, 1) * 540, y = p => 200 - (p - lo) / Math.max(hi - lo, 1e-9) * 190;
+        var s = '<polyline fill="none" stroke="#2196F3" stroke-width="1.5" points="' +
+          pts.map(p => x(p[0]).toFixed(1) + ',' + y(p[1]).toFixed(1)).join(' ') + '"/>';
+        if ('threshold' in c) s += '<line x1="50" x2="590" y1="' + y(c.threshold) + '" y2="' + y(c.threshold) + '" stroke="#f44336" stroke-dasharray="4"/>';
+        s += '<text x="0" y="14" font-size="11">' + hi + '</text><text x="0" y="204" font-size="11">' + lo + '</text>';
+        s += '<text x="50" y="218" font-size="11">' + hhmm(t0) + '</text><text x="590" y="218" font-size="11" text-anchor="end">' + hhmm(t1) + '</text>';
+        svg.innerHTML = s;
+      }).catch(e => { title.textContent = symbol + ': график недоступен (' + e + ')'; svg.innerHTML = ''; });
+    }
+    
+    // Цена, изменение к прошлому закрытию и диапазон закрытий за 52 недели
+    function loadHistory() {
+      fetch('/api/history').then(r => r.json()).then(h => {
+        var prices = document.querySelectorAll('td.price'), ranges = document.querySelectorAll('td.range');
+        h.tickers.forEach((t, i) => {
+          if (!prices[i]) return;
+          var change = 'change' in t ? ' <small style="color:' + (t.change < 0 ? '#f44336' : '#4CAF50') + '">' +
+            (t.change > 0 ? '+' : '') + t.change.toFixed(2) + '%</small>' : '';
+          prices[i].innerHTML = (t.price || '') + change;
+          if ('prevClose' in t) prices[i].title = 'Закрытие ' + t.prevDate + ': ' + t.prevClose;
+          if ('yearLow' in t) ranges[i].textContent = t.yearLow + ' - ' + t.yearHigh + ' (' + t.closes + ' дн.)';
+        });
+      });
+    }
+    loadHistory();
+    
+    function searchSecurities(q) {
+      if (q.length < 1) return;
+      fetch('/api/search?q=' + encodeURIComponent(q)).then(r => r.json()).then(items => {
+        document.getElementById('securities').innerHTML = items.map(s =>
+          '<option value="' + s.symbol + '">' + s.name + '</option>').join('');
+      });
+    }
+  </script>
 </body>
 </html>
-)=====";
+)=====");
+}
+
+// Подсчет длины без вывода: размер буфера страницы до отрисовки
+class LengthPrint : public Print {
+public:
+  size_t write(uint8_t c) override {
+    length++;
+    return 1;
+  }
+  
+  size_t write(const uint8_t* data, size_t size) override {
+    length += size;
+    return size;
+  }
+  
+  size_t length = 0;
+};
+
+class BufferPrint : public Print {
+public:
+  BufferPrint(char* buffer, size_t capacity) : buffer(buffer), capacity(capacity) {}
+  
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+  
+  size_t write(const uint8_t* data, size_t size) override {
+    size_t part = min(size, capacity - length);
+    memcpy(buffer + length, data, part);
+    length += part;
+    return part;
+  }
+  
+  size_t length = 0;
+  
+private:
+  char* buffer;
+  size_t capacity;
+};
+
+// Отрисованная главная страница живет до следующего изменения configVersion.
+// Буфер переиспользуется и растет с запасом, чтобы новый тикер не требовал нового блока
+#define PAGE_CACHE_SLACK 512
+
+static char* pageCache = NULL;
+static size_t pageCacheCapacity = 0;
+static size_t pageCacheLength = 0;
+static uint32_t pageCacheVersion = 0;
+static bool pageCacheValid = false;
+static char pageEtag[24];
+
+static bool refreshPageCache() {
+  if (pageCacheValid && pageCacheVersion == configVersion) return true;
+  pageCacheValid = false;
+  
+  LengthPrint counter;
+  renderRootPage(counter);
+  if (counter.length > pageCacheCapacity) {
+    // Старое содержимое не нужно: free + malloc вместо realloc без копирования
+    free(pageCache);
+    pageCacheCapacity = counter.length + PAGE_CACHE_SLACK;
+    pageCache = (char*)malloc(pageCacheCapacity);
+    if (pageCache == NULL) {
+      pageCacheCapacity = 0;
+      return false;
+    }
+  }
+  
+  BufferPrint out(pageCache, pageCacheCapacity);
+  renderRootPage(out);
+  pageCacheLength = out.length;
+  pageCacheVersion = configVersion;
+  pageCacheValid = true;
+  
+  // Случайная часть отличает версии страницы до и после перезагрузки
+  static uint32_t bootTag = esp_random();
+  snprintf(pageEtag, sizeof(pageEtag), "\"%08lx-%lu\"", (unsigned long)bootTag, (unsigned long)configVersion);
+  return true;
+}
+
+// Страница отрисовывается один раз на версию настроек и отдается из буфера;
+// браузер перепроверяет ее по ETag и при совпадении получает 304 без тела
+void handleRoot() {
+  if (refreshPageCache()) {
+    server.sendHeader("ETag", pageEtag);
+    server.sendHeader("Cache-Control", "no-cache");
+    if (server.header("If-None-Match") == pageEtag) {
+      server.send(304);
+      logEvent(LOG_WEB_REQUEST, "/", 304, 0);
+      return;
+    }
+    server.send_P(200, "text/html", pageCache, pageCacheLength);
+    logEvent(LOG_WEB_REQUEST, "/", 200, pageCacheLength);
+    return;
+  }
+  
+  // Без памяти под буфер страница отдается порциями по мере формирования
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/html", "");
+  
+  ChunkedResponse out;
+  renderRootPage(out);
+  out.flush();
+  server.sendContent("");
+  logEvent(LOG_WEB_REQUEST, "/", 200, out.sentBytes());
+}
 
-  server.send(200, "text/html", html);
+// Тикер определяется символом и рынком: один код бывает на разных рынках
+static int findTicker(const String& symbol, int market) {
+  for (int i = 0; i < numTickers; i++) {
+    if (tickers[i].market == market && tickers[i].symbol == symbol) return i;
+  }
+  return -1;
+}
+
+// Рынок строки из формы; без поля - акции, как у старых страниц
+static int requestMarket() {
+  return server.hasArg("market") ? parseMarket(server.arg("market")) : MARKET_SHARES;
 }
 
 void handleAddTicker() {
@@ -108,25 +446,36 @@ void handleAddTicker() {
     String symbol = server.arg("symbol");
     float threshold = server.arg("threshold").toFloat();
     bool isBuy = server.hasArg("isBuy");
+    int market = parseMarket(server.arg("market"));
+    if (market < 0) market = MARKET_SHARES;
+    normalizeSymbol(symbol, market);
+    
+    // Длинный символ сдвинул бы записи EEPROM, чужие знаки попали бы в HTML
+    if (!isValidSymbol(symbol)) {
+      server.send(400, "text/plain", "Error: invalid symbol");
+      logEvent(LOG_TICKER_REJECTED, "", 400);
+      return;
+    }
+    
+    // Проверка по справочнику акций без обращения к бирже; без справочника - как раньше
+    if (market == MARKET_SHARES && isSecuritiesIndexReady() && !findSecurity(symbol, NULL)) {
+      server.send(400, "text/plain", "Error: unknown symbol " + symbol);
+      logEvent(LOG_TICKER_REJECTED, symbol.c_str(), 400);
+      return;
+    }
     
     if (numTickers < MAX_TICKERS) {
-      bool exists = false;
-      for (int i = 0; i < numTickers; i++) {
-        if (tickers[i].symbol == symbol) {
-          exists = true;
-          break;
-        }
-      }
-      
-      if (!exists) {
+      if (findTicker(symbol, market) < 0) {
         tickers[numTickers].symbol = symbol;
         tickers[numTickers].threshold = threshold;
         tickers[numTickers].isBuySignal = isBuy;
+        tickers[numTickers].market = market;
         updateIndicators[numTickers] = ' ';
         numTickers++;
+        logEvent(LOG_TICKER_ADDED, symbol.c_str(), numTickers - 1);
         saveTickersToEEPROM();
         resetDisplayIndices();
-        updateAllStockPrices();
+        scheduleStockPriceUpdate();
       }
     }
   }
@@ -138,20 +487,19 @@ void handleAddTicker() {
 void handleRemoveTicker() {
   if (server.hasArg("symbol")) {
     String symbol = server.arg("symbol");
+    int i = findTicker(symbol, requestMarket());
     
-    for (int i = 0; i < numTickers; i++) {
-      if (tickers[i].symbol == symbol) {
-        for (int j = i; j < numTickers - 1; j++) {
-          tickers[j] = tickers[j + 1];
-          stockPrices[j] = stockPrices[j + 1];
-          updateIndicators[j] = updateIndicators[j + 1];
-        }
-        numTickers--;
-        saveTickersToEEPROM();
-        resetDisplayIndices();
-        updateAllStockPrices();
-        break;
+    if (i >= 0) {
+      for (int j = i; j < numTickers - 1; j++) {
+        tickers[j] = tickers[j + 1];
+        stockPrices[j] = stockPrices[j + 1];
+        updateIndicators[j] = updateIndicators[j + 1];
       }
+      numTickers--;
+      logEvent(LOG_TICKER_REMOVED, symbol.c_str());
+      saveTickersToEEPROM();
+      resetDisplayIndices();
+      scheduleStockPriceUpdate();
     }
   }
   
@@ -164,30 +512,30 @@ void handleUpdateThreshold() {
     String symbol = server.arg("symbol");
     float threshold = server.arg("threshold").toFloat();
     bool isBuy = server.hasArg("isBuy");
+    int i = findTicker(symbol, requestMarket());
     
-    for (int i = 0; i < numTickers; i++) {
-      if (tickers[i].symbol == symbol) {
-        String previousPrice = stockPrices[i];
-        updateIndicators[i] = '.';
-        updateDisplay();
-        delay(500);
-        
-        tickers[i].threshold = threshold;
-        tickers[i].isBuySignal = isBuy;
-        
-        stockPrices[i] = getStockPrice(tickers[i].symbol);
-        
-        if (stockPrices[i] != "Error") {
-          updateIndicators[i] = ' ';
-        } else {
-          updateIndicators[i] = 'x';
-          stockPrices[i] = previousPrice;
-        }
-        
-        saveTickersToEEPROM();
-        updateDisplay();
-        break;
+    if (i >= 0) {
+      String previousPrice = stockPrices[i];
+      updateIndicators[i] = '.';
+      invalidateTickerLine(i);
+      updateDisplay();
+      delay(500);
+      
+      tickers[i].threshold = threshold;
+      tickers[i].isBuySignal = isBuy;
+      
+      stockPrices[i] = quoteProvider(tickers[i].market).fetchPrice(tickers[i].symbol, NULL);
+      
+      if (stockPrices[i] != "Error") {
+        updateIndicators[i] = ' ';
+      } else {
+        updateIndicators[i] = 'x';
+        stockPrices[i] = previousPrice;
       }
+      invalidateTickerLine(i);
+      
+      saveTickersToEEPROM();
+      updateDisplay();
     }
   }
   
@@ -208,8 +556,34 @@ void handleUpdateSettings() {
       displayChangeInterval = newDisplayChangeInterval;
     }
     
+    if (server.hasArg("fetchConcurrency")) {
+      int newFetchConcurrency = server.arg("fetchConcurrency").toInt();
+      if (newFetchConcurrency >= 1 && newFetchConcurrency <= FETCH_POOL_MAX_WORKERS) {
+        fetchConcurrency = newFetchConcurrency;
+      }
+    }
+    
+    int newDisplayMode = server.arg("displayMode") == "marquee" ? DISPLAY_MODE_MARQUEE : DISPLAY_MODE_ROTATE;
+    if (newDisplayMode != displayMode) {
+      displayMode = newDisplayMode;
+      stopMarquee();
+    }
+    
+    int newPowerMode = parsePowerMode(server.arg("powerMode"));
+    if (newPowerMode >= 0 && newPowerMode != powerMode) {
+      powerMode = newPowerMode;
+      stopMarquee(); // источник шага ленты зависит от режима
+      applyPowerMode();
+    }
+    
+    int newLanMode = parseLanMode(server.arg("lanMode"));
+    if (newLanMode >= 0) lanMode = newLanMode;
+    
     saveTickersToEEPROM();
+    setJobPeriod(priceUpdateJob, updateInterval);
     resetDisplayIndices();
+    updateDisplay();
+    logEvent(LOG_SETTINGS_UPDATED, "", updateInterval / 60000, displayChangeInterval / 1000, fetchConcurrency);
   }
   
   server.sendHeader("Location", "/");
@@ -222,6 +596,538 @@ void handleClearAll() {
   server.send(303);
 }
 
+// Разбор CSV: "symbol,threshold,buy|sell[,market]" по одной строке, # - комментарий
+static String parseTickersCSV(const String& data, TickerData* parsed, int& count) {
+  count = 0;
+  int lineNo = 0;
+  int pos = 0;
+  
+  while (pos < (int)data.length()) {
+    int end = data.indexOf('\n', pos);
+    if (end == -1) end = data.length();
+    String line = data.substring(pos, end);
+    pos = end + 1;
+    lineNo++;
+    
+    line.trim();
+    if (line.length() == 0 || line.startsWith("#")) continue;
+    if (lineNo == 1 && line.startsWith("symbol")) continue;
+    
+    int c1 = line.indexOf(',');
+    if (c1 == -1) return "line " + String(lineNo) + ": expected symbol,threshold[,buy|sell[,market]]";
+    int c2 = line.indexOf(',', c1 + 1);
+    int c3 = c2 == -1 ? -1 : line.indexOf(',', c2 + 1);
+    
+    String symbol = line.substring(0, c1);
+    String threshold = c2 == -1 ? line.substring(c1 + 1) : line.substring(c1 + 1, c2);
+    String signal = c2 == -1 ? "" : c3 == -1 ? line.substring(c2 + 1) : line.substring(c2 + 1, c3);
+    String marketField = c3 == -1 ? "" : line.substring(c3 + 1);
+    threshold.trim();
+    signal.trim();
+    signal.toLowerCase();
+    marketField.trim();
+    marketField.toLowerCase();
+    int market = marketField.length() == 0 ? MARKET_SHARES : parseMarket(marketField);
+    if (market < 0) return "line " + String(lineNo) + ": market must be shares, bonds, currency or futures";
+    normalizeSymbol(symbol, market);
+    
+    if (count >= MAX_TICKERS) return "too many tickers (max " + String(MAX_TICKERS) + ")";
+    if (!isValidSymbol(symbol)) return "line " + String(lineNo) + ": invalid symbol";
+    if (threshold.length() == 0 || (threshold.toFloat() == 0 && threshold[0] != '0')) {
+      return "line " + String(lineNo) + ": invalid threshold";
+    }
+    if (signal.length() > 0 && signal != "buy" && signal != "sell" && signal != "1" && signal != "0") {
+      return "line " + String(lineNo) + ": signal must be buy or sell";
+    }
+    
+    parsed[count].symbol = symbol;
+    parsed[count].threshold = threshold.toFloat();
+    parsed[count].isBuySignal = (signal == "buy" || signal == "1");
+    parsed[count].market = market;
+    count++;
+  }
+  
+  return "";
+}
+
+// Настройки, которые можно передать вместе с тикерами в JSON
+struct ImportSettings {
+  long updateInterval;
+  long displayChangeInterval;
+  int fetchConcurrency;
+  int displayMode;
+  int powerMode;
+  int lanMode;
+};
+
+// Разбор JSON: {"tickers":[{"symbol":"SBER","threshold":300.5,"isBuy":true}],
+// "updateInterval":10,"displayChangeInterval":3} или просто массив тикеров
+static String parseTickersJSON(const String& data, TickerData* parsed, int& count,
+                               ImportSettings& settings) {
+  count = 0;
+  ArenaJsonAllocator allocator(&webArena);
+  JsonDocument doc(&allocator);
+  DeserializationError error = deserializeJson(doc, data);
+  if (error) return String("JSON parsing error: ") + error.c_str();
+  
+  JsonArray list = doc.is<JsonArray>() ? doc.as<JsonArray>() : doc["tickers"].as<JsonArray>();
+  if (list.isNull()) return "missing tickers array";
+  if (list.size() > MAX_TICKERS) return "too many tickers (max " + String(MAX_TICKERS) + ")";
+  
+  for (JsonObject item : list) {
+    int market = item["market"].is<const char*>() ? parseMarket(item["market"].as<const char*>()) : MARKET_SHARES;
+    if (market < 0) return "item " + String(count + 1) + ": market must be shares, bonds, currency or futures";
+    String symbol = item["symbol"] | "";
+    normalizeSymbol(symbol, market);
+    if (!isValidSymbol(symbol)) return "item " + String(count + 1) + ": invalid symbol";
+    if (!item["threshold"].is<float>()) return "item " + String(count + 1) + ": invalid threshold";
+    
+    parsed[count].symbol = symbol;
+    parsed[count].threshold = item["threshold"].as<float>();
+    parsed[count].isBuySignal = item["isBuy"] | false;
+    parsed[count].market = market;
+    count++;
+  }
+  
+  if (!doc.is<JsonArray>()) {
+    if (doc["updateInterval"].is<long>()) {
+      long value = doc["updateInterval"].as<long>() * 60000;
+      if (value < 60000) return "updateInterval must be at least 1 minute";
+      settings.updateInterval = value;
+    }
+    if (doc["displayChangeInterval"].is<long>()) {
+      long value = doc["displayChangeInterval"].as<long>() * 1000;
+      if (value < 1000) return "displayChangeInterval must be at least 1 second";
+      settings.displayChangeInterval = value;
+    }
+    if (doc["fetchConcurrency"].is<int>()) {
+      int value = doc["fetchConcurrency"].as<int>();
+      if (value < 1 || value > FETCH_POOL_MAX_WORKERS) return "fetchConcurrency out of range";
+      settings.fetchConcurrency = value;
+    }
+    if (doc["displayMode"].is<const char*>()) {
+      String value = doc["displayMode"].as<const char*>();
+      if (value == "rotate") settings.displayMode = DISPLAY_MODE_ROTATE;
+      else if (value == "marquee") settings.displayMode = DISPLAY_MODE_MARQUEE;
+      else return "displayMode must be rotate or marquee";
+    }
+    if (doc["powerMode"].is<const char*>()) {
+      int value = parsePowerMode(doc["powerMode"].as<const char*>());
+      if (value < 0) return "powerMode must be performance, modem or light";
+      settings.powerMode = value;
+    }
+    if (doc["lanMode"].is<const char*>()) {
+      int value = parseLanMode(doc["lanMode"].as<const char*>());
+      if (value < 0) return "lanMode must be off, auto or follower";
+      settings.lanMode = value;
+    }
+  }
+  
+  return "";
+}
+
+void handleExport() {
+  ArenaScope scope(webArena);
+  bool asJson = server.arg("format") == "json";
+  size_t length = 0;
+  server.sendHeader("Content-Disposition", String("attachment; filename=tickers.") + (asJson ? "json" : "csv"));
+  
+  if (asJson) {
+    ArenaJsonAllocator allocator(&webArena);
+    JsonDocument doc(&allocator);
+    doc["updateInterval"] = updateInterval / 60000;
+    doc["displayChangeInterval"] = displayChangeInterval / 1000;
+    doc["fetchConcurrency"] = fetchConcurrency;
+    doc["displayMode"] = displayMode == DISPLAY_MODE_MARQUEE ? "marquee" : "rotate";
+    doc["powerMode"] = powerModeName(powerMode);
+    doc["lanMode"] = lanModeName(lanMode);
+    JsonArray list = doc["tickers"].to<JsonArray>();
+    for (int i = 0; i < numTickers; i++) {
+      JsonObject item = list.add<JsonObject>();
+      item["symbol"] = tickers[i].symbol;
+      item["threshold"] = tickers[i].threshold;
+      item["isBuy"] = tickers[i].isBuySignal;
+      item["market"] = marketName(tickers[i].market);
+    }
+    length = sendJson(doc);
+  } else {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/csv", "");
+    ChunkedResponse out;
+    out.print("symbol,threshold,signal,market\n");
+    for (int i = 0; i < numTickers; i++) {
+      out.print(tickers[i].symbol);
+      out.print(',');
+      out.print(tickers[i].threshold, 5);
+      out.print(tickers[i].isBuySignal ? ",buy," : ",sell,");
+      out.print(marketName(tickers[i].market));
+      out.print('\n');
+    }
+    out.flush();
+    server.sendContent("");
+    length = out.sentBytes();
+  }
+  
+  logEvent(LOG_WEB_REQUEST, "/export", 200, length);
+}
+
+void handleImport() {
+  ArenaScope scope(webArena);
+  // Форма отправляет поле data, API-клиенты - тело запроса целиком
+  bool fromForm = server.hasArg("data");
+  String data = fromForm ? server.arg("data") : server.arg("plain");
+  data.trim();
+  
+  TickerData parsed[MAX_TICKERS];
+  int count = 0;
+  ImportSettings settings = { updateInterval, displayChangeInterval, fetchConcurrency, displayMode, powerMode, lanMode };
+  
+  String error;
+  if (data.startsWith("{") || data.startsWith("[")) {
+    error = parseTickersJSON(data, parsed, count, settings);
+  } else {
+    error = parseTickersCSV(data, parsed, count);
+  }
+  
+  for (int i = 0; error.length() == 0 && i < count; i++) {
+    if (parsed[i].market == MARKET_SHARES && isSecuritiesIndexReady() && !findSecurity(parsed[i].symbol, NULL)) {
+      error = "unknown symbol " + parsed[i].symbol;
+      break;
+    }
+    for (int j = 0; j < i; j++) {
+      if (parsed[i].symbol == parsed[j].symbol && parsed[i].market == parsed[j].market) {
+        error = "duplicate symbol " + parsed[i].symbol;
+        break;
+      }
+    }
+  }
+  
+  if (error.length() > 0) {
+    server.send(400, "text/plain", "Error: " + error);
+    logEvent(LOG_IMPORT_REJECTED, error.c_str());
+    return;
+  }
+  
+  // Набор проверен целиком - применяем, сохраняя известные цены совпадающих тикеров
+  String prices[MAX_TICKERS];
+  for (int i = 0; i < count; i++) {
+    int j = findTicker(parsed[i].symbol, parsed[i].market);
+    prices[i] = j >= 0 ? stockPrices[j] : "";
+  }
+  
+  for (int i = 0; i < count; i++) {
+    tickers[i] = parsed[i];
+    stockPrices[i] = prices[i];
+  }
+  for (int i = count; i < MAX_TICKERS; i++) stockPrices[i] = "";
+  numTickers = count;
+  updateInterval = settings.updateInterval;
+  displayChangeInterval = settings.displayChangeInterval;
+  fetchConcurrency = settings.fetchConcurrency;
+  if (settings.displayMode != displayMode) {
+    displayMode = settings.displayMode;
+    stopMarquee();
+  }
+  if (settings.powerMode != powerMode) {
+    powerMode = settings.powerMode;
+    stopMarquee();
+    applyPowerMode();
+  }
+  lanMode = settings.lanMode;
+  
+  saveTickersToEEPROM();
+  setJobPeriod(priceUpdateJob, updateInterval);
+  resetDisplayIndices();
+  updateDisplay();
+  scheduleStockPriceUpdate();
+  logEvent(LOG_IMPORT_DONE, "", count);
+  
+  if (fromForm) {
+    server.sendHeader("Location", "/");
+    server.send(303);
+  } else {
+    server.send(200, "text/plain", "Imported " + String(count) + " tickers");
+  }
+}
+
+// Автодополнение по справочнику бумаг: /api/search?q=SB
+void handleSearch() {
+  String prefix = server.arg("q");
+  prefix.trim();
+  prefix.toUpperCase();
+  
+  SecurityRecord results[10];
+  int count = searchSecurities(prefix, results, 10);
+  
+  ArenaScope scope(webArena);
+  ArenaJsonAllocator allocator(&webArena);
+  JsonDocument doc(&allocator);
+  JsonArray list = doc.to<JsonArray>();
+  for (int i = 0; i < count; i++) {
+    JsonObject item = list.add<JsonObject>();
+    item["symbol"] = results[i].symbol;
+    item["name"] = results[i].shortName;
+    item["board"] = results[i].board;
+    item["decimals"] = results[i].decimals;
+  }
+  
+  logEvent(LOG_WEB_REQUEST, "/api/search", 200, sendJson(doc));
+}
+
+// Статистика планировщика: /api/jobs
+void handleJobs() {
+  ArenaScope scope(webArena);
+  ArenaJsonAllocator allocator(&webArena);
+  JsonDocument doc(&allocator);
+  uint64_t uptimeMicros = esp_timer_get_time();
+  uint64_t sleepMicros = schedulerSleepMicros();
+  doc["uptimeMs"] = uptimeMicros / 1000;
+  doc["sleepMs"] = sleepMicros / 1000;
+  doc["idlePercent"] = uptimeMicros > 0 ? (float)(sleepMicros * 100.0 / uptimeMicros) : 0.0f;
+  
+  JsonArray list = doc["jobs"].to<JsonArray>();
+  for (int id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+    JobStats stats;
+    if (!getJobStats(id, &stats)) continue;
+    JsonObject item = list.add<JsonObject>();
+    item["name"] = stats.name;
+    item["period"] = stats.period;
+    item["runs"] = stats.runs;
+    item["avgMicros"] = stats.runs > 0 ? (uint32_t)(stats.totalMicros / stats.runs) : 0;
+    item["maxMicros"] = stats.maxMicros;
+  }
+  
+  sendJson(doc);
+}
+
+// Доля сна и оценка среднего тока по режимам: /api/power
+void handlePower() {
+  ArenaScope scope(webArena);
+  ArenaJsonAllocator allocator(&webArena);
+  JsonDocument doc(&allocator);
+  doc["mode"] = powerModeName(powerMode);
+  doc["lightSleep"] = isLightSleepActive();
+  
+  JsonObject modes = doc["modes"].to<JsonObject>();
+  for (int mode = 0; mode < POWER_MODE_COUNT; mode++) {
+    PowerStats stats;
+    if (!getPowerStats(mode, &stats)) continue;
+    JsonObject item = modes[powerModeName(mode)].to<JsonObject>();
+    item["asleepMs"] = stats.asleepMicros / 1000;
+    item["awakeMs"] = stats.awakeMicros / 1000;
+    item["averageMilliamps"] = stats.averageMilliamps;
+  }
+  
+  sendJson(doc);
+}
+
+static String formatLanId(uint32_t id) {
+  char text[9];
+  snprintf(text, sizeof(text), "%08lx", (unsigned long)id);
+  return text;
+}
+
+// Внутридневной график: /api/chart?symbol=SBER[&market=bonds][&interval=1|10|60].
+// Порог берется из списка тикеров, если бумага этого рынка в нем есть
+void handleChart() {
+  String symbol = server.arg("symbol");
+  int market = requestMarket();
+  int interval = server.hasArg("interval") ? server.arg("interval").toInt() : CHART_DEFAULT_INTERVAL;
+  if (market < 0 || !isValidChartInterval(interval)) {
+    server.send(400, "text/plain", "Error: invalid market or interval");
+    return;
+  }
+  normalizeSymbol(symbol, market);
+  
+  const TickerData* ticker = NULL;
+  for (int i = 0; i < numTickers; i++) {
+    if (tickers[i].market == market && tickers[i].symbol.equalsIgnoreCase(symbol)) {
+      ticker = &tickers[i];
+      symbol = ticker->symbol;
+      break;
+    }
+  }
+  if (!isValidSymbol(symbol)) {
+    server.send(400, "text/plain", "Error: invalid symbol");
+    return;
+  }
+  
+  // Свечи грузятся в фоне: страница повторяет запрос, пока идет загрузка
+  const CandleChart* chart = NULL;
+  int result = requestCandleChart(symbol, market, interval, &chart);
+  if (result != CHART_READY) {
+    int code = result == CHART_LOADING ? 202 : result == CHART_BUSY ? 503 : 502;
+    server.send(code, "text/plain", result == CHART_LOADING ? "Loading" :
+                result == CHART_BUSY ? "Error: busy, retry later" : "Error: candles unavailable");
+    logEvent(LOG_WEB_REQUEST, "/api/chart", code, 0);
+    return;
+  }
+  
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  ChunkedResponse out;
+  printCandleChart(out, *chart, ticker);
+  out.flush();
+  server.sendContent("");
+  logEvent(LOG_WEB_REQUEST, "/api/chart", 200, out.sentBytes());
+}
+
+// Адреса ISS: задержки, отказы и дублированные запросы: /api/upstreams
+void handleUpstreams() {
+  ArenaScope scope(webArena);
+  ArenaJsonAllocator allocator(&webArena);
+  JsonDocument doc(&allocator);
+  doc["preferred"] = preferredUpstream();
+  JsonArray list = doc["upstreams"].to<JsonArray>();
+  for (int i = 0; i < upstreamCount(); i++) {
+    UpstreamStats stats = upstreamStats(i);
+    JsonObject item = list.add<JsonObject>();
+    item["url"] = upstreamUrl(i);
+    item["requests"] = stats.requests;
+    item["failures"] = stats.failures;
+    item["consecutiveFailures"] = stats.consecutiveFailures;
+    item["p50Ms"] = stats.p50Ms;
+    item["p95Ms"] = stats.p95Ms;
+    item["hedgeDelayMs"] = hedgeDelayMs(i);
+    item["hedges"] = stats.hedges;
+    item["hedgeWins"] = stats.hedgeWins;
+    item["failovers"] = stats.failovers;
+  }
+  
+  sendJson(doc);
+}
+
+// Текущие цены с изменением к прошлому закрытию и диапазоном 52 недель
+// из истории во флеше, без запросов к бирже: /api/history
+void handleHistory() {
+  ArenaScope scope(webArena);
+  ArenaJsonAllocator allocator(&webArena);
+  JsonDocument doc(&allocator);
+  doc["clockSynced"] = isClockSynced();
+  doc["bytes"] = priceHistoryBytes();
+  JsonArray list = doc["tickers"].to<JsonArray>();
+  for (int i = 0; i < numTickers; i++) {
+    JsonObject item = list.add<JsonObject>();
+    item["symbol"] = tickers[i].symbol;
+    item["market"] = marketName(tickers[i].market);
+    if (stockPrices[i].length() > 0 && stockPrices[i] != "Error") item["price"] = stockPrices[i];
+  
+    PriceStats stats;
+    float percent;
+    if (dayChangePercent(i, &stats, &percent)) item["change"] = percent;
+    else if (!getPriceStats(tickers[i], &stats)) continue;
+    item["prevClose"] = stats.prevClose;
+    item["prevDate"] = stats.prevDate;
+    item["yearLow"] = stats.yearLow;
+    item["yearHigh"] = stats.yearHigh;
+    item["closes"] = stats.closes;
+  }
+  
+  sendJson(doc);
+}
+
+// Обновление прошивки по ссылке на образ (.bin, .bin.gz или heatshrink):
+// загрузка идет в фоне, дисплей и веб-интерфейс продолжают работать
+void handleFirmwareUpdate() {
+  if (!server.hasArg("password") || server.arg("password") != otaPassword) {
+    server.send(403, "text/plain", "Error: wrong password");
+    return;
+  }
+  String url = server.arg("url");
+  if (!url.startsWith("http://") && !url.startsWith("https://")) {
+    server.send(400, "text/plain", "Error: expected http:// or https:// URL");
+    return;
+  }
+  if (!startOtaUpdate(url)) {
+    server.send(409, "text/plain", "Error: update already running or not enough memory");
+    return;
+  }
+  
+  server.sendHeader("Location", "/");
+  server.send(303);
+}
+
+// Ход текущего обновления и итог последнего: /api/ota
+void handleOtaStatus() {
+  static const char* stateNames[] = { "idle", "running", "done", "failed" };
+  ArenaScope scope(webArena);
+  ArenaJsonAllocator allocator(&webArena);
+  JsonDocument doc(&allocator);
+  OtaStatus status = otaStatus();
+  doc["state"] = stateNames[status.state];
+  doc["pendingConfirm"] = isOtaPendingConfirm();
+  if (status.state != OTA_STATE_IDLE || status.error) {
+    doc["format"] = otaFormatName(status.format);
+    doc["received"] = status.received;
+    if (status.total >= 0) doc["total"] = status.total;
+    doc["written"] = status.written;
+    if (status.elapsedMs > 0) doc["elapsedMs"] = status.elapsedMs;
+    if (status.error) doc["error"] = status.error;
+  }
+  
+  OtaReport report;
+  if (lastOtaReport(&report)) {
+    JsonObject last = doc["last"].to<JsonObject>();
+    last["format"] = otaFormatName(report.format);
+    last["downloaded"] = report.received;
+    last["imageBytes"] = report.written;
+    last["savedPercent"] = report.written ? 100.0f - 100.0f * report.received / report.written : 0.0f;
+    last["elapsedMs"] = report.elapsedMs;
+  }
+  
+  sendJson(doc);
+}
+
+// Роль в раздаче котировок по сети и счетчики кадров: /api/lan
+void handleLan() {
+  ArenaScope scope(webArena);
+  ArenaJsonAllocator allocator(&webArena);
+  JsonDocument doc(&allocator);
+  doc["mode"] = lanModeName(lanMode);
+  doc["deviceId"] = formatLanId(lanDeviceId());
+  if (lanLeaderId() != 0) doc["leaderId"] = formatLanId(lanLeaderId());
+  doc["role"] = isLanLeader() ? "leader" : isLanFed() ? "follower" : "standalone";
+  doc["peers"] = lanPeerCount();
+  doc["sharedSymbols"] = lanSharedSymbolCount();
+  
+  const LanStats& stats = lanStats();
+  JsonObject frames = doc["frames"].to<JsonObject>();
+  frames["sent"] = stats.framesSent;
+  frames["received"] = stats.framesReceived;
+  frames["bad"] = stats.badFrames;
+  frames["duplicates"] = stats.duplicates;
+  frames["lost"] = stats.lost;
+  doc["pricesApplied"] = stats.pricesApplied;
+  doc["leaderChanges"] = stats.leaderChanges;
+  
+  sendJson(doc);
+}
+
+// Журнал событий: /log или /log?since=<X-Log-Head прошлого ответа> для новых записей
+void handleLog() {
+  uint32_t since = server.hasArg("since") ? strtoul(server.arg("since").c_str(), NULL, 10) : 0;
+  uint32_t head = eventLogHead();
+  
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.sendHeader("X-Log-Head", String(head));
+  server.send(200, "text/plain", "");
+  
+  ChunkedResponse out;
+  printEventLog(out, since, head);
+  out.flush();
+  server.sendContent("");
+}
+
+// Свободная куча, наибольший блок и фрагментация во времени: /api/heap
+void handleHeap() {
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  ChunkedResponse out;
+  printHeapReport(out);
+  out.flush();
+  server.sendContent("");
+}
+
 void handleCSS() {
   String css = R"=====(
 body {
@@ -258,7 +1164,7 @@ form {
   margin-bottom: 15px;
 }
 
-input[type="text"], input[type="number"] {
+input[type="text"], input[type="number"], input[type="url"], input[type="password"], textarea, select {
   padding: 8px;
   border: 1px solid #ddd;
   border-radius: 4px;
@@ -9,6 +9,19 @@ void handleRemoveTicker();
 void handleUpdateThreshold();
 void handleUpdateSettings();
 void handleClearAll();
+void handleExport();
+void handleImport();
+void handleSearch();
+void handleJobs();
+void handlePower();
+void handleLog();
+void handleHeap();
+void handleLan();
+void handleChart();
+void handleUpstreams();
+void handleHistory();
+void handleFirmwareUpdate();
+void handleOtaStatus();
 void handleCSS();
 
 #endif
\ No newline at end of file